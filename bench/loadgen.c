@@ -0,0 +1,829 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * bench/loadgen.c - Synthetic Wayland client load generator
+ *
+ * Opens a number of xdg toplevels drawn into wl_shm buffers, and keeps
+ * redrawing them, either whenever a frame callback arrives or at a fixed
+ * rate. A fixed rate may ignore frame callbacks entirely, as a misbehaving
+ * client would. Every second it logs how many commits it made and how many
+ * frame callbacks it received, so the compositor's throttling and frame
+ * callback routing can be checked from the outside.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <wayland-client.h>
+
+#include "xdg-shell-client-protocol.h"
+
+/* Buffers per surface, so one can be drawn while the other is held */
+#define LOADGEN_BUFFERS 2
+
+/* Size of the moving square for --damage rect */
+#define LOADGEN_RECT_SIZE 64
+
+/* How often the rates are logged, in ms */
+#define LOADGEN_REPORT_MS 1000
+
+enum damage_pattern {
+    DAMAGE_FULL, /* Redraw and damage the whole surface */
+    DAMAGE_RECT, /* Move a small square, damaging where it was and is */
+    DAMAGE_NONE, /* Commit without drawing or damage */
+};
+
+struct buffer {
+    struct window *window; /* NULL for static content */
+    struct wl_buffer *wl_buffer;
+    uint32_t *data;
+    size_t size;
+    bool busy;
+    bool drawn;
+    int rect_x, rect_y; /* Where this buffer's square is */
+};
+
+/* A surface with static content: a subsurface or popup */
+struct child {
+    struct wl_surface *surface;
+    struct wl_subsurface *subsurface;
+    struct xdg_surface *xdg_surface;
+    struct xdg_popup *xdg_popup;
+    struct buffer buffer;
+};
+
+struct window {
+    struct loadgen *loadgen;
+    int index;
+
+    struct wl_surface *surface;
+    struct xdg_surface *xdg_surface;
+    struct xdg_toplevel *xdg_toplevel;
+    struct wl_callback *frame_callback;
+    struct buffer buffers[LOADGEN_BUFFERS];
+    bool configured;
+    bool waiting; /* For a buffer to be released before drawing */
+
+    struct child *subsurfaces;
+    struct child popup;
+
+    uint32_t frame;
+    int rect_x, rect_y; /* Where the last committed square was */
+
+    /* Since the last report */
+    uint32_t commits;
+    uint32_t callbacks;
+    uint32_t skipped;
+};
+
+struct loadgen {
+    struct wl_display *display;
+    struct wl_registry *registry;
+    struct wl_compositor *compositor;
+    struct wl_subcompositor *subcompositor;
+    struct wl_shm *shm;
+    struct xdg_wm_base *wm_base;
+
+    /* Options */
+    int window_count;
+    int first_index; /* Of the first toplevel, for its colour and title */
+    int width, height;
+    double rate; /* Commits per second, 0 to follow frame callbacks */
+    bool ignore_frames;
+    enum damage_pattern damage;
+    int subsurface_count;
+    bool popups;
+    bool per_window;
+
+    struct window *windows;
+    int buffer_serial;
+    bool running;
+};
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void window_draw(struct window *window);
+
+static void buffer_handle_release(void *data, struct wl_buffer *wl_buffer) {
+    (void)wl_buffer;
+    struct buffer *buffer = data;
+    buffer->busy = false;
+
+    /* Draw the frame that had no buffer to go in */
+    if (buffer->window && buffer->window->waiting) {
+        buffer->window->waiting = false;
+        window_draw(buffer->window);
+    }
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+    .release = buffer_handle_release,
+};
+
+static bool buffer_init(struct loadgen *loadgen, struct buffer *buffer,
+                        int width, int height) {
+    int stride = width * 4;
+    buffer->size = (size_t)stride * height;
+
+    char name[64];
+    snprintf(name, sizeof(name), "/infinidesk-loadgen-%d-%d", (int)getpid(),
+             loadgen->buffer_serial++);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create shm %s: %s\n", name,
+                strerror(errno));
+        return false;
+    }
+    shm_unlink(name);
+
+    if (ftruncate(fd, buffer->size) < 0) {
+        fprintf(stderr, "Failed to size shm: %s\n", strerror(errno));
+        close(fd);
+        return false;
+    }
+    buffer->data =
+        mmap(NULL, buffer->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (buffer->data == MAP_FAILED) {
+        fprintf(stderr, "Failed to map shm: %s\n", strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    struct wl_shm_pool *pool =
+        wl_shm_create_pool(loadgen->shm, fd, buffer->size);
+    buffer->wl_buffer = wl_shm_pool_create_buffer(
+        pool, 0, width, height, stride, WL_SHM_FORMAT_XRGB8888);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+
+    wl_buffer_add_listener(buffer->wl_buffer, &buffer_listener, buffer);
+    return true;
+}
+
+static void buffer_finish(struct buffer *buffer) {
+    if (buffer->wl_buffer) {
+        wl_buffer_destroy(buffer->wl_buffer);
+        munmap(buffer->data, buffer->size);
+    }
+}
+
+static void fill(struct buffer *buffer, int stride, int x, int y, int width,
+                 int height, uint32_t colour) {
+    for (int row = y; row < y + height; row++) {
+        uint32_t *pixel = &buffer->data[row * stride + x];
+        for (int col = 0; col < width; col++) {
+            pixel[col] = colour;
+        }
+    }
+}
+
+static uint32_t window_colour(struct window *window, uint32_t frame) {
+    uint32_t shade = (frame * 3 + window->index * 40) & 0xff;
+    return 0xff000000 | shade << 16 | (0xff - shade) << 8 | 0x80;
+}
+
+static void child_init(struct loadgen *loadgen, struct child *child,
+                       int width, int height, uint32_t colour) {
+    child->surface = wl_compositor_create_surface(loadgen->compositor);
+    if (buffer_init(loadgen, &child->buffer, width, height)) {
+        fill(&child->buffer, width, 0, 0, width, height, colour);
+    }
+}
+
+static void child_finish(struct child *child) {
+    if (child->xdg_popup) {
+        xdg_popup_destroy(child->xdg_popup);
+    }
+    if (child->xdg_surface) {
+        xdg_surface_destroy(child->xdg_surface);
+    }
+    if (child->subsurface) {
+        wl_subsurface_destroy(child->subsurface);
+    }
+    if (child->surface) {
+        wl_surface_destroy(child->surface);
+    }
+    buffer_finish(&child->buffer);
+    memset(child, 0, sizeof(*child));
+}
+
+static struct buffer *next_buffer(struct window *window) {
+    for (int i = 0; i < LOADGEN_BUFFERS; i++) {
+        if (!window->buffers[i].busy) {
+            return &window->buffers[i];
+        }
+    }
+    return NULL;
+}
+
+static void frame_handle_done(void *data, struct wl_callback *callback,
+                              uint32_t time);
+
+static const struct wl_callback_listener frame_listener = {
+    .done = frame_handle_done,
+};
+
+static void window_draw(struct window *window) {
+    struct loadgen *loadgen = window->loadgen;
+    int width = loadgen->width, height = loadgen->height;
+
+    struct buffer *buffer = next_buffer(window);
+    if (!buffer) {
+        /* The compositor still holds both buffers */
+        window->skipped++;
+        window->waiting = loadgen->rate == 0;
+        return;
+    }
+
+    uint32_t frame = window->frame++;
+    uint32_t background = window_colour(window, 0);
+    if (!buffer->drawn || loadgen->damage == DAMAGE_FULL) {
+        fill(buffer, width, 0, 0, width, height,
+             loadgen->damage == DAMAGE_FULL ? window_colour(window, frame)
+                                            : background);
+        wl_surface_damage_buffer(window->surface, 0, 0, width, height);
+        buffer->drawn = true;
+        buffer->rect_x = buffer->rect_y = -1;
+    }
+
+    if (loadgen->damage == DAMAGE_RECT && width > LOADGEN_RECT_SIZE &&
+        height > LOADGEN_RECT_SIZE) {
+        /* Bounce the square around, redrawing what this buffer lacks */
+        int range_x = width - LOADGEN_RECT_SIZE;
+        int range_y = height - LOADGEN_RECT_SIZE;
+        int x = (frame * 7) % (2 * range_x);
+        int y = (frame * 5) % (2 * range_y);
+        x = x < range_x ? x : 2 * range_x - x;
+        y = y < range_y ? y : 2 * range_y - y;
+
+        if (buffer->rect_x >= 0) {
+            fill(buffer, width, buffer->rect_x, buffer->rect_y,
+                 LOADGEN_RECT_SIZE, LOADGEN_RECT_SIZE, background);
+        }
+        fill(buffer, width, x, y, LOADGEN_RECT_SIZE, LOADGEN_RECT_SIZE,
+             0xffffffff);
+        buffer->rect_x = x;
+        buffer->rect_y = y;
+
+        if (window->rect_x >= 0) {
+            wl_surface_damage_buffer(window->surface, window->rect_x,
+                                     window->rect_y, LOADGEN_RECT_SIZE,
+                                     LOADGEN_RECT_SIZE);
+        }
+        wl_surface_damage_buffer(window->surface, x, y, LOADGEN_RECT_SIZE,
+                                 LOADGEN_RECT_SIZE);
+        window->rect_x = x;
+        window->rect_y = y;
+    }
+
+    /* Keep one callback outstanding, even when ignoring them */
+    if (!window->frame_callback) {
+        window->frame_callback = wl_surface_frame(window->surface);
+        wl_callback_add_listener(window->frame_callback, &frame_listener,
+                                 window);
+    }
+
+    wl_surface_attach(window->surface, buffer->wl_buffer, 0, 0);
+    wl_surface_commit(window->surface);
+    buffer->busy = true;
+    window->commits++;
+}
+
+static void popup_handle_configure(void *data, struct xdg_popup *xdg_popup,
+                                   int32_t x, int32_t y, int32_t width,
+                                   int32_t height) {
+    (void)data;
+    (void)xdg_popup;
+    (void)x;
+    (void)y;
+    (void)width;
+    (void)height;
+}
+
+static void popup_handle_done(void *data, struct xdg_popup *xdg_popup) {
+    (void)xdg_popup;
+    struct child *popup = data;
+    child_finish(popup);
+}
+
+static void popup_handle_repositioned(void *data, struct xdg_popup *xdg_popup,
+                                      uint32_t token) {
+    (void)data;
+    (void)xdg_popup;
+    (void)token;
+}
+
+static const struct xdg_popup_listener popup_listener = {
+    .configure = popup_handle_configure,
+    .popup_done = popup_handle_done,
+    .repositioned = popup_handle_repositioned,
+};
+
+static void popup_surface_handle_configure(void *data,
+                                           struct xdg_surface *xdg_surface,
+                                           uint32_t serial) {
+    struct child *popup = data;
+    xdg_surface_ack_configure(xdg_surface, serial);
+    wl_surface_attach(popup->surface, popup->buffer.wl_buffer, 0, 0);
+    wl_surface_damage_buffer(popup->surface, 0, 0, INT32_MAX, INT32_MAX);
+    wl_surface_commit(popup->surface);
+}
+
+static const struct xdg_surface_listener popup_surface_listener = {
+    .configure = popup_surface_handle_configure,
+};
+
+static void window_open_popup(struct window *window) {
+    struct loadgen *loadgen = window->loadgen;
+    int width = loadgen->width / 3, height = loadgen->height / 3;
+    struct child *popup = &window->popup;
+
+    child_init(loadgen, popup, width, height, 0xffffd040);
+    popup->xdg_surface =
+        xdg_wm_base_get_xdg_surface(loadgen->wm_base, popup->surface);
+    xdg_surface_add_listener(popup->xdg_surface, &popup_surface_listener,
+                             popup);
+
+    struct xdg_positioner *positioner =
+        xdg_wm_base_create_positioner(loadgen->wm_base);
+    xdg_positioner_set_size(positioner, width, height);
+    xdg_positioner_set_anchor_rect(positioner, 0, 0, loadgen->width / 4,
+                                   loadgen->height / 4);
+    xdg_positioner_set_anchor(positioner, XDG_POSITIONER_ANCHOR_BOTTOM_RIGHT);
+    xdg_positioner_set_gravity(positioner,
+                               XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT);
+    popup->xdg_popup = xdg_surface_get_popup(
+        popup->xdg_surface, window->xdg_surface, positioner);
+    xdg_positioner_destroy(positioner);
+
+    xdg_popup_add_listener(popup->xdg_popup, &popup_listener, popup);
+    wl_surface_commit(popup->surface);
+}
+
+static void frame_handle_done(void *data, struct wl_callback *callback,
+                              uint32_t time) {
+    (void)time;
+    struct window *window = data;
+
+    wl_callback_destroy(callback);
+    window->frame_callback = NULL;
+    window->callbacks++;
+
+    /* Without a fixed rate, draw each time the compositor asks */
+    if (window->loadgen->rate == 0) {
+        window_draw(window);
+    }
+}
+
+static void surface_handle_configure(void *data,
+                                     struct xdg_surface *xdg_surface,
+                                     uint32_t serial) {
+    struct window *window = data;
+    xdg_surface_ack_configure(xdg_surface, serial);
+
+    /* The first configure: draw for the first time */
+    if (!window->configured) {
+        window->configured = true;
+        window_draw(window);
+        if (window->loadgen->popups) {
+            window_open_popup(window);
+        }
+    }
+}
+
+static const struct xdg_surface_listener surface_listener = {
+    .configure = surface_handle_configure,
+};
+
+static void toplevel_handle_configure(void *data,
+                                      struct xdg_toplevel *xdg_toplevel,
+                                      int32_t width, int32_t height,
+                                      struct wl_array *states) {
+    /* The size is fixed by the options, whatever the compositor asks */
+    (void)data;
+    (void)xdg_toplevel;
+    (void)width;
+    (void)height;
+    (void)states;
+}
+
+static void toplevel_handle_close(void *data,
+                                  struct xdg_toplevel *xdg_toplevel) {
+    (void)xdg_toplevel;
+    struct window *window = data;
+    window->loadgen->running = false;
+}
+
+static void toplevel_handle_configure_bounds(void *data,
+                                             struct xdg_toplevel *xdg_toplevel,
+                                             int32_t width, int32_t height) {
+    (void)data;
+    (void)xdg_toplevel;
+    (void)width;
+    (void)height;
+}
+
+static void toplevel_handle_wm_capabilities(void *data,
+                                            struct xdg_toplevel *xdg_toplevel,
+                                            struct wl_array *capabilities) {
+    (void)data;
+    (void)xdg_toplevel;
+    (void)capabilities;
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+    .configure = toplevel_handle_configure,
+    .close = toplevel_handle_close,
+    .configure_bounds = toplevel_handle_configure_bounds,
+    .wm_capabilities = toplevel_handle_wm_capabilities,
+};
+
+static bool window_init(struct loadgen *loadgen, struct window *window,
+                        int index) {
+    window->loadgen = loadgen;
+    window->index = index;
+    window->rect_x = window->rect_y = -1;
+
+    for (int i = 0; i < LOADGEN_BUFFERS; i++) {
+        window->buffers[i].window = window;
+        if (!buffer_init(loadgen, &window->buffers[i], loadgen->width,
+                         loadgen->height)) {
+            return false;
+        }
+    }
+
+    window->surface = wl_compositor_create_surface(loadgen->compositor);
+    window->xdg_surface =
+        xdg_wm_base_get_xdg_surface(loadgen->wm_base, window->surface);
+    xdg_surface_add_listener(window->xdg_surface, &surface_listener, window);
+    window->xdg_toplevel = xdg_surface_get_toplevel(window->xdg_surface);
+    xdg_toplevel_add_listener(window->xdg_toplevel, &toplevel_listener,
+                              window);
+
+    char title[32];
+    snprintf(title, sizeof(title), "loadgen %d", index);
+    xdg_toplevel_set_title(window->xdg_toplevel, title);
+    xdg_toplevel_set_app_id(window->xdg_toplevel, "infinidesk-loadgen");
+
+    /* Subsurfaces are committed once, and applied with the first commit */
+    if (loadgen->subsurface_count > 0) {
+        window->subsurfaces =
+            calloc(loadgen->subsurface_count, sizeof(*window->subsurfaces));
+        if (!window->subsurfaces) {
+            return false;
+        }
+    }
+    for (int i = 0; i < loadgen->subsurface_count; i++) {
+        struct child *child = &window->subsurfaces[i];
+        int width = loadgen->width / 4, height = loadgen->height / 4;
+        child_init(loadgen, child, width, height,
+                   0xff202020 + (uint32_t)i * 0x00201008);
+        child->subsurface = wl_subcompositor_get_subsurface(
+            loadgen->subcompositor, child->surface, window->surface);
+        wl_subsurface_set_position(child->subsurface, 16 + i * 24,
+                                   16 + i * 24);
+        wl_surface_attach(child->surface, child->buffer.wl_buffer, 0, 0);
+        wl_surface_damage_buffer(child->surface, 0, 0, width, height);
+        wl_surface_commit(child->surface);
+    }
+
+    wl_surface_commit(window->surface);
+    return true;
+}
+
+static void window_finish(struct window *window) {
+    if (window->frame_callback) {
+        wl_callback_destroy(window->frame_callback);
+    }
+    child_finish(&window->popup);
+    if (window->subsurfaces) {
+        for (int i = 0; i < window->loadgen->subsurface_count; i++) {
+            child_finish(&window->subsurfaces[i]);
+        }
+        free(window->subsurfaces);
+    }
+    if (window->xdg_toplevel) {
+        xdg_toplevel_destroy(window->xdg_toplevel);
+    }
+    if (window->xdg_surface) {
+        xdg_surface_destroy(window->xdg_surface);
+    }
+    if (window->surface) {
+        wl_surface_destroy(window->surface);
+    }
+    for (int i = 0; i < LOADGEN_BUFFERS; i++) {
+        buffer_finish(&window->buffers[i]);
+    }
+}
+
+static void wm_base_handle_ping(void *data, struct xdg_wm_base *wm_base,
+                                uint32_t serial) {
+    (void)data;
+    xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+    .ping = wm_base_handle_ping,
+};
+
+static void registry_handle_global(void *data, struct wl_registry *registry,
+                                   uint32_t name, const char *interface,
+                                   uint32_t version) {
+    (void)version;
+    struct loadgen *loadgen = data;
+
+    if (strcmp(interface, wl_compositor_interface.name) == 0) {
+        loadgen->compositor =
+            wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+    } else if (strcmp(interface, wl_subcompositor_interface.name) == 0) {
+        loadgen->subcompositor =
+            wl_registry_bind(registry, name, &wl_subcompositor_interface, 1);
+    } else if (strcmp(interface, wl_shm_interface.name) == 0) {
+        loadgen->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+    } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+        loadgen->wm_base =
+            wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+        xdg_wm_base_add_listener(loadgen->wm_base, &wm_base_listener,
+                                 loadgen);
+    }
+}
+
+static void registry_handle_global_remove(void *data,
+                                          struct wl_registry *registry,
+                                          uint32_t name) {
+    (void)data;
+    (void)registry;
+    (void)name;
+}
+
+static const struct wl_registry_listener registry_listener = {
+    .global = registry_handle_global,
+    .global_remove = registry_handle_global_remove,
+};
+
+static void report(struct loadgen *loadgen, double seconds) {
+    uint32_t commits = 0, callbacks = 0, skipped = 0;
+    uint32_t min_callbacks = UINT32_MAX, max_callbacks = 0;
+
+    for (int i = 0; i < loadgen->window_count; i++) {
+        struct window *window = &loadgen->windows[i];
+        if (loadgen->per_window) {
+            fprintf(stderr,
+                    "loadgen: window %d: %.1f commits/s, %.1f frame "
+                    "callbacks/s, %.1f skipped/s\n",
+                    i, window->commits / seconds, window->callbacks / seconds,
+                    window->skipped / seconds);
+        }
+        commits += window->commits;
+        callbacks += window->callbacks;
+        skipped += window->skipped;
+        if (window->callbacks < min_callbacks) {
+            min_callbacks = window->callbacks;
+        }
+        if (window->callbacks > max_callbacks) {
+            max_callbacks = window->callbacks;
+        }
+        window->commits = window->callbacks = window->skipped = 0;
+    }
+
+    fprintf(stderr,
+            "loadgen: %d windows: %.1f commits/s, %.1f frame callbacks/s "
+            "(per window %.1f to %.1f), %.1f skipped/s\n",
+            loadgen->window_count, commits / seconds, callbacks / seconds,
+            min_callbacks / seconds, max_callbacks / seconds,
+            skipped / seconds);
+}
+
+static void print_usage(const char *prog_name) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "\n"
+            "Options:\n"
+            "  -n, --windows <n>      Toplevels to open (default 1)\n"
+            "  -s, --size <w>x<h>     Size of each toplevel (default "
+            "640x480)\n"
+            "  -r, --rate <hz>        Commit at a fixed rate instead of on\n"
+            "                         frame callbacks\n"
+            "  -i, --ignore-frames    With --rate, commit even while a "
+            "frame\n"
+            "                         callback is outstanding\n"
+            "  -d, --damage <kind>    full, rect or none (default full)\n"
+            "  -u, --subsurfaces <n>  Subsurfaces per toplevel (default 0)\n"
+            "  -p, --popups           Open a popup on each toplevel\n"
+            "  -w, --per-window       Log rates for each toplevel\n"
+            "  -o, --offset <n>       Number the toplevels from n, which\n"
+            "                         sets their colours and titles "
+            "(default 0)\n"
+            "  -h, --help             Show this help message\n",
+            prog_name);
+}
+
+int main(int argc, char *argv[]) {
+    struct loadgen loadgen = {
+        .window_count = 1,
+        .width = 640,
+        .height = 480,
+        .damage = DAMAGE_FULL,
+    };
+
+    static struct option long_options[] = {
+        {"windows", required_argument, NULL, 'n'},
+        {"size", required_argument, NULL, 's'},
+        {"rate", required_argument, NULL, 'r'},
+        {"ignore-frames", no_argument, NULL, 'i'},
+        {"damage", required_argument, NULL, 'd'},
+        {"subsurfaces", required_argument, NULL, 'u'},
+        {"popups", no_argument, NULL, 'p'},
+        {"per-window", no_argument, NULL, 'w'},
+        {"offset", required_argument, NULL, 'o'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:s:r:id:u:pwo:h", long_options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'n':
+            loadgen.window_count = atoi(optarg);
+            break;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &loadgen.width, &loadgen.height) !=
+                2) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'r':
+            loadgen.rate = atof(optarg);
+            break;
+        case 'i':
+            loadgen.ignore_frames = true;
+            break;
+        case 'd':
+            if (strcmp(optarg, "full") == 0) {
+                loadgen.damage = DAMAGE_FULL;
+            } else if (strcmp(optarg, "rect") == 0) {
+                loadgen.damage = DAMAGE_RECT;
+            } else if (strcmp(optarg, "none") == 0) {
+                loadgen.damage = DAMAGE_NONE;
+            } else {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'u':
+            loadgen.subsurface_count = atoi(optarg);
+            break;
+        case 'p':
+            loadgen.popups = true;
+            break;
+        case 'w':
+            loadgen.per_window = true;
+            break;
+        case 'o':
+            loadgen.first_index = atoi(optarg);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (loadgen.window_count < 1 || loadgen.width < 1 || loadgen.height < 1 ||
+        loadgen.rate < 0 || loadgen.subsurface_count < 0 ||
+        loadgen.first_index < 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (loadgen.ignore_frames && loadgen.rate == 0) {
+        fprintf(stderr, "--ignore-frames needs --rate\n");
+        return EXIT_FAILURE;
+    }
+
+    loadgen.display = wl_display_connect(NULL);
+    if (!loadgen.display) {
+        fprintf(stderr, "Failed to connect to the Wayland display\n");
+        return EXIT_FAILURE;
+    }
+    loadgen.registry = wl_display_get_registry(loadgen.display);
+    wl_registry_add_listener(loadgen.registry, &registry_listener, &loadgen);
+    wl_display_roundtrip(loadgen.display);
+    if (!loadgen.compositor || !loadgen.shm || !loadgen.wm_base ||
+        (loadgen.subsurface_count > 0 && !loadgen.subcompositor)) {
+        fprintf(stderr, "Compositor is missing a required global\n");
+        return EXIT_FAILURE;
+    }
+
+    loadgen.windows = calloc(loadgen.window_count, sizeof(*loadgen.windows));
+    if (!loadgen.windows) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < loadgen.window_count; i++) {
+        if (!window_init(&loadgen, &loadgen.windows[i],
+                         loadgen.first_index + i)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    uint64_t now = get_time_ns();
+    uint64_t interval_ns = loadgen.rate > 0 ? 1e9 / loadgen.rate : 0;
+    uint64_t next_commit_ns = now + interval_ns;
+    uint64_t last_report_ns = now;
+    uint64_t next_report_ns = now + (uint64_t)LOADGEN_REPORT_MS * 1000000;
+
+    struct pollfd pfd = {
+        .fd = wl_display_get_fd(loadgen.display),
+        .events = POLLIN,
+    };
+
+    loadgen.running = true;
+    int status = EXIT_SUCCESS;
+    while (loadgen.running) {
+        while (wl_display_prepare_read(loadgen.display) != 0) {
+            wl_display_dispatch_pending(loadgen.display);
+        }
+        wl_display_flush(loadgen.display);
+
+        /* Sleep until the next commit or report is due */
+        now = get_time_ns();
+        uint64_t wake_ns = next_report_ns;
+        if (interval_ns > 0 && next_commit_ns < wake_ns) {
+            wake_ns = next_commit_ns;
+        }
+        /* Round up, or the last ms before a wake is spent spinning */
+        int timeout_ms =
+            wake_ns > now ? (int)((wake_ns - now + 999999) / 1000000) : 0;
+
+        if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR) {
+            wl_display_cancel_read(loadgen.display);
+            status = EXIT_FAILURE;
+            break;
+        }
+        if (pfd.revents & POLLIN) {
+            wl_display_read_events(loadgen.display);
+        } else {
+            wl_display_cancel_read(loadgen.display);
+        }
+        if (wl_display_dispatch_pending(loadgen.display) < 0) {
+            fprintf(stderr, "Lost the connection to the compositor\n");
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        now = get_time_ns();
+        if (interval_ns > 0 && now >= next_commit_ns) {
+            for (int i = 0; i < loadgen.window_count; i++) {
+                struct window *window = &loadgen.windows[i];
+                if (!window->configured) {
+                    continue;
+                }
+                if (window->frame_callback && !loadgen.ignore_frames) {
+                    /* Not asked for a frame yet */
+                    window->skipped++;
+                    continue;
+                }
+                window_draw(window);
+            }
+            /* Don't try to catch up on missed commits */
+            next_commit_ns += interval_ns;
+            if (next_commit_ns < now) {
+                next_commit_ns = now + interval_ns;
+            }
+        }
+
+        if (now >= next_report_ns) {
+            report(&loadgen, (now - last_report_ns) / 1e9);
+            last_report_ns = now;
+            next_report_ns = now + (uint64_t)LOADGEN_REPORT_MS * 1000000;
+        }
+    }
+
+    for (int i = 0; i < loadgen.window_count; i++) {
+        window_finish(&loadgen.windows[i]);
+    }
+    free(loadgen.windows);
+    wl_display_disconnect(loadgen.display);
+    return status;
+}
@@ -0,0 +1,153 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * bench/point_transform.c - Throughput of the stroke point transform
+ *
+ * Compares point_transform_batch() with the per-segment scalar transform
+ * the stroke renderer used before, over the same points, and checks that
+ * both give the same results.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "infinidesk/point_transform.h"
+#include "infinidesk/stroke.h"
+
+#define BENCH_POINTS (1 << 20)
+#define BENCH_BATCH 128
+#define BENCH_ROUNDS 20
+
+/* Stand-in for canvas_to_screen(), kept out of line as it is in canvas.c */
+__attribute__((noinline)) static void
+to_screen(double viewport_x, double viewport_y, double scale, double x,
+          double y, double *screen_x, double *screen_y) {
+    *screen_x = (x - viewport_x) * scale;
+    *screen_y = (y - viewport_y) * scale;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Transform each segment's two ends separately, as render_stroke() did */
+static double run_scalar(const struct drawing_point *points, uint32_t count,
+                         double origin_x, double origin_y, double scale,
+                         double output_scale, double *out_x, double *out_y,
+                         double *lengths) {
+    double sum = 0.0;
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        double x1, y1, x2, y2;
+        to_screen(0.0, 0.0, scale, origin_x + points[i].x,
+                  origin_y + points[i].y, &x1, &y1);
+        to_screen(0.0, 0.0, scale, origin_x + points[i + 1].x,
+                  origin_y + points[i + 1].y, &x2, &y2);
+        x1 *= output_scale;
+        y1 *= output_scale;
+        x2 *= output_scale;
+        y2 *= output_scale;
+        double dx = x2 - x1;
+        double dy = y2 - y1;
+        lengths[i] = sqrt(dx * dx + dy * dy);
+        out_x[i] = x1;
+        out_y[i] = y1;
+        sum += lengths[i];
+    }
+    return sum;
+}
+
+/* Transform in batches, carrying the last point over as the renderer does */
+static double run_batch(const struct drawing_point *points, uint32_t count,
+                        const struct point_transform *transform,
+                        double *out_x, double *out_y, double *lengths) {
+    double sum = 0.0;
+    for (uint32_t start = 0; start + 1 < count; start += BENCH_BATCH - 1) {
+        uint32_t n = count - start < BENCH_BATCH ? count - start
+                                                  : BENCH_BATCH;
+        point_transform_batch(transform, &points[start], n, &out_x[start],
+                              &out_y[start], &lengths[start]);
+        for (uint32_t i = 0; i + 1 < n; i++) {
+            sum += lengths[start + i];
+        }
+    }
+    return sum;
+}
+
+int main(void) {
+    struct drawing_point *points = malloc(BENCH_POINTS * sizeof(*points));
+    double *buffers[6];
+    for (int i = 0; i < 6; i++) {
+        buffers[i] = malloc(BENCH_POINTS * sizeof(double));
+    }
+    if (!points || !buffers[0] || !buffers[1] || !buffers[2] ||
+        !buffers[3] || !buffers[4] || !buffers[5]) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    /* A random walk, like a long pen stroke */
+    srand(1);
+    float x = 0.0f, y = 0.0f;
+    for (uint32_t i = 0; i < BENCH_POINTS; i++) {
+        x += (float)(rand() % 1000) / 100.0f - 5.0f;
+        y += (float)(rand() % 1000) / 100.0f - 5.0f;
+        points[i] = (struct drawing_point){x, y};
+    }
+
+    /*
+     * The batch path transforms the origin once, so the two paths round
+     * differently; results are compared with a small tolerance.
+     */
+    double scale = 1.5;
+    double output_scale = 2.0;
+    double origin_x = 1024.0, origin_y = -512.0;
+    struct point_transform transform = {
+        .base_x = origin_x * scale * output_scale,
+        .base_y = origin_y * scale * output_scale,
+        .scale = scale * output_scale,
+    };
+
+    double scalar_time = 0.0, batch_time = 0.0;
+    double scalar_sum = 0.0, batch_sum = 0.0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        double start = now_seconds();
+        scalar_sum += run_scalar(points, BENCH_POINTS, origin_x, origin_y,
+                                 scale, output_scale, buffers[0], buffers[1],
+                                 buffers[2]);
+        double middle = now_seconds();
+        batch_sum += run_batch(points, BENCH_POINTS, &transform, buffers[3],
+                               buffers[4], buffers[5]);
+        batch_time += now_seconds() - middle;
+        scalar_time += middle - start;
+    }
+
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i + 1 < BENCH_POINTS; i++) {
+        if (fabs(buffers[0][i] - buffers[3][i]) > 1e-6 ||
+            fabs(buffers[1][i] - buffers[4][i]) > 1e-6 ||
+            fabs(buffers[2][i] - buffers[5][i]) > 1e-6) {
+            mismatches++;
+        }
+    }
+
+    double total = (double)BENCH_POINTS * BENCH_ROUNDS;
+    printf("scalar: %8.1f Mpoints/s\n", total / scalar_time / 1e6);
+    printf("batch:  %8.1f Mpoints/s (%.2fx)\n", total / batch_time / 1e6,
+           scalar_time / batch_time);
+    printf("length checksum: %.6g vs %.6g, %u mismatched points\n",
+           scalar_sum, batch_sum, mismatches);
+
+    for (int i = 0; i < 6; i++) {
+        free(buffers[i]);
+    }
+    free(points);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * bench/strokes.c - Scaling of stroke indexing, culling and rendering
+ *
+ * Builds canvases of 10 to 10000 finished strokes and times what a frame of
+ * the drawing layer does with them: querying the stroke index for the
+ * visible strokes, sorting them into stacking order and turning them into
+ * rectangles. Rendering goes to a pass that only counts what it is given,
+ * so the figures are the compositor's own work, not the GPU's.
+ *
+ * Frames are timed zoomed in, where the strokes on screen stay about the
+ * same however many there are, and zoomed right out, where every stroke is
+ * on screen and levels of detail do the work.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "infinidesk/point_transform.h"
+#include "infinidesk/stroke.h"
+#include "infinidesk/stroke_index.h"
+#include "infinidesk/stroke_render.h"
+
+/* Minimum time spent measuring each view at each size */
+#define BENCH_SECONDS 0.2
+/* Points drawn per stroke, before simplification */
+#define BENCH_STROKE_POINTS 200
+/* Output the canvas is viewed on */
+#define BENCH_OUTPUT_WIDTH 1920
+#define BENCH_OUTPUT_HEIGHT 1080
+
+/* As the drawing layer finishes strokes drawn at 100% */
+#define BENCH_SIMPLIFY_TOLERANCE 0.75
+#define BENCH_POINT_QUANTUM 0.25f
+#define BENCH_INDEX_CELL_SIZE 256.0
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const uint32_t sizes[] = {10, 100, 1000, 10000};
+
+/* Render pass standing in for wlroots', counting the commands it gets */
+struct command_count {
+    uint64_t rects;
+    uint64_t pixels;
+};
+
+struct bench_frame {
+    struct stroke_index *index;
+    struct drawing_stroke **visible;
+    uint32_t visible_count;
+
+    double viewport_x, viewport_y;
+    double scale;
+    double min_x, min_y, max_x, max_y;
+
+    struct command_count commands;
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double random_between(double min, double max) {
+    return min + (max - min) * ((double)rand() / RAND_MAX);
+}
+
+static void count_rect(void *data, const struct stroke_rect *rect,
+                       const struct drawing_color *color) {
+    (void)color;
+    struct command_count *count = data;
+    count->rects++;
+    count->pixels += (uint64_t)rect->width * rect->height;
+}
+
+/*
+ * Draw a wavy stroke at a random spot of a square canvas, then finish it
+ * as the drawing layer would.
+ */
+static struct drawing_stroke *make_stroke(double side, uint64_t id) {
+    double x = random_between(-side / 2.0, side / 2.0);
+    double y = random_between(-side / 2.0, side / 2.0);
+    struct drawing_stroke *stroke = stroke_create(x, y, COLOR_BLUE);
+    if (!stroke) {
+        return NULL;
+    }
+    stroke->id = id;
+    stroke->z = id;
+
+    double heading = random_between(0.0, 2.0 * M_PI);
+    for (int i = 0; i < BENCH_STROKE_POINTS; i++) {
+        if (!stroke_append_point(stroke, x, y)) {
+            stroke_destroy(stroke);
+            return NULL;
+        }
+        heading += random_between(-0.3, 0.3);
+        x += 3.0 * cos(heading);
+        y += 3.0 * sin(heading);
+    }
+
+    if (stroke_simplify(stroke, BENCH_SIMPLIFY_TOLERANCE)) {
+        stroke->smooth = true;
+        stroke->tolerance = (float)BENCH_SIMPLIFY_TOLERANCE;
+    }
+    stroke_pack(stroke, BENCH_POINT_QUANTUM);
+    stroke_compute_bounds(stroke);
+    /* Levels are built as the compositor does when a stroke ends */
+    stroke->lods_built = true;
+    if (stroke->tolerance > 0.0f) {
+        stroke_build_lods(stroke, stroke->tolerance);
+    }
+    return stroke;
+}
+
+static void collect_visible(struct drawing_stroke *stroke, void *data) {
+    struct bench_frame *frame = data;
+
+    /* The index works per cell, so check the stroke's own bounds too */
+    if (stroke->origin_x + stroke->max_x < frame->min_x ||
+        stroke->origin_x + stroke->min_x > frame->max_x ||
+        stroke->origin_y + stroke->max_y < frame->min_y ||
+        stroke->origin_y + stroke->min_y > frame->max_y) {
+        return;
+    }
+    frame->visible[frame->visible_count++] = stroke;
+}
+
+/* The drawing layer's part of rendering one frame */
+static void render_frame(struct bench_frame *frame) {
+    frame->visible_count = 0;
+    stroke_index_query_strokes(frame->index, frame->min_x, frame->min_y,
+                               frame->max_x, frame->max_y, collect_visible,
+                               frame);
+    stroke_sort_z(frame->visible, frame->visible_count);
+
+    struct stroke_pass pass = {
+        .add_rect = count_rect,
+        .data = &frame->commands,
+    };
+    for (uint32_t i = 0; i < frame->visible_count; i++) {
+        struct drawing_stroke *stroke = frame->visible[i];
+        struct point_transform transform = {
+            .base_x = (stroke->origin_x - frame->viewport_x) * frame->scale,
+            .base_y = (stroke->origin_y - frame->viewport_y) * frame->scale,
+            .scale = frame->scale,
+        };
+        stroke_render(&pass, stroke, &transform, 1.0);
+    }
+}
+
+/* View the canvas centred on the origin at the given scale */
+static void set_view(struct bench_frame *frame, double scale) {
+    double width = BENCH_OUTPUT_WIDTH / scale;
+    double height = BENCH_OUTPUT_HEIGHT / scale;
+    frame->scale = scale;
+    frame->viewport_x = -width / 2.0;
+    frame->viewport_y = -height / 2.0;
+
+    /* Padded by half a line, as the drawing layer does */
+    double pad = STROKE_LINE_WIDTH / 2.0 + 1.0 / scale;
+    frame->min_x = frame->viewport_x - pad;
+    frame->min_y = frame->viewport_y - pad;
+    frame->max_x = frame->viewport_x + width + pad;
+    frame->max_y = frame->viewport_y + height + pad;
+}
+
+/* Render frames for at least BENCH_SECONDS, returning the time per frame */
+static double time_frames(struct bench_frame *frame, uint64_t *frames) {
+    /* The first frame zoomed out builds levels of detail; don't count it */
+    render_frame(frame);
+    frame->commands = (struct command_count){0};
+
+    *frames = 0;
+    double start = now_seconds();
+    double elapsed;
+    do {
+        render_frame(frame);
+        (*frames)++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < BENCH_SECONDS);
+    return elapsed / *frames;
+}
+
+int main(void) {
+    srand(1);
+    printf("%-8s %7s %12s %10s %10s %12s\n", "view", "strokes",
+           "us/frame", "visible", "rects", "index ms");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint32_t count = sizes[s];
+
+        /* About 5 strokes per screenful at 100%, however many there are */
+        double side = sqrt(count / 5.0) * BENCH_OUTPUT_WIDTH;
+        struct drawing_stroke **strokes = calloc(count, sizeof(*strokes));
+        struct drawing_stroke **visible = calloc(count, sizeof(*visible));
+        if (!strokes || !visible) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            strokes[i] = make_stroke(side, i);
+            if (!strokes[i]) {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+        }
+
+        struct stroke_index index;
+        stroke_index_init(&index, BENCH_INDEX_CELL_SIZE);
+        double start = now_seconds();
+        for (uint32_t i = 0; i < count; i++) {
+            if (!stroke_index_insert(&index, strokes[i])) {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+        }
+        double index_time = now_seconds() - start;
+
+        struct bench_frame frame = {
+            .index = &index,
+            .visible = visible,
+        };
+        static const struct {
+            const char *name;
+            bool fit; /* Zoomed out to show every stroke */
+        } views[] = {
+            {"100%", false},
+            {"fit", true},
+        };
+        for (size_t v = 0; v < sizeof(views) / sizeof(views[0]); v++) {
+            set_view(&frame, views[v].fit ? BENCH_OUTPUT_HEIGHT / side : 1.0);
+            uint64_t frames;
+            double seconds = time_frames(&frame, &frames);
+            printf("%-8s %7u %12.1f %10u %10llu %12.2f\n", views[v].name,
+                   count, seconds * 1e6, frame.visible_count,
+                   (unsigned long long)(frame.commands.rects / frames),
+                   index_time * 1e3);
+        }
+
+        stroke_index_finish(&index);
+        for (uint32_t i = 0; i < count; i++) {
+            stroke_destroy(strokes[i]);
+        }
+        free(strokes);
+        free(visible);
+    }
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * bench/views.c - Scaling of view positioning, hit testing and gathering
+ *
+ * Times the per-view work the compositor does, on 10 to 10000 windows
+ * scattered over the canvas:
+ *
+ *   reposition  canvas_to_screen() for every view, as after a pan or zoom
+ *   rebuild     refilling the view cache
+ *   hit-test    one server_view_at()-style lookup of a cursor position
+ *   cull        finding the views on a 1920x1080 output
+ *   gather      views_gather()'s layout of every window
+ *
+ * Each is reported in ns per call, and per view, so that a change in how
+ * anything scales shows up as the per-view figure growing with the count.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <wlr/util/box.h>
+
+#include "infinidesk/canvas.h"
+#include "infinidesk/gather.h"
+#include "infinidesk/view_cache.h"
+
+/* Minimum time spent measuring each operation at each size */
+#define BENCH_SECONDS 0.2
+/* Cursor positions cycled through by the hit test */
+#define BENCH_CURSORS 256
+/* Output the canvas is viewed on */
+#define BENCH_OUTPUT_WIDTH 1920
+#define BENCH_OUTPUT_HEIGHT 1080
+
+static const uint32_t sizes[] = {10, 100, 1000, 10000};
+
+struct bench_state {
+    struct infinidesk_canvas canvas;
+    struct view_cache cache;
+
+    uint32_t count;
+    struct gather_box *boxes;   /* Where the views are */
+    struct gather_box *scratch; /* Moved about by gather */
+    struct wlr_box *geo, *extents;
+
+    double cursor_x[BENCH_CURSORS];
+    double cursor_y[BENCH_CURSORS];
+    uint32_t next_cursor;
+
+    /* Accumulates results, so none of the work can be optimised out */
+    uint64_t checksum;
+};
+
+typedef void (*bench_func_t)(struct bench_state *state);
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double random_between(double min, double max) {
+    return min + (max - min) * ((double)rand() / RAND_MAX);
+}
+
+static void run_reposition(struct bench_state *state) {
+    for (uint32_t i = 0; i < state->count; i++) {
+        double x, y;
+        canvas_to_screen(&state->canvas, state->boxes[i].x,
+                         state->boxes[i].y, &x, &y);
+        state->checksum += (uint64_t)(int64_t)x ^ (uint64_t)(int64_t)y;
+    }
+}
+
+static void run_rebuild(struct bench_state *state) {
+    view_cache_reset(&state->cache, state->count);
+    for (uint32_t i = 0; i < state->count; i++) {
+        view_cache_add(&state->cache, NULL, state->boxes[i].x,
+                       state->boxes[i].y, &state->geo[i],
+                       &state->extents[i]);
+    }
+    state->checksum += state->cache.count;
+}
+
+static void run_hit_test(struct bench_state *state) {
+    uint32_t cursor = state->next_cursor++ % BENCH_CURSORS;
+    double cx, cy;
+    screen_to_canvas(&state->canvas, state->cursor_x[cursor],
+                     state->cursor_y[cursor], &cx, &cy);
+    state->checksum += (uint64_t)view_cache_find(&state->cache, 0, cx, cy,
+                                                 0.0);
+}
+
+static void run_cull(struct bench_state *state) {
+    struct infinidesk_canvas *canvas = &state->canvas;
+    state->checksum += view_cache_cull(
+        &state->cache, canvas->viewport_x, canvas->viewport_y,
+        canvas->viewport_x + BENCH_OUTPUT_WIDTH / canvas->scale,
+        canvas->viewport_y + BENCH_OUTPUT_HEIGHT / canvas->scale);
+}
+
+static void run_gather(struct bench_state *state) {
+    memcpy(state->scratch, state->boxes,
+           state->count * sizeof(*state->scratch));
+    double centroid_x, centroid_y;
+    gather_boxes(state->scratch, state->count, 20.0, &centroid_x,
+                 &centroid_y);
+    state->checksum += (uint64_t)(int64_t)state->scratch[0].x;
+}
+
+/* Call func for at least BENCH_SECONDS, returning its time per call */
+static double time_per_call(bench_func_t func, struct bench_state *state) {
+    uint64_t calls = 0;
+    double start = now_seconds();
+    double elapsed;
+    do {
+        for (int i = 0; i < 16; i++) {
+            func(state);
+        }
+        calls += 16;
+        elapsed = now_seconds() - start;
+    } while (elapsed < BENCH_SECONDS);
+    return elapsed / calls;
+}
+
+/*
+ * Scatter count windows of typical sizes over a square of canvas that
+ * grows with the count, so the number on screen stays roughly constant.
+ */
+static bool setup(struct bench_state *state, uint32_t count) {
+    state->count = count;
+    state->boxes = calloc(count, sizeof(*state->boxes));
+    state->scratch = calloc(count, sizeof(*state->scratch));
+    state->geo = calloc(count, sizeof(*state->geo));
+    state->extents = calloc(count, sizeof(*state->extents));
+    if (!state->boxes || !state->scratch || !state->geo ||
+        !state->extents) {
+        return false;
+    }
+
+    double side = 1000.0 * sqrt(count) + 2000.0;
+    for (uint32_t i = 0; i < count; i++) {
+        double width = random_between(400.0, 1200.0);
+        double height = random_between(300.0, 900.0);
+        state->boxes[i] = (struct gather_box){
+            .x = random_between(-side / 2.0, side / 2.0),
+            .y = random_between(-side / 2.0, side / 2.0),
+            .width = (int)width,
+            .height = (int)height,
+        };
+
+        /* Client-side decorations: a shadow around the window geometry */
+        state->geo[i] = (struct wlr_box){
+            .x = 24,
+            .y = 24,
+            .width = (int)width,
+            .height = (int)height,
+        };
+        state->extents[i] = (struct wlr_box){
+            .x = 0,
+            .y = 0,
+            .width = (int)width + 48,
+            .height = (int)height + 48,
+        };
+    }
+
+    /* Zoomed out on the middle of the windows */
+    state->canvas = (struct infinidesk_canvas){
+        .viewport_x = -BENCH_OUTPUT_WIDTH / 2.0,
+        .viewport_y = -BENCH_OUTPUT_HEIGHT / 2.0,
+        .scale = 1.0,
+    };
+    canvas_scale_about(&state->canvas, 0.5, BENCH_OUTPUT_WIDTH / 2.0,
+                       BENCH_OUTPUT_HEIGHT / 2.0);
+    for (uint32_t i = 0; i < BENCH_CURSORS; i++) {
+        state->cursor_x[i] = random_between(0.0, BENCH_OUTPUT_WIDTH);
+        state->cursor_y[i] = random_between(0.0, BENCH_OUTPUT_HEIGHT);
+    }
+
+    view_cache_init(&state->cache);
+    run_rebuild(state);
+    return true;
+}
+
+static void teardown(struct bench_state *state) {
+    view_cache_finish(&state->cache);
+    free(state->boxes);
+    free(state->scratch);
+    free(state->geo);
+    free(state->extents);
+}
+
+int main(void) {
+    static const struct {
+        const char *name;
+        bench_func_t func;
+    } ops[] = {
+        {"reposition", run_reposition},
+        {"rebuild", run_rebuild},
+        {"hit-test", run_hit_test},
+        {"cull", run_cull},
+        {"gather", run_gather},
+    };
+    const size_t op_count = sizeof(ops) / sizeof(ops[0]);
+
+    srand(1);
+    uint64_t checksum = 0;
+
+    printf("%-12s %6s %14s %12s\n", "operation", "views", "ns/call",
+           "ns/view");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        struct bench_state state = {0};
+        if (!setup(&state, sizes[s])) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+
+        for (size_t o = 0; o < op_count; o++) {
+            double seconds = time_per_call(ops[o].func, &state);
+            printf("%-12s %6u %14.1f %12.2f\n", ops[o].name, sizes[s],
+                   seconds * 1e9, seconds * 1e9 / sizes[s]);
+        }
+
+        checksum += state.checksum;
+        teardown(&state);
+    }
+
+    printf("checksum: %llu\n", (unsigned long long)checksum);
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * bench.h - Headless benchmark scenario
+ */
+
+#ifndef INFINIDESK_BENCH_H
+#define INFINIDESK_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <wayland-server-core.h>
+
+#include "infinidesk/scratch.h"
+
+/* Forward declarations */
+struct infinidesk_output;
+struct infinidesk_replay;
+struct infinidesk_server;
+struct wlr_output;
+
+/* The output the scenario renders to, unless replaying a recording */
+#define BENCH_OUTPUT_WIDTH 1920
+#define BENCH_OUTPUT_HEIGHT 1080
+
+/* Frames measured per scripted phase, 5 s at the headless backend's 60 Hz */
+#define BENCH_PHASE_FRAMES 300
+
+/* Frames rendered before measuring, and how long to wait for windows */
+#define BENCH_WARMUP_FRAMES 30
+#define BENCH_WINDOW_TIMEOUT_MS 10000
+
+/* Give up if the whole run takes longer than this */
+#define BENCH_TIMEOUT_MS 120000
+
+/* Phases of the scenario, run in order */
+enum bench_phase {
+    BENCH_IDLE,     /* Nothing changing */
+    BENCH_PAN,      /* Panning in circles */
+    BENCH_ZOOM,     /* Zooming in and out about the centre */
+    BENCH_DRAW,     /* Drawing zigzag strokes */
+    BENCH_SWITCHER, /* Cycling through the Alt+Tab switcher */
+    BENCH_REPLAY,   /* A recorded session, instead of all the above */
+    BENCH_PHASE_COUNT,
+};
+
+/* Measurements from one phase */
+struct bench_result {
+    uint32_t *frame_ns;
+    uint32_t frames;
+    uint32_t capacity;
+    uint64_t cpu_ns;
+    long peak_rss_kb; /* Peak so far, at the end of the phase */
+};
+
+/*
+ * Headless benchmark run.
+ *
+ * The compositor runs on the headless backend with a single output of a
+ * fixed size, at the default configuration. Once the requested windows
+ * have mapped, each phase of the scenario drives the canvas directly for a
+ * fixed number of frames, timing every frame on the output. When the last
+ * phase finishes, the results are written as JSON and the compositor exits.
+ *
+ * Given a recording, the output takes the size it was recorded at, and
+ * the recording is replayed as the only phase.
+ */
+struct infinidesk_bench {
+    struct infinidesk_server *server;
+
+    /* Where to write the results, "-" for stdout */
+    const char *path;
+
+    /* Command run once per window, or NULL for none */
+    const char *client;
+    uint32_t windows;
+
+    /* Recording to replay instead of the scripted phases, or NULL */
+    struct infinidesk_replay *replay;
+
+    /* Data and config directories for the run, so the user's are left alone */
+    struct scratch_env env;
+
+    struct wlr_output *output;
+    uint32_t width, height;
+    struct wl_event_source *timeout;
+
+    /* Progress through the scenario */
+    bool started;
+    bool done;
+    enum bench_phase phase;
+    uint32_t frame;
+    uint64_t start_ns;
+
+    /* Results */
+    struct bench_result results[BENCH_PHASE_COUNT];
+    uint64_t phase_cpu_start_ns;
+    uint32_t views_mapped;
+    bool failed;
+};
+
+/*
+ * Set the environment up for the headless backend, a software renderer and
+ * a scratch data directory. Must be called before the server is
+ * initialised. Returns false on failure.
+ */
+bool bench_setup_env(struct infinidesk_bench *bench);
+
+/*
+ * Add the output and start the windows' clients, and the replay if there
+ * is one, once the server has started. Returns false on failure.
+ */
+bool bench_start(struct infinidesk_bench *bench,
+                 struct infinidesk_server *server);
+
+/*
+ * Clean up after the run.
+ */
+void bench_finish(struct infinidesk_bench *bench);
+
+/*
+ * Remove the scratch data directory. Must be called after the server has
+ * finished, as it saves the drawing layer there.
+ */
+void bench_cleanup_env(struct infinidesk_bench *bench);
+
+/*
+ * Record a rendered frame and advance the scenario.
+ */
+void bench_frame(struct infinidesk_bench *bench,
+                 struct infinidesk_output *output);
+
+#endif /* INFINIDESK_BENCH_H */
@@ -18,6 +18,11 @@ struct infinidesk_server;
 /* Animation duration for viewport snap (in milliseconds) */
 #define CANVAS_SNAP_DURATION_MS 800
 
+/* How far the viewport may stray from the canvas origin before rebasing */
+#define CANVAS_REBASE_DISTANCE 1048576.0
+/* Rebasing moves the origin by whole multiples of this many canvas units */
+#define CANVAS_REBASE_STEP 65536
+
 /*
  * The infinite canvas state.
  *
@@ -28,12 +33,24 @@ struct infinidesk_server;
  * - Coordinates are unbounded (can be any double value)
  *
  * The viewport represents what portion of the canvas is visible on screen.
+ *
+ * Canvas coordinates in memory are relative to a movable origin, so they
+ * stay small - and precise - however far the user pans. When the viewport
+ * strays too far from it, the origin jumps to near the viewport and
+ * everything positioned on the canvas is shifted to match. The jump is a
+ * multiple of CANVAS_REBASE_STEP, which every grid laid over the canvas
+ * (chunks, index cells) divides, so the grids stay aligned. Anything stored
+ * on disk is kept in absolute terms instead.
  */
 struct infinidesk_canvas {
     /* Viewport position in canvas coordinates (top-left corner) */
     double viewport_x;
     double viewport_y;
 
+    /* Absolute position of canvas coordinates (0, 0) */
+    int64_t origin_x;
+    int64_t origin_y;
+
     /* Zoom level (1.0 = 100%, 0.5 = zoomed out, 2.0 = zoomed in) */
     double scale;
 
@@ -113,6 +130,19 @@ void canvas_pan_delta(struct infinidesk_canvas *canvas, double delta_x,
 void canvas_zoom(struct infinidesk_canvas *canvas, double factor,
                  double focus_x, double focus_y);
 
+/*
+ * Clamp a zoom level to the range the canvas allows.
+ */
+double canvas_clamp_scale(double scale);
+
+/*
+ * Set the zoom level, moving the viewport so the canvas point under the
+ * screen point focus_x/focus_y stays there. Only the viewport changes;
+ * views are not repositioned.
+ */
+void canvas_scale_about(struct infinidesk_canvas *canvas, double scale,
+                        double focus_x, double focus_y);
+
 /*
  * Set the zoom level directly.
  * focus_x/focus_y are the screen coordinates to zoom towards.
@@ -134,6 +164,13 @@ void canvas_get_viewport_centre(struct infinidesk_canvas *canvas,
                                 int output_width, int output_height,
                                 double *centre_x, double *centre_y);
 
+/*
+ * Move the canvas origin near the viewport if it has strayed too far from
+ * it, shifting views and drawings to match. Call this between events, e.g.
+ * once per frame, as it invalidates any canvas coordinates held elsewhere.
+ */
+void canvas_rebase(struct infinidesk_canvas *canvas);
+
 /*
  * Update the viewport snap animation.
  * Call this each frame from the render loop.
@@ -0,0 +1,96 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * chunk_store.h - On-disk storage of canvas chunks
+ */
+
+#ifndef INFINIDESK_CHUNK_STORE_H
+#define INFINIDESK_CHUNK_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct wl_event_loop;
+
+/*
+ * File format
+ *
+ * The canvas is divided into square chunks, and the strokes of each chunk
+ * are stored in a file of their own, named <x>_<y>_<generation>.chunk.
+ * A chunk file is a chunk_file_header followed by journal records (see
+ * journal.h) for each stroke. Files are never modified: a changed chunk is
+ * written under a new generation, and the journal's manifest says which
+ * generation is current. Files it doesn't mention are deleted.
+ */
+
+#define CHUNK_MAGIC "INFCHNK1"
+#define CHUNK_VERSION 3
+
+struct chunk_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct chunk_store;
+
+/*
+ * Called on the main thread when a requested load finishes. records is the
+ * file's contents after the header, allocated with malloc() and owned by
+ * the callee, or NULL if the file couldn't be read.
+ */
+typedef void (*chunk_store_load_func_t)(int32_t x, int32_t y,
+                                        uint64_t generation, void *records,
+                                        size_t size, void *data);
+
+/*
+ * Called for each chunk file when collecting garbage. Return false to
+ * delete the file.
+ */
+typedef bool (*chunk_store_keep_func_t)(int32_t x, int32_t y,
+                                        uint64_t generation, void *data);
+
+/*
+ * Open the chunk directory (creating it if needed) and start the loader
+ * thread. Completed loads are delivered through the event loop.
+ * Returns NULL on error.
+ */
+struct chunk_store *chunk_store_create(const char *dir,
+                                       struct wl_event_loop *loop,
+                                       chunk_store_load_func_t callback,
+                                       void *data);
+
+/*
+ * Stop the loader thread, discarding loads that haven't been delivered.
+ */
+void chunk_store_destroy(struct chunk_store *store);
+
+/*
+ * Queue a chunk file to be read on the loader thread.
+ */
+bool chunk_store_request(struct chunk_store *store, int32_t x, int32_t y,
+                         uint64_t generation);
+
+/*
+ * Read a chunk file immediately. Returns its records (after the header),
+ * which the caller must free, or NULL on error.
+ */
+void *chunk_store_read(struct chunk_store *store, int32_t x, int32_t y,
+                       uint64_t generation, size_t *size);
+
+/*
+ * Durably write a chunk file holding the given records.
+ */
+bool chunk_store_write(struct chunk_store *store, int32_t x, int32_t y,
+                       uint64_t generation, const void *records, size_t size);
+
+/*
+ * Delete the chunk files that keep() rejects.
+ */
+void chunk_store_collect(struct chunk_store *store,
+                         chunk_store_keep_func_t keep, void *data);
+
+#endif /* INFINIDESK_CHUNK_STORE_H */
@@ -0,0 +1,86 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * client_stats.h - Per-client activity counters
+ */
+
+#ifndef INFINIDESK_CLIENT_STATS_H
+#define INFINIDESK_CLIENT_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <wayland-server-core.h>
+
+#include "infinidesk/commit_rate.h"
+
+struct infinidesk_server;
+struct wlr_surface;
+
+/* Default commit rate, in Hz, above which a client is throttled */
+#define CLIENT_DEFAULT_MAX_COMMIT_RATE 300
+
+/* Rate at which a throttled client's off-screen windows are serviced, in Hz */
+#define CLIENT_OFFSCREEN_RATE 10
+
+/*
+ * Counters for one connected client, created when it is first seen and
+ * freed when it disconnects. Found from the client through its destroy
+ * listener, so there is no table to search.
+ */
+struct client_stats {
+    struct wl_list link; /* infinidesk_server.clients */
+    struct wl_client *client;
+    struct wl_listener destroy;
+
+    pid_t pid;
+    char name[16]; /* Process name, as in /proc/<pid>/comm */
+
+    /* Toplevel and layer surface commits */
+    struct commit_rate rate;
+
+    /*
+     * Set once the client commits faster than the configured limit, and
+     * cleared when it has stayed well under it for a while. Meanwhile its
+     * windows' commits are handled once a frame rather than as they
+     * arrive, and less often still while they are off-screen.
+     */
+    bool throttled;
+    uint32_t throttle_changed_ms; /* When throttled was last set or cleared */
+    uint32_t throttle_episodes;
+    uint64_t coalesced; /* Commits deferred and merged into a later one */
+};
+
+/*
+ * Get a client's counters, creating them if need be. Returns NULL if they
+ * couldn't be allocated.
+ */
+struct client_stats *client_stats_get(struct infinidesk_server *server,
+                                      struct wl_client *client);
+
+/*
+ * Get a client's counters if it has any, without creating them.
+ */
+struct client_stats *client_stats_find(struct wl_client *client);
+
+/*
+ * Count a commit to one of a client's surfaces, and its damage, also
+ * adding it to view_rate if that isn't NULL, and decide whether the client
+ * is now throttled. Returns the client's counters, or NULL if they couldn't
+ * be allocated.
+ */
+struct client_stats *client_stats_commit(struct infinidesk_server *server,
+                                         struct wlr_surface *surface,
+                                         struct commit_rate *view_rate);
+
+/*
+ * Check whether a client is being throttled. This only reads the state,
+ * which client_stats_commit() keeps up to date, so a client that has gone
+ * quiet stays throttled until it next commits.
+ */
+bool client_stats_is_throttled(const struct client_stats *stats);
+
+#endif /* INFINIDESK_CLIENT_STATS_H */
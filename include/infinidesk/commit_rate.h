@@ -0,0 +1,62 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * commit_rate.h - Commit rates, and deciding when they are too high
+ */
+
+#ifndef INFINIDESK_COMMIT_RATE_H
+#define INFINIDESK_COMMIT_RATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Rates are measured over windows of this length, in ms */
+#define CLIENT_RATE_WINDOW_MS 1000
+
+/*
+ * A throttled client is only let off once its rate is below this percentage
+ * of the limit, and it has been throttled for at least CLIENT_THROTTLE_HOLD_MS,
+ * so a client committing at about the limit isn't throttled and let off
+ * every other window.
+ */
+#define CLIENT_THROTTLE_EXIT_PERCENT 75
+#define CLIENT_THROTTLE_HOLD_MS 5000
+
+/*
+ * Commit and damage totals, and their rates over the last measurement
+ * window. Damage is counted in buffer pixels.
+ */
+struct commit_rate {
+    uint64_t commits;
+    uint64_t damage;
+
+    uint32_t window_start_ms;
+    uint32_t window_commits;
+    uint64_t window_damage;
+
+    float commits_per_second;
+    float damage_per_second;
+};
+
+/*
+ * Move a rate's measurement window on, if it has ended.
+ */
+void commit_rate_update(struct commit_rate *rate, uint32_t now_ms);
+
+/*
+ * Count a commit with the given damage.
+ */
+void commit_rate_add(struct commit_rate *rate, uint32_t now_ms,
+                     uint64_t damage);
+
+/*
+ * Decide whether a client committing at rate should be throttled, given
+ * whether it is now and for how long it has been, in ms. limit is the
+ * commit rate in Hz above which clients are throttled, or 0 for none.
+ */
+bool commit_rate_over_limit(const struct commit_rate *rate, uint32_t limit,
+                            bool throttled, uint32_t held_ms);
+
+#endif /* INFINIDESK_COMMIT_RATE_H */
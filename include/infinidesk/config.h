@@ -47,6 +47,23 @@ struct infinidesk_config {
     /* Output scale factor (HiDPI scaling) */
     float scale;
 
+    /* Memory for annotations kept loaded, in MiB */
+    float annotation_memory;
+
+    /* Fraction of an output's refresh interval a frame may take to render */
+    float render_budget;
+    /* Stillness in ms before full render quality is restored */
+    uint32_t quality_settle_ms;
+
+    /* Main loop dispatches and frames longer than this (ms) are logged */
+    uint32_t stall_threshold_ms;
+
+    /* Serve metrics on a Unix socket for a local scraper */
+    bool metrics;
+
+    /* Clients committing faster than this (Hz) are throttled, 0 for never */
+    uint32_t max_commit_rate;
+
     /* Keybindings */
     struct keybind *keybinds;
     int keybind_count;
@@ -13,23 +13,35 @@
 #include <wayland-server-core.h>
 
 #include "infinidesk/drawing_ui.h"
+#include "infinidesk/journal.h"
+#include "infinidesk/render_governor.h"
+#include "infinidesk/stroke.h"
+#include "infinidesk/stroke_index.h"
 
 /* Forward declaration */
+struct chunk_store;
+struct drawing_chunk;
 struct infinidesk_server;
 struct wlr_render_pass;
 
-/* A point in canvas coordinates */
-struct drawing_point {
-    double x;
-    double y;
-    struct wl_list link; /* drawing_stroke.points */
+/* Drawing tools */
+enum drawing_tool {
+    DRAWING_TOOL_PEN = 0,
+    DRAWING_TOOL_ERASE_STROKE,  /* Erase every stroke touched */
+    DRAWING_TOOL_ERASE_PARTIAL, /* Erase only the segments touched */
 };
 
-/* A stroke - a continuous line made of multiple points */
-struct drawing_stroke {
-    struct wl_list points;      /* drawing_point.link */
-    struct wl_list link;        /* drawing_layer.strokes */
-    struct drawing_color color; /* Color of this stroke */
+/*
+ * An undoable change to the set of strokes on the canvas.
+ *
+ * Undoing an op removes the `added` strokes and restores the `removed` ones;
+ * redoing does the opposite. Strokes are moved, never copied, so the op
+ * owns whichever of the two sets is currently off the canvas.
+ */
+struct drawing_op {
+    struct wl_list link;     /* drawing_layer.undo_stack / redo_stack */
+    struct wl_array added;   /* struct drawing_stroke * */
+    struct wl_array removed; /* struct drawing_stroke * */
 };
 
 /* The drawing layer state */
@@ -40,30 +52,90 @@ struct drawing_layer {
     bool drawing_mode; /* Whether drawing mode is active */
     bool is_drawing;   /* Currently drawing a stroke */
 
-    /* Strokes list (in order of creation) */
-    struct wl_list strokes; /* drawing_stroke.link */
+    /* Canvas chunks, each holding the strokes on the canvas within it */
+    struct wl_list chunks; /* drawing_chunk.link */
 
-    /* Redo stack for undone strokes */
-    struct wl_list redo_stack; /* drawing_stroke.link */
+    /* Open-addressed table of the chunks, keyed by their coordinates */
+    struct drawing_chunk **chunk_table;
+    uint32_t chunk_capacity; /* Slots, a power of two */
+    uint32_t chunk_count;
+
+    /* Undo and redo history */
+    struct wl_list undo_stack; /* drawing_op.link */
+    struct wl_list redo_stack; /* drawing_op.link */
 
     /* Current stroke being drawn */
     struct drawing_stroke *current_stroke;
+    uint64_t next_stroke_id;
+
+    /* Spatial index of the completed strokes in the strokes list */
+    struct stroke_index index;
+
+    /* Scratch array of strokes visible on the output being rendered */
+    struct drawing_stroke **visible;
+    uint32_t visible_count;
+    uint32_t visible_capacity;
 
     /* Last cursor position (canvas coordinates) for stroke tracking */
     double last_canvas_x;
     double last_canvas_y;
 
-    /* Current drawing color */
+    /* Current drawing color and tool */
     struct drawing_color current_color;
+    enum drawing_tool tool;
+
+    /* Eraser state */
+    bool is_erasing;
+    struct drawing_op *current_erase; /* Changes made by this erase so far */
+    struct wl_array erase_hits;       /* Scratch, struct erase_hit */
+
+    /* On-disk journal of changes, NULL if it couldn't be opened */
+    struct journal *journal;
+    bool replaying;       /* Applying journal records; don't journal them */
+    bool journal_dirty;   /* Changed since the last checkpoint */
+    bool journal_damaged; /* Replay stopped at a bad record; keep the file */
+
+    /*
+     * Where the replay has got to. It pauses while a chunk it refers to is
+     * paged in by the loader thread, and the canvas can't be changed until
+     * it has finished.
+     */
+    struct journal_reader replay_reader;
+    const struct journal_stroke_begin *replay_begin;
+    struct drawing_stroke *replay_stroke; /* Decoded, awaiting its end */
+    struct wl_array replay_held;          /* Strokes for undo, held_stroke */
+    bool replay_history_lost; /* Skip the history up to the next checkpoint */
+
+    /* A checkpoint is taken between strokes once the journal grows this big */
+    size_t checkpoint_at;
+    struct wl_event_source *checkpoint_idle;
+    bool checkpointing; /* Chunk files and journal being written */
+
+    /* Builds levels of detail for loaded strokes (see drawing_chunk.h) */
+    struct wl_event_source *lod_timer;
+
+    /* Chunk files and paging (see drawing_chunk.h) */
+    struct chunk_store *chunk_store;
+    uint64_t chunk_generation; /* Of the newest chunk files */
+    size_t resident_memory;    /* Approximate bytes of resident chunks */
+    size_t memory_budget;      /* Unchanged chunks are evicted above this */
+
+    /* Viewport motion, for prefetching in the pan direction */
+    double page_x, page_y;
+    double page_velocity_x, page_velocity_y; /* Canvas units per second */
+    uint64_t page_time;                      /* ms */
 
     /* UI panel */
     struct drawing_ui_panel ui_panel;
 };
 
 /*
- * Initialize the drawing layer.
+ * Initialize the drawing layer and start restoring the saved annotations,
+ * which finishes once the chunks the journal refers to have been paged in.
+ * Returns false if they are in a journal this build can't read, which is
+ * left as it is rather than replaced.
  */
-void drawing_init(struct drawing_layer *drawing,
+bool drawing_init(struct drawing_layer *drawing,
                   struct infinidesk_server *server);
 
 /*
@@ -82,12 +154,12 @@ void drawing_toggle_mode(struct drawing_layer *drawing);
 void drawing_clear_all(struct drawing_layer *drawing);
 
 /*
- * Undo the last stroke.
+ * Undo the last stroke or erase.
  */
 void drawing_undo_last(struct drawing_layer *drawing);
 
 /*
- * Redo the last undone stroke.
+ * Redo the last undone stroke or erase.
  */
 void drawing_redo_last(struct drawing_layer *drawing);
 
@@ -108,12 +180,43 @@ void drawing_stroke_add_point(struct drawing_layer *drawing, double canvas_x,
  */
 void drawing_stroke_end(struct drawing_layer *drawing);
 
+/*
+ * Begin erasing at the given canvas coordinates with the current tool.
+ */
+void drawing_erase_begin(struct drawing_layer *drawing, double canvas_x,
+                         double canvas_y);
+
+/*
+ * Continue erasing along the path to the given canvas coordinates.
+ */
+void drawing_erase_update(struct drawing_layer *drawing, double canvas_x,
+                          double canvas_y);
+
+/*
+ * End the current erase, recording it as a single undoable operation.
+ */
+void drawing_erase_end(struct drawing_layer *drawing);
+
+/*
+ * Shift everything on the canvas by an offset in canvas coordinates, a
+ * whole multiple of CANVAS_REBASE_STEP, for when the canvas origin moves.
+ */
+void drawing_translate(struct drawing_layer *drawing, double dx, double dy);
+
+/*
+ * Count the strokes in memory, and their points.
+ */
+void drawing_count_strokes(struct drawing_layer *drawing, uint32_t *strokes,
+                           uint64_t *points);
+
 /*
  * Render all strokes to the given render pass.
  * This should be called during the output render cycle.
  * output_scale is the HiDPI scale factor for converting to physical pixels.
+ * quality says how much stroke detail may be dropped to render in time.
  */
 void drawing_render(struct drawing_layer *drawing, struct wlr_render_pass *pass,
-                    int output_width, int output_height, float output_scale);
+                    int output_width, int output_height, float output_scale,
+                    const struct render_quality *quality);
 
 #endif /* INFINIDESK_DRAWING_H */
@@ -0,0 +1,174 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * drawing_chunk.h - Paging of canvas chunks in and out of memory
+ */
+
+#ifndef INFINIDESK_DRAWING_CHUNK_H
+#define INFINIDESK_DRAWING_CHUNK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+#include "infinidesk/journal.h"
+
+struct drawing_layer;
+struct drawing_stroke;
+
+enum drawing_chunk_state {
+    DRAWING_CHUNK_UNLOADED, /* Only on disk */
+    DRAWING_CHUNK_LOADING,  /* Being read on the loader thread */
+    DRAWING_CHUNK_RESIDENT, /* Strokes are on the canvas */
+    DRAWING_CHUNK_FAILED,   /* Couldn't be read; not retried */
+};
+
+/*
+ * A square region of the canvas, holding the strokes whose origin lies in
+ * it. Chunks near a viewport are paged in from their file; distant ones are
+ * dropped again when over the memory budget, unless they have been changed
+ * since they were last written or the undo history refers to them.
+ */
+struct drawing_chunk {
+    struct wl_list link; /* drawing_layer.chunks */
+    int32_t x, y;
+    enum drawing_chunk_state state;
+
+    /* Generation of the chunk's file, or 0 if it has none */
+    uint64_t generation;
+
+    /* Canvas bounds of its strokes, loaded or not (empty if min > max) */
+    double min_x, min_y;
+    double max_x, max_y;
+
+    struct wl_list strokes; /* drawing_stroke.link, strokes on the canvas */
+    void *records;          /* Loaded file contents the strokes point into */
+    size_t memory;          /* Approximate bytes used while resident */
+
+    bool dirty;           /* Changed since its file was written */
+    bool saving;          /* Being written by a checkpoint in progress */
+    uint64_t last_wanted; /* When it was last near a viewport (ms) */
+    bool lods_pending;    /* Has strokes still without levels of detail */
+
+    /* References from undo history to its strokes; it stays while any do */
+    uint32_t history_refs;
+};
+
+/*
+ * Get the chunk containing a canvas position. Chunk coordinates are
+ * absolute, so they don't change when the canvas origin moves.
+ */
+void drawing_chunk_key(struct drawing_layer *drawing, double canvas_x,
+                       double canvas_y, int32_t *x, int32_t *y);
+
+/*
+ * Get the canvas position of the top-left corner of a chunk. Positions
+ * stored on disk are relative to this, so they stay precise wherever the
+ * chunk is.
+ */
+void drawing_chunk_corner(struct drawing_layer *drawing, int32_t x,
+                          int32_t y, double *canvas_x, double *canvas_y);
+
+/*
+ * Find a known chunk, or return NULL.
+ */
+struct drawing_chunk *drawing_chunk_find(struct drawing_layer *drawing,
+                                         int32_t x, int32_t y);
+
+/*
+ * Find or create a chunk. A new chunk is resident and empty; an existing
+ * one that isn't resident is requested from disk.
+ * Returns NULL on allocation failure.
+ */
+struct drawing_chunk *drawing_chunk_get(struct drawing_layer *drawing,
+                                        int32_t x, int32_t y);
+
+/*
+ * Add a chunk known from the journal manifest, to be paged in when needed.
+ */
+struct drawing_chunk *
+drawing_chunk_add_stored(struct drawing_layer *drawing,
+                         const struct journal_chunk *stored);
+
+/*
+ * Destroy a chunk and every stroke in it. History referring to the strokes
+ * must already be gone.
+ */
+void drawing_chunk_destroy(struct drawing_layer *drawing,
+                           struct drawing_chunk *chunk);
+
+/*
+ * Put a stroke on the canvas in its chunk (stroke->chunk), or take it off.
+ * These don't mark the chunk dirty.
+ */
+void drawing_chunk_attach(struct drawing_layer *drawing,
+                          struct drawing_stroke *stroke);
+void drawing_chunk_detach(struct drawing_layer *drawing,
+                          struct drawing_stroke *stroke);
+
+/*
+ * Set the bounds of a resident chunk from the strokes it holds.
+ */
+void drawing_chunk_compute_bounds(struct drawing_chunk *chunk);
+
+/*
+ * Page chunks for a viewport about to be drawn: request chunks near it,
+ * ahead of the direction it is moving in, and evict distant unchanged
+ * chunks while over the memory budget.
+ */
+void drawing_chunks_page(struct drawing_layer *drawing, double min_x,
+                         double min_y, double max_x, double max_y);
+
+/*
+ * Build levels of detail for strokes put on the canvas without them, such
+ * as those paged in or restored from the journal, a slice at a time between
+ * frames (the callback of drawing_layer.lod_timer).
+ */
+int drawing_chunk_handle_lod_timer(void *data);
+
+/*
+ * Deliver a chunk read on the loader thread, putting its strokes on the
+ * canvas unless it has been cleared, rewritten or read since it was
+ * requested.
+ */
+void drawing_chunk_handle_load(int32_t x, int32_t y, uint64_t generation,
+                               void *records, size_t size, void *data);
+
+/*
+ * Describe a finished stroke as a journal stroke record.
+ */
+void drawing_chunk_encode_begin(struct drawing_layer *drawing,
+                                const struct drawing_stroke *stroke,
+                                struct journal_stroke_begin *begin);
+
+/*
+ * Append the begin, points and end records of a stroke to a buffer, ending
+ * it with a record of type end: JOURNAL_STROKE_END, or
+ * JOURNAL_HISTORY_STROKE for one only the undo history holds.
+ * Returns false on allocation failure.
+ */
+bool drawing_chunk_encode_stroke(struct drawing_layer *drawing,
+                                 const struct drawing_stroke *stroke,
+                                 uint32_t end, struct wl_array *out);
+
+/*
+ * Append the records for every stroke in a chunk to a buffer, in the
+ * format of a chunk file. Returns false on allocation failure.
+ */
+bool drawing_chunk_encode(struct drawing_layer *drawing,
+                          struct drawing_chunk *chunk, struct wl_array *out);
+
+/*
+ * Create a stroke from its begin record and the payload of its points
+ * record, using the packed points in place. Returns NULL if the records don't
+ * match or on allocation failure.
+ */
+struct drawing_stroke *
+drawing_chunk_decode_stroke(struct drawing_layer *drawing,
+                            const struct journal_stroke_begin *begin,
+                            const void *payload, uint32_t length);
+
+#endif /* INFINIDESK_DRAWING_CHUNK_H */
@@ -33,6 +33,8 @@ enum drawing_ui_button {
     UI_BUTTON_COLOR_RED,
     UI_BUTTON_COLOR_GREEN,
     UI_BUTTON_COLOR_BLUE,
+    UI_BUTTON_ERASE_STROKE,
+    UI_BUTTON_ERASE_PARTIAL,
     UI_BUTTON_UNDO,
     UI_BUTTON_REDO,
     UI_BUTTON_CLEAR,
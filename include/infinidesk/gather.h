@@ -0,0 +1,29 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * gather.h - Pulling windows together on the canvas
+ */
+
+#ifndef INFINIDESK_GATHER_H
+#define INFINIDESK_GATHER_H
+
+#include <stdint.h>
+
+/* A window's box on the canvas, top-left corner first */
+struct gather_box {
+    double x, y;
+    double width, height;
+};
+
+/*
+ * Move boxes halfway towards the centroid of their centres, stopping each
+ * one minimum_gap short of it along its approach. The centroid is returned
+ * through centroid_x/centroid_y. count must be non-zero.
+ */
+void gather_boxes(struct gather_box *boxes, uint32_t count,
+                  double minimum_gap, double *centroid_x,
+                  double *centroid_y);
+
+#endif /* INFINIDESK_GATHER_H */
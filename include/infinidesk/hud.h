@@ -0,0 +1,108 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * hud.h - On-screen performance overlay
+ */
+
+#ifndef INFINIDESK_HUD_H
+#define INFINIDESK_HUD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wlr/render/pass.h>
+#include <wlr/render/wlr_renderer.h>
+
+/* Forward declarations */
+struct infinidesk_server;
+
+/* Frames shown in each output's frame time graph */
+#define HUD_GRAPH_FRAMES 120
+
+/* How often the overlay is redrawn, in ms */
+#define HUD_REFRESH_MS 250
+
+/*
+ * Statistics gathered for the HUD on one output while it is shown, and the
+ * overlay drawn for it at its scale.
+ */
+struct hud_output {
+    /* Ring of recent frame times, in ms */
+    float frame_ms[HUD_GRAPH_FRAMES];
+    uint32_t head;
+    uint32_t count;
+
+    /* Frames counted towards the frame rate */
+    uint32_t fps_frames;
+    uint64_t fps_start_ns;
+    float fps;
+
+    /* What the last frame drew, not counting the HUD itself */
+    uint64_t rects_mark, textures_mark;
+    uint32_t rects, textures;
+    uint32_t visible_views;
+
+    /* Rendered texture, at the output's scale */
+    struct wlr_texture *texture;
+    int texture_width;
+    int texture_height;
+    uint64_t last_update_ns;
+};
+
+/*
+ * HUD overlay state.
+ *
+ * The overlay is drawn with Cairo into a texture, like the switcher, but
+ * only a few times a second; other frames just draw the texture, so
+ * showing it barely changes the frame times it reports. Each output keeps
+ * its own texture, so outputs at different scales don't redraw it for each
+ * other.
+ */
+struct infinidesk_hud {
+    struct infinidesk_server *server;
+
+    bool active;
+};
+
+/*
+ * Initialize the HUD.
+ */
+void hud_init(struct infinidesk_hud *hud, struct infinidesk_server *server);
+
+/*
+ * Clean up HUD resources.
+ */
+void hud_finish(struct infinidesk_hud *hud);
+
+/*
+ * Free an output's overlay texture, when it is destroyed.
+ */
+void hud_output_finish(struct hud_output *stats);
+
+/*
+ * Show or hide the HUD.
+ */
+void hud_toggle(struct infinidesk_hud *hud);
+
+/*
+ * Start gathering statistics for an output's frame.
+ */
+void hud_frame_begin(struct infinidesk_hud *hud, struct hud_output *stats);
+
+/*
+ * Render the HUD overlay in the top-left corner of an output.
+ * Call this after everything else has been added to the pass.
+ * visible_views is how many views were drawn on the output.
+ */
+void hud_render(struct infinidesk_hud *hud, struct hud_output *stats,
+                struct wlr_render_pass *pass, uint32_t visible_views,
+                float output_scale);
+
+/*
+ * Record the time an output's frame took to render, in ns.
+ */
+void hud_frame_end(struct infinidesk_hud *hud, struct hud_output *stats,
+                   uint64_t frame_ns);
+
+#endif /* INFINIDESK_HUD_H */
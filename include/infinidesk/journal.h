@@ -0,0 +1,265 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * journal.h - Append-only on-disk journal of drawing operations
+ */
+
+#ifndef INFINIDESK_JOURNAL_H
+#define INFINIDESK_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+/*
+ * File format
+ *
+ * A journal file is a journal_file_header followed by a sequence of
+ * records, each a journal_record_header and `length` bytes of payload,
+ * padded to a multiple of 8 bytes. All values are in host byte order.
+ *
+ * The file is memory-mapped when opened, and the packed points of stroke
+ * records (point_codec.h) are used in place, so restoring a canvas doesn't
+ * copy point data.
+ * Records are only ever appended. At a checkpoint the strokes changed
+ * since the last one are written out to per-chunk files (chunk_store.h),
+ * which use the same record framing, and the journal is rewritten as a
+ * manifest of those files. Strokes added to chunks that weren't in memory
+ * to be written follow the manifest. After the checkpoint record comes the
+ * undo and redo history: the strokes only it holds, then its operations.
+ */
+
+#define JOURNAL_MAGIC "INFJRNL1"
+#define JOURNAL_VERSION 5
+/* Oldest format still read; version 4 has no history records */
+#define JOURNAL_OLDEST_VERSION 4
+
+enum journal_record_type {
+    JOURNAL_STROKE_BEGIN = 1, /* journal_stroke_begin */
+    JOURNAL_STROKE_POINTS,    /* journal_stroke_points + packed points */
+    JOURNAL_STROKE_END,       /* journal_stroke_id */
+    JOURNAL_UNDO,             /* No payload */
+    JOURNAL_REDO,             /* No payload */
+    JOURNAL_CLEAR,            /* No payload */
+    JOURNAL_ERASE_BEGIN,      /* No payload */
+    JOURNAL_ERASE_REMOVE,     /* journal_stroke_id */
+    JOURNAL_ERASE_SPLIT,      /* journal_erase_split + fragments */
+    JOURNAL_ERASE_END,        /* No payload */
+    JOURNAL_CHECKPOINT,       /* No payload; older undo history ends here */
+    JOURNAL_MANIFEST,         /* journal_manifest + chunks */
+    JOURNAL_HISTORY_STROKE,   /* journal_stroke_id, ending a stroke */
+    JOURNAL_HISTORY_OP,       /* journal_history_op + stroke ids */
+};
+
+struct journal_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct journal_record_header {
+    uint32_t type;
+    uint32_t length; /* Payload bytes, excluding padding */
+};
+
+struct journal_stroke_begin {
+    uint64_t id;
+    uint64_t z;
+    int32_t chunk_x, chunk_y;  /* Chunk the stroke is stored in */
+    double origin_x, origin_y; /* Relative to the chunk's corner */
+    float r, g, b;
+    float tolerance;
+    float min_x, min_y, max_x, max_y;
+    uint32_t flags; /* JOURNAL_STROKE_* */
+    uint32_t reserved;
+};
+
+#define JOURNAL_STROKE_SMOOTH (1u << 0)
+
+struct journal_stroke_points {
+    uint64_t id;
+    uint32_t point_count;
+    float quantum;      /* Of the packed points */
+    uint32_t data_size; /* Bytes of packed points */
+    uint32_t reserved;
+    /* Followed by a packed block of point_count points */
+};
+
+/* Strokes are referred to by id and the chunk they are stored in */
+struct journal_stroke_id {
+    uint64_t id;
+    int32_t chunk_x, chunk_y;
+};
+
+struct journal_erase_split {
+    uint64_t parent_id;
+    int32_t chunk_x, chunk_y;
+    uint32_t fragment_count;
+    uint32_t reserved;
+    /* Followed by fragment_count journal_fragment */
+};
+
+struct journal_fragment {
+    uint64_t id;
+    uint32_t first_point;
+    uint32_t point_count;
+};
+
+/*
+ * An undoable operation, oldest first on each stack. Its strokes are on the
+ * canvas or were given by earlier JOURNAL_HISTORY_STROKE records.
+ */
+struct journal_history_op {
+    uint32_t added_count;
+    uint32_t removed_count;
+    uint32_t undone; /* On the redo stack rather than the undo stack */
+    uint32_t reserved;
+    /* Followed by added_count then removed_count journal_stroke_id */
+};
+
+/* The chunk files making up the canvas as of the last checkpoint */
+struct journal_manifest {
+    uint64_t generation; /* Of the newest chunk files */
+    uint64_t next_stroke_id;
+    uint32_t chunk_count;
+    uint32_t reserved;
+    /* Followed by chunk_count journal_chunk */
+};
+
+struct journal_chunk {
+    int32_t x, y;
+    uint64_t generation; /* Identifies the chunk's current file */
+    double min_x, min_y, max_x, max_y; /* Of its strokes, from its corner */
+};
+
+/* Iterates the records of a mapped journal or chunk file */
+struct journal_reader {
+    const uint8_t *pos;
+    const uint8_t *end;
+};
+
+/*
+ * A compaction of the journal, carried out on the writer thread. The new
+ * journal holds records, followed by everything appended after it was
+ * started.
+ */
+struct journal_rewrite {
+    struct wl_array records;
+
+    /*
+     * Called on the writer thread before the new journal is written, to
+     * write what it refers to. Returning false abandons the rewrite.
+     */
+    bool (*prepare)(void *data);
+    /* Called on the writer thread once the new journal is in place */
+    void (*commit)(void *data);
+    /* Called on the main thread once the rewrite has succeeded or failed */
+    void (*done)(bool ok, void *data);
+    void *data;
+
+    /* Keep the file being replaced as <path><keep_suffix>, unless NULL */
+    const char *keep_suffix;
+};
+
+struct journal;
+struct wl_event_loop;
+
+/*
+ * Get the default journal location:
+ * $XDG_DATA_HOME/infinidesk/canvas.journal, falling back to
+ * ~/.local/share/infinidesk/canvas.journal.
+ * Caller must free the returned string.
+ */
+char *journal_default_path(void);
+
+/*
+ * Get the path of another file or directory alongside the journal.
+ * Caller must free the returned string.
+ */
+char *journal_data_path(const char *name);
+
+/*
+ * Open (creating if needed) the journal at path, map its existing records
+ * and start the writer thread. Records that were only partly written are
+ * discarded. Finished rewrites are reported through the event loop.
+ * Returns NULL on error, setting *incompatible if the file is a journal in
+ * another version of the format, which is left untouched.
+ */
+struct journal *journal_open(const char *path, struct wl_event_loop *loop,
+                             bool *incompatible);
+
+/*
+ * Write out any pending records and rewrite, stop the writer thread and
+ * unmap the journal. Anything using the mapped records must be released
+ * first.
+ */
+void journal_close(struct journal *journal);
+
+/*
+ * Start reading the records that were in the file when it was opened.
+ */
+void journal_reader_init(struct journal *journal,
+                         struct journal_reader *reader);
+
+/*
+ * Start reading records from a buffer, such as a chunk file read into
+ * memory after its header.
+ */
+void journal_reader_init_data(struct journal_reader *reader, const void *data,
+                              size_t size);
+
+/*
+ * Read the next record. Returns false at the end of the records.
+ */
+bool journal_reader_next(struct journal_reader *reader, uint32_t *type,
+                         const void **payload, uint32_t *length);
+
+/*
+ * Size in bytes of the journal file, including everything appended since
+ * it was opened.
+ */
+size_t journal_size(struct journal *journal);
+
+/*
+ * Size in bytes of a record with the given payload length.
+ */
+size_t journal_record_size(size_t length);
+
+/*
+ * Add a record whose payload is head followed by tail (either may be empty)
+ * to the end of a buffer. Returns false on allocation failure.
+ */
+bool journal_encode(struct wl_array *out, uint32_t type, const void *head,
+                    size_t head_len, const void *tail, size_t tail_len);
+
+/*
+ * Queue a record whose payload is head followed by tail (either may be
+ * empty). This only copies into memory; records reach the disk from the
+ * writer thread after journal_flush().
+ */
+void journal_append(struct journal *journal, uint32_t type, const void *head,
+                    size_t head_len, const void *tail, size_t tail_len);
+
+/*
+ * Hand queued records to the writer thread.
+ */
+void journal_flush(struct journal *journal);
+
+/*
+ * Start replacing the journal with a compacted one, taking over
+ * rewrite->records. Records appended from now on follow them in the new
+ * journal, or go to the old one if the rewrite fails. The existing mapping
+ * stays valid. Only one rewrite may be in progress at a time.
+ */
+void journal_rewrite(struct journal *journal,
+                     struct journal_rewrite *rewrite);
+
+/*
+ * Wait for a rewrite in progress to finish, calling its done callback.
+ */
+void journal_wait_rewrite(struct journal *journal);
+
+#endif /* INFINIDESK_JOURNAL_H */
@@ -0,0 +1,153 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * latency.h - Input to display latency measurement
+ */
+
+#ifndef INFINIDESK_LATENCY_H
+#define INFINIDESK_LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <wayland-server-core.h>
+
+struct wlr_surface;
+
+/* Histogram buckets, of LATENCY_BUCKET_NS each, plus one for anything over */
+#define LATENCY_BUCKET_NS 250000
+#define LATENCY_BUCKETS 400
+
+/* Longest an input waits for a client commit or a frame, in ns */
+#define LATENCY_MAX_WAIT_NS 1000000000ull
+
+/* What an input event did that will show on screen */
+enum latency_path {
+    LATENCY_PAN,            /* Panned the canvas */
+    LATENCY_ZOOM,           /* Zoomed the canvas */
+    LATENCY_DRAW,           /* Added to a stroke or erased */
+    LATENCY_MOVE,           /* Moved a window */
+    LATENCY_RESIZE,         /* Resized a window */
+    LATENCY_CLIENT_POINTER, /* Sent to a client, which then committed */
+    LATENCY_CLIENT_KEY,     /* Likewise, for keys */
+    LATENCY_PATH_COUNT,
+};
+
+/* What the latency is measured up to */
+enum latency_metric {
+    LATENCY_TO_COMMIT,  /* The output frame showing it being committed */
+    LATENCY_TO_PRESENT, /* That frame being presented */
+    LATENCY_METRIC_COUNT,
+};
+
+/*
+ * An input sent to a client, waiting for it to commit.
+ */
+struct latency_forwarded {
+    uint64_t input_ns; /* 0 for none */
+    struct wl_client *client;
+    struct wl_listener client_destroy;
+};
+
+/*
+ * Inputs waiting on a committed output frame to be presented.
+ */
+struct latency_frame {
+    uint64_t input_ns[LATENCY_PATH_COUNT]; /* 0 for none */
+};
+
+/*
+ * Input latency tracker.
+ *
+ * Each input event's timestamp is noted as it is handled. When it changes
+ * something the compositor draws, the oldest such input not yet drawn is
+ * kept for its path. When it is sent to a client instead, it is kept until
+ * that client next commits, and then waits to be drawn in the same way.
+ * The next output frame committed takes all waiting inputs, and the time
+ * from each input to that commit and to the frame's presentation is added
+ * to the path's histograms.
+ *
+ * Only the oldest waiting input per path is measured, which is the one
+ * that waited longest. With several outputs, the first to commit a frame
+ * takes the inputs, whether or not the change is visible on it. Inputs
+ * still waiting after LATENCY_MAX_WAIT_NS are dropped rather than measured,
+ * as whatever they did was evidently never drawn, and an input sent to a
+ * client is dropped if the client disconnects.
+ */
+struct latency_tracker {
+    bool log; /* Log the distributions periodically */
+    uint64_t last_report_ns;
+
+    /* The input event being handled */
+    uint64_t current_ns;
+
+    /* Inputs sent to clients, waiting for them to commit */
+    struct latency_forwarded forwarded[LATENCY_PATH_COUNT];
+
+    /* Inputs waiting to be drawn */
+    uint64_t pending_ns[LATENCY_PATH_COUNT];
+
+    uint32_t histogram[LATENCY_PATH_COUNT][LATENCY_METRIC_COUNT]
+                      [LATENCY_BUCKETS + 1];
+    uint64_t samples[LATENCY_PATH_COUNT][LATENCY_METRIC_COUNT];
+};
+
+/*
+ * Initialise a tracker. If log is set, the distributions are logged every
+ * few seconds.
+ */
+void latency_init(struct latency_tracker *tracker, bool log);
+
+/*
+ * Note the timestamp of the input event about to be handled.
+ */
+void latency_input(struct latency_tracker *tracker, uint32_t time_msec);
+
+/*
+ * The current input event changed something the compositor draws.
+ */
+void latency_effect(struct latency_tracker *tracker, enum latency_path path);
+
+/*
+ * The current input event was sent to a client's surface. The surface may
+ * be NULL if nothing had focus.
+ */
+void latency_forward(struct latency_tracker *tracker, enum latency_path path,
+                     struct wlr_surface *surface);
+
+/*
+ * A client's surface committed.
+ */
+void latency_client_commit(struct latency_tracker *tracker,
+                           struct wlr_surface *surface);
+
+/*
+ * An output committed a frame. Moves the waiting inputs into frame.
+ */
+void latency_frame_commit(struct latency_tracker *tracker,
+                          struct latency_frame *frame);
+
+/*
+ * A frame was presented, or discarded if presented is false. when may be
+ * NULL if the time is unknown.
+ */
+void latency_frame_present(struct latency_tracker *tracker,
+                           struct latency_frame *frame, bool presented,
+                           const struct timespec *when);
+
+/*
+ * Get the 50th, 95th and 99th percentile latency in ns of a path.
+ * Returns false if there are no samples yet.
+ */
+bool latency_percentiles(const struct latency_tracker *tracker,
+                         enum latency_path path, enum latency_metric metric,
+                         uint64_t out[3]);
+
+/*
+ * Get the name of a path.
+ */
+const char *latency_path_name(enum latency_path path);
+
+#endif /* INFINIDESK_LATENCY_H */
@@ -0,0 +1,77 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * metrics.h - Counters and gauges for scraping, over a Unix socket
+ */
+
+#ifndef INFINIDESK_METRICS_H
+#define INFINIDESK_METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <wayland-server-core.h>
+
+struct infinidesk_server;
+
+/* Frame time histogram buckets, plus one for anything over the last */
+#define METRICS_FRAME_BUCKETS 10
+
+/*
+ * Frame counts for one output. Frames are skipped when they can't be
+ * rendered or committed.
+ */
+struct metrics_output {
+    uint64_t frames_rendered;
+    uint64_t frames_skipped;
+    uint64_t frame_buckets[METRICS_FRAME_BUCKETS + 1];
+    uint64_t frame_ns_total;
+};
+
+/*
+ * Metrics endpoint.
+ *
+ * The compositor listens on $XDG_RUNTIME_DIR/infinidesk-<display>.metrics,
+ * named after its Wayland socket and exported as INFINIDESK_METRICS_SOCKET.
+ * Each connection is sent the current values in the Prometheus text
+ * exposition format, then closed, so a local scraper can read it with
+ * something as simple as socat. What a slow scraper hasn't read yet is
+ * buffered and sent as its socket drains, without blocking the compositor.
+ * Nothing is gathered for a scrape until one comes in, apart from the
+ * per-frame and per-client counters, which are kept up to date as they
+ * happen.
+ */
+struct infinidesk_metrics {
+    struct infinidesk_server *server;
+    char *path;
+    int fd;
+    struct wl_event_source *source;
+    struct wl_list connections; /* Scrapers not yet sent everything */
+    uint64_t scrapes;
+};
+
+/*
+ * Start listening, next to the Wayland socket of the given name. Returns
+ * false on failure, leaving the compositor to run without metrics.
+ */
+bool metrics_start(struct infinidesk_metrics *metrics,
+                   struct infinidesk_server *server, const char *display);
+
+/*
+ * Stop listening and remove the socket.
+ */
+void metrics_finish(struct infinidesk_metrics *metrics);
+
+/*
+ * Count a frame rendered in the given time.
+ */
+void metrics_frame_rendered(struct metrics_output *output, uint32_t ns);
+
+/*
+ * Count a frame that couldn't be rendered or committed.
+ */
+void metrics_frame_skipped(struct metrics_output *output);
+
+#endif /* INFINIDESK_METRICS_H */
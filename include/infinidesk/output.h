@@ -14,6 +14,12 @@
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/box.h>
 
+#include "infinidesk/hud.h"
+#include "infinidesk/latency.h"
+#include "infinidesk/metrics.h"
+#include "infinidesk/perf.h"
+#include "infinidesk/render_governor.h"
+
 /* Forward declaration */
 struct infinidesk_server;
 
@@ -40,7 +46,26 @@ struct infinidesk_output {
     /* Usable area after accounting for exclusive zones */
     struct wlr_box usable_area;
 
+    /* Frame timing and render quality */
+    struct render_governor governor;
+
+    /* Per-stage frame timing, when enabled with --perf */
+    struct perf_output perf;
+
+    /* Statistics for the performance HUD */
+    struct hud_output hud;
+
+    /* Frame counts for the metrics socket */
+    struct metrics_output metrics;
+
+    /* Track for this output's frames when tracing */
+    uint32_t trace_track;
+
+    /* Inputs shown by the last committed frame, until it is presented */
+    struct latency_frame latency;
+
     struct wl_listener frame;
+    struct wl_listener present;
     struct wl_listener request_state;
     struct wl_listener destroy;
 };
@@ -60,6 +85,11 @@ void handle_new_output(struct wl_listener *listener, void *data);
  */
 void output_handle_frame(struct wl_listener *listener, void *data);
 
+/*
+ * Handle a committed frame being presented or discarded.
+ */
+void output_handle_present(struct wl_listener *listener, void *data);
+
 /*
  * Handle output state change requests.
  */
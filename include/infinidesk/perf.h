@@ -0,0 +1,133 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * perf.h - Per-stage frame timing
+ */
+
+#ifndef INFINIDESK_PERF_H
+#define INFINIDESK_PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct wlr_render_pass;
+struct wlr_render_rect_options;
+struct wlr_render_texture_options;
+
+/* Frames kept for percentiles */
+#define PERF_WINDOW 512
+
+/* Stages of rendering an output frame, in order */
+enum perf_stage {
+    PERF_STAGE_BEGIN,      /* Animations and starting the render pass */
+    PERF_STAGE_LAYERS,     /* Background and bottom layer surfaces */
+    PERF_STAGE_VIEWS,      /* Windows */
+    PERF_STAGE_POPUPS,     /* Window popups */
+    PERF_STAGE_OVERLAYS,   /* Top and overlay layer surfaces */
+    PERF_STAGE_DRAWING,    /* Annotations */
+    PERF_STAGE_UI,         /* Drawing mode panel */
+    PERF_STAGE_SWITCHER,   /* Window switcher */
+    PERF_STAGE_HUD,        /* Performance HUD */
+    PERF_STAGE_SUBMIT,     /* Submitting the render pass */
+    PERF_STAGE_COMMIT,     /* Committing the output */
+    PERF_STAGE_FRAME_DONE, /* Sending frame callbacks */
+    PERF_STAGE_COUNT,
+};
+
+/* The whole frame, for perf_percentiles() */
+#define PERF_TOTAL PERF_STAGE_COUNT
+
+/* One frame's measurements */
+struct perf_sample {
+    uint32_t ns[PERF_STAGE_COUNT + 1]; /* Per stage, then the total */
+    uint32_t rects[PERF_STAGE_COUNT];
+    uint32_t textures[PERF_STAGE_COUNT];
+};
+
+/*
+ * Frame timing for one output.
+ *
+ * Each stage of a frame is timed from the end of the previous one, and the
+ * rectangles and textures it adds to the render pass are counted. The last
+ * PERF_WINDOW frames are kept, and their percentiles logged every few
+ * seconds.
+ *
+ * Stages can also be timed without keeping statistics, for the watchdog
+ * to look at the current frame. When neither is wanted, nothing is
+ * allocated and every call returns straight away.
+ */
+struct perf_output {
+    bool enabled; /* Keep and log statistics */
+    bool timing;  /* Time the current frame's stages */
+    const char *name;
+
+    uint64_t frame_start_ns;
+    uint64_t mark_ns;
+    uint64_t rects_mark, textures_mark;
+    struct perf_sample current;
+
+    struct perf_sample *samples; /* Ring of PERF_WINDOW frames */
+    uint32_t head;
+    uint32_t count;
+    uint64_t frames;
+    uint64_t last_report_ns;
+};
+
+/*
+ * Initialise timing for an output. name must outlive it. Stages are timed
+ * if either enabled or timing is set.
+ */
+void perf_output_init(struct perf_output *perf, const char *name,
+                      bool enabled, bool timing);
+
+/*
+ * Free the output's timing data.
+ */
+void perf_output_finish(struct perf_output *perf);
+
+/*
+ * Start timing a frame.
+ */
+void perf_frame_begin(struct perf_output *perf);
+
+/*
+ * Add a rectangle or texture to a render pass, counting it. Everything drawn
+ * goes through these, so each stage's draws can be counted without touching
+ * the renderer's own pass.
+ */
+void perf_add_rect(struct wlr_render_pass *pass,
+                   const struct wlr_render_rect_options *options);
+void perf_add_texture(struct wlr_render_pass *pass,
+                      const struct wlr_render_texture_options *options);
+
+/*
+ * Get the rects and textures drawn so far.
+ */
+void perf_draw_counts(uint64_t *rects, uint64_t *textures);
+
+/*
+ * Mark the end of a stage of the current frame.
+ */
+void perf_mark(struct perf_output *perf, enum perf_stage stage);
+
+/*
+ * Finish timing a frame, after its last stage.
+ */
+void perf_frame_end(struct perf_output *perf);
+
+/*
+ * Get the 50th, 95th and 99th percentile times in ns of a stage, or of the
+ * whole frame with PERF_TOTAL, over the recent frames.
+ * Returns false if there are no frames yet.
+ */
+bool perf_percentiles(const struct perf_output *perf, unsigned int stage,
+                      uint64_t out[3]);
+
+/*
+ * Get the name of a stage, or "total" for PERF_TOTAL.
+ */
+const char *perf_stage_name(unsigned int stage);
+
+#endif /* INFINIDESK_PERF_H */
@@ -0,0 +1,100 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * point_codec.h - Compact fixed-point delta encoding of stroke points
+ */
+
+#ifndef INFINIDESK_POINT_CODEC_H
+#define INFINIDESK_POINT_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct drawing_point;
+struct wl_array;
+
+/*
+ * Packed points are rounded to multiples of a quantum (canvas units) and
+ * stored as the zig-zag varint deltas between consecutive points, the first
+ * relative to (0, 0). Points a few quanta apart take two bytes instead of
+ * eight.
+ *
+ * A packed block is a seek table followed by the delta bytes. The seek
+ * table allows starting part-way through, which fragments and hit-testing
+ * need: entry i locates point i * POINT_CODEC_SEEK_INTERVAL.
+ */
+
+#define POINT_CODEC_SEEK_INTERVAL 64
+
+struct point_seek {
+    uint32_t offset; /* Offset of the point's delta in the delta bytes */
+    int32_t x, y;    /* Quantised position of the point before it */
+};
+
+/* A view of a packed block */
+struct packed_points {
+    const struct point_seek *seek;
+    const uint8_t *data; /* Delta bytes */
+    uint32_t size;       /* Number of delta bytes */
+    uint32_t count;      /* Number of points */
+    float quantum;
+};
+
+/*
+ * Walks a run of points one at a time, decoding packed points as it goes
+ * so they never need to be unpacked into an array.
+ */
+struct point_cursor {
+    const struct drawing_point *plain; /* Next plain point, or NULL */
+    const uint8_t *pos, *end;          /* Next packed delta */
+    int64_t x, y;                      /* Last quantised position */
+    float quantum;
+    uint32_t remaining;
+};
+
+/*
+ * Size in bytes of the seek table for count points.
+ */
+size_t point_codec_seek_size(uint32_t count);
+
+/*
+ * Append a packed block holding points[0..count) to out. The quantum is
+ * raised if needed to keep quantised positions within 30 bits, so it is
+ * passed by reference; a quantum of zero picks the finest that fits.
+ * Returns false on allocation failure.
+ */
+bool point_codec_pack(const struct drawing_point *points, uint32_t count,
+                      float *quantum, struct wl_array *out);
+
+/*
+ * Interpret a packed block of size bytes holding count points.
+ * Returns false if the block is inconsistent.
+ */
+bool point_codec_view(const void *block, size_t size, uint32_t count,
+                      float quantum, struct packed_points *packed);
+
+/*
+ * Start walking points [first, first + count) of a packed block.
+ */
+void point_cursor_init_packed(struct point_cursor *cursor,
+                              const struct packed_points *packed,
+                              uint32_t first, uint32_t count);
+
+/*
+ * Start walking an array of plain points.
+ */
+void point_cursor_init_plain(struct point_cursor *cursor,
+                             const struct drawing_point *points,
+                             uint32_t count);
+
+/*
+ * Get the next point. Returns false at the end of the run, or if the
+ * packed data is damaged.
+ */
+bool point_cursor_next(struct point_cursor *cursor,
+                       struct drawing_point *point);
+
+#endif /* INFINIDESK_POINT_CODEC_H */
@@ -0,0 +1,38 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * point_transform.h - Batch transform of stroke points to output pixels
+ */
+
+#ifndef INFINIDESK_POINT_TRANSFORM_H
+#define INFINIDESK_POINT_TRANSFORM_H
+
+#include <stdint.h>
+
+struct drawing_point;
+
+/*
+ * Maps stroke-local points to physical pixels:
+ *   out = base + point * scale
+ * where base is the stroke origin on the output and scale combines the
+ * canvas zoom with the output scale.
+ */
+struct point_transform {
+    double base_x, base_y;
+    double scale;
+};
+
+/*
+ * Transform count points into out_x/out_y, and store the on-screen length
+ * of each segment between consecutive points in lengths (count - 1 entries).
+ *
+ * Uses AVX2 or SSE2 where the CPU has them. Results are identical to the
+ * scalar code on every path.
+ */
+void point_transform_batch(const struct point_transform *transform,
+                           const struct drawing_point *points, uint32_t count,
+                           double *out_x, double *out_y, double *lengths);
+
+#endif /* INFINIDESK_POINT_TRANSFORM_H */
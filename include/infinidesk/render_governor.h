@@ -0,0 +1,108 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * render_governor.h - Adaptive render quality under a frame time budget
+ */
+
+#ifndef INFINIDESK_RENDER_GOVERNOR_H
+#define INFINIDESK_RENDER_GOVERNOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct infinidesk_canvas;
+struct wlr_render_timer;
+struct wlr_renderer;
+
+/* Defaults for the configurable thresholds */
+#define RENDER_GOVERNOR_DEFAULT_BUDGET 0.8f
+#define RENDER_GOVERNOR_DEFAULT_SETTLE_MS 250
+
+/* Quality levels, from full quality down */
+enum render_quality_level {
+    RENDER_QUALITY_FULL,
+    RENDER_QUALITY_REDUCED,
+    RENDER_QUALITY_MINIMAL,
+    RENDER_QUALITY_LEVEL_COUNT,
+};
+
+/*
+ * What to cut back on when rendering a frame.
+ */
+struct render_quality {
+    enum render_quality_level level;
+    bool nearest_filter;    /* Sample window content without filtering */
+    bool skip_corner_masks; /* Leave window corners square */
+    bool stale_scaled;      /* Stretch scaled copies made at another zoom */
+    double stroke_error;    /* Multiplier for the stroke LOD error allowance */
+};
+
+/*
+ * Per-output governor.
+ *
+ * Each frame's composition time is measured on the CPU, and on the GPU
+ * where the renderer supports timers, and compared against a fraction of
+ * the output's refresh interval. When frames keep going over budget while
+ * the canvas is moving, quality is stepped down a level at a time. Once
+ * the canvas has been still for a while, full quality comes back.
+ */
+struct render_governor {
+    /* Thresholds */
+    float budget;       /* Fraction of the refresh interval to stay under */
+    uint32_t settle_ms; /* Stillness before full quality is restored */
+
+    struct render_quality quality;
+
+    /* GPU timer of the previous frame, or NULL if unsupported */
+    struct wlr_render_timer *timer;
+    bool timer_pending;
+    bool frame_ended; /* The previous frame was submitted and timed */
+    uint64_t cpu_start_ns;
+
+    /* Canvas state of the previous frame, to detect motion */
+    double last_x, last_y, last_scale;
+    uint64_t last_motion_ns;
+    uint32_t over_budget_run; /* Consecutive frames over budget */
+
+    /* Instrumentation */
+    uint64_t last_cpu_ns;
+    int64_t last_gpu_ns; /* -1 when unknown */
+    uint64_t budget_ns;
+    uint64_t frames;
+    uint64_t frames_over_budget;
+    uint64_t downgrades;
+};
+
+/*
+ * Initialise a governor. The renderer is used to create a GPU timer.
+ */
+void render_governor_init(struct render_governor *governor,
+                          struct wlr_renderer *renderer, float budget,
+                          uint32_t settle_ms);
+
+/*
+ * Free the governor's GPU timer.
+ */
+void render_governor_finish(struct render_governor *governor);
+
+/*
+ * Start timing a frame and pick its quality. Collects the GPU time of the
+ * previous frame. Returns the timer to pass to the render pass, if any.
+ */
+struct wlr_render_timer *
+render_governor_begin(struct render_governor *governor,
+                      struct infinidesk_canvas *canvas, int refresh_mhz);
+
+/*
+ * Finish timing a frame, after its render pass has been submitted.
+ */
+void render_governor_end(struct render_governor *governor);
+
+/*
+ * Get the name of a quality level.
+ */
+const char *render_quality_name(enum render_quality_level level);
+
+#endif /* INFINIDESK_RENDER_GOVERNOR_H */
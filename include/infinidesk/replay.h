@@ -0,0 +1,152 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * replay.h - Input recording and deterministic replay
+ */
+
+#ifndef INFINIDESK_REPLAY_H
+#define INFINIDESK_REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_pointer.h>
+
+/* Forward declaration */
+struct infinidesk_server;
+
+/* Frames rendered after the last event, to let animations finish */
+#define REPLAY_SETTLE_FRAMES 60
+
+enum replay_event_type {
+    REPLAY_MOTION,
+    REPLAY_MOTION_ABSOLUTE,
+    REPLAY_BUTTON,
+    REPLAY_AXIS,
+    REPLAY_FRAME,
+    REPLAY_KEY,
+};
+
+/*
+ * An input event as it reached the cursor or keyboard handlers. Times are
+ * in ms from the first event recorded.
+ */
+struct replay_event {
+    enum replay_event_type type;
+    uint32_t time_msec;
+    union {
+        struct {
+            double dx, dy;
+            double unaccel_dx, unaccel_dy;
+        } motion;
+        struct {
+            double x, y; /* 0 to 1 across the output layout */
+        } absolute;
+        struct {
+            uint32_t button;
+            uint32_t state;
+        } button;
+        struct {
+            uint32_t source;
+            uint32_t orientation;
+            uint32_t relative_direction;
+            int32_t delta_discrete;
+            double delta;
+        } axis;
+        struct {
+            uint32_t keycode;
+            uint32_t state;
+        } key;
+    };
+};
+
+/*
+ * A recorded session being replayed.
+ *
+ * Events are injected through a virtual pointer and keyboard, so they take
+ * the same path as real input. Time is virtual too: each frame on the
+ * primary output moves the clock on by exactly one refresh interval,
+ * events are injected once the clock reaches them, and animations run off
+ * the same clock. The same recording then renders the same frames however
+ * fast or slow the build rendering them is.
+ *
+ * A replay runs as a benchmark, so it gets the benchmark's scratch data and
+ * config directories: it starts from an empty canvas at the default
+ * configuration, and what it draws never reaches the user's journal.
+ */
+struct infinidesk_replay {
+    struct infinidesk_server *server;
+
+    struct replay_event *events;
+    size_t event_count;
+    size_t next_event;
+
+    /* Size of the output the session was recorded on */
+    uint32_t width, height;
+
+    /* Virtual clock, in us since the replay was started */
+    uint64_t clock_us;
+    uint32_t base_ms; /* Real time the clock started at */
+
+    bool playing;
+    uint64_t play_start_us;
+    uint32_t settle_frames;
+    bool done;
+
+    struct wlr_pointer pointer;
+    struct wlr_keyboard keyboard;
+};
+
+/*
+ * Start recording input to a file. Returns false on failure.
+ */
+bool replay_record_start(const char *path);
+
+/*
+ * Record an input event, if recording. Its time is taken as given, and
+ * made relative to the first event.
+ */
+void replay_record(const struct replay_event *event);
+
+/*
+ * Stop recording, noting the size of the output it was recorded on.
+ */
+void replay_record_stop(uint32_t width, uint32_t height);
+
+/*
+ * Load a recording. Returns false on failure.
+ */
+bool replay_load(struct infinidesk_replay *replay, const char *path);
+
+/*
+ * Create the virtual input devices and take over the server's clock.
+ */
+void replay_start(struct infinidesk_replay *replay,
+                  struct infinidesk_server *server);
+
+/*
+ * Remove the virtual devices and free the recording.
+ */
+void replay_finish(struct infinidesk_replay *replay);
+
+/*
+ * Start injecting events, from the current virtual time.
+ */
+void replay_play(struct infinidesk_replay *replay);
+
+/*
+ * Advance the clock by one frame at the given refresh rate in mHz, and
+ * inject the events that are now due.
+ */
+void replay_frame(struct infinidesk_replay *replay, int32_t refresh_mhz);
+
+/*
+ * Get the virtual time in ms, on the same scale as CLOCK_MONOTONIC.
+ */
+uint32_t replay_time_ms(const struct infinidesk_replay *replay);
+
+#endif /* INFINIDESK_REPLAY_H */
@@ -0,0 +1,53 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * scaled_surface.h - Pre-scaled surface textures for software rendering
+ */
+
+#ifndef INFINIDESK_SCALED_SURFACE_H
+#define INFINIDESK_SCALED_SURFACE_H
+
+#include <stddef.h>
+
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/box.h>
+
+/*
+ * The pixman renderer resamples a texture on the CPU every time it is drawn
+ * at a size other than its own, which is far too slow to do for every
+ * window on every frame.
+ *
+ * Instead, keep a copy of each surface's texture already scaled to the size
+ * it is drawn at, which can then be drawn with a plain copy. The copies are
+ * attached to the surface and only redone when the surface commits new
+ * content or is drawn at a new size, so panning reuses them. A few sizes are
+ * kept at once, so outputs at different scales each keep their own copy, and
+ * a size not drawn for a second is dropped.
+ */
+
+/*
+ * Get the part src_box of a surface's texture scaled to width x height,
+ * redoing the scaling if needed. Only for the pixman renderer.
+ *
+ * If allow_stale is set, a copy of the current content scaled to another
+ * size is returned as it is, to be stretched when drawn.
+ *
+ * Returns NULL on failure, in which case the caller should draw the
+ * original texture.
+ */
+struct wlr_texture *scaled_surface_get(struct wlr_renderer *renderer,
+                                       struct wlr_surface *surface,
+                                       struct wlr_texture *texture,
+                                       const struct wlr_fbox *src_box,
+                                       int width, int height,
+                                       bool allow_stale);
+
+/*
+ * Get the bytes used by all scaled copies.
+ */
+size_t scaled_surface_memory(void);
+
+#endif /* INFINIDESK_SCALED_SURFACE_H */
@@ -0,0 +1,42 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * scratch.h - Throwaway XDG directories for headless runs
+ */
+
+#ifndef INFINIDESK_SCRATCH_H
+#define INFINIDESK_SCRATCH_H
+
+#include <stdbool.h>
+
+/*
+ * A temporary directory standing in for the user's data and config
+ * directories.
+ *
+ * Benchmarks, replays and snapshots run the whole compositor, which saves
+ * annotations under XDG_DATA_HOME. Pointing XDG_DATA_HOME and
+ * XDG_CONFIG_HOME into a fresh directory for the run means each one starts
+ * from an empty canvas and never touches the user's own files, nor do the
+ * clients it starts, which inherit the environment.
+ */
+struct scratch_env {
+    char dir[64]; /* Empty if none was made */
+};
+
+/*
+ * Make a scratch directory named after what it is for, with data and config
+ * directories in it, and point the environment at them. Must be called
+ * before the server is initialised. Returns false on failure.
+ */
+bool scratch_env_create(struct scratch_env *env, const char *name);
+
+/*
+ * Remove the scratch directory and everything in it. Must be called after
+ * the server has finished, as it saves the drawing layer there. Does
+ * nothing if there is none.
+ */
+void scratch_env_remove(struct scratch_env *env);
+
+#endif /* INFINIDESK_SCRATCH_H */
@@ -0,0 +1,42 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * send_buffer.h - Text sent a piece at a time on a non-blocking socket
+ */
+
+#ifndef INFINIDESK_SEND_BUFFER_H
+#define INFINIDESK_SEND_BUFFER_H
+
+#include <stddef.h>
+
+/*
+ * Text being sent to a peer that may read it slowly, or go away before it
+ * has read it all. What the peer hasn't taken yet stays here until its
+ * socket is writable again.
+ */
+struct send_buffer {
+    char *data; /* Owned, freed by send_buffer_finish() */
+    size_t size;
+    size_t sent;
+};
+
+enum send_result {
+    SEND_DONE,    /* Everything has been sent */
+    SEND_PENDING, /* The socket is full; try again once it is writable */
+    SEND_FAILED,  /* The peer has gone away or the socket failed */
+};
+
+/*
+ * Send as much as the socket will take. A peer closing its end fails the
+ * send rather than raising SIGPIPE.
+ */
+enum send_result send_buffer_flush(struct send_buffer *buffer, int fd);
+
+/*
+ * Free the text.
+ */
+void send_buffer_finish(struct send_buffer *buffer);
+
+#endif /* INFINIDESK_SEND_BUFFER_H */
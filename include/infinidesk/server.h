@@ -30,13 +30,21 @@
 #include "infinidesk/canvas.h"
 #include "infinidesk/config.h"
 #include "infinidesk/drawing.h"
+#include "infinidesk/hud.h"
+#include "infinidesk/latency.h"
+#include "infinidesk/metrics.h"
 #include "infinidesk/switcher.h"
+#include "infinidesk/view_cache.h"
+#include "infinidesk/watchdog.h"
 
 /* Forward declarations */
 struct infinidesk_view;
 struct infinidesk_output;
 struct infinidesk_keyboard;
 struct infinidesk_layer_surface;
+struct infinidesk_bench;
+struct infinidesk_replay;
+struct infinidesk_snapshot;
 
 /* Cursor interaction modes */
 enum infinidesk_cursor_mode {
@@ -102,6 +110,7 @@ struct infinidesk_server {
     /* XDG shell */
     struct wlr_xdg_shell *xdg_shell;
     struct wl_list views; /* infinidesk_view.link */
+    struct view_cache view_cache; /* Packed bounds of mapped views */
     struct wl_listener new_xdg_toplevel;
     struct wl_listener new_xdg_popup;
 
@@ -127,11 +136,50 @@ struct infinidesk_server {
     /* Alt+Tab switcher */
     struct infinidesk_switcher switcher;
 
+    /* Performance HUD */
+    struct infinidesk_hud hud;
+
     /* View ID counter for unique identification */
     uint32_t next_view_id;
     /* Output scale factor (from config) */
     float output_scale;
 
+    /* Render governor thresholds (from config) */
+    float render_budget;
+    uint32_t quality_settle_ms;
+
+    /* Log per-stage frame timings (from --perf) */
+    bool perf_enabled;
+
+    /* Main loop stall detection, and its threshold in ms (from config) */
+    struct infinidesk_watchdog watchdog;
+    uint32_t stall_threshold_ms;
+
+    /* Input to display latency, logged with --perf */
+    struct latency_tracker latency;
+
+    /* Metrics socket for a local scraper, if enabled in the config */
+    struct infinidesk_metrics metrics;
+    bool metrics_enabled;
+
+    /* Counters for each connected client */
+    struct wl_list clients; /* client_stats.link */
+
+    /* Commit rate in Hz above which a client is throttled, 0 for none */
+    uint32_t max_commit_rate;
+
+    /* Benchmark being run (from --bench), or NULL */
+    struct infinidesk_bench *bench;
+
+    /* Recorded input being replayed (from --replay), or NULL */
+    struct infinidesk_replay *replay;
+
+    /* Scene being rendered for comparison (from --snapshot), or NULL */
+    struct infinidesk_snapshot *snapshot;
+
+    /* Cleared to leave the main loop */
+    bool running;
+
     /* Configurable keybindings (owned by the server, freed on shutdown) */
     struct keybind *keybinds;
     int keybind_count;
@@ -155,6 +203,17 @@ bool server_start(struct infinidesk_server *server);
  */
 void server_run(struct infinidesk_server *server);
 
+/*
+ * Make server_run() return once the current dispatch is done.
+ */
+void server_terminate(struct infinidesk_server *server);
+
+/*
+ * Get the time animations run on, in ms. This is CLOCK_MONOTONIC, unless a
+ * replay has taken over the clock.
+ */
+uint32_t server_time_ms(struct infinidesk_server *server);
+
 /*
  * Clean up and destroy the server.
  */
@@ -0,0 +1,160 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * snapshot.h - Offscreen renders of a described scene, checked against
+ *              golden images
+ */
+
+#ifndef INFINIDESK_SNAPSHOT_H
+#define INFINIDESK_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <wayland-server-core.h>
+
+#include "infinidesk/drawing_ui.h"
+#include "infinidesk/scratch.h"
+
+/* Forward declarations */
+struct infinidesk_output;
+struct infinidesk_server;
+struct infinidesk_view;
+struct wlr_buffer;
+struct wlr_output;
+
+/* Still frames to wait for before capturing, once nothing is animating */
+#define SNAPSHOT_SETTLE_FRAMES 10
+
+/* Frames timed after the capture */
+#define SNAPSHOT_TIMED_FRAMES 60
+
+/* Give up if the scene isn't captured within this long */
+#define SNAPSHOT_TIMEOUT_MS 30000
+
+/* A window of the scene, drawn by a client in a single flat colour */
+struct snapshot_window {
+    double x, y; /* Canvas position of the window geometry */
+    uint32_t width, height;
+    struct infinidesk_view *view; /* Once mapped */
+};
+
+/* A stroke of the scene */
+struct snapshot_stroke {
+    struct drawing_color color;
+    struct wl_array points; /* Canvas x, y pairs of doubles */
+};
+
+enum snapshot_state {
+    SNAPSHOT_WINDOWS, /* Opening windows one at a time */
+    SNAPSHOT_SETTLE,  /* Waiting for animations to finish */
+    SNAPSHOT_CAPTURE, /* Reading back the next frame */
+    SNAPSHOT_TIMING,  /* Timing further frames of the same scene */
+    SNAPSHOT_DONE,
+};
+
+/*
+ * A scene rendered on the headless backend with the pixman renderer, read
+ * back and compared with a golden image.
+ *
+ * The scene is described in a text file, one item per line:
+ *
+ *   output <width> <height> [scale]     Output size in pixels (1280x720)
+ *   viewport <x> <y> [zoom]             Canvas at the top-left (0 0 1)
+ *   window <x> <y> <width> <height>     A window, by its canvas position
+ *   stroke <r> <g> <b> <x,y> <x,y>...   A stroke through canvas points
+ *   tolerance <channel> [fraction]      Allowed difference (0 0)
+ *
+ * with # starting a comment. Pixels differ if any channel differs by more
+ * than the channel tolerance, and the scene matches if no more than the
+ * given fraction of pixels differ, so the default is byte-for-byte.
+ *
+ * The golden image is the scene's path with its extension replaced by
+ * .ppm. If there is none, or updating was asked for, the render is written
+ * there instead; on a mismatch it is written beside it as .actual.ppm.
+ * Only an update passes without a golden image to compare with.
+ *
+ * Windows are opened one at a time, each by its own client, so they map
+ * and stack in the order they are listed. The client is the load
+ * generator, or anything taking its -n, -s, -d and -o options.
+ */
+struct infinidesk_snapshot {
+    struct infinidesk_server *server;
+
+    /* The scene, from the file */
+    const char *path;
+    int width, height;
+    float scale;
+    double viewport_x, viewport_y, zoom;
+    uint32_t channel_tolerance;
+    double fraction_tolerance;
+    struct wl_array windows; /* struct snapshot_window */
+    struct wl_array strokes; /* struct snapshot_stroke */
+
+    /* Command opening the windows, and whether to rewrite the golden */
+    const char *client;
+    bool update;
+
+    /* Data and config directories for the run, so the user's are left alone */
+    struct scratch_env env;
+
+    struct wlr_output *output;
+    struct wl_event_source *timeout;
+    enum snapshot_state state;
+    uint32_t windows_mapped;
+    uint32_t settled_frames;
+
+    /* Results */
+    uint8_t *pixels; /* Captured frame, packed RGB */
+    uint32_t *frame_ns;
+    uint32_t frames;
+    bool failed;
+};
+
+/*
+ * Read a scene file. Returns false on failure.
+ */
+bool snapshot_load(struct infinidesk_snapshot *snapshot, const char *path);
+
+/*
+ * Set the environment up for the headless backend, the pixman renderer and
+ * a scratch data directory. Must be called before the server is
+ * initialised.
+ */
+bool snapshot_setup_env(struct infinidesk_snapshot *snapshot);
+
+/*
+ * Add the output and lay out the scene, once the server has started.
+ * Returns false on failure.
+ */
+bool snapshot_start(struct infinidesk_snapshot *snapshot,
+                    struct infinidesk_server *server);
+
+/*
+ * Clean up after the run.
+ */
+void snapshot_finish(struct infinidesk_snapshot *snapshot);
+
+/*
+ * Remove the scratch data directory. Must be called after the server has
+ * finished, as it saves the drawing layer there.
+ */
+void snapshot_cleanup_env(struct infinidesk_snapshot *snapshot);
+
+/*
+ * Read back a frame's buffer if it is the one to be captured. Called after
+ * the frame has been committed.
+ */
+void snapshot_capture(struct infinidesk_snapshot *snapshot,
+                      struct infinidesk_output *output,
+                      struct wlr_buffer *buffer);
+
+/*
+ * Record a rendered frame and advance the run.
+ */
+void snapshot_frame(struct infinidesk_snapshot *snapshot,
+                    struct infinidesk_output *output);
+
+#endif /* INFINIDESK_SNAPSHOT_H */
@@ -0,0 +1,230 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * stroke.h - Contiguous point storage for drawing strokes
+ */
+
+#ifndef INFINIDESK_STROKE_H
+#define INFINIDESK_STROKE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+#include "infinidesk/drawing_ui.h"
+#include "infinidesk/point_codec.h"
+
+struct drawing_chunk;
+
+/*
+ * A point in stroke-local coordinates.
+ *
+ * Points are stored as float32 offsets from the stroke origin rather than
+ * absolute canvas doubles, which halves their size and keeps precision
+ * independent of how far the stroke is from the canvas origin.
+ */
+struct drawing_point {
+    float x;
+    float y;
+};
+
+/*
+ * Reference-counted point storage, holding either plain points or a packed
+ * block (point_codec.h). Fragments left by the eraser share their parent's
+ * buffer, so erasing never copies point data.
+ */
+struct stroke_buffer {
+    uint32_t refs;
+    uint32_t capacity; /* In points, for plain points */
+    void *data;
+    bool external; /* data is borrowed (e.g. mapped from disk), not owned */
+};
+
+/* Maximum number of coarser levels kept per stroke */
+#define STROKE_MAX_LODS 8
+
+/*
+ * A decimated, packed copy of a stroke's points, used when zoomed out far
+ * enough that the full-detail points would be indistinguishable.
+ */
+struct stroke_lod {
+    void *data;
+    struct packed_points packed;
+    /*
+     * Max deviation from the full stroke, canvas units, from simplifying and
+     * from rounding to the packed quantum together
+     */
+    float tolerance;
+};
+
+/*
+ * A stroke - a continuous line made of multiple points.
+ *
+ * Points are appended to a plain array while the stroke is drawn. Once it
+ * is finished they are packed into a single block a fraction of the size,
+ * which rendering decodes as it goes. Either way, destroying a stroke is a
+ * constant number of frees regardless of its length.
+ */
+struct drawing_stroke {
+    struct wl_list link;        /* drawing_chunk.strokes */
+    struct drawing_color color; /* Color of this stroke */
+    uint64_t id;                /* Unique per canvas */
+
+    /* Chunk the stroke is stored in, once finished */
+    struct drawing_chunk *chunk;
+
+    /* Stacking order (creation order; erase fragments keep their parent's) */
+    uint64_t z;
+
+    /* Canvas position that all points are relative to (the first point) */
+    double origin_x;
+    double origin_y;
+
+    /* Point storage: a range of a possibly shared buffer */
+    struct stroke_buffer *buffer;
+    struct drawing_point *points; /* Plain points, or NULL once packed */
+    struct packed_points packed;  /* Packed points, if points is NULL */
+    uint32_t first_point;         /* Start of the range within packed */
+    uint32_t point_count;
+
+    /* Render as a Catmull-Rom curve through the points (set once simplified) */
+    bool smooth;
+    float tolerance; /* Simplification tolerance, canvas units */
+
+    /* Bounding box of the points, relative to the origin */
+    float min_x, min_y;
+    float max_x, max_y;
+
+    /* Last stroke_index query that visited this stroke */
+    uint32_t index_stamp;
+
+    /* Level-of-detail pyramid, ordered from finest to coarsest */
+    struct stroke_lod lods[STROKE_MAX_LODS];
+    uint32_t lod_count;
+    bool lods_built; /* Set once building has been attempted */
+};
+
+/*
+ * Create an empty stroke whose points will be relative to the given origin.
+ * Returns NULL on allocation failure.
+ */
+struct drawing_stroke *stroke_create(double origin_x, double origin_y,
+                                     struct drawing_color color);
+
+/*
+ * Create a stroke over packed points owned by someone else, such as
+ * records of a memory-mapped journal. The block must stay valid for the
+ * lifetime of the stroke and any fragments of it, and is never modified.
+ * Returns NULL on allocation failure.
+ */
+struct drawing_stroke *
+stroke_create_packed(double origin_x, double origin_y,
+                     struct drawing_color color,
+                     const struct packed_points *packed);
+
+/*
+ * Create a stroke from points [first_point, first_point + point_count) of
+ * parent, sharing its point storage. The fragment keeps the parent's origin,
+ * color and stacking order. Fragments cannot have points appended.
+ * Returns NULL on allocation failure.
+ */
+struct drawing_stroke *stroke_create_fragment(struct drawing_stroke *parent,
+                                              uint32_t first_point,
+                                              uint32_t point_count);
+
+/*
+ * Destroy a stroke and release its point storage.
+ * The stroke must already be removed from any list it was in.
+ */
+void stroke_destroy(struct drawing_stroke *stroke);
+
+/*
+ * Append a point (in canvas coordinates) to the stroke, growing its
+ * bounding box to include it.
+ * Returns false on allocation failure, or if the stroke shares its points.
+ */
+bool stroke_append_point(struct drawing_stroke *stroke, double canvas_x,
+                         double canvas_y);
+
+/*
+ * Pack the points of a finished stroke, rounding them to multiples of
+ * quantum canvas units. Returns false on allocation failure, or if the
+ * stroke shares its points, leaving the points plain.
+ */
+bool stroke_pack(struct drawing_stroke *stroke, float quantum);
+
+/*
+ * Append the stroke's points to out as a packed block. Plain points are
+ * packed with the given quantum; the quantum used is returned through it.
+ * Returns false on allocation failure.
+ */
+bool stroke_export_points(const struct drawing_stroke *stroke,
+                          struct wl_array *out, float *quantum);
+
+/*
+ * Bytes used by the stroke's points, counting a share of any block it
+ * shares with other fragments.
+ */
+size_t stroke_point_bytes(const struct drawing_stroke *stroke);
+
+/*
+ * Start walking points [first, first + count) of the stroke.
+ */
+void stroke_cursor(const struct drawing_stroke *stroke, uint32_t first,
+                   uint32_t count, struct point_cursor *cursor);
+
+/*
+ * Simplify the stroke in place using Ramer-Douglas-Peucker, dropping points
+ * that lie within `tolerance` canvas units of the simplified polyline.
+ * The first and last points are always kept.
+ * Returns false on allocation failure or if the stroke is packed, leaving
+ * the stroke unchanged.
+ */
+bool stroke_simplify(struct drawing_stroke *stroke, double tolerance);
+
+/*
+ * Test whether the stroke segment p-q (stroke-local) comes within radius of
+ * the canvas segment a-b.
+ */
+bool stroke_segment_near(const struct drawing_stroke *stroke,
+                         const struct drawing_point *p,
+                         const struct drawing_point *q, double ax, double ay,
+                         double bx, double by, double radius);
+
+/*
+ * Recompute the stroke's bounding box from its points, e.g. to tighten it
+ * after simplification.
+ */
+void stroke_compute_bounds(struct drawing_stroke *stroke);
+
+/*
+ * Build the level-of-detail pyramid for a finished stroke. Each level is
+ * simplified with double the tolerance of the previous one, starting from
+ * base_tolerance (canvas units), until a level would be no coarser than its
+ * bounding box. The tolerance bounds the level's points' deviation once
+ * packed, so it covers both simplifying and quantising them. Bounds must be
+ * up to date.
+ * Returns false on allocation failure, leaving the stroke with no levels.
+ */
+bool stroke_build_lods(struct drawing_stroke *stroke, double base_tolerance);
+
+/*
+ * Select the coarsest set of points whose deviation from the full stroke is
+ * at most max_error canvas units, falling back to the full-detail points.
+ * Starts the cursor walking them and returns how many there are.
+ */
+uint32_t stroke_select_lod(const struct drawing_stroke *stroke,
+                           double max_error, struct point_cursor *cursor);
+
+/*
+ * Evaluate the uniform Catmull-Rom spline on the segment ctrl[1] -> ctrl[2]
+ * at parameter t in [0, 1], where ctrl[0] and ctrl[3] are the points either
+ * side of it (or the end points themselves at the ends of a stroke, so the
+ * curve passes through every point). Result is in stroke-local coordinates.
+ */
+void stroke_eval_catmull_rom(const struct drawing_point ctrl[4], float t,
+                             float *x, float *y);
+
+#endif /* INFINIDESK_STROKE_H */
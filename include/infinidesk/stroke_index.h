@@ -0,0 +1,128 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * stroke_index.h - Uniform grid spatial index of stroke segments
+ */
+
+#ifndef INFINIDESK_STROKE_INDEX_H
+#define INFINIDESK_STROKE_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct drawing_stroke;
+
+/*
+ * A run of consecutive segments of one stroke that touch a cell.
+ * Segment i joins points[i] and points[i + 1].
+ */
+struct stroke_index_entry {
+    struct drawing_stroke *stroke;
+    uint32_t first_seg;
+    uint32_t last_seg; /* Inclusive */
+};
+
+/* A grid cell, stored in an open-addressed hash table keyed by (x, y) */
+struct stroke_index_cell {
+    int32_t x, y;
+    bool used;
+
+    struct stroke_index_entry *entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+};
+
+/*
+ * Spatial index over the segments of all completed strokes.
+ *
+ * The canvas is divided into square cells of cell_size canvas units; only
+ * cells that a segment passes through are allocated, and they are freed
+ * again when emptied, so the index stays proportional to the inked area
+ * of an unbounded canvas.
+ */
+struct stroke_index {
+    double cell_size;
+
+    struct stroke_index_cell *cells;
+    uint32_t capacity; /* Always a power of two */
+    uint32_t used;
+
+    /* Incremented per query to visit each stroke once */
+    uint32_t stamp;
+};
+
+/*
+ * Called for each run of segments intersecting a query rect.
+ * The same stroke may be reported more than once, from different cells.
+ */
+typedef void (*stroke_index_segment_func_t)(struct drawing_stroke *stroke,
+                                            uint32_t first_seg,
+                                            uint32_t last_seg, void *data);
+
+/*
+ * Called once for each stroke with a segment in a cell intersecting a query
+ * rect.
+ */
+typedef void (*stroke_index_stroke_func_t)(struct drawing_stroke *stroke,
+                                           void *data);
+
+/*
+ * Initialise an empty index with the given cell size (canvas units).
+ */
+void stroke_index_init(struct stroke_index *index, double cell_size);
+
+/*
+ * Free all memory held by the index.
+ */
+void stroke_index_finish(struct stroke_index *index);
+
+/*
+ * Remove all strokes from the index.
+ */
+void stroke_index_clear(struct stroke_index *index);
+
+/*
+ * Move every cell by an offset in canvas units, which must be a whole
+ * number of cells, to follow strokes that have all been moved by it.
+ * Returns false on allocation failure, leaving the index unchanged.
+ */
+bool stroke_index_translate(struct stroke_index *index, double dx,
+                            double dy);
+
+/*
+ * Add all segments of a stroke to the index. The stroke's points and bounds
+ * must not change while it is indexed.
+ * Returns false on allocation failure, leaving the stroke partly indexed
+ * (stroke_index_remove() undoes this).
+ */
+bool stroke_index_insert(struct stroke_index *index,
+                         struct drawing_stroke *stroke);
+
+/*
+ * Remove all segments of a stroke from the index.
+ */
+void stroke_index_remove(struct stroke_index *index,
+                         struct drawing_stroke *stroke);
+
+/*
+ * Visit each run of segments in cells intersecting the canvas rect.
+ * Segments are reported by cell, so callers needing exact hits must test
+ * the segments themselves.
+ */
+void stroke_index_query_segments(struct stroke_index *index, double min_x,
+                                 double min_y, double max_x, double max_y,
+                                 stroke_index_segment_func_t iterator,
+                                 void *data);
+
+/*
+ * Visit each stroke with segments in cells intersecting the canvas rect,
+ * exactly once per query.
+ */
+void stroke_index_query_strokes(struct stroke_index *index, double min_x,
+                                double min_y, double max_x, double max_y,
+                                stroke_index_stroke_func_t iterator,
+                                void *data);
+
+#endif /* INFINIDESK_STROKE_INDEX_H */
@@ -0,0 +1,55 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * stroke_render.h - Turning strokes into render commands
+ */
+
+#ifndef INFINIDESK_STROKE_RENDER_H
+#define INFINIDESK_STROKE_RENDER_H
+
+#include <stdint.h>
+
+#include "infinidesk/drawing_ui.h"
+
+struct drawing_stroke;
+struct point_transform;
+
+/* Stroke width in canvas units */
+#define STROKE_LINE_WIDTH 4.0f
+
+/* A filled rectangle, in physical pixels */
+struct stroke_rect {
+    int x, y;
+    int width, height;
+};
+
+/*
+ * Where stroke_render() sends the rectangles a stroke is drawn with.
+ * The compositor adds them to a wlroots render pass; benchmarks just count
+ * them.
+ */
+struct stroke_pass {
+    void (*add_rect)(void *data, const struct stroke_rect *rect,
+                     const struct drawing_color *color);
+    void *data;
+};
+
+/*
+ * Render a stroke, following a Catmull-Rom curve through its points if it
+ * has been simplified, or straight segments otherwise. The transform maps
+ * stroke-local points to physical pixels. error_scale says how much detail
+ * may be dropped, 1.0 being none that is visible.
+ */
+void stroke_render(const struct stroke_pass *pass,
+                   struct drawing_stroke *stroke,
+                   const struct point_transform *transform,
+                   double error_scale);
+
+/*
+ * Sort strokes into stacking order, bottom first.
+ */
+void stroke_sort_z(struct drawing_stroke **strokes, uint32_t count);
+
+#endif /* INFINIDESK_STROKE_RENDER_H */
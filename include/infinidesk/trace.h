@@ -0,0 +1,81 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * trace.h - Event tracing in the Chrome trace format
+ */
+
+#ifndef INFINIDESK_TRACE_H
+#define INFINIDESK_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * While tracing, timestamped compositor events are kept in a fixed-size
+ * ring in memory, with the oldest overwritten once it fills. Recording an
+ * event is a few stores, with no allocation or locking; nothing is written
+ * out until tracing stops. The dump is Chrome Trace Event JSON, which
+ * ui.perfetto.dev and chrome://tracing both load.
+ *
+ * Events are recorded on tracks, shown as threads in the trace viewer.
+ */
+
+/* Events kept in the ring */
+#define TRACE_CAPACITY 65536
+
+/* Longest event argument kept, including the terminator */
+#define TRACE_ARG_LEN 48
+
+/* Fixed tracks. Outputs get their own from trace_register_track(). */
+enum trace_track {
+    TRACE_TRACK_INPUT,
+    TRACE_TRACK_CLIENTS,
+    TRACE_TRACK_ANIMATION,
+    TRACE_TRACK_FIXED_COUNT,
+};
+
+/*
+ * Start recording, to be written to path when stopped. With a NULL path,
+ * the previous path is used, or infinidesk-trace.json in $XDG_RUNTIME_DIR.
+ * Does nothing if already recording.
+ */
+bool trace_start(const char *path);
+
+/*
+ * Stop recording and write out the trace. Does nothing if not recording.
+ */
+bool trace_stop(void);
+
+/*
+ * Whether events are being recorded.
+ */
+bool trace_active(void);
+
+/*
+ * Register a named track, e.g. for an output. Returns its id.
+ */
+uint32_t trace_register_track(const char *name);
+
+/*
+ * Get the time to pass as the start of trace_complete(), or 0 when not
+ * recording.
+ */
+uint64_t trace_now(void);
+
+/*
+ * Record an instant event. name must be a string literal; the argument is
+ * formatted and copied, and only when recording.
+ */
+void trace_instant(uint32_t track, const char *name, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/*
+ * Record an event lasting from start_ns (from trace_now()) until now.
+ */
+void trace_complete(uint32_t track, const char *name, uint64_t start_ns,
+                    const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+#endif /* INFINIDESK_TRACE_H */
@@ -10,15 +10,19 @@
 #define INFINIDESK_VIEW_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <wayland-server-core.h>
 #include <wlr/render/pass.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_xdg_shell.h>
 
+#include "infinidesk/client_stats.h"
+
 /* Forward declaration */
 struct infinidesk_server;
 struct infinidesk_canvas;
+struct render_quality;
 
 /* Animation duration in milliseconds */
 #define VIEW_FOCUS_ANIM_DURATION_MS 200
@@ -80,12 +84,30 @@ struct infinidesk_view {
                                  * completes
                                  */
 
+    /* Commit accounting, and coalescing while the client is throttled */
+    struct commit_rate commit_rate;
+    bool commit_deferred;    /* A commit is waiting to be processed */
+    uint32_t commit_done_ms; /* When a commit was last processed */
+    uint32_t shown_ms;       /* When last drawn on any output */
+    uint32_t frame_done_ms;  /* When paced frame done was last sent */
+
     /* Surface event listeners */
     struct wl_listener map;
     struct wl_listener unmap;
     struct wl_listener destroy;
     struct wl_listener commit;
 
+    /*
+     * Subsurfaces at any depth, whose commits can move the view's extents
+     * without its own surface committing
+     */
+    struct wl_list subsurfaces; /* view_subsurface.link */
+    struct wl_listener new_subsurface;
+
+    /* XDG surface event listeners, for tracing */
+    struct wl_listener configure;
+    struct wl_listener ack_configure;
+
     /* Toplevel event listeners */
     struct wl_listener request_move;
     struct wl_listener request_resize;
@@ -129,6 +151,13 @@ void view_get_geometry(struct infinidesk_view *view, double *x, double *y,
  */
 void view_set_position(struct infinidesk_view *view, double x, double y);
 
+/*
+ * Shift the view and any move or resize in progress by an offset in canvas
+ * coordinates, for when the canvas origin moves. The view stays where it
+ * is on screen.
+ */
+void view_translate(struct infinidesk_view *view, double dx, double dy);
+
 /*
  * Update the view's scene graph position based on canvas coordinates
  * and the current viewport.
@@ -182,16 +211,18 @@ void view_close(struct infinidesk_view *view);
 /*
  * Render the view to a render pass with the current canvas transform.
  * output_scale is the HiDPI scale factor of the output (e.g., 1.0, 1.5, 2.0).
+ * quality says what may be cut back on to render the frame in time.
  */
 void view_render(struct infinidesk_view *view, struct wlr_render_pass *pass,
-                 float output_scale);
+                 float output_scale, const struct render_quality *quality);
 
 /*
  * Render the view's popup surfaces (context menus, dropdowns, etc.).
  * Should be called after all views are rendered so popups appear on top.
  */
 void view_render_popups(struct infinidesk_view *view,
-                        struct wlr_render_pass *pass, float output_scale);
+                        struct wlr_render_pass *pass, float output_scale,
+                        const struct render_quality *quality);
 
 /*
  * Snaps to a view
@@ -211,6 +242,27 @@ void view_update_focus_animations(struct infinidesk_server *server,
  */
 bool view_any_animating(struct infinidesk_server *server);
 
+/*
+ * Get the bytes used by the textures of a mapped view's surfaces and
+ * popups, or 0 if it isn't mapped.
+ */
+size_t view_texture_memory(struct infinidesk_view *view);
+
+/*
+ * Process commits deferred while their clients were throttled, once a
+ * frame for windows on-screen and at CLIENT_OFFSCREEN_RATE for the rest.
+ */
+void views_flush_commits(struct infinidesk_server *server, uint32_t time_ms);
+
+/*
+ * Check whether a mapped view should be sent frame done in the frame at
+ * time_ms. Throttled clients are only sent it at CLIENT_OFFSCREEN_RATE while
+ * off-screen, so they are paced down rather than just having their commits
+ * deferred. Every output rendering the frame it is sent in gets the same
+ * answer.
+ */
+bool view_frame_due(struct infinidesk_view *view, uint32_t time_ms);
+
 /*
  * Gather all views so they are exactly minimum_gap pixels apart (edge-to-edge),
  * preserving relative directional positioning, and center on viewport.
@@ -0,0 +1,102 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * view_cache.h - Packed view bounds for culling and hit testing
+ */
+
+#ifndef INFINIDESK_VIEW_CACHE_H
+#define INFINIDESK_VIEW_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+struct infinidesk_view;
+struct wlr_box;
+
+/*
+ * The canvas bounds of every mapped view, front to back, in parallel
+ * arrays so culling and hit testing test several views per instruction.
+ *
+ * Bounds are in canvas coordinates, so panning and zooming leave the cache
+ * valid. It is rebuilt lazily after a view moves, commits, or changes
+ * stacking order or mapped state.
+ */
+struct view_cache {
+    struct infinidesk_view **views;
+
+    /* Hit box: the window geometry, placed as it is rendered */
+    double *x, *y;
+    double *w, *h;
+
+    /* Everything drawn for the view, including decorations */
+    double *draw_x, *draw_y;
+    double *draw_w, *draw_h;
+
+    /* Offset of the window geometry within the view's surface */
+    int32_t *geo_x, *geo_y;
+
+    uint32_t count;
+    uint32_t capacity;
+    bool dirty;
+
+    /* Scratch indices of views found by a cull */
+    uint32_t *visible;
+};
+
+/*
+ * Initialise an empty cache.
+ */
+void view_cache_init(struct view_cache *cache);
+
+/*
+ * Free all memory held by the cache.
+ */
+void view_cache_finish(struct view_cache *cache);
+
+/*
+ * Mark the cache as needing a rebuild.
+ */
+void view_cache_invalidate(struct view_cache *cache);
+
+/*
+ * Rebuild the cache from a list of views (infinidesk_view.link) if it has
+ * been invalidated. Returns false on allocation failure, leaving the cache
+ * empty until the next attempt.
+ */
+bool view_cache_update(struct view_cache *cache, struct wl_list *views);
+
+/*
+ * Empty the cache and make room for count views. Returns false on
+ * allocation failure. view_cache_update() does this and view_cache_add()
+ * itself; they are separate so the cache can be filled without wlroots
+ * surfaces.
+ */
+bool view_cache_reset(struct view_cache *cache, uint32_t count);
+
+/*
+ * Add a view behind those already in the cache, given its canvas position,
+ * window geometry and surface extents.
+ */
+void view_cache_add(struct view_cache *cache, struct infinidesk_view *view,
+                    double x, double y, const struct wlr_box *geo,
+                    const struct wlr_box *extents);
+
+/*
+ * Find the views whose drawn bounds intersect a canvas rect. Their indices
+ * are stored front to back in cache->visible; returns how many there are.
+ */
+uint32_t view_cache_cull(struct view_cache *cache, double min_x, double min_y,
+                         double max_x, double max_y);
+
+/*
+ * Find the frontmost view at or after index start whose hit box, grown by
+ * margin canvas units on each side, contains a canvas point.
+ * Returns its index, or -1 if there is none.
+ */
+int32_t view_cache_find(const struct view_cache *cache, uint32_t start,
+                        double x, double y, double margin);
+
+#endif /* INFINIDESK_VIEW_CACHE_H */
@@ -0,0 +1,98 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * watchdog.h - Main loop stall detection
+ */
+
+#ifndef INFINIDESK_WATCHDOG_H
+#define INFINIDESK_WATCHDOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct perf_sample;
+
+/* Default stall threshold, in ms */
+#define WATCHDOG_DEFAULT_THRESHOLD_MS 20
+
+/* Handler sections kept per dispatch, and how deeply they may nest */
+#define WATCHDOG_MAX_SECTIONS 16
+#define WATCHDOG_MAX_DEPTH 8
+
+/* A handler that ran during a dispatch */
+struct watchdog_section {
+    const char *name;
+    uint32_t depth;
+    uint64_t ns;
+};
+
+/*
+ * Each dispatch of the main loop is timed, from the loop waking up until
+ * it goes back to waiting. The main event handlers mark themselves as
+ * sections, so that a dispatch going over the threshold can be logged with
+ * the handlers that ran during it. Output frames going over are logged with
+ * the time taken by each stage of rendering.
+ */
+struct infinidesk_watchdog {
+    uint64_t threshold_ns; /* 0 disables the watchdog */
+
+    /* The current dispatch */
+    uint64_t dispatch_start_ns;
+    struct watchdog_section sections[WATCHDOG_MAX_SECTIONS];
+    uint32_t section_count;
+    uint32_t sections_dropped;
+
+    /* Sections that have been entered but not yet left */
+    struct {
+        const char *name;
+        uint64_t start_ns;
+        uint32_t first; /* Where its own section will go */
+    } stack[WATCHDOG_MAX_DEPTH];
+    uint32_t depth;
+
+    /* Instrumentation */
+    uint64_t dispatches;
+    uint64_t stalls;
+    uint64_t frame_stalls;
+    uint64_t stall_ns_total;
+    uint64_t max_stall_ns;
+    uint64_t last_stall_ns;
+};
+
+/*
+ * Initialise the watchdog. A threshold of 0 disables it.
+ */
+void watchdog_init(struct infinidesk_watchdog *watchdog,
+                   uint32_t threshold_ms);
+
+/*
+ * Mark the start of a dispatch of the main loop.
+ */
+void watchdog_dispatch_begin(struct infinidesk_watchdog *watchdog);
+
+/*
+ * Mark the end of a dispatch, logging it if it stalled. name says what the
+ * loop was doing.
+ */
+void watchdog_dispatch_end(struct infinidesk_watchdog *watchdog,
+                           const char *name);
+
+/*
+ * Enter a handler section. name must stay valid until the dispatch ends.
+ */
+void watchdog_enter(struct infinidesk_watchdog *watchdog, const char *name);
+
+/*
+ * Leave the innermost handler section.
+ */
+void watchdog_leave(struct infinidesk_watchdog *watchdog);
+
+/*
+ * Check a rendered frame's stage timings, logging them if it stalled.
+ */
+void watchdog_frame(struct infinidesk_watchdog *watchdog,
+                    const char *output_name, const struct perf_sample *sample);
+
+#endif /* INFINIDESK_WATCHDOG_H */
@@ -0,0 +1,492 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * bench.c - Headless benchmark scenario
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/bench.h"
+#include "infinidesk/canvas.h"
+#include "infinidesk/drawing.h"
+#include "infinidesk/output.h"
+#include "infinidesk/perf.h"
+#include "infinidesk/replay.h"
+#include "infinidesk/scratch.h"
+#include "infinidesk/server.h"
+#include "infinidesk/switcher.h"
+#include "infinidesk/view.h"
+
+/* Screen pixels panned per frame, and frames per circle */
+#define BENCH_PAN_SPEED 24.0
+#define BENCH_PAN_PERIOD 120
+
+/* Zoom factor per frame, and frames each way */
+#define BENCH_ZOOM_STEP 1.03
+#define BENCH_ZOOM_PERIOD 60
+
+/* Frames per stroke, and how far apart its points are in screen pixels */
+#define BENCH_STROKE_FRAMES 30
+#define BENCH_STROKE_STEP 50.0
+
+/* Frames between switcher steps, and steps before confirming */
+#define BENCH_SWITCHER_STEP 10
+#define BENCH_SWITCHER_CYCLE 6
+
+static const char *phase_names[] = {
+    [BENCH_IDLE] = "idle",
+    [BENCH_PAN] = "pan",
+    [BENCH_ZOOM] = "zoom",
+    [BENCH_DRAW] = "draw",
+    [BENCH_SWITCHER] = "switcher",
+    [BENCH_REPLAY] = "replay",
+};
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t get_cpu_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long get_peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) < 0) {
+        return 0;
+    }
+    return usage.ru_maxrss;
+}
+
+bool bench_setup_env(struct infinidesk_bench *bench) {
+    setenv("WLR_BACKENDS", "headless", true);
+    setenv("WLR_LIBINPUT_NO_DEVICES", "1", true);
+    /* Keep a renderer chosen by the caller, so GPU runs are still possible */
+    setenv("WLR_RENDERER", "pixman", false);
+
+    /* Start from an empty canvas, and leave the user's annotations alone */
+    return scratch_env_create(&bench->env, "bench");
+}
+
+void bench_cleanup_env(struct infinidesk_bench *bench) {
+    scratch_env_remove(&bench->env);
+}
+
+static void find_headless(struct wlr_backend *backend, void *data) {
+    struct wlr_backend **headless = data;
+    if (wlr_backend_is_headless(backend)) {
+        *headless = backend;
+    }
+}
+
+static int handle_timeout(void *data) {
+    struct infinidesk_bench *bench = data;
+
+    wlr_log(WLR_ERROR, "Benchmark timed out in phase %s after %u frames",
+            bench->started ? phase_names[bench->phase] : "startup",
+            bench->frame);
+    bench->failed = true;
+    server_terminate(bench->server);
+    return 0;
+}
+
+bool bench_start(struct infinidesk_bench *bench,
+                 struct infinidesk_server *server) {
+    bench->server = server;
+    bench->start_ns = get_time_ns();
+
+    struct wlr_backend *headless = NULL;
+    if (wlr_backend_is_headless(server->backend)) {
+        headless = server->backend;
+    } else if (wlr_backend_is_multi(server->backend)) {
+        wlr_multi_for_each_backend(server->backend, find_headless, &headless);
+    }
+    if (!headless) {
+        wlr_log(WLR_ERROR, "Benchmark needs the headless backend");
+        return false;
+    }
+
+    bench->width = BENCH_OUTPUT_WIDTH;
+    bench->height = BENCH_OUTPUT_HEIGHT;
+    if (bench->replay && bench->replay->width > 0 &&
+        bench->replay->height > 0) {
+        bench->width = bench->replay->width;
+        bench->height = bench->replay->height;
+    }
+
+    /* Outputs time their frames if they see a benchmark running */
+    server->bench = bench;
+    bench->output =
+        wlr_headless_add_output(headless, bench->width, bench->height);
+    if (!bench->output) {
+        wlr_log(WLR_ERROR, "Failed to add benchmark output");
+        server->bench = NULL;
+        return false;
+    }
+
+    bench->timeout =
+        wl_event_loop_add_timer(server->event_loop, handle_timeout, bench);
+    if (bench->timeout) {
+        /* A replay runs at its recorded pace, or slower if frames are slow */
+        uint32_t timeout_ms = BENCH_TIMEOUT_MS;
+        struct infinidesk_replay *replay = bench->replay;
+        if (replay && replay->event_count > 0) {
+            timeout_ms += 2 * replay->events[replay->event_count - 1].time_msec;
+        }
+        wl_event_source_timer_update(bench->timeout, timeout_ms);
+    }
+
+    if (bench->client) {
+        for (uint32_t i = 0; i < bench->windows; i++) {
+            if (fork() == 0) {
+                execl("/bin/sh", "/bin/sh", "-c", bench->client,
+                      (char *)NULL);
+                _exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    if (bench->replay) {
+        replay_start(bench->replay, server);
+    }
+
+    wlr_log(WLR_INFO, "Benchmark started: %ux%u, %u windows%s",
+            bench->width, bench->height, bench->client ? bench->windows : 0,
+            bench->replay ? ", replaying a recording" : "");
+    return true;
+}
+
+void bench_finish(struct infinidesk_bench *bench) {
+    if (bench->timeout) {
+        wl_event_source_remove(bench->timeout);
+        bench->timeout = NULL;
+    }
+    if (bench->server) {
+        bench->server->bench = NULL;
+    }
+    for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+        free(bench->results[phase].frame_ns);
+        bench->results[phase] = (struct bench_result){0};
+    }
+}
+
+static uint32_t count_mapped_views(struct infinidesk_server *server) {
+    uint32_t count = 0;
+    struct infinidesk_view *view;
+    wl_list_for_each(view, &server->views, link) {
+        if (view->xdg_toplevel->base->surface->mapped) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/* Apply the scenario's step for the given frame of the current phase */
+static void step(struct infinidesk_bench *bench) {
+    struct infinidesk_server *server = bench->server;
+    uint32_t frame = bench->frame;
+    double centre_x = bench->width / 2.0;
+    double centre_y = bench->height / 2.0;
+
+    switch (bench->phase) {
+    case BENCH_IDLE:
+        break;
+
+    case BENCH_PAN: {
+        double angle = 2.0 * M_PI * frame / BENCH_PAN_PERIOD;
+        canvas_pan_delta(&server->canvas, BENCH_PAN_SPEED * cos(angle),
+                         BENCH_PAN_SPEED * sin(angle));
+        break;
+    }
+
+    case BENCH_ZOOM: {
+        bool zoom_in = (frame / BENCH_ZOOM_PERIOD) % 2 == 0;
+        canvas_zoom(&server->canvas,
+                    zoom_in ? BENCH_ZOOM_STEP : 1.0 / BENCH_ZOOM_STEP,
+                    centre_x, centre_y);
+        break;
+    }
+
+    case BENCH_DRAW: {
+        struct drawing_layer *drawing = &server->drawing;
+        if (!drawing->drawing_mode) {
+            drawing_toggle_mode(drawing);
+        }
+
+        /* Zigzag strokes across the screen, one row after another */
+        uint32_t stroke = frame / BENCH_STROKE_FRAMES;
+        uint32_t point = frame % BENCH_STROKE_FRAMES;
+        double screen_x = 100.0 + point * BENCH_STROKE_STEP;
+        double screen_y = 100.0 + (stroke % 10) * 90.0 + 30.0 * (point % 2);
+        double canvas_x, canvas_y;
+        screen_to_canvas(&server->canvas, screen_x, screen_y, &canvas_x,
+                         &canvas_y);
+        if (point == 0) {
+            drawing_stroke_end(drawing);
+            drawing_stroke_begin(drawing, canvas_x, canvas_y);
+        } else {
+            drawing_stroke_add_point(drawing, canvas_x, canvas_y);
+        }
+        break;
+    }
+
+    case BENCH_SWITCHER: {
+        struct infinidesk_switcher *switcher = &server->switcher;
+        if (frame % BENCH_SWITCHER_STEP != 0) {
+            break;
+        }
+        uint32_t steps = frame / BENCH_SWITCHER_STEP;
+        if (!switcher->active) {
+            switcher_start(switcher);
+        } else if (steps % BENCH_SWITCHER_CYCLE == 0) {
+            switcher_confirm(switcher);
+        } else {
+            switcher_next(switcher);
+        }
+        break;
+    }
+
+    case BENCH_REPLAY:
+        /* The replay injects its own input as frames start */
+        break;
+
+    case BENCH_PHASE_COUNT:
+        break;
+    }
+}
+
+/* Leave the canvas as the phase found it, as far as later phases care */
+static void end_phase(struct infinidesk_bench *bench) {
+    struct infinidesk_server *server = bench->server;
+
+    switch (bench->phase) {
+    case BENCH_ZOOM:
+        canvas_set_scale(&server->canvas, 1.0, bench->width / 2.0,
+                         bench->height / 2.0);
+        break;
+
+    case BENCH_DRAW:
+        drawing_stroke_end(&server->drawing);
+        if (server->drawing.drawing_mode) {
+            drawing_toggle_mode(&server->drawing);
+        }
+        break;
+
+    case BENCH_SWITCHER:
+        if (server->switcher.active) {
+            switcher_cancel(&server->switcher);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    struct bench_result *result = &bench->results[bench->phase];
+    result->cpu_ns = get_cpu_time_ns() - bench->phase_cpu_start_ns;
+    result->peak_rss_kb = get_peak_rss_kb();
+}
+
+static bool add_frame(struct bench_result *result, uint32_t ns) {
+    if (result->frames == result->capacity) {
+        uint32_t capacity =
+            result->capacity ? result->capacity * 2 : BENCH_PHASE_FRAMES;
+        uint32_t *frame_ns =
+            realloc(result->frame_ns, capacity * sizeof(*frame_ns));
+        if (!frame_ns) {
+            return false;
+        }
+        result->frame_ns = frame_ns;
+        result->capacity = capacity;
+    }
+    result->frame_ns[result->frames++] = ns;
+    return true;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Write frame time statistics in ms, sorting the values in place */
+static void write_frame_stats(FILE *file, uint32_t *values, size_t count) {
+    qsort(values, count, sizeof(values[0]), compare_u32);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        sum += values[i];
+    }
+    fprintf(file,
+            "{\"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, "
+            "\"max\": %.3f}",
+            sum / count / 1e6, values[(count - 1) * 50 / 100] / 1e6,
+            values[(count - 1) * 95 / 100] / 1e6,
+            values[(count - 1) * 99 / 100] / 1e6, values[count - 1] / 1e6);
+}
+
+static bool write_results(struct infinidesk_bench *bench) {
+    bool to_stdout = strcmp(bench->path, "-") == 0;
+    FILE *file = to_stdout ? stdout : fopen(bench->path, "w");
+    if (!file) {
+        wlr_log_errno(WLR_ERROR, "Failed to open %s", bench->path);
+        return false;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const char *renderer = getenv("WLR_RENDERER");
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"backend\": \"headless\",\n");
+    fprintf(file, "  \"renderer\": \"%s\",\n", renderer ? renderer : "auto");
+    fprintf(file,
+            "  \"output\": {\"width\": %d, \"height\": %d, "
+            "\"scale\": %.2f},\n",
+            bench->width, bench->height, bench->server->output_scale);
+    fprintf(file, "  \"windows\": %u,\n", bench->views_mapped);
+    fprintf(file, "  \"phases\": [\n");
+
+    size_t total = 0;
+    for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+        total += bench->results[phase].frames;
+    }
+    uint32_t *all = calloc(total ? total : 1, sizeof(*all));
+    if (!all) {
+        wlr_log(WLR_ERROR, "Failed to allocate benchmark results");
+        if (!to_stdout) {
+            fclose(file);
+        }
+        return false;
+    }
+
+    /* Only the phases that ran */
+    size_t written = 0;
+    for (int phase = 0; phase < BENCH_PHASE_COUNT; phase++) {
+        struct bench_result *result = &bench->results[phase];
+        if (result->frames == 0) {
+            continue;
+        }
+        memcpy(&all[written], result->frame_ns,
+               result->frames * sizeof(*all));
+        written += result->frames;
+
+        fprintf(file, "    {\"name\": \"%s\", \"frames\": %u, ",
+                phase_names[phase], result->frames);
+        fprintf(file, "\"frame_ms\": ");
+        write_frame_stats(file, result->frame_ns, result->frames);
+        fprintf(file, ", \"cpu_ms\": %.1f, \"peak_rss_kb\": %ld}%s\n",
+                result->cpu_ns / 1e6, result->peak_rss_kb,
+                written < total ? "," : "");
+    }
+    fprintf(file, "  ],\n");
+
+    fprintf(file, "  \"frame_ms\": ");
+    write_frame_stats(file, all, total);
+    fprintf(file, ",\n");
+    free(all);
+    fprintf(file, "  \"cpu_user_s\": %.3f,\n",
+            usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6);
+    fprintf(file, "  \"cpu_system_s\": %.3f,\n",
+            usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6);
+    fprintf(file, "  \"peak_rss_kb\": %ld,\n", usage.ru_maxrss);
+    fprintf(file, "  \"wall_s\": %.3f\n",
+            (get_time_ns() - bench->start_ns) / 1e9);
+    fprintf(file, "}\n");
+
+    if (to_stdout) {
+        fflush(file);
+        return true;
+    }
+    return fclose(file) == 0;
+}
+
+void bench_frame(struct infinidesk_bench *bench,
+                 struct infinidesk_output *output) {
+    if (output->wlr_output != bench->output || bench->done) {
+        return;
+    }
+
+    if (!bench->started) {
+        /* Wait for the windows to map, then let their first frames settle */
+        bench->frame++;
+        uint32_t wanted = bench->client ? bench->windows : 0;
+        uint32_t mapped = count_mapped_views(bench->server);
+        bool timed_out = get_time_ns() - bench->start_ns >
+                         (uint64_t)BENCH_WINDOW_TIMEOUT_MS * 1000000;
+        if ((mapped < wanted && !timed_out) ||
+            bench->frame < BENCH_WARMUP_FRAMES) {
+            return;
+        }
+        if (mapped < wanted) {
+            wlr_log(WLR_ERROR, "Only %u of %u benchmark windows mapped",
+                    mapped, wanted);
+        }
+
+        bench->views_mapped = mapped;
+        bench->started = true;
+        bench->phase = bench->replay ? BENCH_REPLAY : BENCH_IDLE;
+        bench->frame = 0;
+        bench->phase_cpu_start_ns = get_cpu_time_ns();
+        if (bench->replay) {
+            replay_play(bench->replay);
+        }
+        step(bench);
+        return;
+    }
+
+    bench->frame++;
+    if (!add_frame(&bench->results[bench->phase],
+                   output->perf.current.ns[PERF_TOTAL])) {
+        wlr_log(WLR_ERROR, "Failed to allocate benchmark results");
+        bench->failed = true;
+        bench->done = true;
+        server_terminate(bench->server);
+        return;
+    }
+
+    bool phase_done = bench->replay ? bench->replay->done
+                                    : bench->frame == BENCH_PHASE_FRAMES;
+    if (!phase_done) {
+        step(bench);
+        return;
+    }
+
+    end_phase(bench);
+    wlr_log(WLR_INFO, "Benchmark phase %s done", phase_names[bench->phase]);
+    if (bench->phase + 1 < BENCH_REPLAY) {
+        bench->phase++;
+        bench->frame = 0;
+        bench->phase_cpu_start_ns = get_cpu_time_ns();
+        step(bench);
+        return;
+    }
+
+    bench->done = true;
+    if (!write_results(bench)) {
+        bench->failed = true;
+    }
+    server_terminate(bench->server);
+}
@@ -8,16 +8,16 @@
 
 #define _POSIX_C_SOURCE 200809L
 
+#include <inttypes.h>
+#include <math.h>
+
 #include <wlr/util/log.h>
 
 #include "infinidesk/canvas.h"
 #include "infinidesk/server.h"
+#include "infinidesk/trace.h"
 #include "infinidesk/view.h"
 
-/* Minimum and maximum zoom levels */
-#define ZOOM_MIN 0.1
-#define ZOOM_MAX 4.0
-
 /* Pan sensitivity multiplier for scroll-based panning */
 #define PAN_SENSITIVITY 2.5
 
@@ -28,6 +28,8 @@ void canvas_init(struct infinidesk_canvas *canvas,
     /* Start with viewport at origin */
     canvas->viewport_x = 0.0;
     canvas->viewport_y = 0.0;
+    canvas->origin_x = 0;
+    canvas->origin_y = 0;
 
     /* Initial zoom level is 100% */
     canvas->scale = 1.0;
@@ -50,20 +52,6 @@ void canvas_init(struct infinidesk_canvas *canvas,
     wlr_log(WLR_DEBUG, "Canvas initialised at origin with scale 1.0");
 }
 
-void canvas_to_screen(struct infinidesk_canvas *canvas, double canvas_x,
-                      double canvas_y, double *screen_x, double *screen_y) {
-    /* screen = (canvas - viewport) * scale */
-    *screen_x = (canvas_x - canvas->viewport_x) * canvas->scale;
-    *screen_y = (canvas_y - canvas->viewport_y) * canvas->scale;
-}
-
-void screen_to_canvas(struct infinidesk_canvas *canvas, double screen_x,
-                      double screen_y, double *canvas_x, double *canvas_y) {
-    /* canvas = screen / scale + viewport */
-    *canvas_x = screen_x / canvas->scale + canvas->viewport_x;
-    *canvas_y = screen_y / canvas->scale + canvas->viewport_y;
-}
-
 void canvas_pan_begin(struct infinidesk_canvas *canvas, double cursor_x,
                       double cursor_y) {
     canvas->is_panning = true;
@@ -118,31 +106,12 @@ void canvas_pan_delta(struct infinidesk_canvas *canvas, double delta_x,
 void canvas_zoom(struct infinidesk_canvas *canvas, double factor,
                  double focus_x, double focus_y) {
     /* Calculate new scale, clamped to limits */
-    double new_scale = canvas->scale * factor;
-    if (new_scale < ZOOM_MIN) {
-        new_scale = ZOOM_MIN;
-    } else if (new_scale > ZOOM_MAX) {
-        new_scale = ZOOM_MAX;
-    }
-
+    double new_scale = canvas_clamp_scale(canvas->scale * factor);
     if (new_scale == canvas->scale) {
         return; /* No change */
     }
 
-    /* Get the canvas position under the focus point before zoom */
-    double canvas_focus_x, canvas_focus_y;
-    screen_to_canvas(canvas, focus_x, focus_y, &canvas_focus_x,
-                     &canvas_focus_y);
-
-    /* Apply the new scale */
-    canvas->scale = new_scale;
-
-    /* Adjust viewport so the focus point stays in the same screen position */
-    /* After zoom: focus = (canvas_focus - new_viewport) * new_scale
-     * We want focus to remain at the same screen position, so:
-     * new_viewport = canvas_focus - focus / new_scale */
-    canvas->viewport_x = canvas_focus_x - focus_x / canvas->scale;
-    canvas->viewport_y = canvas_focus_y - focus_y / canvas->scale;
+    canvas_scale_about(canvas, new_scale, focus_x, focus_y);
 
     wlr_log(WLR_DEBUG, "Zoomed to scale %.2f, viewport (%.1f, %.1f)",
             canvas->scale, canvas->viewport_x, canvas->viewport_y);
@@ -165,13 +134,44 @@ void canvas_update_view_positions(struct infinidesk_canvas *canvas) {
     /* Note: Background is now rendered directly in the custom render pass */
 }
 
-void canvas_get_viewport_centre(struct infinidesk_canvas *canvas,
-                                int output_width, int output_height,
-                                double *centre_x, double *centre_y) {
-    /* The centre of the viewport in screen space is (width/2, height/2) */
-    /* Convert to canvas space */
-    screen_to_canvas(canvas, output_width / 2.0, output_height / 2.0, centre_x,
-                     centre_y);
+/*
+ * Get the multiple of the rebase step nearest to a canvas coordinate.
+ */
+static int64_t rebase_step_near(double v) {
+    return (int64_t)round(v / CANVAS_REBASE_STEP) * CANVAS_REBASE_STEP;
+}
+
+void canvas_rebase(struct infinidesk_canvas *canvas) {
+    if (fabs(canvas->viewport_x) < CANVAS_REBASE_DISTANCE &&
+        fabs(canvas->viewport_y) < CANVAS_REBASE_DISTANCE) {
+        return;
+    }
+
+    int64_t shift_x = rebase_step_near(canvas->viewport_x);
+    int64_t shift_y = rebase_step_near(canvas->viewport_y);
+    canvas->origin_x += shift_x;
+    canvas->origin_y += shift_y;
+
+    /* Whole steps are exact in a double, so shifting loses nothing */
+    double dx = -(double)shift_x;
+    double dy = -(double)shift_y;
+    canvas->viewport_x += dx;
+    canvas->viewport_y += dy;
+    canvas->pan_start_viewport_x += dx;
+    canvas->pan_start_viewport_y += dy;
+    canvas->snap_start_x += dx;
+    canvas->snap_start_y += dy;
+    canvas->snap_target_x += dx;
+    canvas->snap_target_y += dy;
+
+    struct infinidesk_view *view;
+    wl_list_for_each(view, &canvas->server->views, link) {
+        view_translate(view, dx, dy);
+    }
+    drawing_translate(&canvas->server->drawing, dx, dy);
+
+    wlr_log(WLR_DEBUG, "Rebased canvas origin to (%" PRId64 ", %" PRId64 ")",
+            canvas->origin_x, canvas->origin_y);
 }
 
 /* Cubic ease-out: starts fast, decelerates smoothly */
@@ -194,6 +194,8 @@ void canvas_update_snap_animation(struct infinidesk_canvas *canvas,
         canvas->viewport_x = canvas->snap_target_x;
         canvas->viewport_y = canvas->snap_target_y;
         canvas->snap_anim_active = false;
+        trace_instant(TRACE_TRACK_ANIMATION, "snap_end", "viewport %.0f,%.0f",
+                      canvas->viewport_x, canvas->viewport_y);
     } else {
         /* Apply cubic ease-out */
         double t = ease_out_cubic(progress);
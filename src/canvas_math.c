@@ -0,0 +1,70 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * canvas_math.c - Canvas coordinate arithmetic
+ *
+ * The parts of the canvas that only do arithmetic on its viewport, kept
+ * apart from the parts that move views, so they can be used without a
+ * server.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "infinidesk/canvas.h"
+
+/* Minimum and maximum zoom levels */
+#define ZOOM_MIN 0.1
+#define ZOOM_MAX 4.0
+
+void canvas_to_screen(struct infinidesk_canvas *canvas, double canvas_x,
+                      double canvas_y, double *screen_x, double *screen_y) {
+    /* screen = (canvas - viewport) * scale */
+    *screen_x = (canvas_x - canvas->viewport_x) * canvas->scale;
+    *screen_y = (canvas_y - canvas->viewport_y) * canvas->scale;
+}
+
+void screen_to_canvas(struct infinidesk_canvas *canvas, double screen_x,
+                      double screen_y, double *canvas_x, double *canvas_y) {
+    /* canvas = screen / scale + viewport */
+    *canvas_x = screen_x / canvas->scale + canvas->viewport_x;
+    *canvas_y = screen_y / canvas->scale + canvas->viewport_y;
+}
+
+double canvas_clamp_scale(double scale) {
+    if (scale < ZOOM_MIN) {
+        return ZOOM_MIN;
+    }
+    if (scale > ZOOM_MAX) {
+        return ZOOM_MAX;
+    }
+    return scale;
+}
+
+void canvas_scale_about(struct infinidesk_canvas *canvas, double scale,
+                        double focus_x, double focus_y) {
+    /* Get the canvas position under the focus point before zoom */
+    double canvas_focus_x, canvas_focus_y;
+    screen_to_canvas(canvas, focus_x, focus_y, &canvas_focus_x,
+                     &canvas_focus_y);
+
+    /* Apply the new scale */
+    canvas->scale = scale;
+
+    /* Adjust viewport so the focus point stays in the same screen position */
+    /* After zoom: focus = (canvas_focus - new_viewport) * new_scale
+     * We want focus to remain at the same screen position, so:
+     * new_viewport = canvas_focus - focus / new_scale */
+    canvas->viewport_x = canvas_focus_x - focus_x / canvas->scale;
+    canvas->viewport_y = canvas_focus_y - focus_y / canvas->scale;
+}
+
+void canvas_get_viewport_centre(struct infinidesk_canvas *canvas,
+                                int output_width, int output_height,
+                                double *centre_x, double *centre_y) {
+    /* The centre of the viewport in screen space is (width/2, height/2) */
+    /* Convert to canvas space */
+    screen_to_canvas(canvas, output_width / 2.0, output_height / 2.0, centre_x,
+                     centre_y);
+}
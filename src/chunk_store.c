@@ -0,0 +1,396 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * chunk_store.c - On-disk storage of canvas chunks
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/chunk_store.h"
+
+#define CHUNK_NAME_MAX 64
+
+/* A chunk file read, queued or completed */
+struct chunk_load {
+    struct wl_list link; /* chunk_store.queue or chunk_store.done */
+    int32_t x, y;
+    uint64_t generation;
+    void *records;
+    size_t size;
+};
+
+struct chunk_store {
+    char *dir;
+    int dir_fd;
+
+    chunk_store_load_func_t callback;
+    void *data;
+
+    /* Loader thread */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    struct wl_list queue; /* chunk_load.link, waiting to be read */
+    struct wl_list done;  /* chunk_load.link, waiting to be delivered */
+    bool stopping;
+
+    /* Wakes the main thread when loads complete */
+    int notify_fds[2];
+    struct wl_event_source *notify_source;
+};
+
+static void chunk_file_name(char *name, int32_t x, int32_t y,
+                            uint64_t generation) {
+    snprintf(name, CHUNK_NAME_MAX, "%" PRId32 "_%" PRId32 "_%" PRIu64 ".chunk",
+             x, y, generation);
+}
+
+static bool read_all(int fd, void *data, size_t size, off_t offset) {
+    uint8_t *p = data;
+    while (size > 0) {
+        ssize_t n = pread(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void *data, size_t size) {
+    const uint8_t *p = data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void *read_chunk_file(struct chunk_store *store, int32_t x, int32_t y,
+                             uint64_t generation, size_t *size) {
+    char name[CHUNK_NAME_MAX];
+    chunk_file_name(name, x, y, generation);
+
+    int fd = openat(store->dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        wlr_log(WLR_ERROR, "Failed to open chunk %s: %s", name,
+                strerror(errno));
+        return NULL;
+    }
+
+    struct chunk_file_header header;
+    struct stat st;
+    void *records = NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(header) ||
+        !read_all(fd, &header, sizeof(header), 0) ||
+        memcmp(header.magic, CHUNK_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CHUNK_VERSION) {
+        wlr_log(WLR_ERROR, "Chunk %s is not readable", name);
+        goto out;
+    }
+
+    *size = st.st_size - sizeof(header);
+    records = malloc(*size ? *size : 1);
+    if (records && !read_all(fd, records, *size, sizeof(header))) {
+        wlr_log(WLR_ERROR, "Failed to read chunk %s: %s", name,
+                strerror(errno));
+        free(records);
+        records = NULL;
+    }
+
+out:
+    close(fd);
+    return records;
+}
+
+static void *loader_thread(void *data) {
+    struct chunk_store *store = data;
+
+    pthread_mutex_lock(&store->lock);
+    while (true) {
+        while (wl_list_empty(&store->queue) && !store->stopping) {
+            pthread_cond_wait(&store->wake, &store->lock);
+        }
+        if (store->stopping) {
+            break;
+        }
+
+        struct chunk_load *load =
+            wl_container_of(store->queue.next, load, link);
+        wl_list_remove(&load->link);
+        pthread_mutex_unlock(&store->lock);
+
+        load->records = read_chunk_file(store, load->x, load->y,
+                                        load->generation, &load->size);
+
+        pthread_mutex_lock(&store->lock);
+        wl_list_insert(store->done.prev, &load->link);
+
+        /* A full pipe already has a wakeup pending */
+        char byte = 0;
+        if (write(store->notify_fds[1], &byte, 1) < 0 && errno != EAGAIN) {
+            wlr_log(WLR_ERROR, "Failed to signal chunk load: %s",
+                    strerror(errno));
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    return NULL;
+}
+
+static int handle_notify(int fd, uint32_t mask, void *data) {
+    (void)mask;
+    struct chunk_store *store = data;
+
+    char buf[64];
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+
+    /* Take the completed loads so callbacks run without the lock */
+    struct wl_list done;
+    wl_list_init(&done);
+    pthread_mutex_lock(&store->lock);
+    wl_list_insert_list(&done, &store->done);
+    wl_list_init(&store->done);
+    pthread_mutex_unlock(&store->lock);
+
+    struct chunk_load *load, *tmp;
+    wl_list_for_each_safe(load, tmp, &done, link) {
+        wl_list_remove(&load->link);
+        store->callback(load->x, load->y, load->generation, load->records,
+                        load->size, store->data);
+        free(load);
+    }
+
+    return 0;
+}
+
+struct chunk_store *chunk_store_create(const char *dir,
+                                       struct wl_event_loop *loop,
+                                       chunk_store_load_func_t callback,
+                                       void *data) {
+    struct chunk_store *store = calloc(1, sizeof(*store));
+    if (!store) {
+        return NULL;
+    }
+    store->dir_fd = -1;
+    store->notify_fds[0] = store->notify_fds[1] = -1;
+    store->callback = callback;
+    store->data = data;
+    wl_list_init(&store->queue);
+    wl_list_init(&store->done);
+
+    store->dir = strdup(dir);
+    if (!store->dir) {
+        goto error;
+    }
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        wlr_log(WLR_ERROR, "Failed to create directory %s: %s", dir,
+                strerror(errno));
+        goto error;
+    }
+    store->dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (store->dir_fd < 0) {
+        wlr_log(WLR_ERROR, "Failed to open %s: %s", dir, strerror(errno));
+        goto error;
+    }
+
+    if (pipe(store->notify_fds) != 0) {
+        wlr_log(WLR_ERROR, "Failed to create pipe: %s", strerror(errno));
+        goto error;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(store->notify_fds[i], F_SETFD, FD_CLOEXEC);
+        fcntl(store->notify_fds[i], F_SETFL, O_NONBLOCK);
+    }
+
+    store->notify_source =
+        wl_event_loop_add_fd(loop, store->notify_fds[0], WL_EVENT_READABLE,
+                             handle_notify, store);
+    if (!store->notify_source) {
+        goto error;
+    }
+
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->wake, NULL);
+    if (pthread_create(&store->thread, NULL, loader_thread, store) != 0) {
+        wlr_log(WLR_ERROR, "Failed to start chunk loader thread");
+        pthread_cond_destroy(&store->wake);
+        pthread_mutex_destroy(&store->lock);
+        goto error;
+    }
+
+    return store;
+
+error:
+    if (store->notify_source) {
+        wl_event_source_remove(store->notify_source);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (store->notify_fds[i] >= 0) {
+            close(store->notify_fds[i]);
+        }
+    }
+    if (store->dir_fd >= 0) {
+        close(store->dir_fd);
+    }
+    free(store->dir);
+    free(store);
+    return NULL;
+}
+
+void chunk_store_destroy(struct chunk_store *store) {
+    if (!store) {
+        return;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    store->stopping = true;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+    pthread_join(store->thread, NULL);
+
+    struct wl_list *lists[] = {&store->queue, &store->done};
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        struct chunk_load *load, *tmp;
+        wl_list_for_each_safe(load, tmp, lists[i], link) {
+            wl_list_remove(&load->link);
+            free(load->records);
+            free(load);
+        }
+    }
+
+    pthread_cond_destroy(&store->wake);
+    pthread_mutex_destroy(&store->lock);
+    wl_event_source_remove(store->notify_source);
+    close(store->notify_fds[0]);
+    close(store->notify_fds[1]);
+    close(store->dir_fd);
+    free(store->dir);
+    free(store);
+}
+
+bool chunk_store_request(struct chunk_store *store, int32_t x, int32_t y,
+                         uint64_t generation) {
+    struct chunk_load *load = calloc(1, sizeof(*load));
+    if (!load) {
+        return false;
+    }
+    load->x = x;
+    load->y = y;
+    load->generation = generation;
+
+    pthread_mutex_lock(&store->lock);
+    wl_list_insert(store->queue.prev, &load->link);
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+    return true;
+}
+
+void *chunk_store_read(struct chunk_store *store, int32_t x, int32_t y,
+                       uint64_t generation, size_t *size) {
+    return read_chunk_file(store, x, y, generation, size);
+}
+
+bool chunk_store_write(struct chunk_store *store, int32_t x, int32_t y,
+                       uint64_t generation, const void *records,
+                       size_t size) {
+    char name[CHUNK_NAME_MAX];
+    char tmp_name[CHUNK_NAME_MAX + sizeof(".tmp")];
+    chunk_file_name(name, x, y, generation);
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", name);
+
+    int fd = openat(store->dir_fd, tmp_name,
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        wlr_log(WLR_ERROR, "Failed to create chunk %s: %s", tmp_name,
+                strerror(errno));
+        return false;
+    }
+
+    struct chunk_file_header header = {
+        .version = CHUNK_VERSION,
+    };
+    memcpy(header.magic, CHUNK_MAGIC, sizeof(header.magic));
+
+    /* The manifest will refer to this file, so it must reach the disk */
+    bool ok = write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, records, size) && fsync(fd) == 0;
+    close(fd);
+    if (ok) {
+        ok = renameat(store->dir_fd, tmp_name, store->dir_fd, name) == 0 &&
+             fsync(store->dir_fd) == 0;
+    }
+
+    if (!ok) {
+        wlr_log(WLR_ERROR, "Failed to write chunk %s: %s", name,
+                strerror(errno));
+        unlinkat(store->dir_fd, tmp_name, 0);
+    }
+    return ok;
+}
+
+void chunk_store_collect(struct chunk_store *store,
+                         chunk_store_keep_func_t keep, void *data) {
+    /*
+     * A dup() would share its position with dir_fd, left at the end by the
+     * last collect, so open the directory afresh.
+     */
+    int fd = openat(store->dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!dir) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        int32_t x, y;
+        uint64_t generation;
+        int end = 0;
+        if (sscanf(entry->d_name, "%" SCNd32 "_%" SCNd32 "_%" SCNu64 "%n", &x,
+                   &y, &generation, &end) != 3) {
+            continue;
+        }
+
+        /* Leftovers from an interrupted write are always garbage */
+        const char *suffix = entry->d_name + end;
+        if (strcmp(suffix, ".chunk.tmp") == 0 ||
+            (strcmp(suffix, ".chunk") == 0 && !keep(x, y, generation, data))) {
+            unlinkat(store->dir_fd, entry->d_name, 0);
+        }
+    }
+
+    closedir(dir);
+}
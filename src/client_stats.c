@@ -0,0 +1,142 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * client_stats.c - Per-client activity counters
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pixman.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/client_stats.h"
+#include "infinidesk/server.h"
+#include "infinidesk/trace.h"
+
+static void handle_client_destroy(struct wl_listener *listener, void *data) {
+    (void)data;
+    struct client_stats *stats = wl_container_of(listener, stats, destroy);
+
+    wl_list_remove(&stats->destroy.link);
+    wl_list_remove(&stats->link);
+    free(stats);
+}
+
+/* Read the process name, which is more useful than a pid on its own */
+static void read_name(struct client_stats *stats) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/comm", (int)stats->pid);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return;
+    }
+    if (fgets(stats->name, sizeof(stats->name), file)) {
+        stats->name[strcspn(stats->name, "\n")] = '\0';
+    }
+    fclose(file);
+}
+
+struct client_stats *client_stats_find(struct wl_client *client) {
+    struct wl_listener *listener =
+        wl_client_get_destroy_listener(client, handle_client_destroy);
+    if (!listener) {
+        return NULL;
+    }
+    struct client_stats *stats;
+    return wl_container_of(listener, stats, destroy);
+}
+
+struct client_stats *client_stats_get(struct infinidesk_server *server,
+                                      struct wl_client *client) {
+    struct client_stats *stats = client_stats_find(client);
+    if (stats) {
+        return stats;
+    }
+
+    stats = calloc(1, sizeof(*stats));
+    if (!stats) {
+        wlr_log(WLR_ERROR, "Failed to allocate client stats");
+        return NULL;
+    }
+    stats->client = client;
+    wl_client_get_credentials(client, &stats->pid, NULL, NULL);
+    read_name(stats);
+
+    stats->destroy.notify = handle_client_destroy;
+    wl_client_add_destroy_listener(client, &stats->destroy);
+    wl_list_insert(&server->clients, &stats->link);
+    return stats;
+}
+
+/* Pixels of the buffer damaged by the commit just applied */
+static uint64_t damage_area(struct wlr_surface *surface) {
+    int count;
+    pixman_box32_t *boxes =
+        pixman_region32_rectangles(&surface->buffer_damage, &count);
+    uint64_t area = 0;
+    for (int i = 0; i < count; i++) {
+        area += (uint64_t)(boxes[i].x2 - boxes[i].x1) *
+                (uint64_t)(boxes[i].y2 - boxes[i].y1);
+    }
+    return area;
+}
+
+/* Throttle or let off a client, from the rate of its latest window */
+static void update_throttle(struct infinidesk_server *server,
+                            struct client_stats *stats, uint32_t now_ms) {
+    uint32_t limit = server->max_commit_rate;
+    bool over = commit_rate_over_limit(&stats->rate, limit, stats->throttled,
+                                       now_ms - stats->throttle_changed_ms);
+    if (over && !stats->throttled) {
+        stats->throttled = true;
+        stats->throttle_changed_ms = now_ms;
+        stats->throttle_episodes++;
+        wlr_log(WLR_INFO,
+                "Client %d (%s) is committing at %.0f Hz, over the %u Hz "
+                "limit, so its commits will be coalesced",
+                (int)stats->pid, stats->name, stats->rate.commits_per_second,
+                limit);
+        trace_instant(TRACE_TRACK_CLIENTS, "throttle_begin", "%s %.0f Hz",
+                      stats->name, stats->rate.commits_per_second);
+    } else if (!over && stats->throttled) {
+        stats->throttled = false;
+        stats->throttle_changed_ms = now_ms;
+        wlr_log(WLR_INFO,
+                "Client %d (%s) is down to %.0f Hz and no longer throttled, "
+                "%llu commits coalesced in all",
+                (int)stats->pid, stats->name, stats->rate.commits_per_second,
+                (unsigned long long)stats->coalesced);
+        trace_instant(TRACE_TRACK_CLIENTS, "throttle_end", "%s %.0f Hz",
+                      stats->name, stats->rate.commits_per_second);
+    }
+}
+
+bool client_stats_is_throttled(const struct client_stats *stats) {
+    return stats->throttled;
+}
+
+struct client_stats *client_stats_commit(struct infinidesk_server *server,
+                                         struct wlr_surface *surface,
+                                         struct commit_rate *view_rate) {
+    uint32_t now_ms = server_time_ms(server);
+    uint64_t damage = damage_area(surface);
+    if (view_rate) {
+        commit_rate_add(view_rate, now_ms, damage);
+    }
+
+    struct client_stats *stats =
+        client_stats_get(server, wl_resource_get_client(surface->resource));
+    if (stats) {
+        commit_rate_add(&stats->rate, now_ms, damage);
+        update_throttle(server, stats, now_ms);
+    }
+    return stats;
+}
@@ -0,0 +1,46 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * commit_rate.c - Commit rates, and deciding when they are too high
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "infinidesk/commit_rate.h"
+
+void commit_rate_update(struct commit_rate *rate, uint32_t now_ms) {
+    uint32_t elapsed = now_ms - rate->window_start_ms;
+    if (elapsed < CLIENT_RATE_WINDOW_MS) {
+        return;
+    }
+    /* A window that ran on with nothing in it counts as a quieter one */
+    rate->commits_per_second = rate->window_commits * 1000.0f / elapsed;
+    rate->damage_per_second = rate->window_damage * 1000.0f / elapsed;
+    rate->window_start_ms = now_ms;
+    rate->window_commits = 0;
+    rate->window_damage = 0;
+}
+
+void commit_rate_add(struct commit_rate *rate, uint32_t now_ms,
+                     uint64_t damage) {
+    commit_rate_update(rate, now_ms);
+    rate->commits++;
+    rate->damage += damage;
+    rate->window_commits++;
+    rate->window_damage += damage;
+}
+
+bool commit_rate_over_limit(const struct commit_rate *rate, uint32_t limit,
+                            bool throttled, uint32_t held_ms) {
+    if (limit == 0) {
+        return false;
+    }
+    if (!throttled) {
+        return rate->commits_per_second > limit;
+    }
+    return held_ms < CLIENT_THROTTLE_HOLD_MS ||
+           rate->commits_per_second >=
+               limit * CLIENT_THROTTLE_EXIT_PERCENT / 100.0f;
+}
@@ -20,7 +20,10 @@
 #include <wlr/util/log.h>
 #include <xkbcommon/xkbcommon.h>
 
+#include "infinidesk/client_stats.h"
 #include "infinidesk/config.h"
+#include "infinidesk/render_governor.h"
+#include "infinidesk/watchdog.h"
 
 #define CONFIG_DIR ".config/infinidesk"
 #define CONFIG_FILE "infinidesk.toml"
@@ -34,6 +37,29 @@ static const char *DEFAULT_CONFIG =
     "# Output scale factor for HiDPI displays (e.g., 1.0, 1.5, 2.0)\n"
     "scale = 1.0\n"
     "\n"
+    "# Memory in MiB for annotations kept loaded; distant ones beyond this\n"
+    "# are paged out to disk\n"
+    "annotation_memory = 256\n"
+    "\n"
+    "# Fraction of the refresh interval a frame may take to render before\n"
+    "# quality is reduced while panning or zooming, and how long in ms the\n"
+    "# canvas must be still before full quality returns\n"
+    "render_budget = 0.8\n"
+    "quality_settle_ms = 250\n"
+    "\n"
+    "# Main loop stalls and frames longer than this many ms are logged with\n"
+    "# a breakdown of where the time went (0 to disable)\n"
+    "stall_threshold_ms = 20\n"
+    "\n"
+    "# Serve Prometheus metrics on a Unix socket in $XDG_RUNTIME_DIR, named\n"
+    "# after the Wayland socket (e.g. infinidesk-wayland-1.metrics)\n"
+    "metrics = false\n"
+    "\n"
+    "# Clients committing more often than this per second have their\n"
+    "# commits coalesced to the refresh rate, or to 10 Hz while off-screen\n"
+    "# (0 to disable)\n"
+    "max_commit_rate = 300\n"
+    "\n"
     "# Startup commands are executed when the compositor starts.\n"
     "# Each command runs in its own shell process.\n"
     "startup = [\n"
@@ -636,6 +662,33 @@ static void config_set_default_keybinds(struct infinidesk_config *config) {
     wlr_log(WLR_INFO, "Using %d default keybind(s)", config->keybind_count);
 }
 
+/*
+ * Parse a true or false value from the config line.
+ */
+static bool parse_bool_value(const char *line, const char *key, bool *value) {
+    char *p = (char *)line;
+    size_t key_len = strlen(key);
+
+    if (strncmp(p, key, key_len) != 0) {
+        return false;
+    }
+
+    p = skip_whitespace(p + key_len);
+    if (*p != '=') {
+        return false;
+    }
+
+    p = skip_whitespace(p + 1);
+    if (strcmp(p, "true") == 0) {
+        *value = true;
+    } else if (strcmp(p, "false") == 0) {
+        *value = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
 /*
  * Parse a float value from the config line.
  */
@@ -668,6 +721,11 @@ bool config_load(struct infinidesk_config *config) {
 
     /* Set defaults */
     config->scale = 1.0f;
+    config->annotation_memory = 256.0f;
+    config->render_budget = RENDER_GOVERNOR_DEFAULT_BUDGET;
+    config->quality_settle_ms = RENDER_GOVERNOR_DEFAULT_SETTLE_MS;
+    config->stall_threshold_ms = WATCHDOG_DEFAULT_THRESHOLD_MS;
+    config->max_commit_rate = CLIENT_DEFAULT_MAX_COMMIT_RATE;
 
     char *path = get_config_path();
     if (!path) {
@@ -710,6 +768,56 @@ bool config_load(struct infinidesk_config *config) {
             config->scale = scale_value;
             wlr_log(WLR_INFO, "Config: scale = %.2f", config->scale);
         }
+
+        /* Parse annotation memory budget */
+        float memory_value;
+        if (parse_float_value(p, "annotation_memory", &memory_value) &&
+            memory_value > 0.0f) {
+            config->annotation_memory = memory_value;
+            wlr_log(WLR_INFO, "Config: annotation_memory = %.0f MiB",
+                    config->annotation_memory);
+        }
+
+        /* Parse render governor thresholds */
+        float budget_value;
+        if (parse_float_value(p, "render_budget", &budget_value) &&
+            budget_value > 0.0f) {
+            config->render_budget = budget_value;
+            wlr_log(WLR_INFO, "Config: render_budget = %.2f",
+                    config->render_budget);
+        }
+
+        float settle_value;
+        if (parse_float_value(p, "quality_settle_ms", &settle_value) &&
+            settle_value >= 0.0f) {
+            config->quality_settle_ms = (uint32_t)settle_value;
+            wlr_log(WLR_INFO, "Config: quality_settle_ms = %u",
+                    config->quality_settle_ms);
+        }
+
+        /* Parse watchdog threshold */
+        float stall_value;
+        if (parse_float_value(p, "stall_threshold_ms", &stall_value) &&
+            stall_value >= 0.0f) {
+            config->stall_threshold_ms = (uint32_t)stall_value;
+            wlr_log(WLR_INFO, "Config: stall_threshold_ms = %u",
+                    config->stall_threshold_ms);
+        }
+
+        /* Parse metrics socket */
+        if (parse_bool_value(p, "metrics", &config->metrics)) {
+            wlr_log(WLR_INFO, "Config: metrics = %s",
+                    config->metrics ? "true" : "false");
+        }
+
+        /* Parse client commit rate limit */
+        float rate_value;
+        if (parse_float_value(p, "max_commit_rate", &rate_value) &&
+            rate_value >= 0.0f) {
+            config->max_commit_rate = (uint32_t)rate_value;
+            wlr_log(WLR_INFO, "Config: max_commit_rate = %u",
+                    config->max_commit_rate);
+        }
     }
 
     /* Rewind and parse startup array */
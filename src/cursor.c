@@ -25,10 +25,14 @@
 #include "infinidesk/cursor.h"
 #include "infinidesk/drawing.h"
 #include "infinidesk/drawing_ui.h"
+#include "infinidesk/latency.h"
 #include "infinidesk/layer_shell.h"
 #include "infinidesk/output.h"
+#include "infinidesk/replay.h"
 #include "infinidesk/server.h"
+#include "infinidesk/trace.h"
 #include "infinidesk/view.h"
+#include "infinidesk/watchdog.h"
 
 /* Zoom factor for scroll wheel zoom */
 #define ZOOM_SCROLL_FACTOR 1.03
@@ -100,12 +104,23 @@ void cursor_handle_motion(struct wl_listener *listener, void *data) {
         wl_container_of(listener, server, cursor_motion);
     struct wlr_pointer_motion_event *event = data;
 
+    trace_instant(TRACE_TRACK_INPUT, "motion", "time %u", event->time_msec);
+    latency_input(&server->latency, event->time_msec);
+    replay_record(&(struct replay_event){
+        .type = REPLAY_MOTION,
+        .time_msec = event->time_msec,
+        .motion = {event->delta_x, event->delta_y, event->unaccel_dx,
+                   event->unaccel_dy},
+    });
+
     /* Move the cursor */
     wlr_cursor_move(server->cursor, &event->pointer->base, event->delta_x,
                     event->delta_y);
 
     /* Process the motion */
+    watchdog_enter(&server->watchdog, "pointer_motion");
     cursor_process_motion(server, event->time_msec);
+    watchdog_leave(&server->watchdog);
 }
 
 void cursor_handle_motion_absolute(struct wl_listener *listener, void *data) {
@@ -113,18 +128,29 @@ void cursor_handle_motion_absolute(struct wl_listener *listener, void *data) {
         wl_container_of(listener, server, cursor_motion_absolute);
     struct wlr_pointer_motion_absolute_event *event = data;
 
+    trace_instant(TRACE_TRACK_INPUT, "motion", "time %u", event->time_msec);
+    latency_input(&server->latency, event->time_msec);
+    replay_record(&(struct replay_event){
+        .type = REPLAY_MOTION_ABSOLUTE,
+        .time_msec = event->time_msec,
+        .absolute = {event->x, event->y},
+    });
+
     /* Warp to the absolute position */
     wlr_cursor_warp_absolute(server->cursor, &event->pointer->base, event->x,
                              event->y);
 
     /* Process the motion */
+    watchdog_enter(&server->watchdog, "pointer_motion");
     cursor_process_motion(server, event->time_msec);
+    watchdog_leave(&server->watchdog);
 }
 
-void cursor_handle_button(struct wl_listener *listener, void *data) {
-    struct infinidesk_server *server =
-        wl_container_of(listener, server, cursor_button);
-    struct wlr_pointer_button_event *event = data;
+static void process_button(struct infinidesk_server *server,
+                           struct wlr_pointer_button_event *event) {
+    trace_instant(TRACE_TRACK_INPUT, "button", "time %u button %u state %d",
+                  event->time_msec, event->button, (int)event->state);
+    latency_input(&server->latency, event->time_msec);
 
     if (event->state == WL_POINTER_BUTTON_STATE_PRESSED) {
         /*
@@ -158,6 +184,8 @@ void cursor_handle_button(struct wl_listener *listener, void *data) {
     /* Notify the seat of the button event */
     wlr_seat_pointer_notify_button(server->seat, event->time_msec,
                                    event->button, event->state);
+    latency_forward(&server->latency, LATENCY_CLIENT_POINTER,
+                    server->seat->pointer_state.focused_surface);
 
     if (event->state == WL_POINTER_BUTTON_STATE_PRESSED) {
         /* Button pressed */
@@ -235,7 +263,7 @@ void cursor_handle_button(struct wl_listener *listener, void *data) {
 
             if (event->button == BTN_LEFT) {
                 /* Left click in drawing mode (not on UI): Begin drawing stroke
-                 */
+                 * or erasing, depending on the tool */
                 wlr_log(WLR_DEBUG, "Beginning drawing stroke");
                 server->cursor_mode = INFINIDESK_CURSOR_DRAW;
 
@@ -243,7 +271,11 @@ void cursor_handle_button(struct wl_listener *listener, void *data) {
                 double canvas_x, canvas_y;
                 screen_to_canvas(&server->canvas, server->cursor->x,
                                  server->cursor->y, &canvas_x, &canvas_y);
-                drawing_stroke_begin(&server->drawing, canvas_x, canvas_y);
+                if (server->drawing.tool == DRAWING_TOOL_PEN) {
+                    drawing_stroke_begin(&server->drawing, canvas_x, canvas_y);
+                } else {
+                    drawing_erase_begin(&server->drawing, canvas_x, canvas_y);
+                }
                 return;
             }
         }
@@ -306,17 +338,35 @@ void cursor_handle_button(struct wl_listener *listener, void *data) {
             cursor_reset_mode(server);
 
         } else if (server->cursor_mode == INFINIDESK_CURSOR_DRAW) {
-            /* End drawing stroke */
+            /* End drawing stroke or erase */
             drawing_stroke_end(&server->drawing);
+            drawing_erase_end(&server->drawing);
             cursor_reset_mode(server);
         }
     }
 }
 
-void cursor_handle_axis(struct wl_listener *listener, void *data) {
+void cursor_handle_button(struct wl_listener *listener, void *data) {
     struct infinidesk_server *server =
-        wl_container_of(listener, server, cursor_axis);
-    struct wlr_pointer_axis_event *event = data;
+        wl_container_of(listener, server, cursor_button);
+    struct wlr_pointer_button_event *event = data;
+
+    replay_record(&(struct replay_event){
+        .type = REPLAY_BUTTON,
+        .time_msec = event->time_msec,
+        .button = {event->button, event->state},
+    });
+
+    watchdog_enter(&server->watchdog, "pointer_button");
+    process_button(server, event);
+    watchdog_leave(&server->watchdog);
+}
+
+static void process_axis(struct infinidesk_server *server,
+                         struct wlr_pointer_axis_event *event) {
+    trace_instant(TRACE_TRACK_INPUT, "axis", "time %u delta %.2f",
+                  event->time_msec, event->delta);
+    latency_input(&server->latency, event->time_msec);
 
     /* Alt + Scroll: Zoom canvas */
     if (server->super_pressed) {
@@ -325,6 +375,7 @@ void cursor_handle_axis(struct wl_listener *listener, void *data) {
                                                : (1.0 / ZOOM_SCROLL_FACTOR);
             canvas_zoom(&server->canvas, factor, server->cursor->x,
                         server->cursor->y);
+            latency_effect(&server->latency, LATENCY_ZOOM);
         }
         /* Ignore horizontal scroll when Alt is held */
         return;
@@ -341,6 +392,7 @@ void cursor_handle_axis(struct wl_listener *listener, void *data) {
         } else {
             canvas_pan_delta(&server->canvas, event->delta, 0);
         }
+        latency_effect(&server->latency, LATENCY_PAN);
         /* Reset the timer on each scroll event */
         if (server->scroll_pan_timer) {
             wl_event_source_timer_update(server->scroll_pan_timer,
@@ -369,6 +421,8 @@ void cursor_handle_axis(struct wl_listener *listener, void *data) {
                                          event->orientation, event->delta,
                                          event->delta_discrete, event->source,
                                          event->relative_direction);
+            latency_forward(&server->latency, LATENCY_CLIENT_POINTER,
+                            layer_srf);
             return;
         }
     }
@@ -383,6 +437,7 @@ void cursor_handle_axis(struct wl_listener *listener, void *data) {
         wlr_seat_pointer_notify_axis(
             server->seat, event->time_msec, event->orientation, event->delta,
             event->delta_discrete, event->source, event->relative_direction);
+        latency_forward(&server->latency, LATENCY_CLIENT_POINTER, surface);
     } else {
         /* Scroll over empty canvas - start pan gesture */
         server->scroll_panning = true;
@@ -403,14 +458,38 @@ void cursor_handle_axis(struct wl_listener *listener, void *data) {
         } else {
             canvas_pan_delta(&server->canvas, event->delta, 0);
         }
+        latency_effect(&server->latency, LATENCY_PAN);
     }
 }
 
+void cursor_handle_axis(struct wl_listener *listener, void *data) {
+    struct infinidesk_server *server =
+        wl_container_of(listener, server, cursor_axis);
+    struct wlr_pointer_axis_event *event = data;
+
+    replay_record(&(struct replay_event){
+        .type = REPLAY_AXIS,
+        .time_msec = event->time_msec,
+        .axis = {event->source, event->orientation, event->relative_direction,
+                 event->delta_discrete, event->delta},
+    });
+
+    watchdog_enter(&server->watchdog, "pointer_axis");
+    process_axis(server, event);
+    watchdog_leave(&server->watchdog);
+}
+
 void cursor_handle_frame(struct wl_listener *listener, void *data) {
     (void)data;
     struct infinidesk_server *server =
         wl_container_of(listener, server, cursor_frame);
 
+    /* Frames carry no time, but follow their events immediately */
+    replay_record(&(struct replay_event){
+        .type = REPLAY_FRAME,
+        .time_msec = server_time_ms(server),
+    });
+
     /* Notify the seat of the frame event */
     wlr_seat_pointer_notify_frame(server->seat);
 }
@@ -440,6 +519,7 @@ void cursor_process_motion(struct infinidesk_server *server, uint32_t time) {
             screen_to_canvas(&server->canvas, server->cursor->x,
                              server->cursor->y, &canvas_x, &canvas_y);
             view_move_update(server->grabbed_view, canvas_x, canvas_y);
+            latency_effect(&server->latency, LATENCY_MOVE);
         }
         return;
     }
@@ -448,15 +528,18 @@ void cursor_process_motion(struct infinidesk_server *server, uint32_t time) {
         /* Update the viewport during pan */
         canvas_pan_update(&server->canvas, server->cursor->x,
                           server->cursor->y);
+        latency_effect(&server->latency, LATENCY_PAN);
         return;
     }
 
     case INFINIDESK_CURSOR_DRAW: {
-        /* Add points to the current stroke */
+        /* Add points to the current stroke, or keep erasing */
         double canvas_x, canvas_y;
         screen_to_canvas(&server->canvas, server->cursor->x, server->cursor->y,
                          &canvas_x, &canvas_y);
         drawing_stroke_add_point(&server->drawing, canvas_x, canvas_y);
+        drawing_erase_update(&server->drawing, canvas_x, canvas_y);
+        latency_effect(&server->latency, LATENCY_DRAW);
         return;
     }
 
@@ -467,6 +550,7 @@ void cursor_process_motion(struct infinidesk_server *server, uint32_t time) {
             screen_to_canvas(&server->canvas, server->cursor->x,
                              server->cursor->y, &canvas_x, &canvas_y);
             view_resize_update(server->grabbed_view, canvas_x, canvas_y);
+            latency_effect(&server->latency, LATENCY_RESIZE);
         }
         return;
     }
@@ -526,6 +610,8 @@ void cursor_process_motion(struct infinidesk_server *server, uint32_t time) {
                                           layer_sy);
             wlr_seat_pointer_notify_motion(server->seat, time, layer_sx,
                                            layer_sy);
+            latency_forward(&server->latency, LATENCY_CLIENT_POINTER,
+                            layer_srf);
             return;
         }
     }
@@ -545,6 +631,7 @@ void cursor_process_motion(struct infinidesk_server *server, uint32_t time) {
         /* Notify the seat of the pointer entering/moving on the surface */
         wlr_seat_pointer_notify_enter(server->seat, surface, sx, sy);
         wlr_seat_pointer_notify_motion(server->seat, time, sx, sy);
+        latency_forward(&server->latency, LATENCY_CLIENT_POINTER, surface);
 
         /*
          * Focus-follows-mouse: focus the view under cursor.
@@ -10,27 +10,121 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <wlr/render/pass.h>
 #include <wlr/util/log.h>
 
 #include "infinidesk/canvas.h"
+#include "infinidesk/chunk_store.h"
 #include "infinidesk/drawing.h"
+#include "infinidesk/drawing_chunk.h"
+#include "infinidesk/journal.h"
+#include "infinidesk/perf.h"
+#include "infinidesk/point_transform.h"
 #include "infinidesk/server.h"
+#include "infinidesk/stroke_render.h"
 
 /* Drawing configuration */
-#define DRAWING_LINE_WIDTH 4.0f
 #define DRAWING_COLOR_A 1.0f
 /* Min distance between points in canvas coords */
 #define MIN_POINT_DISTANCE 2.0
+/* Max deviation allowed when simplifying a finished stroke, in screen px */
+#define DRAWING_SIMPLIFY_TOLERANCE 0.75
+/* Grid finished stroke points are rounded to when packed, in screen px */
+#define DRAWING_POINT_QUANTUM 0.25
+/* Size of a stroke index cell in canvas coords */
+#define DRAWING_INDEX_CELL_SIZE 256.0
+/* Eraser radius in screen px */
+#define DRAWING_ERASER_RADIUS 8.0
+/* Resident annotation memory before unchanged chunks are paged out */
+#define DRAWING_MEMORY_BUDGET (256 * 1024 * 1024)
+/* Journal growth after which a checkpoint is taken mid-session */
+#define DRAWING_CHECKPOINT_BYTES (32 * 1024 * 1024)
+
+/* A stroke segment touched by the eraser */
+struct erase_hit {
+    struct drawing_stroke *stroke;
+    uint32_t seg;
+};
+
+/* Outcome of applying a journal record */
+enum replay_result {
+    REPLAY_OK,
+    REPLAY_WAIT, /* Refers to a chunk still being paged in */
+    REPLAY_MALFORMED,
+};
+
+/* A stroke only the undo history holds, read back from a checkpoint */
+struct held_stroke {
+    struct drawing_stroke *stroke;
+    bool owned; /* Taken by an operation */
+};
+
+/* A chunk file written by a checkpoint */
+struct checkpoint_file {
+    int32_t x, y;
+    uint64_t generation; /* 0 if the chunk has been left empty */
+    size_t offset, size; /* Of its records in the checkpoint's data */
+};
+
+/*
+ * A checkpoint being written on the journal's writer thread. It is a
+ * snapshot, so the canvas can carry on changing in the meantime.
+ */
+struct checkpoint {
+    struct drawing_layer *drawing;
+    struct chunk_store *store;
+    uint64_t generation;
+    bool collect;          /* Delete chunk files the manifest doesn't list */
+    struct wl_array files; /* struct checkpoint_file */
+    struct wl_array data;  /* Records of the chunk files */
+    struct wl_array kept;  /* struct journal_chunk, sorted by position */
+};
 
 /* Forward declarations */
-static struct drawing_stroke *drawing_stroke_create(void);
 static void drawing_stroke_destroy(struct drawing_stroke *stroke);
-static struct drawing_point *drawing_point_create(double x, double y);
-static void drawing_point_destroy(struct drawing_point *point);
-
-void drawing_init(struct drawing_layer *drawing,
+static struct drawing_op *drawing_op_create(void);
+static void drawing_op_free(struct drawing_op *op);
+static void drawing_op_destroy(struct drawing_op *op, bool undone);
+static bool drawing_op_add(struct wl_array *strokes,
+                           struct drawing_stroke *stroke);
+static void drawing_push_op(struct drawing_layer *drawing,
+                            struct drawing_op *op);
+static void drawing_attach_stroke(struct drawing_layer *drawing,
+                                  struct drawing_stroke *stroke);
+static void drawing_detach_stroke(struct drawing_layer *drawing,
+                                  struct drawing_stroke *stroke);
+static bool undo_op(struct drawing_layer *drawing);
+static bool redo_op(struct drawing_layer *drawing);
+static void erase_start(struct drawing_layer *drawing);
+static void erase_finish(struct drawing_layer *drawing);
+static void erase_remove_stroke(struct drawing_layer *drawing,
+                                struct drawing_stroke *stroke);
+static bool erase_apply_split(struct drawing_layer *drawing,
+                              struct drawing_stroke *stroke,
+                              const struct journal_fragment *fragments,
+                              uint32_t fragment_count);
+static void erase_segment(struct drawing_layer *drawing, double ax,
+                          double ay, double bx, double by);
+static void drawing_clear(struct drawing_layer *drawing);
+static void drawing_drop_history(struct drawing_layer *drawing);
+static void drawing_commit_stroke(struct drawing_layer *drawing,
+                                  struct drawing_stroke *stroke);
+static void journal_record(struct drawing_layer *drawing, uint32_t type,
+                           const void *head, size_t head_len,
+                           const void *tail, size_t tail_len, bool flush);
+static void journal_record_stroke(struct drawing_layer *drawing,
+                                  struct drawing_stroke *stroke, bool flush);
+static void drawing_checkpoint(struct drawing_layer *drawing);
+static bool drawing_load(struct drawing_layer *drawing);
+static void replay_continue(struct drawing_layer *drawing);
+static void replay_release_held(struct drawing_layer *drawing);
+static void handle_chunk_load(int32_t x, int32_t y, uint64_t generation,
+                              void *records, size_t size, void *data);
+static void drawing_maybe_checkpoint(struct drawing_layer *drawing);
+
+bool drawing_init(struct drawing_layer *drawing,
                   struct infinidesk_server *server) {
     drawing->server = server;
     drawing->drawing_mode = false;
@@ -39,22 +133,108 @@ void drawing_init(struct drawing_layer *drawing,
     drawing->last_canvas_x = 0;
     drawing->last_canvas_y = 0;
 
-    wl_list_init(&drawing->strokes);
+    drawing->next_stroke_id = 0;
+    drawing->visible = NULL;
+    drawing->visible_count = 0;
+    drawing->visible_capacity = 0;
+
+    wl_list_init(&drawing->chunks);
+    drawing->chunk_table = NULL;
+    drawing->chunk_capacity = 0;
+    drawing->chunk_count = 0;
+    wl_list_init(&drawing->undo_stack);
     wl_list_init(&drawing->redo_stack);
+    stroke_index_init(&drawing->index, DRAWING_INDEX_CELL_SIZE);
 
-    /* Initialize with default red color */
+    /* Initialize with default red color and the pen */
     drawing->current_color = COLOR_RED;
+    drawing->tool = DRAWING_TOOL_PEN;
+
+    drawing->is_erasing = false;
+    drawing->current_erase = NULL;
+    wl_array_init(&drawing->erase_hits);
 
     /* UI panel initialized on first frame */
     drawing->ui_panel.hovered_button = UI_BUTTON_NONE;
     drawing->ui_panel.pressed_button = UI_BUTTON_NONE;
 
+    /* Restore annotations from the previous session */
+    drawing->journal = NULL;
+    drawing->replaying = false;
+    drawing->journal_dirty = false;
+    drawing->journal_damaged = false;
+    drawing->replay_begin = NULL;
+    drawing->replay_stroke = NULL;
+    wl_array_init(&drawing->replay_held);
+    drawing->replay_history_lost = false;
+    drawing->chunk_store = NULL;
+    drawing->chunk_generation = 0;
+    drawing->resident_memory = 0;
+    drawing->memory_budget = DRAWING_MEMORY_BUDGET;
+    drawing->page_x = drawing->page_y = 0;
+    drawing->page_velocity_x = drawing->page_velocity_y = 0;
+    drawing->page_time = 0;
+    drawing->checkpoint_at = 0;
+    drawing->checkpoint_idle = NULL;
+    drawing->checkpointing = false;
+    drawing->lod_timer = NULL;
+    if (!drawing_load(drawing)) {
+        return false;
+    }
+
+    /* Start on the levels of detail of the strokes just restored */
+    drawing->lod_timer = wl_event_loop_add_timer(
+        server->event_loop, drawing_chunk_handle_lod_timer, drawing);
+    if (drawing->lod_timer) {
+        wl_event_source_timer_update(drawing->lod_timer, 1);
+    }
+
     wlr_log(WLR_DEBUG, "Drawing layer initialized");
+    return true;
 }
 
 void drawing_finish(struct drawing_layer *drawing) {
-    /* Clean up all strokes */
-    drawing_clear_all(drawing);
+    if (drawing->checkpoint_idle) {
+        wl_event_source_remove(drawing->checkpoint_idle);
+        drawing->checkpoint_idle = NULL;
+    }
+    if (drawing->lod_timer) {
+        wl_event_source_remove(drawing->lod_timer);
+        drawing->lod_timer = NULL;
+    }
+
+    /*
+     * Save this session's changes to the chunk files, unless the replay
+     * hasn't finished; the journal still holds everything then.
+     */
+    drawing_erase_end(drawing);
+    if (drawing->journal) {
+        journal_wait_rewrite(drawing->journal);
+    }
+    if (drawing->journal_dirty && !drawing->replaying) {
+        drawing_checkpoint(drawing);
+        journal_wait_rewrite(drawing->journal);
+    }
+
+    /* Clean up all strokes (without journaling it as a clear) */
+    drawing_clear(drawing);
+    stroke_destroy(drawing->replay_stroke);
+    drawing->replay_stroke = NULL;
+    replay_release_held(drawing);
+    wl_array_release(&drawing->replay_held);
+    free(drawing->chunk_table);
+    drawing->chunk_table = NULL;
+    drawing->chunk_capacity = 0;
+    stroke_index_finish(&drawing->index);
+    free(drawing->visible);
+    drawing->visible = NULL;
+    wl_array_release(&drawing->erase_hits);
+
+    /* Strokes may point into the journal mapping, so close it last */
+    chunk_store_destroy(drawing->chunk_store);
+    drawing->chunk_store = NULL;
+    journal_close(drawing->journal);
+    drawing->journal = NULL;
 
     wlr_log(WLR_DEBUG, "Drawing layer finished");
 }
@@ -66,30 +246,154 @@ void drawing_toggle_mode(struct drawing_layer *drawing) {
     if (!drawing->drawing_mode && drawing->is_drawing) {
         drawing_stroke_end(drawing);
     }
+    if (!drawing->drawing_mode && drawing->is_erasing) {
+        drawing_erase_end(drawing);
+    }
 
     wlr_log(WLR_INFO, "Drawing mode %s",
             drawing->drawing_mode ? "enabled" : "disabled");
 }
 
 void drawing_clear_all(struct drawing_layer *drawing) {
-    struct drawing_stroke *stroke, *tmp_stroke;
+    if (drawing->replaying) {
+        return;
+    }
 
-    wl_list_for_each_safe(stroke, tmp_stroke, &drawing->strokes, link) {
-        drawing_stroke_destroy(stroke);
+    drawing_clear(drawing);
+    journal_record(drawing, JOURNAL_CLEAR, NULL, 0, NULL, 0, true);
+
+    wlr_log(WLR_INFO, "All drawings cleared");
+}
+
+static void drawing_clear(struct drawing_layer *drawing) {
+    /* Drop the history first, freeing the strokes it owns */
+    if (drawing->current_erase) {
+        drawing_op_destroy(drawing->current_erase, false);
+        drawing->current_erase = NULL;
     }
+    drawing->is_erasing = false;
+    drawing_drop_history(drawing);
 
-    /* Clear redo stack as well */
-    wl_list_for_each_safe(stroke, tmp_stroke, &drawing->redo_stack, link) {
-        drawing_stroke_destroy(stroke);
+    /* Chunk files are deleted at the next checkpoint */
+    struct drawing_chunk *chunk, *tmp_chunk;
+    wl_list_for_each_safe(chunk, tmp_chunk, &drawing->chunks, link) {
+        drawing_chunk_destroy(drawing, chunk);
     }
 
+    stroke_index_clear(&drawing->index);
+
+    drawing_stroke_destroy(drawing->current_stroke);
     drawing->current_stroke = NULL;
     drawing->is_drawing = false;
+}
 
-    wlr_log(WLR_INFO, "All drawings cleared");
+/*
+ * Forget all undo and redo history, keeping the canvas as it is.
+ */
+static void drawing_drop_history(struct drawing_layer *drawing) {
+    struct drawing_op *op, *tmp_op;
+    wl_list_for_each_safe(op, tmp_op, &drawing->undo_stack, link) {
+        drawing_op_destroy(op, false);
+    }
+    wl_list_for_each_safe(op, tmp_op, &drawing->redo_stack, link) {
+        drawing_op_destroy(op, true);
+    }
+}
+
+/*
+ * Shift the strokes in an op's array by an offset in canvas coordinates.
+ */
+static void translate_strokes(struct wl_array *strokes, double dx,
+                              double dy) {
+    struct drawing_stroke **stroke;
+    wl_array_for_each(stroke, strokes) {
+        (*stroke)->origin_x += dx;
+        (*stroke)->origin_y += dy;
+    }
+}
+
+void drawing_translate(struct drawing_layer *drawing, double dx, double dy) {
+    /* Strokes on the canvas, and the chunks holding them */
+    struct drawing_chunk *chunk;
+    wl_list_for_each(chunk, &drawing->chunks, link) {
+        chunk->min_x += dx;
+        chunk->min_y += dy;
+        chunk->max_x += dx;
+        chunk->max_y += dy;
+
+        struct drawing_stroke *stroke;
+        wl_list_for_each(stroke, &chunk->strokes, link) {
+            stroke->origin_x += dx;
+            stroke->origin_y += dy;
+        }
+    }
+
+    /* Strokes only the history holds, each in exactly one op */
+    struct drawing_op *op;
+    wl_list_for_each(op, &drawing->undo_stack, link) {
+        translate_strokes(&op->removed, dx, dy);
+    }
+    wl_list_for_each(op, &drawing->redo_stack, link) {
+        translate_strokes(&op->added, dx, dy);
+    }
+    if (drawing->current_erase) {
+        translate_strokes(&drawing->current_erase->removed, dx, dy);
+    }
+    if (drawing->current_stroke) {
+        drawing->current_stroke->origin_x += dx;
+        drawing->current_stroke->origin_y += dy;
+    }
+    if (drawing->replay_stroke) {
+        drawing->replay_stroke->origin_x += dx;
+        drawing->replay_stroke->origin_y += dy;
+    }
+    struct held_stroke *held;
+    wl_array_for_each(held, &drawing->replay_held) {
+        if (!held->owned) {
+            held->stroke->origin_x += dx;
+            held->stroke->origin_y += dy;
+        }
+    }
+
+    drawing->last_canvas_x += dx;
+    drawing->last_canvas_y += dy;
+    drawing->page_x += dx;
+    drawing->page_y += dy;
+
+    if (!stroke_index_translate(&drawing->index, dx, dy)) {
+        /* Fall back to indexing everything again */
+        wlr_log(WLR_ERROR, "Failed to move stroke index, rebuilding it");
+        stroke_index_clear(&drawing->index);
+        wl_list_for_each(chunk, &drawing->chunks, link) {
+            struct drawing_stroke *stroke;
+            wl_list_for_each(stroke, &chunk->strokes, link) {
+                if (!stroke_index_insert(&drawing->index, stroke)) {
+                    wlr_log(WLR_ERROR, "Failed to index stroke");
+                }
+            }
+        }
+    }
+}
+
+void drawing_count_strokes(struct drawing_layer *drawing, uint32_t *strokes,
+                           uint64_t *points) {
+    *strokes = 0;
+    *points = 0;
+    struct drawing_chunk *chunk;
+    wl_list_for_each(chunk, &drawing->chunks, link) {
+        struct drawing_stroke *stroke;
+        wl_list_for_each(stroke, &chunk->strokes, link) {
+            (*strokes)++;
+            *points += stroke->point_count;
+        }
+    }
 }
 
 void drawing_undo_last(struct drawing_layer *drawing) {
+    if (drawing->replaying) {
+        return;
+    }
+
     /* If currently drawing, end and remove that stroke */
     if (drawing->is_drawing && drawing->current_stroke) {
         drawing_stroke_destroy(drawing->current_stroke);
@@ -99,65 +403,52 @@ void drawing_undo_last(struct drawing_layer *drawing) {
         return;
     }
 
-    /* Otherwise remove the last completed stroke */
-    if (wl_list_empty(&drawing->strokes)) {
-        wlr_log(WLR_DEBUG, "No strokes to undo");
-        return;
-    }
-
-    /* Get the last stroke in the list */
-    struct drawing_stroke *stroke =
-        wl_container_of(drawing->strokes.prev, stroke, link);
-
-    /* Move stroke to redo stack instead of destroying */
-    wl_list_remove(&stroke->link);
-    wl_list_insert(drawing->redo_stack.prev, &stroke->link);
+    /* An erase in progress becomes the operation to undo */
+    erase_finish(drawing);
 
-    wlr_log(WLR_INFO, "Undid last stroke");
+    if (undo_op(drawing)) {
+        wlr_log(WLR_INFO, "Undid last operation");
+    } else {
+        wlr_log(WLR_DEBUG, "Nothing to undo");
+    }
 }
 
 void drawing_redo_last(struct drawing_layer *drawing) {
-    if (wl_list_empty(&drawing->redo_stack)) {
-        wlr_log(WLR_DEBUG, "No strokes to redo");
+    if (drawing->is_drawing || drawing->is_erasing || drawing->replaying) {
         return;
     }
 
-    struct drawing_stroke *stroke =
-        wl_container_of(drawing->redo_stack.prev, stroke, link);
-
-    wl_list_remove(&stroke->link);
-    wl_list_insert(drawing->strokes.prev, &stroke->link);
-
-    wlr_log(WLR_INFO, "Redid stroke");
+    if (redo_op(drawing)) {
+        wlr_log(WLR_INFO, "Redid operation");
+    } else {
+        wlr_log(WLR_DEBUG, "Nothing to redo");
+    }
 }
 
 void drawing_stroke_begin(struct drawing_layer *drawing, double canvas_x,
                           double canvas_y) {
-    if (!drawing->drawing_mode) {
+    if (!drawing->drawing_mode || drawing->is_erasing || drawing->replaying) {
         return;
     }
 
-    /* Create a new stroke */
-    drawing->current_stroke = drawing_stroke_create();
+    /* Create a new stroke, with points relative to its first point */
+    drawing->current_stroke =
+        stroke_create(canvas_x, canvas_y, drawing->current_color);
     if (!drawing->current_stroke) {
         wlr_log(WLR_ERROR, "Failed to create stroke");
         return;
     }
-
-    /* Save the current color with the stroke */
-    drawing->current_stroke->color = drawing->current_color;
+    drawing->current_stroke->id = drawing->next_stroke_id++;
+    drawing->current_stroke->z = drawing->current_stroke->id;
 
     /* Add the first point */
-    struct drawing_point *point = drawing_point_create(canvas_x, canvas_y);
-    if (!point) {
+    if (!stroke_append_point(drawing->current_stroke, canvas_x, canvas_y)) {
         wlr_log(WLR_ERROR, "Failed to create point");
-        free(drawing->current_stroke);
+        stroke_destroy(drawing->current_stroke);
         drawing->current_stroke = NULL;
         return;
     }
 
-    wl_list_insert(&drawing->current_stroke->points, &point->link);
-
     drawing->is_drawing = true;
     drawing->last_canvas_x = canvas_x;
     drawing->last_canvas_y = canvas_y;
@@ -181,14 +472,11 @@ void drawing_stroke_add_point(struct drawing_layer *drawing, double canvas_x,
         return;
     }
 
-    struct drawing_point *point = drawing_point_create(canvas_x, canvas_y);
-    if (!point) {
+    if (!stroke_append_point(drawing->current_stroke, canvas_x, canvas_y)) {
         wlr_log(WLR_ERROR, "Failed to create point");
         return;
     }
 
-    wl_list_insert(drawing->current_stroke->points.prev, &point->link);
-
     drawing->last_canvas_x = canvas_x;
     drawing->last_canvas_y = canvas_y;
 }
@@ -199,27 +487,65 @@ void drawing_stroke_end(struct drawing_layer *drawing) {
     }
 
     /* Only keep strokes with at least 2 points */
-    int point_count = 0;
-    struct drawing_point *point;
-    wl_list_for_each(point, &drawing->current_stroke->points, link) {
-        point_count++;
-        if (point_count >= 2) {
-            break;
-        }
-    }
+    uint32_t point_count = drawing->current_stroke->point_count;
 
     if (point_count < 2) {
         wlr_log(WLR_DEBUG, "Stroke too short, discarding");
         drawing_stroke_destroy(drawing->current_stroke);
     } else {
-        /* Add the completed stroke to the list */
-        wl_list_insert(drawing->strokes.prev, &drawing->current_stroke->link);
-        wlr_log(WLR_DEBUG, "Finished stroke with %d points", point_count);
+        /*
+         * Simplify the stroke relative to the zoom it was drawn at, so the
+         * result is visually identical at that zoom, then render it as a
+         * smooth curve through the remaining points.
+         */
+        struct drawing_stroke *stroke = drawing->current_stroke;
+        double tolerance =
+            DRAWING_SIMPLIFY_TOLERANCE / drawing->server->canvas.scale;
+        if (stroke_simplify(stroke, tolerance)) {
+            stroke->smooth = true;
+            stroke->tolerance = (float)tolerance;
+        } else {
+            wlr_log(WLR_ERROR, "Failed to simplify stroke");
+        }
+
+        /*
+         * The stroke is complete, so pack its points. Rounding them to a
+         * fraction of a pixel at the zoom it was drawn at is invisible.
+         */
+        float quantum =
+            (float)(DRAWING_POINT_QUANTUM / drawing->server->canvas.scale);
+        if (!stroke_pack(stroke, quantum)) {
+            wlr_log(WLR_ERROR, "Failed to pack stroke points");
+        }
+
+        /*
+         * Build levels of detail while the stroke is small and fresh,
+         * rather than on the frame it is first seen zoomed out.
+         */
+        stroke_compute_bounds(stroke);
+        stroke->lods_built = true;
+        if (stroke->tolerance > 0.0f &&
+            !stroke_build_lods(stroke, stroke->tolerance)) {
+            wlr_log(WLR_ERROR, "Failed to build stroke levels of detail");
+        }
 
-        /* Clear redo stack when new stroke is drawn */
-        struct drawing_stroke *redo_stroke, *tmp;
-        wl_list_for_each_safe(redo_stroke, tmp, &drawing->redo_stack, link) {
-            drawing_stroke_destroy(redo_stroke);
+        /* Store the stroke in the chunk it starts in */
+        int32_t chunk_x, chunk_y;
+        drawing_chunk_key(drawing, stroke->origin_x, stroke->origin_y,
+                          &chunk_x, &chunk_y);
+        stroke->chunk = drawing_chunk_get(drawing, chunk_x, chunk_y);
+
+        if (!stroke->chunk) {
+            wlr_log(WLR_ERROR, "Failed to create canvas chunk");
+            drawing_stroke_destroy(stroke);
+        } else {
+            /* Add the completed stroke to the canvas, history and journal */
+            drawing_commit_stroke(drawing, stroke);
+            journal_record_stroke(drawing, stroke, true);
+            wlr_log(WLR_DEBUG,
+                    "Finished stroke with %u points (%u before "
+                    "simplification)",
+                    stroke->point_count, point_count);
         }
     }
 
@@ -227,188 +553,1490 @@ void drawing_stroke_end(struct drawing_layer *drawing) {
     drawing->is_drawing = false;
 }
 
-void drawing_render(struct drawing_layer *drawing, struct wlr_render_pass *pass,
-                    int output_width, int output_height, float output_scale) {
-    (void)output_width;
-    (void)output_height;
+void drawing_erase_begin(struct drawing_layer *drawing, double canvas_x,
+                         double canvas_y) {
+    if (!drawing->drawing_mode || drawing->is_drawing ||
+        drawing->is_erasing || drawing->replaying) {
+        return;
+    }
+
+    erase_start(drawing);
+    if (!drawing->is_erasing) {
+        return;
+    }
+
+    drawing->last_canvas_x = canvas_x;
+    drawing->last_canvas_y = canvas_y;
+
+    erase_segment(drawing, canvas_x, canvas_y, canvas_x, canvas_y);
+}
+
+void drawing_erase_update(struct drawing_layer *drawing, double canvas_x,
+                          double canvas_y) {
+    if (!drawing->is_erasing || drawing->replaying) {
+        return;
+    }
+
+    /* Erase along the path moved, so fast motion doesn't skip strokes */
+    erase_segment(drawing, drawing->last_canvas_x, drawing->last_canvas_y,
+                  canvas_x, canvas_y);
+
+    drawing->last_canvas_x = canvas_x;
+    drawing->last_canvas_y = canvas_y;
+}
+
+void drawing_erase_end(struct drawing_layer *drawing) {
+    if (!drawing->replaying) {
+        erase_finish(drawing);
+    }
+}
+
+struct visible_query {
+    struct drawing_layer *drawing;
+    double min_x, min_y, max_x, max_y;
+};
+
+static void collect_visible_stroke(struct drawing_stroke *stroke,
+                                   void *data) {
+    struct visible_query *query = data;
+    struct drawing_layer *drawing = query->drawing;
+
+    /* The index works per cell, so check the stroke's own bounds too */
+    if (stroke->origin_x + stroke->max_x < query->min_x ||
+        stroke->origin_x + stroke->min_x > query->max_x ||
+        stroke->origin_y + stroke->max_y < query->min_y ||
+        stroke->origin_y + stroke->min_y > query->max_y) {
+        return;
+    }
+
+    if (drawing->visible_count >= drawing->visible_capacity) {
+        uint32_t new_capacity = drawing->visible_capacity
+                                    ? drawing->visible_capacity * 2
+                                    : 64;
+        struct drawing_stroke **new_visible =
+            realloc(drawing->visible, new_capacity * sizeof(*new_visible));
+        if (!new_visible) {
+            return;
+        }
+        drawing->visible = new_visible;
+        drawing->visible_capacity = new_capacity;
+    }
+
+    drawing->visible[drawing->visible_count++] = stroke;
+}
+
+/*
+ * Add a rectangle of a stroke to the wlroots render pass in data.
+ */
+static void add_stroke_rect(void *data, const struct stroke_rect *rect,
+                            const struct drawing_color *color) {
+    struct wlr_render_pass *pass = data;
+    perf_add_rect(
+        pass, &(struct wlr_render_rect_options){
+                  .box =
+                      {
+                          .x = rect->x,
+                          .y = rect->y,
+                          .width = rect->width,
+                          .height = rect->height,
+                      },
+                  .color =
+                      {
+                          .r = color->r,
+                          .g = color->g,
+                          .b = color->b,
+                          .a = DRAWING_COLOR_A,
+                      },
+              });
+}
 
+/*
+ * Render a stroke with its points relative to the canvas viewport.
+ * output_scale is the HiDPI scale factor for converting to physical pixels.
+ */
+static void render_stroke(const struct stroke_pass *pass,
+                          struct infinidesk_canvas *canvas,
+                          struct drawing_stroke *stroke, float output_scale,
+                          double error_scale) {
+    /*
+     * Points are stored relative to the stroke origin, so transform the
+     * origin once and then only scale each point offset. canvas_to_screen()
+     * returns logical coordinates, but we render in physical pixels.
+     */
+    double base_x, base_y;
+    canvas_to_screen(canvas, stroke->origin_x, stroke->origin_y, &base_x,
+                     &base_y);
+    struct point_transform transform = {
+        .base_x = base_x * output_scale,
+        .base_y = base_y * output_scale,
+        .scale = canvas->scale * output_scale,
+    };
+    stroke_render(pass, stroke, &transform, error_scale);
+}
+
+void drawing_render(struct drawing_layer *drawing, struct wlr_render_pass *pass,
+                    int output_width, int output_height, float output_scale,
+                    const struct render_quality *quality) {
     struct infinidesk_canvas *canvas = &drawing->server->canvas;
 
     /*
-     * Combined scale: canvas scale (zoom) * output scale (HiDPI).
-     * canvas_to_screen() returns logical coordinates, but we render
-     * in physical pixels, so we must multiply by output_scale.
+     * Visible canvas rect, grown by half the line width so strokes just
+     * outside the edge still draw their visible half.
      */
-    double combined_scale = canvas->scale * output_scale;
+    double pad = STROKE_LINE_WIDTH / 2.0 + 1.0 / canvas->scale;
+    struct visible_query query = {
+        .drawing = drawing,
+        .min_x = canvas->viewport_x - pad,
+        .min_y = canvas->viewport_y - pad,
+        .max_x = canvas->viewport_x +
+                 output_width / output_scale / canvas->scale + pad,
+        .max_y = canvas->viewport_y +
+                 output_height / output_scale / canvas->scale + pad,
+    };
+
+    /* Page in what this output is about to show */
+    drawing_chunks_page(drawing, query.min_x, query.min_y, query.max_x,
+                        query.max_y);
+
+    /* Only visit completed strokes that intersect this output */
+    drawing->visible_count = 0;
+    stroke_index_query_strokes(&drawing->index, query.min_x, query.min_y,
+                               query.max_x, query.max_y,
+                               collect_visible_stroke, &query);
+
+    /* Render in stacking order so overlapping strokes stack correctly */
+    struct stroke_pass stroke_pass = {
+        .add_rect = add_stroke_rect,
+        .data = pass,
+    };
+    stroke_sort_z(drawing->visible, drawing->visible_count);
+    for (uint32_t i = 0; i < drawing->visible_count; i++) {
+        render_stroke(&stroke_pass, canvas, drawing->visible[i], output_scale,
+                      quality->stroke_error);
+    }
+
+    /* Render the current stroke being drawn */
+    if (drawing->is_drawing && drawing->current_stroke) {
+        render_stroke(&stroke_pass, canvas, drawing->current_stroke,
+                      output_scale, quality->stroke_error);
+    }
+}
+
+/* Internal functions */
+
+static void drawing_stroke_destroy(struct drawing_stroke *stroke) {
+    if (!stroke) {
+        return;
+    }
+
+    wl_list_remove(&stroke->link);
+    stroke_destroy(stroke);
+}
+
+static struct drawing_op *drawing_op_create(void) {
+    struct drawing_op *op = calloc(1, sizeof(*op));
+    if (!op) {
+        return NULL;
+    }
+
+    wl_list_init(&op->link);
+    wl_array_init(&op->added);
+    wl_array_init(&op->removed);
+    return op;
+}
+
+/*
+ * Free an operation but not its strokes, letting go of their chunks.
+ */
+static void drawing_op_free(struct drawing_op *op) {
+    struct drawing_stroke **stroke;
+    wl_array_for_each(stroke, &op->added) {
+        (*stroke)->chunk->history_refs--;
+    }
+    wl_array_for_each(stroke, &op->removed) {
+        (*stroke)->chunk->history_refs--;
+    }
+
+    wl_list_remove(&op->link);
+    wl_array_release(&op->added);
+    wl_array_release(&op->removed);
+    free(op);
+}
+
+/*
+ * Destroy an operation along with the strokes it owns: the removed strokes
+ * if it is applied, or the added strokes if it has been undone.
+ */
+static void drawing_op_destroy(struct drawing_op *op, bool undone) {
+    struct wl_array *owned = undone ? &op->added : &op->removed;
+    struct drawing_stroke **stroke;
+    wl_array_for_each(stroke, owned) {
+        (*stroke)->chunk->history_refs--;
+        drawing_stroke_destroy(*stroke);
+    }
+    owned->size = 0;
+    drawing_op_free(op);
+}
+
+/*
+ * Add a stroke to one of an operation's arrays. Its chunk stays in memory
+ * while the history refers to it.
+ */
+static bool drawing_op_add(struct wl_array *strokes,
+                           struct drawing_stroke *stroke) {
+    struct drawing_stroke **slot = wl_array_add(strokes, sizeof(*slot));
+    if (!slot) {
+        return false;
+    }
+    *slot = stroke;
+    stroke->chunk->history_refs++;
+    return true;
+}
+
+/*
+ * Record a new operation, discarding anything that could be redone.
+ */
+static void drawing_push_op(struct drawing_layer *drawing,
+                            struct drawing_op *op) {
+    struct drawing_op *redo_op, *tmp;
+    wl_list_for_each_safe(redo_op, tmp, &drawing->redo_stack, link) {
+        drawing_op_destroy(redo_op, true);
+    }
+
+    wl_list_insert(drawing->undo_stack.prev, &op->link);
+}
+
+/*
+ * Put a stroke on the canvas.
+ */
+static void drawing_attach_stroke(struct drawing_layer *drawing,
+                                  struct drawing_stroke *stroke) {
+    /* A changed chunk stays resident until it has been saved */
+    stroke->chunk->dirty = true;
+    drawing_chunk_attach(drawing, stroke);
+}
+
+/*
+ * Take a stroke off the canvas without destroying it.
+ */
+static void drawing_detach_stroke(struct drawing_layer *drawing,
+                                  struct drawing_stroke *stroke) {
+    stroke->chunk->dirty = true;
+    drawing_chunk_detach(drawing, stroke);
+}
+
+/*
+ * Undo the last operation on the undo stack. Returns false if there is
+ * none.
+ */
+static bool undo_op(struct drawing_layer *drawing) {
+    if (wl_list_empty(&drawing->undo_stack)) {
+        return false;
+    }
+
+    struct drawing_op *op =
+        wl_container_of(drawing->undo_stack.prev, op, link);
+
+    struct drawing_stroke **stroke;
+    wl_array_for_each(stroke, &op->added) {
+        drawing_detach_stroke(drawing, *stroke);
+    }
+    wl_array_for_each(stroke, &op->removed) {
+        drawing_attach_stroke(drawing, *stroke);
+    }
+
+    /* Move the operation to the redo stack */
+    wl_list_remove(&op->link);
+    wl_list_insert(drawing->redo_stack.prev, &op->link);
+    journal_record(drawing, JOURNAL_UNDO, NULL, 0, NULL, 0, true);
+    return true;
+}
 
-    /* Render all completed strokes */
+/*
+ * Redo the last operation on the redo stack. Returns false if there is
+ * none.
+ */
+static bool redo_op(struct drawing_layer *drawing) {
+    if (wl_list_empty(&drawing->redo_stack)) {
+        return false;
+    }
+
+    struct drawing_op *op =
+        wl_container_of(drawing->redo_stack.prev, op, link);
+
+    struct drawing_stroke **stroke;
+    wl_array_for_each(stroke, &op->removed) {
+        drawing_detach_stroke(drawing, *stroke);
+    }
+    wl_array_for_each(stroke, &op->added) {
+        drawing_attach_stroke(drawing, *stroke);
+    }
+
+    wl_list_remove(&op->link);
+    wl_list_insert(drawing->undo_stack.prev, &op->link);
+    journal_record(drawing, JOURNAL_REDO, NULL, 0, NULL, 0, true);
+    return true;
+}
+
+/*
+ * Erase a whole stroke as part of the current erase operation.
+ */
+static void erase_remove_stroke(struct drawing_layer *drawing,
+                                struct drawing_stroke *stroke) {
+    struct drawing_op *op = drawing->current_erase;
+    struct journal_stroke_id record = {
+        .id = stroke->id,
+        .chunk_x = stroke->chunk->x,
+        .chunk_y = stroke->chunk->y,
+    };
+    journal_record(drawing, JOURNAL_ERASE_REMOVE, &record, sizeof(record),
+                   NULL, 0, false);
+
+    drawing_detach_stroke(drawing, stroke);
+
+    /* A fragment left earlier in this erase never existed to undo */
+    struct drawing_stroke **added = op->added.data;
+    size_t added_count = op->added.size / sizeof(*added);
+    for (size_t i = 0; i < added_count; i++) {
+        if (added[i] == stroke) {
+            added[i] = added[added_count - 1];
+            op->added.size -= sizeof(*added);
+            stroke->chunk->history_refs--;
+            stroke_destroy(stroke);
+            return;
+        }
+    }
+
+    if (!drawing_op_add(&op->removed, stroke)) {
+        /* Can't be undone, so put it back rather than lose it */
+        wlr_log(WLR_ERROR, "Failed to record erased stroke");
+        drawing_attach_stroke(drawing, stroke);
+    }
+}
+
+/*
+ * Start recording an erase operation.
+ */
+static void erase_start(struct drawing_layer *drawing) {
+    /* Everything erased until the button is released is one operation */
+    drawing->current_erase = drawing_op_create();
+    if (!drawing->current_erase) {
+        wlr_log(WLR_ERROR, "Failed to create erase operation");
+        return;
+    }
+
+    drawing->is_erasing = true;
+    journal_record(drawing, JOURNAL_ERASE_BEGIN, NULL, 0, NULL, 0, false);
+}
+
+/*
+ * Finish the current erase, if any, pushing it onto the undo stack.
+ */
+static void erase_finish(struct drawing_layer *drawing) {
+    if (!drawing->is_erasing) {
+        return;
+    }
+
+    struct drawing_op *op = drawing->current_erase;
+    drawing->current_erase = NULL;
+    drawing->is_erasing = false;
+    journal_record(drawing, JOURNAL_ERASE_END, NULL, 0, NULL, 0, true);
+
+    if (op->added.size == 0 && op->removed.size == 0) {
+        drawing_op_destroy(op, false);
+        return;
+    }
+
+    wlr_log(WLR_DEBUG, "Erased %zu strokes, leaving %zu fragments",
+            op->removed.size / sizeof(struct drawing_stroke *),
+            op->added.size / sizeof(struct drawing_stroke *));
+    drawing_push_op(drawing, op);
+}
+
+/*
+ * Put fragments of a stroke on the canvas as part of the current erase
+ * operation. The stroke itself is left in place for the caller to remove.
+ * Returns false, changing nothing, if any fragment can't be created.
+ */
+static bool erase_apply_split(struct drawing_layer *drawing,
+                              struct drawing_stroke *stroke,
+                              const struct journal_fragment *fragments,
+                              uint32_t fragment_count) {
+    struct drawing_op *op = drawing->current_erase;
+    size_t first_added = op->added.size / sizeof(struct drawing_stroke *);
+
+    for (uint32_t i = 0; i < fragment_count; i++) {
+        struct drawing_stroke *fragment =
+            stroke_create_fragment(stroke, fragments[i].first_point,
+                                   fragments[i].point_count);
+        if (!fragment || !drawing_op_add(&op->added, fragment)) {
+            wlr_log(WLR_ERROR, "Failed to create stroke fragment");
+            stroke_destroy(fragment);
+
+            /* Leave the stroke whole rather than lose part of it */
+            struct drawing_stroke **added = op->added.data;
+            size_t added_count = op->added.size / sizeof(*added);
+            for (size_t j = first_added; j < added_count; j++) {
+                added[j]->chunk->history_refs--;
+                stroke_destroy(added[j]);
+            }
+            op->added.size = first_added * sizeof(*added);
+            return false;
+        }
+        fragment->id = fragments[i].id;
+    }
+
+    struct journal_erase_split record = {
+        .parent_id = stroke->id,
+        .chunk_x = stroke->chunk->x,
+        .chunk_y = stroke->chunk->y,
+        .fragment_count = fragment_count,
+    };
+    journal_record(drawing, JOURNAL_ERASE_SPLIT, &record, sizeof(record),
+                   fragments, fragment_count * sizeof(*fragments), false);
+
+    /* Only touch the canvas once every fragment exists */
+    struct drawing_stroke **added = op->added.data;
+    size_t added_count = op->added.size / sizeof(*added);
+    for (size_t i = first_added; i < added_count; i++) {
+        drawing_attach_stroke(drawing, added[i]);
+    }
+    return true;
+}
+
+/*
+ * Replace a stroke with the fragments between its erased segments.
+ * hits[0..hit_count) are the stroke's erased segments, sorted and unique.
+ */
+static void erase_split_stroke(struct drawing_layer *drawing,
+                               struct drawing_stroke *stroke,
+                               const struct erase_hit *hits,
+                               size_t hit_count) {
+    struct journal_fragment *fragments =
+        calloc(hit_count + 1, sizeof(*fragments));
+    if (!fragments) {
+        wlr_log(WLR_ERROR, "Failed to allocate stroke fragments");
+        return;
+    }
+
+    /*
+     * Each run of untouched segments [run_start, end] becomes a fragment
+     * over points [run_start, end + 1], sharing the stroke's points.
+     */
+    uint32_t last_seg = stroke->point_count - 2;
+    uint32_t run_start = 0;
+    uint32_t fragment_count = 0;
+    for (size_t i = 0; i <= hit_count; i++) {
+        uint32_t run_end = i < hit_count ? hits[i].seg : last_seg + 1;
+        if (run_end > run_start) {
+            fragments[fragment_count++] = (struct journal_fragment){
+                .id = drawing->next_stroke_id++,
+                .first_point = run_start,
+                .point_count = run_end - run_start + 1,
+            };
+        }
+        run_start = run_end + 1;
+    }
+
+    if (erase_apply_split(drawing, stroke, fragments, fragment_count)) {
+        erase_remove_stroke(drawing, stroke);
+    }
+    free(fragments);
+}
+
+struct erase_query {
+    struct drawing_layer *drawing;
+    double ax, ay, bx, by;
+    double radius;
+};
+
+static void collect_erase_hits(struct drawing_stroke *stroke,
+                               uint32_t first_seg, uint32_t last_seg,
+                               void *data) {
+    struct erase_query *query = data;
+
+    /* Decode just the points of the run */
+    struct point_cursor cursor;
+    struct drawing_point p, q;
+    stroke_cursor(stroke, first_seg, last_seg - first_seg + 2, &cursor);
+    if (!point_cursor_next(&cursor, &p)) {
+        return;
+    }
+
+    for (uint32_t seg = first_seg; point_cursor_next(&cursor, &q);
+         seg++, p = q) {
+        if (!stroke_segment_near(stroke, &p, &q, query->ax, query->ay,
+                                 query->bx, query->by, query->radius)) {
+            continue;
+        }
+
+        struct erase_hit *hit =
+            wl_array_add(&query->drawing->erase_hits, sizeof(*hit));
+        if (!hit) {
+            return;
+        }
+        hit->stroke = stroke;
+        hit->seg = seg;
+    }
+}
+
+static int compare_erase_hit(const void *a, const void *b) {
+    const struct erase_hit *hit_a = a;
+    const struct erase_hit *hit_b = b;
+    if (hit_a->stroke->id != hit_b->stroke->id) {
+        return hit_a->stroke->id < hit_b->stroke->id ? -1 : 1;
+    }
+    return (hit_a->seg > hit_b->seg) - (hit_a->seg < hit_b->seg);
+}
+
+/*
+ * Erase everything the eraser touches moving along the canvas segment a-b.
+ */
+static void erase_segment(struct drawing_layer *drawing, double ax,
+                          double ay, double bx, double by) {
+    struct erase_query query = {
+        .drawing = drawing,
+        .ax = ax,
+        .ay = ay,
+        .bx = bx,
+        .by = by,
+        .radius = DRAWING_ERASER_RADIUS / drawing->server->canvas.scale +
+                  STROKE_LINE_WIDTH / 2.0,
+    };
+
+    /* Find the touched segments through the index */
+    drawing->erase_hits.size = 0;
+    stroke_index_query_segments(
+        &drawing->index, fmin(ax, bx) - query.radius,
+        fmin(ay, by) - query.radius, fmax(ax, bx) + query.radius,
+        fmax(ay, by) + query.radius, collect_erase_hits, &query);
+
+    size_t hit_count = drawing->erase_hits.size / sizeof(struct erase_hit);
+    if (hit_count == 0) {
+        return;
+    }
+
+    /* Group by stroke; a segment spanning cells may be reported twice */
+    struct erase_hit *hits = drawing->erase_hits.data;
+    qsort(hits, hit_count, sizeof(*hits), compare_erase_hit);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < hit_count; i++) {
+        if (unique == 0 || hits[i].stroke != hits[unique - 1].stroke ||
+            hits[i].seg != hits[unique - 1].seg) {
+            hits[unique++] = hits[i];
+        }
+    }
+
+    for (size_t first = 0; first < unique;) {
+        size_t end = first + 1;
+        while (end < unique && hits[end].stroke == hits[first].stroke) {
+            end++;
+        }
+
+        if (drawing->tool == DRAWING_TOOL_ERASE_PARTIAL) {
+            erase_split_stroke(drawing, hits[first].stroke, &hits[first],
+                               end - first);
+        } else {
+            erase_remove_stroke(drawing, hits[first].stroke);
+        }
+        first = end;
+    }
+}
+
+/*
+ * Put a finished stroke on the canvas as a new undoable operation.
+ */
+static void drawing_commit_stroke(struct drawing_layer *drawing,
+                                  struct drawing_stroke *stroke) {
+    drawing_attach_stroke(drawing, stroke);
+
+    struct drawing_op *op = drawing_op_create();
+    if (op && drawing_op_add(&op->added, stroke)) {
+        drawing_push_op(drawing, op);
+    } else {
+        wlr_log(WLR_ERROR, "Failed to record stroke for undo");
+        free(op);
+    }
+}
+
+/*
+ * Queue a journal record, unless there is no journal or the change being
+ * recorded is itself coming from the journal. With flush set, everything
+ * queued is handed to the writer thread.
+ */
+static void journal_record(struct drawing_layer *drawing, uint32_t type,
+                           const void *head, size_t head_len,
+                           const void *tail, size_t tail_len, bool flush) {
+    if (!drawing->journal || drawing->replaying) {
+        return;
+    }
+
+    drawing->journal_dirty = true;
+    journal_append(drawing->journal, type, head, head_len, tail, tail_len);
+    if (flush) {
+        journal_flush(drawing->journal);
+        drawing_maybe_checkpoint(drawing);
+    }
+}
+
+/*
+ * Journal a finished stroke as a begin, points and end record batch.
+ */
+static void journal_record_stroke(struct drawing_layer *drawing,
+                                  struct drawing_stroke *stroke, bool flush) {
+    if (!drawing->journal || drawing->replaying) {
+        return;
+    }
+
+    struct journal_stroke_begin begin;
+    drawing_chunk_encode_begin(drawing, stroke, &begin);
+
+    struct wl_array block;
+    wl_array_init(&block);
+    float quantum = (float)(DRAWING_POINT_QUANTUM /
+                            drawing->server->canvas.scale);
+    if (!stroke_export_points(stroke, &block, &quantum)) {
+        wlr_log(WLR_ERROR, "Failed to encode stroke for the journal");
+        wl_array_release(&block);
+        return;
+    }
+    struct journal_stroke_points points = {
+        .id = stroke->id,
+        .point_count = stroke->point_count,
+        .quantum = quantum,
+        .data_size = block.size,
+    };
+    struct journal_stroke_id end = {
+        .id = stroke->id,
+        .chunk_x = stroke->chunk->x,
+        .chunk_y = stroke->chunk->y,
+    };
+
+    journal_record(drawing, JOURNAL_STROKE_BEGIN, &begin, sizeof(begin), NULL,
+                   0, false);
+    journal_record(drawing, JOURNAL_STROKE_POINTS, &points, sizeof(points),
+                   block.data, block.size, false);
+    journal_record(drawing, JOURNAL_STROKE_END, &end, sizeof(end), NULL, 0,
+                   flush);
+    wl_array_release(&block);
+}
+
+/*
+ * Find a stroke the journal refers to on the canvas. Returns REPLAY_WAIT if
+ * it isn't there yet but its chunk is being paged in, so it may turn up.
+ */
+static enum replay_result replay_find(struct drawing_layer *drawing,
+                                      int32_t x, int32_t y, uint64_t id,
+                                      struct drawing_stroke **found) {
+    struct drawing_chunk *chunk = drawing_chunk_get(drawing, x, y);
+    if (!chunk) {
+        return REPLAY_MALFORMED;
+    }
+
+    /* The journal only refers to strokes on the canvas at the time */
     struct drawing_stroke *stroke;
-    wl_list_for_each(stroke, &drawing->strokes, link) {
-        struct drawing_point *prev_point = NULL;
-        struct drawing_point *point;
-
-        wl_list_for_each(point, &stroke->points, link) {
-            if (prev_point) {
-                /* Convert canvas coordinates to logical screen coordinates */
-                double screen_x1, screen_y1, screen_x2, screen_y2;
-                canvas_to_screen(canvas, prev_point->x, prev_point->y,
-                                 &screen_x1, &screen_y1);
-                canvas_to_screen(canvas, point->x, point->y, &screen_x2,
-                                 &screen_y2);
-
-                /* Convert to physical pixels */
-                screen_x1 *= output_scale;
-                screen_y1 *= output_scale;
-                screen_x2 *= output_scale;
-                screen_y2 *= output_scale;
-
-                /* Draw line segment */
-                /* Note: wlroots doesn't have a direct line primitive,
-                 * so we approximate with small rectangles */
-                double dx = screen_x2 - screen_x1;
-                double dy = screen_y2 - screen_y1;
-                double length = sqrt(dx * dx + dy * dy);
-
-                if (length > 0.1) {
-                    double scaled_width = DRAWING_LINE_WIDTH * combined_scale;
-
-                    /* Draw multiple small rects along the line for smoothness
-                     */
-                    int segments = (int)(length / 2.0) + 1;
-                    for (int i = 0; i <= segments; i++) {
-                        double t = segments > 0 ? (double)i / segments : 0;
-                        double x = screen_x1 + dx * t;
-                        double y = screen_y1 + dy * t;
-
-                        /* Draw a small rectangle at this point */
-                        wlr_render_pass_add_rect(
-                            pass, &(struct wlr_render_rect_options){
-                                      .box =
-                                          {
-                                              .x = (int)(x - scaled_width / 2),
-                                              .y = (int)(y - scaled_width / 2),
-                                              .width = (int)scaled_width + 1,
-                                              .height = (int)scaled_width + 1,
-                                          },
-                                      .color =
-                                          {
-                                              .r = stroke->color.r,
-                                              .g = stroke->color.g,
-                                              .b = stroke->color.b,
-                                              .a = DRAWING_COLOR_A,
-                                          },
-                                  });
-                    }
-                }
+    wl_list_for_each(stroke, &chunk->strokes, link) {
+        if (stroke->id == id) {
+            *found = stroke;
+            return REPLAY_OK;
+        }
+    }
+    return chunk->state == DRAWING_CHUNK_LOADING ? REPLAY_WAIT
+                                                 : REPLAY_MALFORMED;
+}
+
+/*
+ * Make the chunks listed in a manifest known, without loading them.
+ */
+static bool replay_manifest(struct drawing_layer *drawing,
+                            const void *payload, uint32_t length) {
+    const struct journal_manifest *manifest = payload;
+    if (length < sizeof(*manifest) ||
+        (length - sizeof(*manifest)) / sizeof(struct journal_chunk) <
+            manifest->chunk_count) {
+        return false;
+    }
+
+    const struct journal_chunk *chunks =
+        (const struct journal_chunk *)(manifest + 1);
+    for (uint32_t i = 0; i < manifest->chunk_count; i++) {
+        if (!drawing_chunk_add_stored(drawing, &chunks[i])) {
+            return false;
+        }
+    }
+
+    if (manifest->generation > drawing->chunk_generation) {
+        drawing->chunk_generation = manifest->generation;
+    }
+    if (manifest->next_stroke_id > drawing->next_stroke_id) {
+        drawing->next_stroke_id = manifest->next_stroke_id;
+    }
+    return true;
+}
+
+/*
+ * Find a stroke given by a JOURNAL_HISTORY_STROKE record.
+ */
+static struct held_stroke *
+replay_find_held(struct drawing_layer *drawing,
+                 const struct journal_stroke_id *id) {
+    struct held_stroke *held;
+    wl_array_for_each(held, &drawing->replay_held) {
+        if (held->stroke->id == id->id &&
+            held->stroke->chunk->x == id->chunk_x &&
+            held->stroke->chunk->y == id->chunk_y) {
+            return held;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Rebuild an undoable operation from a checkpoint. The strokes it owns are
+ * held ones; the rest are held for a later operation, or on the canvas.
+ */
+static enum replay_result replay_history_op(struct drawing_layer *drawing,
+                                            const void *payload,
+                                            uint32_t length) {
+    const struct journal_history_op *record = payload;
+    if (length < sizeof(*record) ||
+        (length - sizeof(*record)) / sizeof(struct journal_stroke_id) <
+            (uint64_t)record->added_count + record->removed_count ||
+        record->added_count + record->removed_count == 0) {
+        return REPLAY_MALFORMED;
+    }
+    const struct journal_stroke_id *ids =
+        (const struct journal_stroke_id *)(record + 1);
+    uint32_t count = record->added_count + record->removed_count;
+
+    struct drawing_op *op = drawing_op_create();
+    if (!op) {
+        return REPLAY_MALFORMED;
+    }
+
+    /* An undone operation owns the strokes it added, otherwise the removed */
+    enum replay_result result = REPLAY_OK;
+    uint32_t found;
+    for (found = 0; found < count; found++) {
+        bool added = found < record->added_count;
+        bool owns = added == (record->undone != 0);
+        struct held_stroke *held = replay_find_held(drawing, &ids[found]);
+        struct drawing_stroke *stroke;
+        if (owns && (!held || held->owned)) {
+            result = REPLAY_MALFORMED;
+            break;
+        }
+        if (held) {
+            stroke = held->stroke;
+        } else {
+            result = replay_find(drawing, ids[found].chunk_x,
+                                 ids[found].chunk_y, ids[found].id, &stroke);
+            if (result != REPLAY_OK) {
+                break;
             }
-            prev_point = point;
+        }
+        if (!drawing_op_add(added ? &op->added : &op->removed, stroke)) {
+            result = REPLAY_MALFORMED;
+            break;
+        }
+        if (owns) {
+            held->owned = true;
         }
     }
 
-    /* Render the current stroke being drawn */
-    if (drawing->is_drawing && drawing->current_stroke) {
-        struct drawing_point *prev_point = NULL;
-        struct drawing_point *point;
-
-        wl_list_for_each(point, &drawing->current_stroke->points, link) {
-            if (prev_point) {
-                double screen_x1, screen_y1, screen_x2, screen_y2;
-                canvas_to_screen(canvas, prev_point->x, prev_point->y,
-                                 &screen_x1, &screen_y1);
-                canvas_to_screen(canvas, point->x, point->y, &screen_x2,
-                                 &screen_y2);
-
-                /* Convert to physical pixels */
-                screen_x1 *= output_scale;
-                screen_y1 *= output_scale;
-                screen_x2 *= output_scale;
-                screen_y2 *= output_scale;
-
-                double dx = screen_x2 - screen_x1;
-                double dy = screen_y2 - screen_y1;
-                double length = sqrt(dx * dx + dy * dy);
-
-                if (length > 0.1) {
-                    double scaled_width = DRAWING_LINE_WIDTH * combined_scale;
-
-                    int segments = (int)(length / 2.0) + 1;
-                    for (int i = 0; i <= segments; i++) {
-                        double t = segments > 0 ? (double)i / segments : 0;
-                        double x = screen_x1 + dx * t;
-                        double y = screen_y1 + dy * t;
-
-                        wlr_render_pass_add_rect(
-                            pass, &(struct wlr_render_rect_options){
-                                      .box =
-                                          {
-                                              .x = (int)(x - scaled_width / 2),
-                                              .y = (int)(y - scaled_width / 2),
-                                              .width = (int)scaled_width + 1,
-                                              .height = (int)scaled_width + 1,
-                                          },
-                                      .color =
-                                          {
-                                              .r = drawing->current_color.r,
-                                              .g = drawing->current_color.g,
-                                              .b = drawing->current_color.b,
-                                              .a = DRAWING_COLOR_A,
-                                          },
-                                  });
-                    }
-                }
+    if (result != REPLAY_OK) {
+        /* Leave the strokes as they were, for trying again or releasing */
+        for (uint32_t i = 0; i < found; i++) {
+            if ((i < record->added_count) == (record->undone != 0)) {
+                replay_find_held(drawing, &ids[i])->owned = false;
             }
-            prev_point = point;
         }
+        drawing_op_free(op);
+        return result;
     }
+
+    struct wl_list *stack =
+        record->undone ? &drawing->redo_stack : &drawing->undo_stack;
+    wl_list_insert(stack->prev, &op->link);
+    return REPLAY_OK;
 }
 
-/* Internal functions */
+/*
+ * Let go of the strokes given for the undo history, destroying those no
+ * operation took. Any left over mean the history is incomplete, so what
+ * there is of it is dropped.
+ */
+static void replay_release_held(struct drawing_layer *drawing) {
+    struct held_stroke *held;
+    bool complete = true;
+    wl_array_for_each(held, &drawing->replay_held) {
+        complete = complete && held->owned;
+    }
+    if (!complete && (!wl_list_empty(&drawing->undo_stack) ||
+                      !wl_list_empty(&drawing->redo_stack))) {
+        wlr_log(WLR_ERROR, "Incomplete undo history in the annotation "
+                "journal, dropping it");
+        drawing_drop_history(drawing);
+    }
 
-static struct drawing_stroke *drawing_stroke_create(void) {
-    struct drawing_stroke *stroke = calloc(1, sizeof(*stroke));
-    if (!stroke) {
-        return NULL;
+    wl_array_for_each(held, &drawing->replay_held) {
+        if (!held->owned) {
+            stroke_destroy(held->stroke);
+        }
+    }
+    drawing->replay_held.size = 0;
+}
+
+/*
+ * Apply one journal record. A record returning REPLAY_WAIT has changed
+ * nothing, and is applied again once more chunks have been paged in.
+ */
+static enum replay_result replay_record(struct drawing_layer *drawing,
+                                        uint32_t type, const void *payload,
+                                        uint32_t length) {
+    switch (type) {
+    case JOURNAL_STROKE_BEGIN:
+        if (length < sizeof(*drawing->replay_begin)) {
+            return REPLAY_MALFORMED;
+        }
+        drawing->replay_begin = payload;
+        break;
+
+    case JOURNAL_STROKE_POINTS:
+        if (!drawing->replay_begin || drawing->replay_stroke) {
+            return REPLAY_MALFORMED;
+        }
+        /* Use the mapped points in place */
+        drawing->replay_stroke = drawing_chunk_decode_stroke(
+            drawing, drawing->replay_begin, payload, length);
+        if (!drawing->replay_stroke) {
+            return REPLAY_MALFORMED;
+        }
+        break;
+
+    case JOURNAL_STROKE_END: {
+        struct drawing_stroke *stroke = drawing->replay_stroke;
+        if (!stroke) {
+            return REPLAY_MALFORMED;
+        }
+        /* New strokes are merged with the stored ones once they arrive */
+        stroke->chunk =
+            drawing_chunk_get(drawing, drawing->replay_begin->chunk_x,
+                              drawing->replay_begin->chunk_y);
+        if (!stroke->chunk) {
+            return REPLAY_MALFORMED;
+        }
+        drawing_commit_stroke(drawing, stroke);
+        if (stroke->id >= drawing->next_stroke_id) {
+            drawing->next_stroke_id = stroke->id + 1;
+        }
+        drawing->replay_begin = NULL;
+        drawing->replay_stroke = NULL;
+        break;
+    }
+
+    case JOURNAL_UNDO:
+        erase_finish(drawing);
+        undo_op(drawing);
+        break;
+
+    case JOURNAL_REDO:
+        redo_op(drawing);
+        break;
+
+    case JOURNAL_CLEAR:
+        drawing_clear(drawing);
+        replay_release_held(drawing);
+        break;
+
+    case JOURNAL_ERASE_BEGIN:
+        if (drawing->is_erasing) {
+            return REPLAY_MALFORMED;
+        }
+        erase_start(drawing);
+        break;
+
+    case JOURNAL_ERASE_REMOVE: {
+        const struct journal_stroke_id *record = payload;
+        if (!drawing->is_erasing || length < sizeof(*record)) {
+            return REPLAY_MALFORMED;
+        }
+        struct drawing_stroke *target;
+        enum replay_result result = replay_find(
+            drawing, record->chunk_x, record->chunk_y, record->id, &target);
+        if (result != REPLAY_OK) {
+            return result;
+        }
+        erase_remove_stroke(drawing, target);
+        break;
+    }
+
+    case JOURNAL_ERASE_SPLIT: {
+        const struct journal_erase_split *record = payload;
+        if (!drawing->is_erasing || length < sizeof(*record) ||
+            (length - sizeof(*record)) / sizeof(struct journal_fragment) <
+                record->fragment_count) {
+            return REPLAY_MALFORMED;
+        }
+        struct drawing_stroke *parent;
+        enum replay_result result =
+            replay_find(drawing, record->chunk_x, record->chunk_y,
+                        record->parent_id, &parent);
+        if (result != REPLAY_OK) {
+            return result;
+        }
+
+        const struct journal_fragment *fragments =
+            (const struct journal_fragment *)(record + 1);
+        for (uint32_t i = 0; i < record->fragment_count; i++) {
+            if (fragments[i].point_count < 2 ||
+                fragments[i].first_point > parent->point_count ||
+                parent->point_count - fragments[i].first_point <
+                    fragments[i].point_count) {
+                return REPLAY_MALFORMED;
+            }
+            if (fragments[i].id >= drawing->next_stroke_id) {
+                drawing->next_stroke_id = fragments[i].id + 1;
+            }
+        }
+
+        if (!erase_apply_split(drawing, parent, fragments,
+                               record->fragment_count)) {
+            return REPLAY_MALFORMED;
+        }
+        break;
+    }
+
+    case JOURNAL_ERASE_END:
+        erase_finish(drawing);
+        break;
+
+    case JOURNAL_CHECKPOINT:
+        /* The history follows, if the checkpoint kept any */
+        drawing_drop_history(drawing);
+        replay_release_held(drawing);
+        drawing->replay_history_lost = false;
+        break;
+
+    case JOURNAL_HISTORY_STROKE: {
+        struct drawing_stroke *stroke = drawing->replay_stroke;
+        if (!stroke) {
+            return REPLAY_MALFORMED;
+        }
+        if (drawing->replay_history_lost) {
+            stroke_destroy(stroke);
+            drawing->replay_begin = NULL;
+            drawing->replay_stroke = NULL;
+            break;
+        }
+        stroke->chunk =
+            drawing_chunk_get(drawing, drawing->replay_begin->chunk_x,
+                              drawing->replay_begin->chunk_y);
+        struct held_stroke *held =
+            wl_array_add(&drawing->replay_held, sizeof(*held));
+        if (!stroke->chunk || !held) {
+            return REPLAY_MALFORMED;
+        }
+        drawing->replay_begin = NULL;
+        drawing->replay_stroke = NULL;
+        *held = (struct held_stroke){.stroke = stroke};
+        if (stroke->id >= drawing->next_stroke_id) {
+            drawing->next_stroke_id = stroke->id + 1;
+        }
+        break;
+    }
+
+    case JOURNAL_HISTORY_OP: {
+        if (drawing->replay_history_lost) {
+            break;
+        }
+        enum replay_result result =
+            replay_history_op(drawing, payload, length);
+        if (result != REPLAY_MALFORMED) {
+            return result;
+        }
+        /* The canvas is right without it, so carry on with the rest */
+        wlr_log(WLR_ERROR, "Undo history in the annotation journal doesn't "
+                "match the canvas, dropping it");
+        drawing_drop_history(drawing);
+        replay_release_held(drawing);
+        drawing->replay_history_lost = true;
+        drawing->journal_dirty = true;
+        break;
+    }
+
+    case JOURNAL_MANIFEST:
+        if (!replay_manifest(drawing, payload, length)) {
+            return REPLAY_MALFORMED;
+        }
+        break;
+
+    default:
+        /* Unknown records are from a newer version; skip them */
+        break;
     }
 
-    wl_list_init(&stroke->points);
-    wl_list_init(&stroke->link);
+    return REPLAY_OK;
+}
+
+static int compare_chunk_position(const void *a, const void *b) {
+    const struct journal_chunk *chunk_a = a;
+    const struct journal_chunk *chunk_b = b;
+    if (chunk_a->x != chunk_b->x) {
+        return chunk_a->x < chunk_b->x ? -1 : 1;
+    }
+    return (chunk_a->y > chunk_b->y) - (chunk_a->y < chunk_b->y);
+}
 
-    return stroke;
+static void checkpoint_free(struct checkpoint *checkpoint) {
+    wl_array_release(&checkpoint->files);
+    wl_array_release(&checkpoint->data);
+    wl_array_release(&checkpoint->kept);
+    free(checkpoint);
 }
 
-static void drawing_stroke_destroy(struct drawing_stroke *stroke) {
-    if (!stroke) {
+/*
+ * Write the changed chunks' files (a journal_rewrite prepare callback, on
+ * the writer thread). They aren't current until the new journal is in
+ * place, so a failure loses nothing.
+ */
+static bool checkpoint_prepare(void *data) {
+    struct checkpoint *checkpoint = data;
+    struct checkpoint_file *file;
+    wl_array_for_each(file, &checkpoint->files) {
+        if (file->generation != 0 &&
+            !chunk_store_write(checkpoint->store, file->x, file->y,
+                               file->generation,
+                               (char *)checkpoint->data.data + file->offset,
+                               file->size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool keep_chunk_file(int32_t x, int32_t y, uint64_t generation,
+                            void *data) {
+    struct checkpoint *checkpoint = data;
+    struct journal_chunk key = {.x = x, .y = y};
+    const struct journal_chunk *entry =
+        bsearch(&key, checkpoint->kept.data,
+                checkpoint->kept.size / sizeof(key), sizeof(key),
+                compare_chunk_position);
+    return entry && entry->generation == generation;
+}
+
+/*
+ * Delete the chunk files the new journal no longer refers to (a
+ * journal_rewrite commit callback, on the writer thread).
+ */
+static void checkpoint_commit(void *data) {
+    struct checkpoint *checkpoint = data;
+    if (checkpoint->collect) {
+        chunk_store_collect(checkpoint->store, keep_chunk_file, checkpoint);
+    }
+}
+
+/*
+ * Adopt the files a checkpoint wrote, or mark their chunks changed again
+ * if it failed (a journal_rewrite done callback).
+ */
+static void checkpoint_done(bool ok, void *data) {
+    struct checkpoint *checkpoint = data;
+    struct drawing_layer *drawing = checkpoint->drawing;
+    drawing->checkpointing = false;
+
+    struct checkpoint_file *file;
+    wl_array_for_each(file, &checkpoint->files) {
+        /* A chunk cleared since has nothing to do with this file */
+        struct drawing_chunk *chunk =
+            drawing_chunk_find(drawing, file->x, file->y);
+        if (!chunk || !chunk->saving) {
+            continue;
+        }
+        chunk->saving = false;
+        if (!ok) {
+            chunk->dirty = true;
+            continue;
+        }
+
+        /* Forget chunks left empty, unless they have changed since */
+        chunk->generation = file->generation;
+        if (chunk->generation == 0 && !chunk->dirty &&
+            chunk->history_refs == 0 && wl_list_empty(&chunk->strokes)) {
+            drawing_chunk_destroy(drawing, chunk);
+        }
+    }
+
+    if (ok) {
+        drawing->journal_damaged = false;
+        wlr_log(WLR_INFO, "Saved annotations in %zu chunks",
+                checkpoint->kept.size / sizeof(struct journal_chunk));
+    } else {
+        drawing->journal_dirty = true;
+    }
+    drawing->checkpoint_at =
+        journal_size(drawing->journal) + DRAWING_CHECKPOINT_BYTES;
+    checkpoint_free(checkpoint);
+}
+
+/*
+ * Append an undoable operation to a checkpoint, referring to its strokes.
+ */
+static bool encode_history_op(struct drawing_op *op, bool undone,
+                              struct wl_array *out) {
+    struct journal_history_op record = {
+        .added_count = op->added.size / sizeof(struct drawing_stroke *),
+        .removed_count = op->removed.size / sizeof(struct drawing_stroke *),
+        .undone = undone,
+    };
+
+    struct wl_array ids;
+    wl_array_init(&ids);
+    struct wl_array *lists[] = {&op->added, &op->removed};
+    for (size_t i = 0; i < 2; i++) {
+        struct drawing_stroke **stroke;
+        wl_array_for_each(stroke, lists[i]) {
+            struct journal_stroke_id *id = wl_array_add(&ids, sizeof(*id));
+            if (!id) {
+                wl_array_release(&ids);
+                return false;
+            }
+            *id = (struct journal_stroke_id){
+                .id = (*stroke)->id,
+                .chunk_x = (*stroke)->chunk->x,
+                .chunk_y = (*stroke)->chunk->y,
+            };
+        }
+    }
+
+    bool ok = journal_encode(out, JOURNAL_HISTORY_OP, &record, sizeof(record),
+                             ids.data, ids.size);
+    wl_array_release(&ids);
+    return ok;
+}
+
+/*
+ * Append the undo and redo history to a checkpoint: the strokes only the
+ * history holds, then the operations, oldest first on each stack.
+ */
+static bool encode_history(struct drawing_layer *drawing,
+                           struct wl_array *out) {
+    struct drawing_op *op;
+    struct drawing_stroke **stroke;
+    wl_list_for_each(op, &drawing->undo_stack, link) {
+        wl_array_for_each(stroke, &op->removed) {
+            if (!drawing_chunk_encode_stroke(drawing, *stroke,
+                                             JOURNAL_HISTORY_STROKE, out)) {
+                return false;
+            }
+        }
+    }
+    wl_list_for_each(op, &drawing->redo_stack, link) {
+        wl_array_for_each(stroke, &op->added) {
+            if (!drawing_chunk_encode_stroke(drawing, *stroke,
+                                             JOURNAL_HISTORY_STROKE, out)) {
+                return false;
+            }
+        }
+    }
+
+    wl_list_for_each(op, &drawing->undo_stack, link) {
+        if (!encode_history_op(op, false, out)) {
+            return false;
+        }
+    }
+    wl_list_for_each(op, &drawing->redo_stack, link) {
+        if (!encode_history_op(op, true, out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Start writing every changed chunk to a new file and replacing the
+ * journal with a manifest of the chunk files and the undo history. Both
+ * are written on the journal's writer thread from a snapshot taken here;
+ * until the journal is replaced the old files stay current, so a failure
+ * at any point loses nothing.
+ * A changed chunk that isn't resident only has the strokes added since it
+ * was paged out in memory. Those stay in the journal, after the manifest,
+ * until the chunk has been read and can be written whole.
+ */
+static void drawing_checkpoint(struct drawing_layer *drawing) {
+    if (!drawing->journal || !drawing->chunk_store ||
+        drawing->checkpointing) {
+        return;
+    }
+
+    struct checkpoint *checkpoint = calloc(1, sizeof(*checkpoint));
+    if (!checkpoint) {
         return;
     }
+    checkpoint->drawing = drawing;
+    checkpoint->store = drawing->chunk_store;
+    checkpoint->generation = ++drawing->chunk_generation;
+    /* Leave the files a damaged journal refers to for this once */
+    checkpoint->collect = !drawing->journal_damaged;
+    wl_array_init(&checkpoint->files);
+    wl_array_init(&checkpoint->data);
+    wl_array_init(&checkpoint->kept);
+
+    struct journal_rewrite rewrite = {
+        .prepare = checkpoint_prepare,
+        .commit = checkpoint_commit,
+        .done = checkpoint_done,
+        .data = checkpoint,
+        .keep_suffix = drawing->journal_damaged ? ".damaged" : NULL,
+    };
+    wl_array_init(&rewrite.records);
+    struct wl_array pending;
+    wl_array_init(&pending);
+
+    struct drawing_chunk *chunk, *tmp;
+    wl_list_for_each_safe(chunk, tmp, &drawing->chunks, link) {
+        struct journal_chunk entry = {
+            .x = chunk->x,
+            .y = chunk->y,
+            .generation = chunk->generation,
+        };
+
+        if (!chunk->dirty) {
+            /* Forget chunks that were looked up but never had strokes */
+            if (chunk->generation == 0 && chunk->history_refs == 0 &&
+                wl_list_empty(&chunk->strokes)) {
+                drawing_chunk_destroy(drawing, chunk);
+                continue;
+            }
+        } else if (chunk->state != DRAWING_CHUNK_RESIDENT) {
+            if (!drawing_chunk_encode(drawing, chunk, &pending)) {
+                goto fail;
+            }
+        } else {
+            drawing_chunk_compute_bounds(chunk);
+            struct checkpoint_file *file =
+                wl_array_add(&checkpoint->files, sizeof(*file));
+            if (!file) {
+                goto fail;
+            }
+            *file = (struct checkpoint_file){
+                .x = chunk->x,
+                .y = chunk->y,
+                .offset = checkpoint->data.size,
+            };
+            if (!wl_list_empty(&chunk->strokes)) {
+                if (!drawing_chunk_encode(drawing, chunk, &checkpoint->data)) {
+                    goto fail;
+                }
+                file->generation = checkpoint->generation;
+            }
+            file->size = checkpoint->data.size - file->offset;
+            entry.generation = file->generation;
+        }
 
-    /* Free all points in the stroke */
-    struct drawing_point *point, *tmp;
-    wl_list_for_each_safe(point, tmp, &stroke->points, link) {
-        drawing_point_destroy(point);
+        if (entry.generation != 0) {
+            double corner_x, corner_y;
+            drawing_chunk_corner(drawing, chunk->x, chunk->y, &corner_x,
+                                 &corner_y);
+            entry.min_x = chunk->min_x - corner_x;
+            entry.min_y = chunk->min_y - corner_y;
+            entry.max_x = chunk->max_x - corner_x;
+            entry.max_y = chunk->max_y - corner_y;
+            struct journal_chunk *slot =
+                wl_array_add(&checkpoint->kept, sizeof(*slot));
+            if (!slot) {
+                goto fail;
+            }
+            *slot = entry;
+        }
     }
 
-    wl_list_remove(&stroke->link);
-    free(stroke);
+    /* Replacing the journal is what commits the new files */
+    struct journal_manifest manifest = {
+        .generation = checkpoint->generation,
+        .next_stroke_id = drawing->next_stroke_id,
+        .chunk_count = checkpoint->kept.size / sizeof(struct journal_chunk),
+    };
+    if (!journal_encode(&rewrite.records, JOURNAL_MANIFEST, &manifest,
+                        sizeof(manifest), checkpoint->kept.data,
+                        checkpoint->kept.size)) {
+        goto fail;
+    }
+    if (pending.size > 0) {
+        void *records = wl_array_add(&rewrite.records, pending.size);
+        if (!records) {
+            goto fail;
+        }
+        memcpy(records, pending.data, pending.size);
+    }
+    if (!journal_encode(&rewrite.records, JOURNAL_CHECKPOINT, NULL, 0, NULL,
+                        0) ||
+        !encode_history(drawing, &rewrite.records)) {
+        goto fail;
+    }
+    qsort(checkpoint->kept.data,
+          checkpoint->kept.size / sizeof(struct journal_chunk),
+          sizeof(struct journal_chunk), compare_chunk_position);
+
+    /* Changes from here on are in the journal after the checkpoint */
+    struct checkpoint_file *file;
+    wl_array_for_each(file, &checkpoint->files) {
+        chunk = drawing_chunk_find(drawing, file->x, file->y);
+        chunk->saving = true;
+        chunk->dirty = false;
+    }
+    drawing->journal_dirty = false;
+    drawing->checkpointing = true;
+    journal_rewrite(drawing->journal, &rewrite);
+    wl_array_release(&pending);
+    return;
+
+fail:
+    wlr_log(WLR_ERROR, "Failed to encode annotations for a checkpoint");
+    wl_array_release(&pending);
+    wl_array_release(&rewrite.records);
+    checkpoint_free(checkpoint);
 }
 
-static struct drawing_point *drawing_point_create(double x, double y) {
-    struct drawing_point *point = calloc(1, sizeof(*point));
-    if (!point) {
-        return NULL;
+static void handle_checkpoint_idle(void *data) {
+    struct drawing_layer *drawing = data;
+    drawing->checkpoint_idle = NULL;
+
+    /* Finish what's in progress first; its end will try again */
+    if (drawing->is_drawing || drawing->is_erasing) {
+        return;
     }
 
-    point->x = x;
-    point->y = y;
-    wl_list_init(&point->link);
+    /* Don't retry on every stroke if this fails */
+    size_t size = journal_size(drawing->journal);
+    drawing->checkpoint_at = size + DRAWING_CHECKPOINT_BYTES;
 
-    return point;
+    wlr_log(WLR_INFO, "Annotation journal has grown to %zu KiB, saving a "
+            "checkpoint", size / 1024);
+    drawing_checkpoint(drawing);
 }
 
-static void drawing_point_destroy(struct drawing_point *point) {
-    if (!point) {
+/*
+ * Keep a long session's journal, and the replay after a crash, bounded by
+ * checkpointing once the journal has grown past a limit. This runs from an
+ * idle callback, after the change that was just journaled has been
+ * handled.
+ */
+static void drawing_maybe_checkpoint(struct drawing_layer *drawing) {
+    if (drawing->checkpoint_idle || drawing->checkpointing ||
+        journal_size(drawing->journal) < drawing->checkpoint_at) {
         return;
     }
+    drawing->checkpoint_idle = wl_event_loop_add_idle(
+        drawing->server->event_loop, handle_checkpoint_idle, drawing);
+}
+
+/*
+ * Open the annotation journal and chunk files, and start replaying the
+ * journal onto the canvas. Chunks it doesn't touch are paged in as they
+ * come into view.
+ * Returns false if the journal is from an incompatible version, in which
+ * case carrying on would mean dropping its annotations.
+ */
+static bool drawing_load(struct drawing_layer *drawing) {
+    char *path = journal_default_path();
+    if (!path) {
+        return true;
+    }
+    bool incompatible;
+    drawing->journal =
+        journal_open(path, drawing->server->event_loop, &incompatible);
+    free(path);
+    if (incompatible) {
+        return false;
+    }
+    if (!drawing->journal) {
+        wlr_log(WLR_ERROR, "Annotations will not be saved");
+        return true;
+    }
+
+    path = journal_data_path("chunks");
+    if (path) {
+        drawing->chunk_store =
+            chunk_store_create(path, drawing->server->event_loop,
+                               handle_chunk_load, drawing);
+        free(path);
+    }
+    if (!drawing->chunk_store) {
+        wlr_log(WLR_ERROR, "Annotations will be kept in memory");
+    }
+
+    journal_reader_init(drawing->journal, &drawing->replay_reader);
+    drawing->replaying = true;
+    replay_continue(drawing);
+    return true;
+}
 
-    wl_list_remove(&point->link);
-    free(point);
+/*
+ * Apply journal records until one needs a chunk that is still being paged
+ * in, or until the end of the journal.
+ */
+static void replay_continue(struct drawing_layer *drawing) {
+    uint32_t type, length;
+    const void *payload;
+    struct journal_reader next = drawing->replay_reader;
+    while (journal_reader_next(&next, &type, &payload, &length)) {
+        enum replay_result result =
+            replay_record(drawing, type, payload, length);
+        if (result == REPLAY_WAIT) {
+            return;
+        }
+        if (result == REPLAY_MALFORMED) {
+            wlr_log(WLR_ERROR, "Malformed annotation journal record %u, "
+                    "ignoring the rest", type);
+            drawing->journal_damaged = true;
+            drawing->journal_dirty = true;
+            break;
+        }
+        if (type != JOURNAL_MANIFEST && type != JOURNAL_CHECKPOINT &&
+            type != JOURNAL_STROKE_BEGIN && type != JOURNAL_STROKE_POINTS &&
+            type != JOURNAL_HISTORY_STROKE && type != JOURNAL_HISTORY_OP) {
+            drawing->journal_dirty = true;
+        }
+        drawing->replay_reader = next;
+    }
+
+    /* Tidy up after a journal cut short mid-stroke or mid-erase */
+    if (drawing->replay_begin) {
+        drawing->journal_dirty = true;
+    }
+    stroke_destroy(drawing->replay_stroke);
+    drawing->replay_stroke = NULL;
+    drawing->replay_begin = NULL;
+    erase_finish(drawing);
+    replay_release_held(drawing);
+    drawing->replaying = false;
+
+    /*
+     * Fold the last session's changes into the chunk files. A damaged
+     * journal is kept aside rather than replaced, as the records after the
+     * bad one are lost otherwise.
+     */
+    drawing->checkpoint_at =
+        journal_size(drawing->journal) + DRAWING_CHECKPOINT_BYTES;
+    if (drawing->journal_dirty) {
+        drawing_checkpoint(drawing);
+    }
+
+    wlr_log(WLR_INFO, "Restored %u annotation chunks", drawing->chunk_count);
+}
+
+/*
+ * Deliver a chunk read on the loader thread (a chunk_store_load_func_t),
+ * carrying on with the replay if it was waiting for one.
+ */
+static void handle_chunk_load(int32_t x, int32_t y, uint64_t generation,
+                              void *records, size_t size, void *data) {
+    struct drawing_layer *drawing = data;
+    drawing_chunk_handle_load(x, y, generation, records, size, drawing);
+    if (drawing->replaying) {
+        replay_continue(drawing);
+    }
 }
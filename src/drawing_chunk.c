@@ -0,0 +1,649 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * drawing_chunk.c - Paging of canvas chunks in and out of memory
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <wlr/util/log.h>
+
+#include "infinidesk/canvas.h"
+#include "infinidesk/chunk_store.h"
+#include "infinidesk/drawing.h"
+#include "infinidesk/drawing_chunk.h"
+#include "infinidesk/server.h"
+
+/* Size of a chunk in canvas coords */
+#define DRAWING_CHUNK_SIZE 2048
+/* Margin paged in around a viewport, as a fraction of its size */
+#define DRAWING_PREFETCH_MARGIN 0.5
+/* How far ahead of a moving viewport to page in, in seconds of motion */
+#define DRAWING_PREFETCH_TIME 0.5
+/* A viewport still for this long is no longer moving (ms) */
+#define DRAWING_PAGE_IDLE_MS 100
+/* Chunks wanted this recently are never evicted (ms) */
+#define DRAWING_CHUNK_KEEP_MS 2000
+/* Time spent building levels of detail per slice, and the gap between */
+#define DRAWING_LOD_SLICE_NS 2000000
+#define DRAWING_LOD_GAP_MS 1
+/* Initial number of chunk table slots (must be a power of two) */
+#define DRAWING_CHUNK_TABLE_CAPACITY 64
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t now_ms(void) {
+    return now_ns() / 1000000;
+}
+
+_Static_assert(CANVAS_REBASE_STEP % DRAWING_CHUNK_SIZE == 0,
+               "rebasing the canvas must keep chunks aligned");
+
+/*
+ * Get the absolute chunk coordinate of a canvas coordinate, given the
+ * absolute position of the canvas origin. The origin is a whole number of
+ * chunks, so it is added separately to keep the result exact.
+ */
+static int32_t chunk_coord(double v, int64_t origin) {
+    double c = floor(v / DRAWING_CHUNK_SIZE) +
+               (double)(origin / DRAWING_CHUNK_SIZE);
+    if (c < INT32_MIN) {
+        return INT32_MIN;
+    }
+    if (c > INT32_MAX) {
+        return INT32_MAX;
+    }
+    return (int32_t)c;
+}
+
+void drawing_chunk_key(struct drawing_layer *drawing, double canvas_x,
+                       double canvas_y, int32_t *x, int32_t *y) {
+    struct infinidesk_canvas *canvas = &drawing->server->canvas;
+    *x = chunk_coord(canvas_x, canvas->origin_x);
+    *y = chunk_coord(canvas_y, canvas->origin_y);
+}
+
+void drawing_chunk_corner(struct drawing_layer *drawing, int32_t x,
+                          int32_t y, double *canvas_x, double *canvas_y) {
+    struct infinidesk_canvas *canvas = &drawing->server->canvas;
+    *canvas_x = (double)((int64_t)x * DRAWING_CHUNK_SIZE - canvas->origin_x);
+    *canvas_y = (double)((int64_t)y * DRAWING_CHUNK_SIZE - canvas->origin_y);
+}
+
+/*
+ * Memory a resident stroke costs: the stroke itself, its points and its
+ * spatial index entries.
+ */
+static size_t stroke_memory(const struct drawing_stroke *stroke) {
+    return sizeof(*stroke) + stroke_point_bytes(stroke) +
+           stroke->point_count * sizeof(struct stroke_index_entry);
+}
+
+static uint32_t chunk_hash(int32_t x, int32_t y) {
+    uint32_t h = (uint32_t)x * 0x9e3779b1u ^ (uint32_t)y * 0x85ebca77u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+/*
+ * Find the slot for chunk (x, y) in the chunk table: either the chunk
+ * itself or the empty slot where it would be inserted.
+ */
+static struct drawing_chunk **find_slot(struct drawing_chunk **table,
+                                        uint32_t capacity, int32_t x,
+                                        int32_t y) {
+    uint32_t mask = capacity - 1;
+    uint32_t i = chunk_hash(x, y) & mask;
+    while (table[i] && (table[i]->x != x || table[i]->y != y)) {
+        i = (i + 1) & mask;
+    }
+    return &table[i];
+}
+
+static bool grow_table(struct drawing_layer *drawing) {
+    uint32_t new_capacity = drawing->chunk_capacity
+                                ? drawing->chunk_capacity * 2
+                                : DRAWING_CHUNK_TABLE_CAPACITY;
+    struct drawing_chunk **new_table =
+        calloc(new_capacity, sizeof(*new_table));
+    if (!new_table) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < drawing->chunk_capacity; i++) {
+        struct drawing_chunk *chunk = drawing->chunk_table[i];
+        if (chunk) {
+            *find_slot(new_table, new_capacity, chunk->x, chunk->y) = chunk;
+        }
+    }
+
+    free(drawing->chunk_table);
+    drawing->chunk_table = new_table;
+    drawing->chunk_capacity = new_capacity;
+    return true;
+}
+
+/*
+ * Take a chunk out of the chunk table, shifting later chunks of its probe
+ * sequence back so lookups still find them without tombstones.
+ */
+static void table_remove(struct drawing_layer *drawing,
+                         struct drawing_chunk *chunk) {
+    uint32_t mask = drawing->chunk_capacity - 1;
+    struct drawing_chunk **table = drawing->chunk_table;
+    uint32_t hole = (uint32_t)(find_slot(table, drawing->chunk_capacity,
+                                         chunk->x, chunk->y) -
+                               table);
+
+    for (uint32_t i = (hole + 1) & mask; table[i]; i = (i + 1) & mask) {
+        uint32_t home = chunk_hash(table[i]->x, table[i]->y) & mask;
+        /* It may only move back if the hole is between home and here */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table[hole] = table[i];
+            hole = i;
+        }
+    }
+
+    table[hole] = NULL;
+    drawing->chunk_count--;
+}
+
+static struct drawing_chunk *chunk_create(struct drawing_layer *drawing,
+                                          int32_t x, int32_t y) {
+    /* Keep the load factor under 70% so probe sequences stay short */
+    if ((uint64_t)(drawing->chunk_count + 1) * 10 >
+            (uint64_t)drawing->chunk_capacity * 7 &&
+        !grow_table(drawing)) {
+        return NULL;
+    }
+
+    struct drawing_chunk *chunk = calloc(1, sizeof(*chunk));
+    if (!chunk) {
+        return NULL;
+    }
+
+    chunk->x = x;
+    chunk->y = y;
+    chunk->min_x = chunk->min_y = INFINITY;
+    chunk->max_x = chunk->max_y = -INFINITY;
+    wl_list_init(&chunk->strokes);
+    wl_list_insert(&drawing->chunks, &chunk->link);
+    *find_slot(drawing->chunk_table, drawing->chunk_capacity, x, y) = chunk;
+    drawing->chunk_count++;
+    return chunk;
+}
+
+struct drawing_chunk *drawing_chunk_find(struct drawing_layer *drawing,
+                                         int32_t x, int32_t y) {
+    if (drawing->chunk_count == 0) {
+        return NULL;
+    }
+    return *find_slot(drawing->chunk_table, drawing->chunk_capacity, x, y);
+}
+
+static void chunk_request(struct drawing_layer *drawing,
+                          struct drawing_chunk *chunk) {
+    if (drawing->chunk_store &&
+        chunk_store_request(drawing->chunk_store, chunk->x, chunk->y,
+                            chunk->generation)) {
+        chunk->state = DRAWING_CHUNK_LOADING;
+    }
+}
+
+struct drawing_chunk *drawing_chunk_get(struct drawing_layer *drawing,
+                                        int32_t x, int32_t y) {
+    struct drawing_chunk *chunk = drawing_chunk_find(drawing, x, y);
+    if (!chunk) {
+        chunk = chunk_create(drawing, x, y);
+        if (chunk) {
+            chunk->state = DRAWING_CHUNK_RESIDENT;
+        }
+        return chunk;
+    }
+
+    /* New strokes are merged with the stored ones once they arrive */
+    if (chunk->state == DRAWING_CHUNK_UNLOADED) {
+        chunk_request(drawing, chunk);
+    }
+    chunk->last_wanted = now_ms();
+    return chunk;
+}
+
+struct drawing_chunk *
+drawing_chunk_add_stored(struct drawing_layer *drawing,
+                         const struct journal_chunk *stored) {
+    struct drawing_chunk *chunk =
+        drawing_chunk_find(drawing, stored->x, stored->y);
+    if (!chunk) {
+        chunk = chunk_create(drawing, stored->x, stored->y);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->state = DRAWING_CHUNK_UNLOADED;
+    }
+
+    double corner_x, corner_y;
+    drawing_chunk_corner(drawing, chunk->x, chunk->y, &corner_x, &corner_y);
+    chunk->generation = stored->generation;
+    chunk->min_x = corner_x + stored->min_x;
+    chunk->min_y = corner_y + stored->min_y;
+    chunk->max_x = corner_x + stored->max_x;
+    chunk->max_y = corner_y + stored->max_y;
+    return chunk;
+}
+
+void drawing_chunk_attach(struct drawing_layer *drawing,
+                          struct drawing_stroke *stroke) {
+    struct drawing_chunk *chunk = stroke->chunk;
+    wl_list_insert(chunk->strokes.prev, &stroke->link);
+    if (!stroke_index_insert(&drawing->index, stroke)) {
+        wlr_log(WLR_ERROR, "Failed to index stroke");
+    }
+
+    chunk->min_x = fmin(chunk->min_x, stroke->origin_x + stroke->min_x);
+    chunk->min_y = fmin(chunk->min_y, stroke->origin_y + stroke->min_y);
+    chunk->max_x = fmax(chunk->max_x, stroke->origin_x + stroke->max_x);
+    chunk->max_y = fmax(chunk->max_y, stroke->origin_y + stroke->max_y);
+
+    size_t memory = stroke_memory(stroke);
+    chunk->memory += memory;
+    drawing->resident_memory += memory;
+
+    if (!stroke->lods_built && !chunk->lods_pending) {
+        chunk->lods_pending = true;
+        if (drawing->lod_timer) {
+            wl_event_source_timer_update(drawing->lod_timer,
+                                         DRAWING_LOD_GAP_MS);
+        }
+    }
+}
+
+void drawing_chunk_detach(struct drawing_layer *drawing,
+                          struct drawing_stroke *stroke) {
+    stroke_index_remove(&drawing->index, stroke);
+    wl_list_remove(&stroke->link);
+    wl_list_init(&stroke->link);
+
+    size_t memory = stroke_memory(stroke);
+    stroke->chunk->memory -= memory;
+    drawing->resident_memory -= memory;
+}
+
+void drawing_chunk_compute_bounds(struct drawing_chunk *chunk) {
+    chunk->min_x = chunk->min_y = INFINITY;
+    chunk->max_x = chunk->max_y = -INFINITY;
+
+    struct drawing_stroke *stroke;
+    wl_list_for_each(stroke, &chunk->strokes, link) {
+        chunk->min_x = fmin(chunk->min_x, stroke->origin_x + stroke->min_x);
+        chunk->min_y = fmin(chunk->min_y, stroke->origin_y + stroke->min_y);
+        chunk->max_x = fmax(chunk->max_x, stroke->origin_x + stroke->max_x);
+        chunk->max_y = fmax(chunk->max_y, stroke->origin_y + stroke->max_y);
+    }
+}
+
+/*
+ * Drop a chunk's strokes and file contents, leaving it on disk only.
+ */
+static void chunk_unload(struct drawing_layer *drawing,
+                         struct drawing_chunk *chunk) {
+    struct drawing_stroke *stroke, *tmp;
+    wl_list_for_each_safe(stroke, tmp, &chunk->strokes, link) {
+        stroke_index_remove(&drawing->index, stroke);
+        wl_list_remove(&stroke->link);
+        stroke_destroy(stroke);
+    }
+
+    /* Strokes point into the records, so they go last */
+    free(chunk->records);
+    chunk->records = NULL;
+
+    drawing->resident_memory -= chunk->memory;
+    chunk->memory = 0;
+    chunk->state = DRAWING_CHUNK_UNLOADED;
+    chunk->lods_pending = false;
+}
+
+int drawing_chunk_handle_lod_timer(void *data) {
+    struct drawing_layer *drawing = data;
+    uint64_t deadline = now_ns() + DRAWING_LOD_SLICE_NS;
+
+    struct drawing_chunk *chunk;
+    wl_list_for_each(chunk, &drawing->chunks, link) {
+        if (!chunk->lods_pending) {
+            continue;
+        }
+        struct drawing_stroke *stroke;
+        wl_list_for_each(stroke, &chunk->strokes, link) {
+            if (stroke->lods_built) {
+                continue;
+            }
+            /* Leave the rest for the next slice, so frames aren't held up */
+            if (now_ns() >= deadline) {
+                wl_event_source_timer_update(drawing->lod_timer,
+                                             DRAWING_LOD_GAP_MS);
+                return 0;
+            }
+            /* Without levels, the stroke simply renders at full detail */
+            stroke->lods_built = true;
+            if (stroke->tolerance > 0.0f) {
+                stroke_build_lods(stroke, stroke->tolerance);
+            }
+        }
+        chunk->lods_pending = false;
+    }
+    return 0;
+}
+
+void drawing_chunk_destroy(struct drawing_layer *drawing,
+                           struct drawing_chunk *chunk) {
+    chunk_unload(drawing, chunk);
+    table_remove(drawing, chunk);
+    wl_list_remove(&chunk->link);
+    free(chunk);
+}
+
+void drawing_chunk_encode_begin(struct drawing_layer *drawing,
+                                const struct drawing_stroke *stroke,
+                                struct journal_stroke_begin *begin) {
+    double corner_x, corner_y;
+    drawing_chunk_corner(drawing, stroke->chunk->x, stroke->chunk->y,
+                         &corner_x, &corner_y);
+    *begin = (struct journal_stroke_begin){
+        .id = stroke->id,
+        .z = stroke->z,
+        .chunk_x = stroke->chunk->x,
+        .chunk_y = stroke->chunk->y,
+        .origin_x = stroke->origin_x - corner_x,
+        .origin_y = stroke->origin_y - corner_y,
+        .r = stroke->color.r,
+        .g = stroke->color.g,
+        .b = stroke->color.b,
+        .tolerance = stroke->tolerance,
+        .min_x = stroke->min_x,
+        .min_y = stroke->min_y,
+        .max_x = stroke->max_x,
+        .max_y = stroke->max_y,
+        .flags = stroke->smooth ? JOURNAL_STROKE_SMOOTH : 0,
+    };
+}
+
+bool drawing_chunk_encode_stroke(struct drawing_layer *drawing,
+                                 const struct drawing_stroke *stroke,
+                                 uint32_t end, struct wl_array *out) {
+    struct journal_stroke_begin begin;
+    drawing_chunk_encode_begin(drawing, stroke, &begin);
+
+    /* Strokes are packed when finished, so this is normally a copy */
+    struct wl_array block;
+    wl_array_init(&block);
+    float quantum = stroke->packed.quantum;
+    if (!stroke_export_points(stroke, &block, &quantum)) {
+        wl_array_release(&block);
+        return false;
+    }
+    struct journal_stroke_points points = {
+        .id = stroke->id,
+        .point_count = stroke->point_count,
+        .quantum = quantum,
+        .data_size = block.size,
+    };
+    struct journal_stroke_id id = {
+        .id = stroke->id,
+        .chunk_x = stroke->chunk->x,
+        .chunk_y = stroke->chunk->y,
+    };
+
+    bool ok = journal_encode(out, JOURNAL_STROKE_BEGIN, &begin,
+                             sizeof(begin), NULL, 0) &&
+              journal_encode(out, JOURNAL_STROKE_POINTS, &points,
+                             sizeof(points), block.data, block.size) &&
+              journal_encode(out, end, &id, sizeof(id), NULL, 0);
+    wl_array_release(&block);
+    return ok;
+}
+
+bool drawing_chunk_encode(struct drawing_layer *drawing,
+                          struct drawing_chunk *chunk, struct wl_array *out) {
+    struct drawing_stroke *stroke;
+    wl_list_for_each(stroke, &chunk->strokes, link) {
+        if (!drawing_chunk_encode_stroke(drawing, stroke, JOURNAL_STROKE_END,
+                                         out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct drawing_stroke *
+drawing_chunk_decode_stroke(struct drawing_layer *drawing,
+                            const struct journal_stroke_begin *begin,
+                            const void *payload, uint32_t length) {
+    const struct journal_stroke_points *points = payload;
+    struct packed_points packed;
+    if (length < sizeof(*points) || points->id != begin->id ||
+        points->point_count < 2 ||
+        length - sizeof(*points) < points->data_size ||
+        !point_codec_view(points + 1, points->data_size, points->point_count,
+                          points->quantum, &packed)) {
+        return NULL;
+    }
+
+    double corner_x, corner_y;
+    drawing_chunk_corner(drawing, begin->chunk_x, begin->chunk_y, &corner_x,
+                         &corner_y);
+    struct drawing_stroke *stroke = stroke_create_packed(
+        corner_x + begin->origin_x, corner_y + begin->origin_y,
+        (struct drawing_color){begin->r, begin->g, begin->b}, &packed);
+    if (!stroke) {
+        return NULL;
+    }
+
+    stroke->id = begin->id;
+    stroke->z = begin->z;
+    stroke->smooth = begin->flags & JOURNAL_STROKE_SMOOTH;
+    stroke->tolerance = begin->tolerance;
+    stroke->min_x = begin->min_x;
+    stroke->min_y = begin->min_y;
+    stroke->max_x = begin->max_x;
+    stroke->max_y = begin->max_y;
+    return stroke;
+}
+
+/*
+ * Put the strokes of a chunk file on the canvas. The chunk takes ownership
+ * of the records, which the strokes point into.
+ */
+static void chunk_apply_records(struct drawing_layer *drawing,
+                                struct drawing_chunk *chunk, void *records,
+                                size_t size) {
+    struct journal_reader reader;
+    journal_reader_init_data(&reader, records, size);
+
+    const struct journal_stroke_begin *begin = NULL;
+    struct drawing_stroke *stroke = NULL;
+    uint32_t type, length;
+    const void *payload;
+    size_t count = 0;
+    bool ok = true;
+    while (ok && journal_reader_next(&reader, &type, &payload, &length)) {
+        switch (type) {
+        case JOURNAL_STROKE_BEGIN:
+            ok = length >= sizeof(*begin);
+            begin = payload;
+            break;
+        case JOURNAL_STROKE_POINTS:
+            ok = begin && !stroke &&
+                 (stroke = drawing_chunk_decode_stroke(drawing, begin,
+                                                       payload, length));
+            break;
+        case JOURNAL_STROKE_END:
+            ok = stroke != NULL;
+            if (ok) {
+                stroke->chunk = chunk;
+                drawing_chunk_attach(drawing, stroke);
+                stroke = NULL;
+                begin = NULL;
+                count++;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    stroke_destroy(stroke);
+
+    if (!ok) {
+        wlr_log(WLR_ERROR, "Chunk (%d, %d) is damaged, loaded %zu strokes",
+                chunk->x, chunk->y, count);
+    }
+
+    chunk->records = records;
+    chunk->memory += size;
+    drawing->resident_memory += size;
+    chunk->state = DRAWING_CHUNK_RESIDENT;
+    wlr_log(WLR_DEBUG, "Paged in chunk (%d, %d) with %zu strokes", chunk->x,
+            chunk->y, count);
+}
+
+void drawing_chunk_handle_load(int32_t x, int32_t y, uint64_t generation,
+                               void *records, size_t size, void *data) {
+    struct drawing_layer *drawing = data;
+
+    /* The chunk may have been cleared, rewritten or read since */
+    struct drawing_chunk *chunk = drawing_chunk_find(drawing, x, y);
+    if (!chunk || chunk->state != DRAWING_CHUNK_LOADING ||
+        chunk->generation != generation) {
+        free(records);
+        return;
+    }
+
+    if (!records) {
+        chunk->state = DRAWING_CHUNK_FAILED;
+        return;
+    }
+    chunk_apply_records(drawing, chunk, records, size);
+}
+
+static bool chunk_intersects(const struct drawing_chunk *chunk, double min_x,
+                             double min_y, double max_x, double max_y) {
+    return chunk->min_x <= max_x && chunk->max_x >= min_x &&
+           chunk->min_y <= max_y && chunk->max_y >= min_y;
+}
+
+/*
+ * Track how fast the viewport is moving, in canvas units per second.
+ * All outputs share the viewport origin, so rendering several outputs in a
+ * frame doesn't look like motion.
+ */
+static void update_page_velocity(struct drawing_layer *drawing, double x,
+                                 double y, uint64_t now) {
+    uint64_t dt = now - drawing->page_time;
+    if (drawing->page_time == 0) {
+        drawing->page_time = now;
+        drawing->page_x = x;
+        drawing->page_y = y;
+        return;
+    }
+
+    if (x != drawing->page_x || y != drawing->page_y) {
+        if (dt == 0) {
+            return;
+        }
+        /* Smooth out uneven frame timing */
+        double vx = (x - drawing->page_x) * 1000.0 / dt;
+        double vy = (y - drawing->page_y) * 1000.0 / dt;
+        drawing->page_velocity_x = (drawing->page_velocity_x + vx) / 2.0;
+        drawing->page_velocity_y = (drawing->page_velocity_y + vy) / 2.0;
+        drawing->page_time = now;
+        drawing->page_x = x;
+        drawing->page_y = y;
+    } else if (dt > DRAWING_PAGE_IDLE_MS) {
+        drawing->page_velocity_x = 0.0;
+        drawing->page_velocity_y = 0.0;
+        drawing->page_time = now;
+    }
+}
+
+/*
+ * Mark chunks intersecting a rect as wanted, requesting any not loaded.
+ */
+static void want_chunks(struct drawing_layer *drawing, double min_x,
+                        double min_y, double max_x, double max_y,
+                        uint64_t now) {
+    struct drawing_chunk *chunk;
+    wl_list_for_each(chunk, &drawing->chunks, link) {
+        if (!chunk_intersects(chunk, min_x, min_y, max_x, max_y)) {
+            continue;
+        }
+        chunk->last_wanted = now;
+        if (chunk->state == DRAWING_CHUNK_UNLOADED) {
+            chunk_request(drawing, chunk);
+        }
+    }
+}
+
+/*
+ * Evict the least recently wanted unchanged chunks until within budget.
+ */
+static void evict_chunks(struct drawing_layer *drawing, uint64_t now) {
+    while (drawing->resident_memory > drawing->memory_budget) {
+        struct drawing_chunk *oldest = NULL, *chunk;
+        wl_list_for_each(chunk, &drawing->chunks, link) {
+            if (chunk->state != DRAWING_CHUNK_RESIDENT || chunk->dirty ||
+                chunk->saving || chunk->history_refs > 0 ||
+                chunk->generation == 0 ||
+                now - chunk->last_wanted < DRAWING_CHUNK_KEEP_MS) {
+                continue;
+            }
+            if (!oldest || chunk->last_wanted < oldest->last_wanted) {
+                oldest = chunk;
+            }
+        }
+        if (!oldest) {
+            return;
+        }
+
+        wlr_log(WLR_DEBUG, "Paging out chunk (%d, %d)", oldest->x,
+                oldest->y);
+        chunk_unload(drawing, oldest);
+    }
+}
+
+void drawing_chunks_page(struct drawing_layer *drawing, double min_x,
+                         double min_y, double max_x, double max_y) {
+    uint64_t now = now_ms();
+    update_page_velocity(drawing, min_x, min_y, now);
+
+    /* What's on screen is queued before anything prefetched */
+    want_chunks(drawing, min_x, min_y, max_x, max_y, now);
+
+    double width = max_x - min_x;
+    double height = max_y - min_y;
+    double margin_x = width * DRAWING_PREFETCH_MARGIN;
+    double margin_y = height * DRAWING_PREFETCH_MARGIN;
+    double ahead_x = drawing->page_velocity_x * DRAWING_PREFETCH_TIME;
+    double ahead_y = drawing->page_velocity_y * DRAWING_PREFETCH_TIME;
+
+    /* Look ahead in the pan direction, at most a couple of screens */
+    ahead_x = fmax(-2.0 * width, fmin(2.0 * width, ahead_x));
+    ahead_y = fmax(-2.0 * height, fmin(2.0 * height, ahead_y));
+    want_chunks(drawing, min_x - margin_x + fmin(ahead_x, 0.0),
+                min_y - margin_y + fmin(ahead_y, 0.0),
+                max_x + margin_x + fmax(ahead_x, 0.0),
+                max_y + margin_y + fmax(ahead_y, 0.0), now);
+
+    evict_chunks(drawing, now);
+}
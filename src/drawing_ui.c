@@ -16,6 +16,7 @@
 
 #include "infinidesk/drawing.h"
 #include "infinidesk/drawing_ui.h"
+#include "infinidesk/perf.h"
 
 /* UI Layout constants */
 #define UI_PANEL_X 20
@@ -25,6 +26,11 @@
 #define UI_PANEL_PADDING 10
 #define UI_SEPARATOR_HEIGHT 20
 
+/* Buttons above the separator (colors and erasers) and below it (actions) */
+#define UI_TOOL_BUTTONS 5
+#define UI_ACTION_BUTTONS 3
+#define UI_TOTAL_BUTTONS (UI_TOOL_BUTTONS + UI_ACTION_BUTTONS)
+
 /* UI Colors */
 #define UI_BG_COLOR {0.15f, 0.15f, 0.15f, 0.9f}
 #define UI_BUTTON_NORMAL {0.25f, 0.25f, 0.25f, 1.0f}
@@ -46,6 +52,11 @@ static void render_redo_icon(struct wlr_render_pass *pass, int x, int y,
                              float scale);
 static void render_clear_icon(struct wlr_render_pass *pass, int x, int y,
                               float scale);
+static void render_eraser_icon(struct wlr_render_pass *pass, int x, int y,
+                               float scale, bool partial);
+static void get_button_color(struct drawing_ui_panel *panel,
+                             enum drawing_ui_button button, bool is_selected,
+                             float color[4]);
 static int get_button_y(struct drawing_ui_panel *panel, int button_index);
 static bool is_color_equal(struct drawing_color a, struct drawing_color b);
 
@@ -55,9 +66,14 @@ void drawing_ui_init(struct drawing_ui_panel *panel, int screen_width,
 
     panel->width = UI_BUTTON_WIDTH + 2 * UI_PANEL_PADDING;
 
-    /* Calculate total height: 3 color buttons + separator + 3 action buttons */
-    panel->height = UI_PANEL_PADDING * 2 + UI_BUTTON_HEIGHT * 6 +
-                    UI_BUTTON_SPACING * 5 + UI_SEPARATOR_HEIGHT;
+    /*
+     * Calculate total height: 3 color buttons + 2 eraser buttons + separator
+     * + 3 action buttons
+     */
+    panel->height = UI_PANEL_PADDING * 2 +
+                    UI_BUTTON_HEIGHT * UI_TOTAL_BUTTONS +
+                    UI_BUTTON_SPACING * (UI_TOTAL_BUTTONS - 1) +
+                    UI_SEPARATOR_HEIGHT;
 
     panel->x = UI_PANEL_X;
     panel->y = (screen_height - panel->height) / 2;
@@ -85,49 +101,73 @@ void drawing_ui_render(struct drawing_ui_panel *panel,
 
     /* Render panel background */
     float bg_color[] = UI_BG_COLOR;
-    wlr_render_pass_add_rect(pass,
-                             &(struct wlr_render_rect_options){
-                                 .box =
-                                     {
-                                         .x = (int)(panel->x * s),
-                                         .y = (int)(panel->y * s),
-                                         .width = (int)(panel->width * s),
-                                         .height = (int)(panel->height * s),
-                                     },
-                                 .color =
-                                     {
-                                         .r = bg_color[0],
-                                         .g = bg_color[1],
-                                         .b = bg_color[2],
-                                         .a = bg_color[3],
-                                     },
-                             });
+    perf_add_rect(pass,
+                  &(struct wlr_render_rect_options){
+                      .box =
+                          {
+                              .x = (int)(panel->x * s),
+                              .y = (int)(panel->y * s),
+                              .width = (int)(panel->width * s),
+                              .height = (int)(panel->height * s),
+                          },
+                      .color =
+                          {
+                              .r = bg_color[0],
+                              .g = bg_color[1],
+                              .b = bg_color[2],
+                              .a = bg_color[3],
+                          },
+                  });
 
     /* Button positions (scaled) */
     int button_x = (int)((panel->x + UI_PANEL_PADDING) * s);
     int button_w = (int)(UI_BUTTON_WIDTH * s);
     int button_h = (int)(UI_BUTTON_HEIGHT * s);
 
-    /* Color buttons */
+    /* Color buttons (only shown selected while using the pen) */
+    bool pen = drawing->tool == DRAWING_TOOL_PEN;
     render_color_button(pass, button_x, (int)(get_button_y(panel, 0) * s),
                         button_w, button_h, COLOR_RED,
-                        is_color_equal(drawing->current_color, COLOR_RED),
+                        pen && is_color_equal(drawing->current_color,
+                                              COLOR_RED),
                         panel->hovered_button == UI_BUTTON_COLOR_RED);
 
     render_color_button(pass, button_x, (int)(get_button_y(panel, 1) * s),
                         button_w, button_h, COLOR_GREEN,
-                        is_color_equal(drawing->current_color, COLOR_GREEN),
+                        pen && is_color_equal(drawing->current_color,
+                                              COLOR_GREEN),
                         panel->hovered_button == UI_BUTTON_COLOR_GREEN);
 
     render_color_button(pass, button_x, (int)(get_button_y(panel, 2) * s),
                         button_w, button_h, COLOR_BLUE,
-                        is_color_equal(drawing->current_color, COLOR_BLUE),
+                        pen && is_color_equal(drawing->current_color,
+                                              COLOR_BLUE),
                         panel->hovered_button == UI_BUTTON_COLOR_BLUE);
 
+    /* Eraser buttons */
+    int erase_stroke_y = (int)(get_button_y(panel, 3) * s);
+    int erase_partial_y = (int)(get_button_y(panel, 4) * s);
+
+    float erase_stroke_color[4];
+    get_button_color(panel, UI_BUTTON_ERASE_STROKE,
+                     drawing->tool == DRAWING_TOOL_ERASE_STROKE,
+                     erase_stroke_color);
+    render_button(pass, button_x, erase_stroke_y, button_w, button_h,
+                  erase_stroke_color);
+    render_eraser_icon(pass, button_x, erase_stroke_y, s, false);
+
+    float erase_partial_color[4];
+    get_button_color(panel, UI_BUTTON_ERASE_PARTIAL,
+                     drawing->tool == DRAWING_TOOL_ERASE_PARTIAL,
+                     erase_partial_color);
+    render_button(pass, button_x, erase_partial_y, button_w, button_h,
+                  erase_partial_color);
+    render_eraser_icon(pass, button_x, erase_partial_y, s, true);
+
     /* Action buttons (after separator) */
-    int undo_y = (int)(get_button_y(panel, 3) * s);
-    int redo_y = (int)(get_button_y(panel, 4) * s);
-    int clear_y = (int)(get_button_y(panel, 5) * s);
+    int undo_y = (int)(get_button_y(panel, 5) * s);
+    int redo_y = (int)(get_button_y(panel, 6) * s);
+    int clear_y = (int)(get_button_y(panel, 7) * s);
 
     /* Undo button */
     float undo_color[4];
@@ -183,7 +223,7 @@ enum drawing_ui_button drawing_ui_get_button_at(struct drawing_ui_panel *panel,
     }
 
     /* Check each button's Y coordinate */
-    for (int i = 0; i < 6; i++) {
+    for (int i = 0; i < UI_TOTAL_BUTTONS; i++) {
         int button_y = get_button_y(panel, i);
         if ((int)y >= button_y && (int)y < button_y + UI_BUTTON_HEIGHT) {
             /* Map button index to enum */
@@ -195,10 +235,14 @@ enum drawing_ui_button drawing_ui_get_button_at(struct drawing_ui_panel *panel,
             case 2:
                 return UI_BUTTON_COLOR_BLUE;
             case 3:
-                return UI_BUTTON_UNDO;
+                return UI_BUTTON_ERASE_STROKE;
             case 4:
-                return UI_BUTTON_REDO;
+                return UI_BUTTON_ERASE_PARTIAL;
             case 5:
+                return UI_BUTTON_UNDO;
+            case 6:
+                return UI_BUTTON_REDO;
+            case 7:
                 return UI_BUTTON_CLEAR;
             }
         }
@@ -215,19 +259,32 @@ void drawing_ui_handle_click(struct drawing_ui_panel *panel,
     switch (button) {
     case UI_BUTTON_COLOR_RED:
         drawing->current_color = COLOR_RED;
+        drawing->tool = DRAWING_TOOL_PEN;
         wlr_log(WLR_DEBUG, "Selected red color");
         break;
 
     case UI_BUTTON_COLOR_GREEN:
         drawing->current_color = COLOR_GREEN;
+        drawing->tool = DRAWING_TOOL_PEN;
         wlr_log(WLR_DEBUG, "Selected green color");
         break;
 
     case UI_BUTTON_COLOR_BLUE:
         drawing->current_color = COLOR_BLUE;
+        drawing->tool = DRAWING_TOOL_PEN;
         wlr_log(WLR_DEBUG, "Selected blue color");
         break;
 
+    case UI_BUTTON_ERASE_STROKE:
+        drawing->tool = DRAWING_TOOL_ERASE_STROKE;
+        wlr_log(WLR_DEBUG, "Selected stroke eraser");
+        break;
+
+    case UI_BUTTON_ERASE_PARTIAL:
+        drawing->tool = DRAWING_TOOL_ERASE_PARTIAL;
+        wlr_log(WLR_DEBUG, "Selected partial eraser");
+        break;
+
     case UI_BUTTON_UNDO:
         drawing_undo_last(drawing);
         break;
@@ -254,22 +311,22 @@ void drawing_ui_update_hover(struct drawing_ui_panel *panel, double x,
 
 static void render_button(struct wlr_render_pass *pass, int x, int y, int width,
                           int height, float color[4]) {
-    wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-                                       .box =
-                                           {
-                                               .x = x,
-                                               .y = y,
-                                               .width = width,
-                                               .height = height,
-                                           },
-                                       .color =
-                                           {
-                                               .r = color[0],
-                                               .g = color[1],
-                                               .b = color[2],
-                                               .a = color[3],
-                                           },
-                                   });
+    perf_add_rect(pass, &(struct wlr_render_rect_options){
+                            .box =
+                                {
+                                    .x = x,
+                                    .y = y,
+                                    .width = width,
+                                    .height = height,
+                                },
+                            .color =
+                                {
+                                    .r = color[0],
+                                    .g = color[1],
+                                    .b = color[2],
+                                    .a = color[3],
+                                },
+                        });
 }
 
 static void render_color_button(struct wlr_render_pass *pass, int x, int y,
@@ -296,22 +353,22 @@ static void render_color_button(struct wlr_render_pass *pass, int x, int y,
     int swatch_y = y + (height - swatch_size) / 2;
 
     float swatch_color[4] = {color.r, color.g, color.b, 1.0f};
-    wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-                                       .box =
-                                           {
-                                               .x = swatch_x,
-                                               .y = swatch_y,
-                                               .width = swatch_size,
-                                               .height = swatch_size,
-                                           },
-                                       .color =
-                                           {
-                                               .r = swatch_color[0],
-                                               .g = swatch_color[1],
-                                               .b = swatch_color[2],
-                                               .a = swatch_color[3],
-                                           },
-                                   });
+    perf_add_rect(pass, &(struct wlr_render_rect_options){
+                            .box =
+                                {
+                                    .x = swatch_x,
+                                    .y = swatch_y,
+                                    .width = swatch_size,
+                                    .height = swatch_size,
+                                },
+                            .color =
+                                {
+                                    .r = swatch_color[0],
+                                    .g = swatch_color[1],
+                                    .b = swatch_color[2],
+                                    .a = swatch_color[3],
+                                },
+                        });
 }
 
 static void render_undo_icon(struct wlr_render_pass *pass, int x, int y,
@@ -332,7 +389,7 @@ static void render_undo_icon(struct wlr_render_pass *pass, int x, int y,
         int h = (int)((i * 2 + 1) * scale / icon_size * icon_size);
         if (h < 1)
             h = 1;
-        wlr_render_pass_add_rect(
+        perf_add_rect(
             pass, &(struct wlr_render_rect_options){
                       .box =
                           {
@@ -367,7 +424,7 @@ static void render_redo_icon(struct wlr_render_pass *pass, int x, int y,
         line_w = 1;
 
     for (int i = 0; i < icon_size; i++) {
-        wlr_render_pass_add_rect(
+        perf_add_rect(
             pass, &(struct wlr_render_rect_options){
                       .box =
                           {
@@ -403,56 +460,129 @@ static void render_clear_icon(struct wlr_render_pass *pass, int x, int y,
 
     /* Top-left to bottom-right diagonal */
     for (int i = 0; i < size; i++) {
-        wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-                                           .box =
-                                               {
-                                                   .x = center_x - size / 2 + i,
-                                                   .y = center_y - size / 2 + i,
-                                                   .width = dot_size,
-                                                   .height = dot_size,
-                                               },
-                                           .color =
-                                               {
-                                                   .r = icon_color[0],
-                                                   .g = icon_color[1],
-                                                   .b = icon_color[2],
-                                                   .a = icon_color[3],
-                                               },
-                                       });
+        perf_add_rect(pass, &(struct wlr_render_rect_options){
+                                .box =
+                                    {
+                                        .x = center_x - size / 2 + i,
+                                        .y = center_y - size / 2 + i,
+                                        .width = dot_size,
+                                        .height = dot_size,
+                                    },
+                                .color =
+                                    {
+                                        .r = icon_color[0],
+                                        .g = icon_color[1],
+                                        .b = icon_color[2],
+                                        .a = icon_color[3],
+                                    },
+                            });
     }
 
     /* Top-right to bottom-left diagonal */
     for (int i = 0; i < size; i++) {
-        wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-                                           .box =
-                                               {
-                                                   .x = center_x + size / 2 - i,
-                                                   .y = center_y - size / 2 + i,
-                                                   .width = dot_size,
-                                                   .height = dot_size,
-                                               },
-                                           .color =
-                                               {
-                                                   .r = icon_color[0],
-                                                   .g = icon_color[1],
-                                                   .b = icon_color[2],
-                                                   .a = icon_color[3],
-                                               },
-                                       });
+        perf_add_rect(pass, &(struct wlr_render_rect_options){
+                                .box =
+                                    {
+                                        .x = center_x + size / 2 - i,
+                                        .y = center_y - size / 2 + i,
+                                        .width = dot_size,
+                                        .height = dot_size,
+                                    },
+                                .color =
+                                    {
+                                        .r = icon_color[0],
+                                        .g = icon_color[1],
+                                        .b = icon_color[2],
+                                        .a = icon_color[3],
+                                    },
+                            });
+    }
+}
+
+static void render_eraser_icon(struct wlr_render_pass *pass, int x, int y,
+                               float scale, bool partial) {
+    float icon_color[] = UI_ICON_COLOR;
+    int button_w = (int)(UI_BUTTON_WIDTH * scale);
+    int button_h = (int)(UI_BUTTON_HEIGHT * scale);
+    int center_x = x + button_w / 2;
+    int center_y = y + button_h / 2;
+
+    /* Eraser block outline */
+    int width = (int)(24 * scale);
+    int height = (int)(14 * scale);
+    int line_w = (int)(2 * scale);
+    if (line_w < 1)
+        line_w = 1;
+
+    int left = center_x - width / 2;
+    int top = center_y - height / 2;
+    struct wlr_box edges[] = {
+        {left, top, width, line_w},
+        {left, top + height - line_w, width, line_w},
+        {left, top, line_w, height},
+        {left + width - line_w, top, line_w, height},
+    };
+
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        perf_add_rect(pass, &(struct wlr_render_rect_options){
+                                .box = edges[i],
+                                .color =
+                                    {
+                                        .r = icon_color[0],
+                                        .g = icon_color[1],
+                                        .b = icon_color[2],
+                                        .a = icon_color[3],
+                                    },
+                            });
+    }
+
+    /* Stroke eraser is solid; partial eraser is only half filled */
+    int fill_w = partial ? width / 2 : width;
+    perf_add_rect(pass, &(struct wlr_render_rect_options){
+                            .box =
+                                {
+                                    .x = left,
+                                    .y = top,
+                                    .width = fill_w,
+                                    .height = height,
+                                },
+                            .color =
+                                {
+                                    .r = icon_color[0],
+                                    .g = icon_color[1],
+                                    .b = icon_color[2],
+                                    .a = icon_color[3],
+                                },
+                        });
+}
+
+static void get_button_color(struct drawing_ui_panel *panel,
+                             enum drawing_ui_button button, bool is_selected,
+                             float color[4]) {
+    if (is_selected) {
+        float selected[] = UI_BUTTON_SELECTED;
+        memcpy(color, selected, sizeof(selected));
+    } else if (panel->hovered_button == button) {
+        float hover[] = UI_BUTTON_HOVER;
+        memcpy(color, hover, sizeof(hover));
+    } else {
+        float normal[] = UI_BUTTON_NORMAL;
+        memcpy(color, normal, sizeof(normal));
     }
 }
 
 static int get_button_y(struct drawing_ui_panel *panel, int button_index) {
     int y = panel->y + UI_PANEL_PADDING;
 
-    if (button_index < 3) {
-        /* Color buttons (0-2) */
+    if (button_index < UI_TOOL_BUTTONS) {
+        /* Color and eraser buttons (0-4) */
         y += button_index * (UI_BUTTON_HEIGHT + UI_BUTTON_SPACING);
     } else {
-        /* Action buttons (3-5) - add separator space */
-        y += 3 * (UI_BUTTON_HEIGHT + UI_BUTTON_SPACING);
+        /* Action buttons (5-7) - add separator space */
+        y += UI_TOOL_BUTTONS * (UI_BUTTON_HEIGHT + UI_BUTTON_SPACING);
         y += UI_SEPARATOR_HEIGHT;
-        y += (button_index - 3) * (UI_BUTTON_HEIGHT + UI_BUTTON_SPACING);
+        y += (button_index - UI_TOOL_BUTTONS) *
+             (UI_BUTTON_HEIGHT + UI_BUTTON_SPACING);
     }
 
     return y;
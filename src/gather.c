@@ -0,0 +1,106 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * gather.c - Pulling windows together on the canvas
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+
+#include "infinidesk/gather.h"
+
+void gather_boxes(struct gather_box *boxes, uint32_t count,
+                  double minimum_gap, double *centroid_x,
+                  double *centroid_y) {
+    /* Add the centre points of each box, and divide to get the centroid */
+    double sum_x = 0.0, sum_y = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum_x += boxes[i].x + boxes[i].width / 2.0;
+        sum_y += boxes[i].y + boxes[i].height / 2.0;
+    }
+    *centroid_x = sum_x / count;
+    *centroid_y = sum_y / count;
+
+    /* Scale factor to bring boxes closer to the centroid (0.5 = halfway) */
+    double scale_factor = 0.5;
+
+    /* Move each box closer to the centroid by scaling its vector from the
+     * centroid */
+    for (uint32_t i = 0; i < count; i++) {
+        struct gather_box *box = &boxes[i];
+
+        /* Calculate current box centre */
+        double center_x = box->x + box->width / 2.0;
+        double center_y = box->y + box->height / 2.0;
+
+        /* Calculate vector from centroid to box centre */
+        double vec_x = center_x - *centroid_x;
+        double vec_y = center_y - *centroid_y;
+
+        /* Calculate current distance from centroid */
+        double current_distance = sqrt(vec_x * vec_x + vec_y * vec_y);
+
+        /*
+         * Calculate minimum allowed distance based on the bounding box.
+         * Use half the diagonal of the bounding box plus the minimum gap.
+         * This ensures the box's edge doesn't get closer than minimum_gap to
+         * the centroid.
+         */
+        double half_width = box->width / 2.0;
+        double half_height = box->height / 2.0;
+
+        /*
+         * For a more accurate minimum distance, calculate how far the edge of
+         * the bounding box is from the centre along the direction of the
+         * vector. This accounts for the box's aspect ratio and approach angle.
+         */
+        double min_distance;
+        if (current_distance < 0.001) {
+            /* Box is already at centroid, no need to move */
+            min_distance = 0.0;
+        } else {
+            /* Normalise the vector to get direction */
+            double dir_x = vec_x / current_distance;
+            double dir_y = vec_y / current_distance;
+
+            /*
+             * Calculate intersection of the direction ray with the bounding
+             * box. The distance from centre to edge along direction (dir_x,
+             * dir_y) is: min(half_width / |dir_x|, half_height / |dir_y|) but
+             * we need to handle the case where dir_x or dir_y is zero.
+             */
+            double t_x =
+                (fabs(dir_x) > 0.001) ? half_width / fabs(dir_x) : INFINITY;
+            double t_y =
+                (fabs(dir_y) > 0.001) ? half_height / fabs(dir_y) : INFINITY;
+            double edge_distance = fmin(t_x, t_y);
+
+            /* Minimum distance is edge distance plus the gap */
+            min_distance = edge_distance + minimum_gap;
+        }
+
+        /* Calculate the new distance after scaling */
+        double new_distance = current_distance * scale_factor;
+
+        /* Clamp the new distance to not go below minimum */
+        if (new_distance < min_distance) {
+            new_distance = min_distance;
+        }
+
+        /* Calculate scale factor for this box (may differ from global
+         * scale_factor) */
+        double effective_scale =
+            (current_distance > 0.001) ? new_distance / current_distance : 1.0;
+
+        /* Scale the vector to get new position */
+        double new_center_x = *centroid_x + vec_x * effective_scale;
+        double new_center_y = *centroid_y + vec_y * effective_scale;
+
+        /* Set new box position (converting back from centre to top-left) */
+        box->x = new_center_x - box->width / 2.0;
+        box->y = new_center_y - box->height / 2.0;
+    }
+}
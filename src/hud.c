@@ -0,0 +1,356 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * hud.c - On-screen performance overlay
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <cairo.h>
+#include <drm_fourcc.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <pango/pangocairo.h>
+
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/drawing.h"
+#include "infinidesk/hud.h"
+#include "infinidesk/output.h"
+#include "infinidesk/perf.h"
+#include "infinidesk/scaled_surface.h"
+#include "infinidesk/server.h"
+#include "infinidesk/view.h"
+
+/* Styling constants */
+#define HUD_MARGIN 10
+#define HUD_PADDING 10
+#define HUD_WIDTH 400
+#define HUD_LINE_HEIGHT 16
+#define HUD_GRAPH_HEIGHT 40
+#define HUD_SECTION_GAP 8
+#define HUD_FONT "Monospace 9"
+
+/* Text lines above and below each output's graph */
+#define HUD_OUTPUT_LINES 3
+/* Text lines for the whole compositor */
+#define HUD_SERVER_LINES 4
+
+/* Colors */
+#define BG_R 0.1
+#define BG_G 0.1
+#define BG_B 0.1
+#define BG_A 0.85
+
+#define TEXT_R 1.0
+#define TEXT_G 1.0
+#define TEXT_B 1.0
+
+#define MiB (1024.0 * 1024.0)
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void hud_init(struct infinidesk_hud *hud, struct infinidesk_server *server) {
+    hud->server = server;
+    hud->active = false;
+}
+
+void hud_output_finish(struct hud_output *stats) {
+    if (stats->texture) {
+        wlr_texture_destroy(stats->texture);
+        stats->texture = NULL;
+    }
+}
+
+void hud_finish(struct infinidesk_hud *hud) {
+    struct infinidesk_output *output;
+    wl_list_for_each(output, &hud->server->outputs, link) {
+        hud_output_finish(&output->hud);
+    }
+}
+
+void hud_toggle(struct infinidesk_hud *hud) {
+    hud->active = !hud->active;
+    wlr_log(WLR_DEBUG, "HUD %s", hud->active ? "shown" : "hidden");
+
+    if (hud->active) {
+        /* Start from fresh statistics */
+        struct infinidesk_output *output;
+        wl_list_for_each(output, &hud->server->outputs, link) {
+            memset(&output->hud, 0, sizeof(output->hud));
+        }
+    } else {
+        hud_finish(hud);
+    }
+}
+
+void hud_frame_begin(struct infinidesk_hud *hud, struct hud_output *stats) {
+    if (!hud->active) {
+        return;
+    }
+    perf_draw_counts(&stats->rects_mark, &stats->textures_mark);
+}
+
+void hud_frame_end(struct infinidesk_hud *hud, struct hud_output *stats,
+                   uint64_t frame_ns) {
+    if (!hud->active) {
+        return;
+    }
+
+    stats->frame_ms[stats->head] = frame_ns / 1e6f;
+    stats->head = (stats->head + 1) % HUD_GRAPH_FRAMES;
+    if (stats->count < HUD_GRAPH_FRAMES) {
+        stats->count++;
+    }
+
+    /* Frame rate over roughly the last second */
+    uint64_t now = get_time_ns();
+    if (stats->fps_start_ns == 0) {
+        stats->fps_start_ns = now;
+    }
+    stats->fps_frames++;
+    if (now - stats->fps_start_ns >= 1000000000) {
+        stats->fps = stats->fps_frames * 1e9f / (now - stats->fps_start_ns);
+        stats->fps_frames = 0;
+        stats->fps_start_ns = now;
+    }
+}
+
+static void show_line(cairo_t *cr, PangoLayout *layout, double y,
+                      const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void show_line(cairo_t *cr, PangoLayout *layout, double y,
+                      const char *fmt, ...) {
+    char text[128];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+
+    cairo_set_source_rgb(cr, TEXT_R, TEXT_G, TEXT_B);
+    pango_layout_set_text(layout, text, -1);
+    cairo_move_to(cr, HUD_PADDING, y);
+    pango_cairo_show_layout(cr, layout);
+}
+
+/*
+ * Draw an output's recent frame times as bars, against its frame budget.
+ */
+static void draw_graph(cairo_t *cr, const struct hud_output *stats,
+                       double budget_ms, double y) {
+    double width = HUD_WIDTH - HUD_PADDING * 2;
+    double bar_width = width / HUD_GRAPH_FRAMES;
+
+    /* Budget at half height, so overruns up to twice it are shown */
+    double max_ms = budget_ms > 0 ? budget_ms * 2 : 33.3;
+
+    cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.08);
+    cairo_rectangle(cr, HUD_PADDING, y, width, HUD_GRAPH_HEIGHT);
+    cairo_fill(cr);
+
+    /* Oldest on the left */
+    uint32_t start =
+        (stats->head + HUD_GRAPH_FRAMES - stats->count) % HUD_GRAPH_FRAMES;
+    for (uint32_t i = 0; i < stats->count; i++) {
+        float ms = stats->frame_ms[(start + i) % HUD_GRAPH_FRAMES];
+        double h = ms / max_ms * HUD_GRAPH_HEIGHT;
+        if (h > HUD_GRAPH_HEIGHT) {
+            h = HUD_GRAPH_HEIGHT;
+        }
+        if (budget_ms > 0 && ms > budget_ms) {
+            cairo_set_source_rgb(cr, 0.9, 0.3, 0.3);
+        } else {
+            cairo_set_source_rgb(cr, 0.3, 0.8, 0.4);
+        }
+        double x = HUD_PADDING + (HUD_GRAPH_FRAMES - stats->count + i) *
+                                     bar_width;
+        cairo_rectangle(cr, x, y + HUD_GRAPH_HEIGHT - h, bar_width, h);
+        cairo_fill(cr);
+    }
+
+    if (budget_ms > 0) {
+        cairo_set_source_rgba(cr, 0.9, 0.8, 0.2, 0.8);
+        cairo_set_line_width(cr, 1.0);
+        cairo_move_to(cr, HUD_PADDING, y + HUD_GRAPH_HEIGHT / 2.0);
+        cairo_line_to(cr, HUD_PADDING + width, y + HUD_GRAPH_HEIGHT / 2.0);
+        cairo_stroke(cr);
+    }
+}
+
+static void render_texture(struct infinidesk_hud *hud, struct hud_output *dest,
+                           float output_scale) {
+    struct infinidesk_server *server = hud->server;
+
+    int output_count = 0;
+    struct infinidesk_output *output;
+    wl_list_for_each(output, &server->outputs, link) { output_count++; }
+
+    /* Count views, and the memory their surfaces' textures use */
+    uint32_t view_count = 0;
+    size_t client_bytes = 0;
+    struct infinidesk_view *view;
+    wl_list_for_each(view, &server->views, link) {
+        view_count++;
+        client_bytes += view_texture_memory(view);
+    }
+
+    /* Count the strokes in memory */
+    struct drawing_layer *drawing = &server->drawing;
+    uint32_t stroke_count;
+    uint64_t point_count;
+    drawing_count_strokes(drawing, &stroke_count, &point_count);
+
+    /* Calculate dimensions in logical pixels */
+    int width = HUD_WIDTH;
+    int height = HUD_PADDING * 2 + HUD_SERVER_LINES * HUD_LINE_HEIGHT +
+                 output_count * (HUD_OUTPUT_LINES * HUD_LINE_HEIGHT +
+                                 HUD_GRAPH_HEIGHT + HUD_SECTION_GAP);
+
+    /* Calculate physical pixel dimensions for crisp HiDPI rendering */
+    int physical_width = (int)(width * output_scale);
+    int physical_height = (int)(height * output_scale);
+
+    cairo_surface_t *surface = cairo_image_surface_create(
+        CAIRO_FORMAT_ARGB32, physical_width, physical_height);
+    cairo_t *cr = cairo_create(surface);
+    cairo_scale(cr, output_scale, output_scale);
+
+    cairo_set_source_rgba(cr, BG_R, BG_G, BG_B, BG_A);
+    cairo_paint(cr);
+
+    PangoLayout *layout = pango_cairo_create_layout(cr);
+    PangoFontDescription *font_desc =
+        pango_font_description_from_string(HUD_FONT);
+    pango_layout_set_font_description(layout, font_desc);
+
+    double y = HUD_PADDING;
+    wl_list_for_each(output, &server->outputs, link) {
+        const struct hud_output *stats = &output->hud;
+        const struct render_governor *governor = &output->governor;
+
+        float total_ms = 0, max_ms = 0;
+        for (uint32_t i = 0; i < stats->count; i++) {
+            total_ms += stats->frame_ms[i];
+            if (stats->frame_ms[i] > max_ms) {
+                max_ms = stats->frame_ms[i];
+            }
+        }
+        float mean_ms = stats->count ? total_ms / stats->count : 0;
+
+        show_line(cr, layout, y, "%s  %.1f fps  %s quality",
+                  output->wlr_output->name, stats->fps,
+                  render_quality_name(governor->quality.level));
+        y += HUD_LINE_HEIGHT;
+        if (governor->last_gpu_ns >= 0) {
+            show_line(cr, layout, y,
+                      "cpu %.2f ms mean, %.2f max  gpu %.2f ms", mean_ms,
+                      max_ms, governor->last_gpu_ns / 1e6);
+        } else {
+            show_line(cr, layout, y, "cpu %.2f ms mean, %.2f max", mean_ms,
+                      max_ms);
+        }
+        y += HUD_LINE_HEIGHT;
+
+        draw_graph(cr, stats, governor->budget_ns / 1e6, y);
+        y += HUD_GRAPH_HEIGHT;
+
+        show_line(cr, layout, y, "%u rects  %u textures  %u/%u views",
+                  stats->rects, stats->textures, stats->visible_views,
+                  view_count);
+        y += HUD_LINE_HEIGHT + HUD_SECTION_GAP;
+    }
+
+    show_line(cr, layout, y, "%u strokes in memory, %u drawn, %lu points",
+              stroke_count, drawing->visible_count,
+              (unsigned long)point_count);
+    y += HUD_LINE_HEIGHT;
+    show_line(cr, layout, y, "textures: clients %.1f MiB, scaled %.1f MiB",
+              client_bytes / MiB, scaled_surface_memory() / MiB);
+    y += HUD_LINE_HEIGHT;
+    show_line(cr, layout, y, "annotations: %.1f of %.0f MiB",
+              drawing->resident_memory / MiB, drawing->memory_budget / MiB);
+    y += HUD_LINE_HEIGHT;
+
+    const struct infinidesk_watchdog *watchdog = &server->watchdog;
+    show_line(cr, layout, y, "stalls: %lu loop, %lu frame, max %.1f ms",
+              (unsigned long)watchdog->stalls,
+              (unsigned long)watchdog->frame_stalls,
+              watchdog->max_stall_ns / 1e6);
+
+    /* Clean up Pango */
+    g_object_unref(layout);
+    pango_font_description_free(font_desc);
+
+    /* Convert to wlr_texture */
+    cairo_surface_flush(surface);
+    unsigned char *data = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+
+    /* Free old texture */
+    hud_output_finish(dest);
+
+    dest->texture =
+        wlr_texture_from_pixels(server->renderer, DRM_FORMAT_ARGB8888, stride,
+                                physical_width, physical_height, data);
+
+    /* Store physical pixel dimensions for 1:1 rendering */
+    dest->texture_width = physical_width;
+    dest->texture_height = physical_height;
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+}
+
+void hud_render(struct infinidesk_hud *hud, struct hud_output *stats,
+                struct wlr_render_pass *pass, uint32_t visible_views,
+                float output_scale) {
+    if (!hud->active) {
+        return;
+    }
+
+    /* What the frame drew before the HUD */
+    uint64_t rects, textures;
+    perf_draw_counts(&rects, &textures);
+    stats->rects = (uint32_t)(rects - stats->rects_mark);
+    stats->textures = (uint32_t)(textures - stats->textures_mark);
+    stats->visible_views = visible_views;
+
+    /* Only redraw the overlay every so often */
+    uint64_t now = get_time_ns();
+    if (!stats->texture ||
+        now - stats->last_update_ns >= (uint64_t)HUD_REFRESH_MS * 1000000) {
+        render_texture(hud, stats, output_scale);
+        stats->last_update_ns = now;
+    }
+
+    if (!stats->texture) {
+        return;
+    }
+
+    /* Render 1:1 - texture is already at physical resolution */
+    int margin = (int)(HUD_MARGIN * output_scale);
+    struct wlr_render_texture_options opts = {
+        .texture = stats->texture,
+        .dst_box =
+            {
+                .x = margin,
+                .y = margin,
+                .width = stats->texture_width,
+                .height = stats->texture_height,
+            },
+    };
+
+    perf_add_texture(pass, &opts);
+}
@@ -0,0 +1,666 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * journal.c - Append-only on-disk journal of drawing operations
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/journal.h"
+
+#define JOURNAL_DIR "infinidesk"
+#define JOURNAL_FILE "canvas.journal"
+
+struct journal {
+    char *path;
+    char *tmp_path;
+    int fd; /* File records are appended to (guarded by lock) */
+
+    /* Records present when the journal was opened */
+    void *map;
+    size_t map_size;
+    size_t records_end;
+
+    /* Bytes in the file once everything queued is written */
+    size_t size;
+
+    /* Writer thread */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    /* Signalled when there is work or on stop */
+    pthread_cond_t drained; /* Signalled after each write */
+    struct wl_array pending;
+    bool flush_requested;
+    bool writing;
+    bool stopping;
+    bool write_failed;
+
+    /*
+     * Rewrite in progress. It is queued at an offset into pending, where
+     * the new file takes over from the old one, and reported back to the
+     * main thread through the notify pipe.
+     */
+    struct journal_rewrite rewrite;
+    bool rewrite_queued; /* Guarded by lock */
+    size_t rewrite_offset;
+    bool rewrite_finished; /* Guarded by lock */
+    bool rewrite_ok;
+    bool rewriting;          /* Main thread, until done is called */
+    size_t rewrite_old_size; /* journal_size() of the old file */
+    size_t rewrite_new_size; /* And of the new one, when it started */
+    int notify_fds[2];
+    struct wl_event_source *notify_source;
+};
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+size_t journal_record_size(size_t length) {
+    return sizeof(struct journal_record_header) + align8(length);
+}
+
+/*
+ * Create every missing directory leading up to path.
+ */
+static bool ensure_parent_directories(const char *path) {
+    char *copy = strdup(path);
+    if (!copy) {
+        return false;
+    }
+
+    for (char *p = copy + 1; *p; p++) {
+        if (*p != '/') {
+            continue;
+        }
+        *p = '\0';
+        if (mkdir(copy, 0755) != 0 && errno != EEXIST) {
+            wlr_log(WLR_ERROR, "Failed to create directory %s: %s", copy,
+                    strerror(errno));
+            free(copy);
+            return false;
+        }
+        *p = '/';
+    }
+
+    free(copy);
+    return true;
+}
+
+char *journal_default_path(void) {
+    return journal_data_path(JOURNAL_FILE);
+}
+
+char *journal_data_path(const char *name) {
+    const char *data_home = getenv("XDG_DATA_HOME");
+    const char *home = getenv("HOME");
+    char *path = NULL;
+    int len;
+
+    if (data_home && data_home[0] == '/') {
+        len = snprintf(NULL, 0, "%s/%s/%s", data_home, JOURNAL_DIR, name);
+        path = malloc(len + 1);
+        if (path) {
+            snprintf(path, len + 1, "%s/%s/%s", data_home, JOURNAL_DIR,
+                     name);
+        }
+    } else if (home) {
+        len = snprintf(NULL, 0, "%s/.local/share/%s/%s", home, JOURNAL_DIR,
+                       name);
+        path = malloc(len + 1);
+        if (path) {
+            snprintf(path, len + 1, "%s/.local/share/%s/%s", home,
+                     JOURNAL_DIR, name);
+        }
+    } else {
+        wlr_log(WLR_ERROR, "Neither XDG_DATA_HOME nor HOME is set");
+    }
+
+    return path;
+}
+
+static bool write_all(int fd, const void *data, size_t size) {
+    const uint8_t *p = data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool write_file_header(int fd) {
+    struct journal_file_header header = {
+        .version = JOURNAL_VERSION,
+    };
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    return write_all(fd, &header, sizeof(header));
+}
+
+/*
+ * Write the new journal of a rewrite and move it into place, keeping the
+ * old one aside if asked to. Returns the new file, or -1 if the old one is
+ * still current.
+ */
+static int write_rewrite(struct journal *journal) {
+    struct journal_rewrite *rewrite = &journal->rewrite;
+    if (rewrite->prepare && !rewrite->prepare(rewrite->data)) {
+        return -1;
+    }
+
+    int fd = open(journal->tmp_path,
+                  O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        wlr_log(WLR_ERROR, "Failed to create %s: %s", journal->tmp_path,
+                strerror(errno));
+        return -1;
+    }
+    if (!write_file_header(fd) ||
+        !write_all(fd, rewrite->records.data, rewrite->records.size) ||
+        fsync(fd) != 0) {
+        wlr_log(WLR_ERROR, "Failed to write %s: %s", journal->tmp_path,
+                strerror(errno));
+        goto error;
+    }
+
+    if (rewrite->keep_suffix) {
+        size_t len = strlen(journal->path) + strlen(rewrite->keep_suffix) + 1;
+        char *keep_path = malloc(len);
+        if (!keep_path) {
+            goto error;
+        }
+        snprintf(keep_path, len, "%s%s", journal->path, rewrite->keep_suffix);
+        unlink(keep_path);
+        bool kept = link(journal->path, keep_path) == 0;
+        if (kept) {
+            wlr_log(WLR_INFO, "Kept the old annotation journal as %s",
+                    keep_path);
+        } else {
+            wlr_log(WLR_ERROR, "Failed to keep %s as %s: %s", journal->path,
+                    keep_path, strerror(errno));
+        }
+        free(keep_path);
+        if (!kept) {
+            goto error;
+        }
+    }
+
+    if (rename(journal->tmp_path, journal->path) != 0) {
+        wlr_log(WLR_ERROR, "Failed to replace %s: %s", journal->path,
+                strerror(errno));
+        goto error;
+    }
+    return fd;
+
+error:
+    close(fd);
+    unlink(journal->tmp_path);
+    return -1;
+}
+
+static void *writer_thread(void *data) {
+    struct journal *journal = data;
+    struct wl_array batch;
+    wl_array_init(&batch);
+
+    pthread_mutex_lock(&journal->lock);
+    while (true) {
+        while (!journal->flush_requested && !journal->stopping) {
+            pthread_cond_wait(&journal->wake, &journal->lock);
+        }
+        if (journal->stopping && journal->pending.size == 0 &&
+            !journal->rewrite_queued) {
+            break;
+        }
+
+        /* Take everything queued so far and write it without the lock */
+        struct wl_array tmp = batch;
+        batch = journal->pending;
+        journal->pending = tmp;
+        journal->pending.size = 0;
+        bool rewrite = journal->rewrite_queued;
+        size_t split = rewrite ? journal->rewrite_offset : batch.size;
+        journal->rewrite_queued = false;
+        journal->flush_requested = false;
+        journal->writing = true;
+        int fd = journal->fd;
+        pthread_mutex_unlock(&journal->lock);
+
+        /* What was queued before a rewrite still goes to the old file */
+        bool ok = write_all(fd, batch.data, split);
+        int new_fd = -1;
+        if (rewrite) {
+            new_fd = write_rewrite(journal);
+            wl_array_release(&journal->rewrite.records);
+            wl_array_init(&journal->rewrite.records);
+            if (new_fd >= 0) {
+                close(fd);
+                fd = new_fd;
+                if (journal->rewrite.commit) {
+                    journal->rewrite.commit(journal->rewrite.data);
+                }
+            }
+        }
+        if (!write_all(fd, (uint8_t *)batch.data + split,
+                       batch.size - split)) {
+            ok = false;
+        }
+        batch.size = 0;
+
+        pthread_mutex_lock(&journal->lock);
+        journal->fd = fd;
+        if (!ok && !journal->write_failed) {
+            wlr_log(WLR_ERROR, "Failed to write annotation journal: %s",
+                    strerror(errno));
+            journal->write_failed = true;
+        }
+        if (rewrite) {
+            journal->rewrite_finished = true;
+            journal->rewrite_ok = new_fd >= 0;
+            char byte = 0;
+            if (write(journal->notify_fds[1], &byte, 1) < 0 &&
+                errno != EAGAIN) {
+                wlr_log(WLR_ERROR, "Failed to signal journal rewrite: %s",
+                        strerror(errno));
+            }
+        }
+        journal->writing = false;
+        pthread_cond_broadcast(&journal->drained);
+    }
+    pthread_mutex_unlock(&journal->lock);
+
+    wl_array_release(&batch);
+    return NULL;
+}
+
+/*
+ * Find the end of the complete records in the mapping.
+ */
+static size_t find_records_end(struct journal *journal) {
+    struct journal_reader reader;
+    reader.pos = (const uint8_t *)journal->map +
+                 sizeof(struct journal_file_header);
+    reader.end = (const uint8_t *)journal->map + journal->map_size;
+
+    uint32_t type, length;
+    const void *payload;
+    while (journal_reader_next(&reader, &type, &payload, &length)) {
+    }
+    return reader.pos - (const uint8_t *)journal->map;
+}
+
+/*
+ * Open the journal file, replacing it if it isn't a journal at all. One
+ * written in another version of the format is left alone, setting
+ * *incompatible. Returns the file size, or -1 on error.
+ */
+static off_t open_file(struct journal *journal, bool *incompatible) {
+    journal->fd = open(journal->path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC,
+                       0644);
+    if (journal->fd < 0) {
+        wlr_log(WLR_ERROR, "Failed to open %s: %s", journal->path,
+                strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(journal->fd, &st) != 0) {
+        return -1;
+    }
+
+    struct journal_file_header header;
+    if (st.st_size >= (off_t)sizeof(header) &&
+        pread(journal->fd, &header, sizeof(header), 0) ==
+            (ssize_t)sizeof(header) &&
+        memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) == 0) {
+        if (header.version >= JOURNAL_OLDEST_VERSION &&
+            header.version <= JOURNAL_VERSION) {
+            return st.st_size;
+        }
+
+        /* Starting afresh would lose the canvas it holds */
+        wlr_log(WLR_ERROR,
+                "%s holds annotations in journal format %u, but this build "
+                "only reads formats %u to %u. Use a build that matches it, "
+                "or move it aside to start with an empty canvas",
+                journal->path, header.version, JOURNAL_OLDEST_VERSION,
+                JOURNAL_VERSION);
+        *incompatible = true;
+        return -1;
+    }
+
+    /* Keep anything unreadable aside rather than destroying it */
+    if (st.st_size > 0) {
+        size_t len = strlen(journal->path) + sizeof(".old");
+        char *old_path = malloc(len);
+        if (!old_path) {
+            return -1;
+        }
+        snprintf(old_path, len, "%s.old", journal->path);
+        wlr_log(WLR_ERROR, "%s is not a readable journal, moving it to %s",
+                journal->path, old_path);
+        rename(journal->path, old_path);
+        free(old_path);
+
+        close(journal->fd);
+        journal->fd = open(journal->path,
+                           O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (journal->fd < 0) {
+            return -1;
+        }
+    }
+
+    if (ftruncate(journal->fd, 0) != 0 || !write_file_header(journal->fd)) {
+        wlr_log(WLR_ERROR, "Failed to initialise %s: %s", journal->path,
+                strerror(errno));
+        return -1;
+    }
+    return sizeof(header);
+}
+
+/*
+ * Call the done callback of a finished rewrite, if there is one.
+ */
+static void finish_rewrite(struct journal *journal) {
+    pthread_mutex_lock(&journal->lock);
+    bool finished = journal->rewrite_finished;
+    bool ok = journal->rewrite_ok;
+    journal->rewrite_finished = false;
+    pthread_mutex_unlock(&journal->lock);
+    if (!finished) {
+        return;
+    }
+
+    /* Records appended since it started went to the old file instead */
+    if (!ok) {
+        journal->size = journal->rewrite_old_size +
+                        (journal->size - journal->rewrite_new_size);
+    }
+    journal->rewriting = false;
+    journal->rewrite.done(ok, journal->rewrite.data);
+}
+
+static int handle_notify(int fd, uint32_t mask, void *data) {
+    (void)mask;
+    struct journal *journal = data;
+
+    char buf[64];
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+
+    finish_rewrite(journal);
+    return 0;
+}
+
+struct journal *journal_open(const char *path, struct wl_event_loop *loop,
+                             bool *incompatible) {
+    *incompatible = false;
+
+    struct journal *journal = calloc(1, sizeof(*journal));
+    if (!journal) {
+        return NULL;
+    }
+    journal->fd = -1;
+    journal->notify_fds[0] = journal->notify_fds[1] = -1;
+    wl_array_init(&journal->pending);
+    wl_array_init(&journal->rewrite.records);
+
+    journal->path = strdup(path);
+    size_t tmp_len = strlen(path) + sizeof(".tmp");
+    journal->tmp_path = malloc(tmp_len);
+    if (!journal->path || !journal->tmp_path) {
+        goto error;
+    }
+    snprintf(journal->tmp_path, tmp_len, "%s.tmp", path);
+
+    if (!ensure_parent_directories(path)) {
+        goto error;
+    }
+
+    off_t size = open_file(journal, incompatible);
+    if (size < 0) {
+        goto error;
+    }
+
+    /* Map the existing records; their points are used in place */
+    journal->map_size = size;
+    journal->map = mmap(NULL, journal->map_size, PROT_READ, MAP_PRIVATE,
+                        journal->fd, 0);
+    if (journal->map == MAP_FAILED) {
+        wlr_log(WLR_ERROR, "Failed to map %s: %s", path, strerror(errno));
+        journal->map = NULL;
+        goto error;
+    }
+
+    /* Drop a record torn by a crash so new records follow valid ones */
+    journal->records_end = find_records_end(journal);
+    if (journal->records_end < journal->map_size) {
+        wlr_log(WLR_ERROR, "Discarding %zu bytes of incomplete records",
+                journal->map_size - journal->records_end);
+        if (ftruncate(journal->fd, journal->records_end) != 0) {
+            goto error;
+        }
+    }
+    journal->size = journal->records_end;
+
+    if (pipe(journal->notify_fds) != 0) {
+        wlr_log(WLR_ERROR, "Failed to create pipe: %s", strerror(errno));
+        goto error;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(journal->notify_fds[i], F_SETFD, FD_CLOEXEC);
+        fcntl(journal->notify_fds[i], F_SETFL, O_NONBLOCK);
+    }
+    journal->notify_source =
+        wl_event_loop_add_fd(loop, journal->notify_fds[0], WL_EVENT_READABLE,
+                             handle_notify, journal);
+    if (!journal->notify_source) {
+        goto error;
+    }
+
+    pthread_mutex_init(&journal->lock, NULL);
+    pthread_cond_init(&journal->wake, NULL);
+    pthread_cond_init(&journal->drained, NULL);
+    if (pthread_create(&journal->thread, NULL, writer_thread, journal) != 0) {
+        wlr_log(WLR_ERROR, "Failed to start journal writer thread");
+        pthread_cond_destroy(&journal->drained);
+        pthread_cond_destroy(&journal->wake);
+        pthread_mutex_destroy(&journal->lock);
+        goto error;
+    }
+
+    wlr_log(WLR_INFO, "Opened annotation journal %s (%zu bytes)", path,
+            journal->size);
+    return journal;
+
+error:
+    if (journal->notify_source) {
+        wl_event_source_remove(journal->notify_source);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (journal->notify_fds[i] >= 0) {
+            close(journal->notify_fds[i]);
+        }
+    }
+    if (journal->map) {
+        munmap(journal->map, journal->map_size);
+    }
+    if (journal->fd >= 0) {
+        close(journal->fd);
+    }
+    wl_array_release(&journal->pending);
+    free(journal->tmp_path);
+    free(journal->path);
+    free(journal);
+    return NULL;
+}
+
+void journal_close(struct journal *journal) {
+    if (!journal) {
+        return;
+    }
+
+    /* The writer drains the queue, and any rewrite, before it exits */
+    pthread_mutex_lock(&journal->lock);
+    journal->stopping = true;
+    pthread_cond_signal(&journal->wake);
+    pthread_mutex_unlock(&journal->lock);
+    pthread_join(journal->thread, NULL);
+
+    if (fsync(journal->fd) != 0) {
+        wlr_log(WLR_ERROR, "Failed to sync annotation journal: %s",
+                strerror(errno));
+    }
+
+    pthread_cond_destroy(&journal->drained);
+    pthread_cond_destroy(&journal->wake);
+    pthread_mutex_destroy(&journal->lock);
+
+    wl_event_source_remove(journal->notify_source);
+    close(journal->notify_fds[0]);
+    close(journal->notify_fds[1]);
+    munmap(journal->map, journal->map_size);
+    close(journal->fd);
+    wl_array_release(&journal->pending);
+    free(journal->tmp_path);
+    free(journal->path);
+    free(journal);
+}
+
+void journal_reader_init(struct journal *journal,
+                         struct journal_reader *reader) {
+    reader->pos = (const uint8_t *)journal->map +
+                  sizeof(struct journal_file_header);
+    reader->end = (const uint8_t *)journal->map + journal->records_end;
+}
+
+void journal_reader_init_data(struct journal_reader *reader, const void *data,
+                              size_t size) {
+    reader->pos = data;
+    reader->end = (const uint8_t *)data + size;
+}
+
+bool journal_reader_next(struct journal_reader *reader, uint32_t *type,
+                         const void **payload, uint32_t *length) {
+    struct journal_record_header header;
+    if ((size_t)(reader->end - reader->pos) < sizeof(header)) {
+        return false;
+    }
+
+    memcpy(&header, reader->pos, sizeof(header));
+    size_t size = journal_record_size(header.length);
+    if (header.type == 0 || (size_t)(reader->end - reader->pos) < size) {
+        return false;
+    }
+
+    *type = header.type;
+    *length = header.length;
+    *payload = reader->pos + sizeof(header);
+    reader->pos += size;
+    return true;
+}
+
+size_t journal_size(struct journal *journal) {
+    return journal->size;
+}
+
+bool journal_encode(struct wl_array *out, uint32_t type, const void *head,
+                    size_t head_len, const void *tail, size_t tail_len) {
+    struct journal_record_header header = {
+        .type = type,
+        .length = (uint32_t)(head_len + tail_len),
+    };
+    size_t size = journal_record_size(header.length);
+
+    uint8_t *p = wl_array_add(out, size);
+    if (!p) {
+        return false;
+    }
+
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    if (head_len > 0) {
+        memcpy(p, head, head_len);
+    }
+    if (tail_len > 0) {
+        memcpy(p + head_len, tail, tail_len);
+    }
+    memset(p + head_len + tail_len, 0,
+           size - sizeof(header) - head_len - tail_len);
+    return true;
+}
+
+void journal_append(struct journal *journal, uint32_t type, const void *head,
+                    size_t head_len, const void *tail, size_t tail_len) {
+    pthread_mutex_lock(&journal->lock);
+    bool ok = journal_encode(&journal->pending, type, head, head_len, tail,
+                             tail_len);
+    pthread_mutex_unlock(&journal->lock);
+
+    if (!ok) {
+        wlr_log(WLR_ERROR, "Failed to queue journal record");
+        return;
+    }
+    journal->size += journal_record_size(head_len + tail_len);
+}
+
+void journal_flush(struct journal *journal) {
+    pthread_mutex_lock(&journal->lock);
+    journal->flush_requested = true;
+    pthread_cond_signal(&journal->wake);
+    pthread_mutex_unlock(&journal->lock);
+}
+
+void journal_rewrite(struct journal *journal,
+                     struct journal_rewrite *rewrite) {
+    journal->rewriting = true;
+    journal->rewrite_old_size = journal->size;
+    journal->rewrite_new_size =
+        sizeof(struct journal_file_header) + rewrite->records.size;
+    journal->size = journal->rewrite_new_size;
+
+    pthread_mutex_lock(&journal->lock);
+    journal->rewrite = *rewrite;
+    journal->rewrite_queued = true;
+    journal->rewrite_offset = journal->pending.size;
+    journal->flush_requested = true;
+    pthread_cond_signal(&journal->wake);
+    pthread_mutex_unlock(&journal->lock);
+
+    wl_array_init(&rewrite->records);
+}
+
+void journal_wait_rewrite(struct journal *journal) {
+    if (!journal->rewriting) {
+        return;
+    }
+
+    pthread_mutex_lock(&journal->lock);
+    while (!journal->rewrite_finished) {
+        pthread_cond_wait(&journal->drained, &journal->lock);
+    }
+    pthread_mutex_unlock(&journal->lock);
+
+    finish_rewrite(journal);
+}
@@ -20,11 +20,16 @@
 
 #include "infinidesk/config.h"
 #include "infinidesk/drawing.h"
+#include "infinidesk/hud.h"
 #include "infinidesk/keyboard.h"
+#include "infinidesk/latency.h"
 #include "infinidesk/output.h"
+#include "infinidesk/replay.h"
 #include "infinidesk/server.h"
 #include "infinidesk/switcher.h"
+#include "infinidesk/trace.h"
 #include "infinidesk/view.h"
+#include "infinidesk/watchdog.h"
 
 void keyboard_create(struct infinidesk_server *server,
                      struct wlr_keyboard *wlr_keyboard) {
@@ -86,6 +91,16 @@ void keyboard_handle_key(struct wl_listener *listener, void *data) {
     struct infinidesk_server *server = keyboard->server;
     struct wlr_keyboard_key_event *event = data;
 
+    trace_instant(TRACE_TRACK_INPUT, "key", "time %u key %u state %d",
+                  event->time_msec, event->keycode, (int)event->state);
+    latency_input(&server->latency, event->time_msec);
+    replay_record(&(struct replay_event){
+        .type = REPLAY_KEY,
+        .time_msec = event->time_msec,
+        .key = {event->keycode, event->state},
+    });
+    watchdog_enter(&server->watchdog, "keyboard_key");
+
     /* Get the keycode and translate to XKB keysym */
     uint32_t keycode = event->keycode + 8; /* libinput -> XKB offset */
     const xkb_keysym_t *syms;
@@ -131,7 +146,10 @@ void keyboard_handle_key(struct wl_listener *listener, void *data) {
         wlr_seat_set_keyboard(server->seat, keyboard->wlr_keyboard);
         wlr_seat_keyboard_notify_key(server->seat, event->time_msec,
                                      event->keycode, event->state);
+        latency_forward(&server->latency, LATENCY_CLIENT_KEY,
+                        server->seat->keyboard_state.focused_surface);
     }
+    watchdog_leave(&server->watchdog);
 }
 
 void keyboard_handle_modifiers(struct wl_listener *listener, void *data) {
@@ -181,7 +199,7 @@ static void action_close_window(struct infinidesk_server *server) {
 
 static void action_exit(struct infinidesk_server *server) {
     wlr_log(WLR_INFO, "Exiting compositor");
-    wl_display_terminate(server->wl_display);
+    server_terminate(server);
 }
 
 static void action_toggle_drawing(struct infinidesk_server *server) {
@@ -212,6 +230,19 @@ static void action_window_switcher(struct infinidesk_server *server) {
     }
 }
 
+static void action_toggle_hud(struct infinidesk_server *server) {
+    hud_toggle(&server->hud);
+}
+
+static void action_toggle_trace(struct infinidesk_server *server) {
+    (void)server;
+    if (trace_active()) {
+        trace_stop();
+    } else {
+        trace_start(NULL);
+    }
+}
+
 static const struct {
     const char *name;
     action_fn fn;
@@ -224,6 +255,8 @@ static const struct {
     {"redo_stroke", action_redo_stroke},
     {"gather_windows", action_gather_windows},
     {"window_switcher", action_window_switcher},
+    {"toggle_hud", action_toggle_hud},
+    {"toggle_trace", action_toggle_trace},
 };
 #define ACTION_TABLE_SIZE (sizeof(action_table) / sizeof(action_table[0]))
 
@@ -283,6 +316,9 @@ bool keyboard_handle_keybinding(struct infinidesk_server *server,
             continue;
         }
 
+        /* Named after the action, as a fork can stall the loop too */
+        watchdog_enter(&server->watchdog,
+                       kb->type == KEYBIND_ACTION ? kb->value : "exec");
         switch (kb->type) {
         case KEYBIND_ACTION:
             dispatch_action(server, kb->value);
@@ -291,6 +327,7 @@ bool keyboard_handle_keybinding(struct infinidesk_server *server,
             exec_command(kb->value);
             break;
         }
+        watchdog_leave(&server->watchdog);
         return true;
     }
 
@@ -0,0 +1,241 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * latency.c - Input to display latency measurement
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/latency.h"
+
+/* How often the distributions are logged, in ns */
+#define LATENCY_REPORT_INTERVAL_NS 10000000000ull
+
+/* Input timestamps older than this are assumed to be on another clock */
+#define LATENCY_MAX_AGE_MS 1000
+
+static const char *path_names[] = {
+    [LATENCY_PAN] = "pan",
+    [LATENCY_ZOOM] = "zoom",
+    [LATENCY_DRAW] = "draw",
+    [LATENCY_MOVE] = "move",
+    [LATENCY_RESIZE] = "resize",
+    [LATENCY_CLIENT_POINTER] = "client pointer",
+    [LATENCY_CLIENT_KEY] = "client key",
+};
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void latency_init(struct latency_tracker *tracker, bool log) {
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->log = log;
+    tracker->last_report_ns = get_time_ns();
+    for (int path = 0; path < LATENCY_PATH_COUNT; path++) {
+        wl_list_init(&tracker->forwarded[path].client_destroy.link);
+    }
+}
+
+static void forwarded_clear(struct latency_forwarded *forwarded) {
+    forwarded->input_ns = 0;
+    forwarded->client = NULL;
+    wl_list_remove(&forwarded->client_destroy.link);
+    wl_list_init(&forwarded->client_destroy.link);
+}
+
+static void handle_client_destroy(struct wl_listener *listener, void *data) {
+    (void)data;
+    struct latency_forwarded *forwarded =
+        wl_container_of(listener, forwarded, client_destroy);
+    /* The wl_client may be reused for a new client, which didn't get it */
+    forwarded_clear(forwarded);
+}
+
+void latency_input(struct latency_tracker *tracker, uint32_t time_msec) {
+    /*
+     * Input timestamps are CLOCK_MONOTONIC in ms, truncated to 32 bits, so
+     * work out how long ago the event happened and go back that far.
+     */
+    uint64_t now = get_time_ns();
+    uint32_t age_ms = (uint32_t)(now / 1000000) - time_msec;
+    if (age_ms > LATENCY_MAX_AGE_MS) {
+        age_ms = 0;
+    }
+    tracker->current_ns = now - (uint64_t)age_ms * 1000000;
+}
+
+/* Keep the older of two waiting inputs */
+static void keep_oldest(uint64_t *slot, uint64_t input_ns) {
+    if (input_ns != 0 && (*slot == 0 || input_ns < *slot)) {
+        *slot = input_ns;
+    }
+}
+
+void latency_effect(struct latency_tracker *tracker, enum latency_path path) {
+    keep_oldest(&tracker->pending_ns[path], tracker->current_ns);
+}
+
+void latency_forward(struct latency_tracker *tracker, enum latency_path path,
+                     struct wlr_surface *surface) {
+    if (!surface || tracker->current_ns == 0) {
+        return;
+    }
+
+    struct latency_forwarded *forwarded = &tracker->forwarded[path];
+    struct wl_client *client = wl_resource_get_client(surface->resource);
+    if (forwarded->input_ns != 0 && forwarded->client == client &&
+        tracker->current_ns - forwarded->input_ns <= LATENCY_MAX_WAIT_NS) {
+        /* Still waiting on an older input to the same client */
+        return;
+    }
+
+    forwarded_clear(forwarded);
+    forwarded->input_ns = tracker->current_ns;
+    forwarded->client = client;
+    forwarded->client_destroy.notify = handle_client_destroy;
+    wl_client_add_destroy_listener(client, &forwarded->client_destroy);
+}
+
+void latency_client_commit(struct latency_tracker *tracker,
+                           struct wlr_surface *surface) {
+    struct wl_client *client = wl_resource_get_client(surface->resource);
+    uint64_t now = 0;
+    for (int path = 0; path < LATENCY_PATH_COUNT; path++) {
+        struct latency_forwarded *forwarded = &tracker->forwarded[path];
+        if (forwarded->input_ns == 0 || forwarded->client != client) {
+            continue;
+        }
+        if (now == 0) {
+            now = get_time_ns();
+        }
+        if (now - forwarded->input_ns <= LATENCY_MAX_WAIT_NS) {
+            keep_oldest(&tracker->pending_ns[path], forwarded->input_ns);
+        }
+        forwarded_clear(forwarded);
+    }
+}
+
+static void add_sample(struct latency_tracker *tracker, int path,
+                       enum latency_metric metric, uint64_t ns) {
+    uint64_t bucket = ns / LATENCY_BUCKET_NS;
+    if (bucket > LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS;
+    }
+    tracker->histogram[path][metric][bucket]++;
+    tracker->samples[path][metric]++;
+}
+
+void latency_frame_commit(struct latency_tracker *tracker,
+                          struct latency_frame *frame) {
+    uint64_t now = get_time_ns();
+    for (int path = 0; path < LATENCY_PATH_COUNT; path++) {
+        uint64_t input_ns = tracker->pending_ns[path];
+        if (input_ns == 0) {
+            continue;
+        }
+        tracker->pending_ns[path] = 0;
+        if (now > input_ns + LATENCY_MAX_WAIT_NS) {
+            /* Whatever it did was never drawn, so it can't be measured */
+            continue;
+        }
+        if (now > input_ns) {
+            add_sample(tracker, path, LATENCY_TO_COMMIT, now - input_ns);
+        }
+        keep_oldest(&frame->input_ns[path], input_ns);
+    }
+}
+
+static void report(struct latency_tracker *tracker) {
+    for (int path = 0; path < LATENCY_PATH_COUNT; path++) {
+        uint64_t commit[3], present[3];
+        if (!latency_percentiles(tracker, path, LATENCY_TO_COMMIT, commit)) {
+            continue;
+        }
+        if (!latency_percentiles(tracker, path, LATENCY_TO_PRESENT,
+                                 present)) {
+            memset(present, 0, sizeof(present));
+        }
+        wlr_log(WLR_INFO,
+                "latency %-14s commit p50 %5.1f p95 %5.1f p99 %5.1f ms, "
+                "present p50 %5.1f p95 %5.1f p99 %5.1f ms (%lu inputs)",
+                path_names[path], commit[0] / 1e6, commit[1] / 1e6,
+                commit[2] / 1e6, present[0] / 1e6, present[1] / 1e6,
+                present[2] / 1e6,
+                (unsigned long)tracker->samples[path][LATENCY_TO_COMMIT]);
+    }
+}
+
+void latency_frame_present(struct latency_tracker *tracker,
+                           struct latency_frame *frame, bool presented,
+                           const struct timespec *when) {
+    for (int path = 0; path < LATENCY_PATH_COUNT; path++) {
+        uint64_t input_ns = frame->input_ns[path];
+        if (input_ns == 0) {
+            continue;
+        }
+        frame->input_ns[path] = 0;
+
+        if (!presented) {
+            /* Never shown, so the next frame shows it instead */
+            keep_oldest(&tracker->pending_ns[path], input_ns);
+            continue;
+        }
+        if (!when) {
+            continue;
+        }
+        uint64_t present_ns =
+            (uint64_t)when->tv_sec * 1000000000 + when->tv_nsec;
+        if (present_ns > input_ns) {
+            add_sample(tracker, path, LATENCY_TO_PRESENT,
+                       present_ns - input_ns);
+        }
+    }
+
+    if (tracker->log) {
+        uint64_t now = get_time_ns();
+        if (now - tracker->last_report_ns >= LATENCY_REPORT_INTERVAL_NS) {
+            tracker->last_report_ns = now;
+            report(tracker);
+        }
+    }
+}
+
+bool latency_percentiles(const struct latency_tracker *tracker,
+                         enum latency_path path, enum latency_metric metric,
+                         uint64_t out[3]) {
+    uint64_t total = tracker->samples[path][metric];
+    if (total == 0) {
+        return false;
+    }
+
+    static const unsigned int percent[3] = {50, 95, 99};
+    const uint32_t *histogram = tracker->histogram[path][metric];
+    uint64_t seen = 0;
+    int p = 0;
+    for (int bucket = 0; bucket <= LATENCY_BUCKETS && p < 3; bucket++) {
+        seen += histogram[bucket];
+        /* Report the top of the bucket the percentile falls in */
+        while (p < 3 && seen * 100 >= total * percent[p]) {
+            out[p++] = (uint64_t)(bucket + 1) * LATENCY_BUCKET_NS;
+        }
+    }
+    return true;
+}
+
+const char *latency_path_name(enum latency_path path) {
+    if (path >= LATENCY_PATH_COUNT) {
+        return "unknown";
+    }
+    return path_names[path];
+}
@@ -18,9 +18,12 @@
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/util/log.h>
 
+#include "infinidesk/client_stats.h"
+#include "infinidesk/latency.h"
 #include "infinidesk/layer_shell.h"
 #include "infinidesk/output.h"
 #include "infinidesk/server.h"
+#include "infinidesk/trace.h"
 #include "infinidesk/view.h"
 
 /* Forward declarations */
@@ -294,6 +297,11 @@ static void handle_layer_surface_commit(struct wl_listener *listener,
         wl_container_of(listener, layer, commit);
     struct wlr_layer_surface_v1 *layer_surface = layer->layer_surface;
 
+    trace_instant(TRACE_TRACK_CLIENTS, "layer_commit", "%s",
+                  layer_surface->namespace ?: "(null)");
+    latency_client_commit(&layer->server->latency, layer_surface->surface);
+    client_stats_commit(layer->server, layer_surface->surface, NULL);
+
     /*
      * Handle initial commit - this is when the client first tells us
      * what it wants (size, anchors, etc.) and we must respond with a configure.
@@ -16,10 +16,27 @@
 
 #include <wlr/util/log.h>
 
+#include "infinidesk/bench.h"
 #include "infinidesk/config.h"
+#include "infinidesk/output.h"
+#include "infinidesk/replay.h"
 #include "infinidesk/server.h"
+#include "infinidesk/snapshot.h"
+#include "infinidesk/trace.h"
 
 static struct infinidesk_server server = {0};
+static struct infinidesk_bench bench = {0};
+static struct infinidesk_replay replay = {0};
+static struct infinidesk_snapshot snapshot = {0};
+
+/* Options with no short form */
+enum {
+    OPT_BENCH_WINDOWS = 256,
+    OPT_BENCH_CLIENT,
+    OPT_REPLAY,
+    OPT_SNAPSHOT,
+    OPT_SNAPSHOT_UPDATE,
+};
 
 static void print_usage(const char *prog_name) {
     fprintf(stderr,
@@ -28,6 +45,18 @@ static void print_usage(const char *prog_name) {
             "Options:\n"
             "  -s, --startup <cmd>  Command to run at startup\n"
             "  -d, --debug          Enable debug logging\n"
+            "  -p, --perf           Log per-stage frame timings\n"
+            "  -t, --trace <file>   Record a trace to file, written on exit\n"
+            "  -b, --bench <file>   Run the headless benchmark, writing JSON\n"
+            "                       results to file (- for stdout)\n"
+            "  --bench-windows <n>  Windows to open for the benchmark\n"
+            "  --bench-client <cmd> Command run to open each window, also\n"
+            "                       used by --snapshot\n"
+            "  -r, --record <file>  Record input to file\n"
+            "  --replay <file>      Benchmark a replay of recorded input\n"
+            "  --snapshot <scene>   Render a scene headless and compare it\n"
+            "                       with its golden image\n"
+            "  --snapshot-update    Rewrite the golden image instead\n"
             "  -h, --help           Show this help message\n"
             "\n"
             "Infinidesk is an infinite canvas Wayland compositor.\n"
@@ -49,21 +78,37 @@ static void print_usage(const char *prog_name) {
 
 static void handle_signal(int sig) {
     (void)sig;
-    wl_display_terminate(server.wl_display);
+    server_terminate(&server);
 }
 
 int main(int argc, char *argv[]) {
     char *startup_cmd = NULL;
     enum wlr_log_importance log_level = WLR_INFO;
+    bool perf_enabled = false;
+    char *trace_path = NULL;
+    char *bench_path = NULL;
+    char *record_path = NULL;
+    char *replay_path = NULL;
+    char *snapshot_path = NULL;
 
     static struct option long_options[] = {
         {"startup", required_argument, NULL, 's'},
         {"debug", no_argument, NULL, 'd'},
+        {"perf", no_argument, NULL, 'p'},
+        {"trace", required_argument, NULL, 't'},
+        {"bench", required_argument, NULL, 'b'},
+        {"bench-windows", required_argument, NULL, OPT_BENCH_WINDOWS},
+        {"bench-client", required_argument, NULL, OPT_BENCH_CLIENT},
+        {"record", required_argument, NULL, 'r'},
+        {"replay", required_argument, NULL, OPT_REPLAY},
+        {"snapshot", required_argument, NULL, OPT_SNAPSHOT},
+        {"snapshot-update", no_argument, NULL, OPT_SNAPSHOT_UPDATE},
         {"help", no_argument, NULL, 'h'},
         {NULL, 0, NULL, 0}};
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "s:dh", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "s:dpt:b:r:h", long_options,
+                              NULL)) != -1) {
         switch (opt) {
         case 's':
             startup_cmd = optarg;
@@ -71,6 +116,34 @@ int main(int argc, char *argv[]) {
         case 'd':
             log_level = WLR_DEBUG;
             break;
+        case 'p':
+            perf_enabled = true;
+            break;
+        case 't':
+            trace_path = optarg;
+            break;
+        case 'b':
+            bench_path = optarg;
+            break;
+        case OPT_BENCH_WINDOWS:
+            bench.windows = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case OPT_BENCH_CLIENT:
+            bench.client = optarg;
+            snapshot.client = optarg;
+            break;
+        case 'r':
+            record_path = optarg;
+            break;
+        case OPT_REPLAY:
+            replay_path = optarg;
+            break;
+        case OPT_SNAPSHOT:
+            snapshot_path = optarg;
+            break;
+        case OPT_SNAPSHOT_UPDATE:
+            snapshot.update = true;
+            break;
         case 'h':
             print_usage(argv[0]);
             return EXIT_SUCCESS;
@@ -80,26 +153,80 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (snapshot_path && (bench_path || replay_path)) {
+        fprintf(stderr, "--snapshot can't be combined with a benchmark\n");
+        return EXIT_FAILURE;
+    }
+
     wlr_log_init(log_level, NULL);
     wlr_log(WLR_INFO, "Starting Infinidesk");
 
+    if (trace_path) {
+        trace_start(trace_path);
+    }
+
     /* Set up signal handlers */
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
 
+    if (record_path && !replay_record_start(record_path)) {
+        return EXIT_FAILURE;
+    }
+
+    /*
+     * A replay is run as a benchmark, writing to stdout unless told, and in
+     * its scratch directory so it starts from an empty canvas
+     */
+    if (replay_path) {
+        if (!replay_load(&replay, replay_path)) {
+            return EXIT_FAILURE;
+        }
+        bench.replay = &replay;
+        if (!bench_path) {
+            bench_path = "-";
+        }
+    }
+
+    /* The benchmark runs headless, so the backend must be chosen first */
+    if (bench_path) {
+        bench.path = bench_path;
+        if (!bench_setup_env(&bench)) {
+            replay_finish(&replay);
+            return EXIT_FAILURE;
+        }
+    }
+    if (snapshot_path && (!snapshot_load(&snapshot, snapshot_path) ||
+                          !snapshot_setup_env(&snapshot))) {
+        snapshot_cleanup_env(&snapshot);
+        return EXIT_FAILURE;
+    }
+
     /* Initialise the server */
     if (!server_init(&server)) {
         wlr_log(WLR_ERROR, "Failed to initialise server");
+        bench_cleanup_env(&bench);
+        snapshot_cleanup_env(&snapshot);
         return EXIT_FAILURE;
     }
+    server.perf_enabled = perf_enabled;
 
     /* Load configuration file (before server_start so output scale is set) */
-    struct infinidesk_config config;
-    if (!config_load(&config)) {
+    struct infinidesk_config config = {0};
+    if (bench_path || snapshot_path) {
+        /* Use the defaults, so runs are comparable between machines */
+        wlr_log(WLR_INFO, "Running with the default configuration");
+    } else if (!config_load(&config)) {
         wlr_log(WLR_ERROR, "Failed to load config, continuing with defaults");
         /* server.output_scale already set to 1.0f in server_init */
     } else {
         server.output_scale = config.scale;
+        server.drawing.memory_budget =
+            (size_t)(config.annotation_memory * 1024.0f * 1024.0f);
+        server.render_budget = config.render_budget;
+        server.quality_settle_ms = config.quality_settle_ms;
+        server.stall_threshold_ms = config.stall_threshold_ms;
+        server.metrics_enabled = config.metrics;
+        server.max_commit_rate = config.max_commit_rate;
 
         /*
          * Transfer keybind ownership from config to server.
@@ -117,6 +244,27 @@ int main(int argc, char *argv[]) {
         wlr_log(WLR_ERROR, "Failed to start server");
         config_free(&config);
         server_finish(&server);
+        bench_cleanup_env(&bench);
+        snapshot_cleanup_env(&snapshot);
+        return EXIT_FAILURE;
+    }
+
+    /* Add the benchmark's output and windows */
+    if (bench_path && !bench_start(&bench, &server)) {
+        wlr_log(WLR_ERROR, "Failed to start benchmark");
+        replay_finish(&replay);
+        config_free(&config);
+        server_finish(&server);
+        bench_cleanup_env(&bench);
+        return EXIT_FAILURE;
+    }
+
+    /* Add the snapshot's output, and lay out its scene */
+    if (snapshot_path && !snapshot_start(&snapshot, &server)) {
+        wlr_log(WLR_ERROR, "Failed to start snapshot");
+        snapshot_finish(&snapshot);
+        server_finish(&server);
+        snapshot_cleanup_env(&snapshot);
         return EXIT_FAILURE;
     }
 
@@ -139,8 +287,23 @@ int main(int argc, char *argv[]) {
 
     /* Clean up */
     wlr_log(WLR_INFO, "Shutting down");
+    /* Note the size of the output the recording was made on */
+    if (record_path) {
+        int width = 0, height = 0;
+        struct infinidesk_output *primary = output_get_primary(&server);
+        if (primary) {
+            output_get_effective_resolution(primary, &width, &height);
+        }
+        replay_record_stop(width, height);
+    }
+    bench_finish(&bench);
+    replay_finish(&replay);
+    snapshot_finish(&snapshot);
+    trace_stop();
     config_free(&config);
     server_finish(&server);
+    bench_cleanup_env(&bench);
+    snapshot_cleanup_env(&snapshot);
 
-    return EXIT_SUCCESS;
+    return bench.failed || snapshot.failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
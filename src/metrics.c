@@ -0,0 +1,499 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * metrics.c - Counters and gauges for scraping, over a Unix socket
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/client_stats.h"
+#include "infinidesk/drawing.h"
+#include "infinidesk/metrics.h"
+#include "infinidesk/output.h"
+#include "infinidesk/scaled_surface.h"
+#include "infinidesk/send_buffer.h"
+#include "infinidesk/server.h"
+#include "infinidesk/view.h"
+#include "infinidesk/watchdog.h"
+
+/* Scrapers being sent metrics at once; more are turned away */
+#define METRICS_MAX_CONNECTIONS 4
+
+/* Upper bounds of the frame time buckets, in ns */
+static const uint32_t frame_bucket_ns[METRICS_FRAME_BUCKETS] = {
+    1000000,  2000000,  4000000,  8000000,  12000000,
+    16700000, 25000000, 33300000, 50000000, 100000000,
+};
+
+void metrics_frame_rendered(struct metrics_output *output, uint32_t ns) {
+    int bucket = 0;
+    while (bucket < METRICS_FRAME_BUCKETS && ns > frame_bucket_ns[bucket]) {
+        bucket++;
+    }
+    output->frame_buckets[bucket]++;
+    output->frame_ns_total += ns;
+    output->frames_rendered++;
+}
+
+void metrics_frame_skipped(struct metrics_output *output) {
+    output->frames_skipped++;
+}
+
+static void write_header(FILE *file, const char *name, const char *type,
+                         const char *help) {
+    fprintf(file, "# HELP infinidesk_%s %s\n", name, help);
+    fprintf(file, "# TYPE infinidesk_%s %s\n", name, type);
+}
+
+/* Write a label value, escaped as the text format requires */
+static void write_label_value(FILE *file, const char *value) {
+    for (const char *c = value; *c; c++) {
+        if (*c == '\\' || *c == '"') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if (*c == '\n') {
+            fputs("\\n", file);
+        } else {
+            fputc(*c, file);
+        }
+    }
+}
+
+static void write_outputs(FILE *file, struct infinidesk_server *server) {
+    struct infinidesk_output *output;
+
+    write_header(file, "frames_rendered_total", "counter",
+                 "Frames rendered and committed.");
+    wl_list_for_each(output, &server->outputs, link) {
+        fprintf(file, "infinidesk_frames_rendered_total{output=\"");
+        write_label_value(file, output->wlr_output->name);
+        fprintf(file, "\"} %llu\n",
+                (unsigned long long)output->metrics.frames_rendered);
+    }
+
+    write_header(file, "frames_skipped_total", "counter",
+                 "Frames that could not be rendered or committed.");
+    wl_list_for_each(output, &server->outputs, link) {
+        fprintf(file, "infinidesk_frames_skipped_total{output=\"");
+        write_label_value(file, output->wlr_output->name);
+        fprintf(file, "\"} %llu\n",
+                (unsigned long long)output->metrics.frames_skipped);
+    }
+
+    write_header(file, "frame_seconds", "histogram",
+                 "Time taken to render a frame on the CPU.");
+    wl_list_for_each(output, &server->outputs, link) {
+        const struct metrics_output *stats = &output->metrics;
+        uint64_t cumulative = 0;
+        for (int i = 0; i <= METRICS_FRAME_BUCKETS; i++) {
+            cumulative += stats->frame_buckets[i];
+            fprintf(file, "infinidesk_frame_seconds_bucket{output=\"");
+            write_label_value(file, output->wlr_output->name);
+            if (i < METRICS_FRAME_BUCKETS) {
+                fprintf(file, "\",le=\"%g\"} %llu\n",
+                        frame_bucket_ns[i] / 1e9,
+                        (unsigned long long)cumulative);
+            } else {
+                fprintf(file, "\",le=\"+Inf\"} %llu\n",
+                        (unsigned long long)cumulative);
+            }
+        }
+        fprintf(file, "infinidesk_frame_seconds_sum{output=\"");
+        write_label_value(file, output->wlr_output->name);
+        fprintf(file, "\"} %.6f\n", stats->frame_ns_total / 1e9);
+        fprintf(file, "infinidesk_frame_seconds_count{output=\"");
+        write_label_value(file, output->wlr_output->name);
+        fprintf(file, "\"} %llu\n",
+                (unsigned long long)stats->frames_rendered);
+    }
+}
+
+/*
+ * A rate as it stands now, counting a window that has run on with nothing
+ * in it. Worked out on a copy, so a scrape changes nothing.
+ */
+static struct commit_rate current_rate(const struct commit_rate *rate,
+                                       uint32_t now_ms) {
+    struct commit_rate current = *rate;
+    commit_rate_update(&current, now_ms);
+    return current;
+}
+
+/* Write a client's labels, as in {pid="1",name="foot"} */
+static void write_client_labels(FILE *file, const char *name,
+                                struct client_stats *stats) {
+    fprintf(file, "infinidesk_%s{pid=\"%d\",name=\"", name, (int)stats->pid);
+    write_label_value(file, stats->name);
+    fputs("\"} ", file);
+}
+
+static void write_clients(FILE *file, struct infinidesk_server *server) {
+    struct client_stats *stats;
+    uint32_t now_ms = server_time_ms(server);
+
+    write_header(file, "client_commits_total", "counter",
+                 "Commits to each connected client's windows and layer "
+                 "surfaces.");
+    wl_list_for_each(stats, &server->clients, link) {
+        write_client_labels(file, "client_commits_total", stats);
+        fprintf(file, "%llu\n", (unsigned long long)stats->rate.commits);
+    }
+
+    write_header(file, "client_damage_pixels_total", "counter",
+                 "Buffer pixels damaged by each client's commits.");
+    wl_list_for_each(stats, &server->clients, link) {
+        write_client_labels(file, "client_damage_pixels_total", stats);
+        fprintf(file, "%llu\n", (unsigned long long)stats->rate.damage);
+    }
+
+    write_header(file, "client_commit_rate", "gauge",
+                 "Commits per second by each client, over the last second.");
+    wl_list_for_each(stats, &server->clients, link) {
+        struct commit_rate rate = current_rate(&stats->rate, now_ms);
+        write_client_labels(file, "client_commit_rate", stats);
+        fprintf(file, "%.1f\n", rate.commits_per_second);
+    }
+
+    write_header(file, "client_damage_rate", "gauge",
+                 "Pixels damaged per second by each client, over the last "
+                 "second.");
+    wl_list_for_each(stats, &server->clients, link) {
+        struct commit_rate rate = current_rate(&stats->rate, now_ms);
+        write_client_labels(file, "client_damage_rate", stats);
+        fprintf(file, "%.0f\n", rate.damage_per_second);
+    }
+
+    write_header(file, "client_throttled", "gauge",
+                 "1 while a client commits faster than the limit.");
+    wl_list_for_each(stats, &server->clients, link) {
+        write_client_labels(file, "client_throttled", stats);
+        fprintf(file, "%d\n", client_stats_is_throttled(stats) ? 1 : 0);
+    }
+
+    write_header(file, "client_throttles_total", "counter",
+                 "Times each client has gone over the commit rate limit.");
+    wl_list_for_each(stats, &server->clients, link) {
+        write_client_labels(file, "client_throttles_total", stats);
+        fprintf(file, "%u\n", stats->throttle_episodes);
+    }
+
+    write_header(file, "client_coalesced_commits_total", "counter",
+                 "Commits merged into a later one while throttled.");
+    wl_list_for_each(stats, &server->clients, link) {
+        write_client_labels(file, "client_coalesced_commits_total", stats);
+        fprintf(file, "%llu\n", (unsigned long long)stats->coalesced);
+    }
+}
+
+/* Write a view's labels, as in {id="3",app_id="foot"} */
+static void write_view_labels(FILE *file, const char *name,
+                              struct infinidesk_view *view) {
+    const char *app_id = view->xdg_toplevel->app_id;
+    fprintf(file, "infinidesk_%s{id=\"%u\",app_id=\"", name, view->id);
+    write_label_value(file, app_id ? app_id : "");
+    fputs("\"} ", file);
+}
+
+static void write_views(FILE *file, struct infinidesk_server *server) {
+    struct infinidesk_view *view;
+    uint32_t now_ms = server_time_ms(server);
+
+    write_header(file, "view_commits_total", "counter",
+                 "Commits to each window.");
+    wl_list_for_each(view, &server->views, link) {
+        write_view_labels(file, "view_commits_total", view);
+        fprintf(file, "%llu\n",
+                (unsigned long long)view->commit_rate.commits);
+    }
+
+    write_header(file, "view_commit_rate", "gauge",
+                 "Commits per second to each window, over the last second.");
+    wl_list_for_each(view, &server->views, link) {
+        struct commit_rate rate = current_rate(&view->commit_rate, now_ms);
+        write_view_labels(file, "view_commit_rate", view);
+        fprintf(file, "%.1f\n", rate.commits_per_second);
+    }
+
+    write_header(file, "view_damage_rate", "gauge",
+                 "Pixels damaged per second in each window, over the last "
+                 "second.");
+    wl_list_for_each(view, &server->views, link) {
+        struct commit_rate rate = current_rate(&view->commit_rate, now_ms);
+        write_view_labels(file, "view_damage_rate", view);
+        fprintf(file, "%.0f\n", rate.damage_per_second);
+    }
+}
+
+static void write_gauge(FILE *file, const char *name, const char *help,
+                        double value) {
+    write_header(file, name, "gauge", help);
+    fprintf(file, "infinidesk_%s %.17g\n", name, value);
+}
+
+static void write_counter(FILE *file, const char *name, const char *help,
+                          uint64_t value) {
+    write_header(file, name, "counter", help);
+    fprintf(file, "infinidesk_%s %llu\n", name, (unsigned long long)value);
+}
+
+/* Write everything, in the Prometheus text exposition format */
+static void write_metrics(FILE *file, struct infinidesk_metrics *metrics) {
+    struct infinidesk_server *server = metrics->server;
+
+    write_outputs(file, server);
+    write_clients(file, server);
+    write_views(file, server);
+
+    uint32_t views = 0, mapped = 0;
+    size_t client_bytes = 0;
+    struct infinidesk_view *view;
+    wl_list_for_each(view, &server->views, link) {
+        views++;
+        if (view->xdg_toplevel->base->surface->mapped) {
+            mapped++;
+        }
+        client_bytes += view_texture_memory(view);
+    }
+    write_gauge(file, "views", "Windows, mapped or not.", views);
+    write_gauge(file, "views_mapped", "Windows mapped.", mapped);
+
+    write_header(file, "texture_bytes", "gauge",
+                 "Approximate memory used by textures.");
+    fprintf(file, "infinidesk_texture_bytes{kind=\"client\"} %zu\n",
+            client_bytes);
+    fprintf(file, "infinidesk_texture_bytes{kind=\"scaled\"} %zu\n",
+            scaled_surface_memory());
+
+    struct drawing_layer *drawing = &server->drawing;
+    uint32_t strokes;
+    uint64_t points;
+    drawing_count_strokes(drawing, &strokes, &points);
+    write_gauge(file, "strokes", "Annotation strokes in memory.", strokes);
+    write_gauge(file, "stroke_points", "Points of the strokes in memory.",
+                (double)points);
+    write_gauge(file, "annotation_resident_bytes",
+                "Approximate memory used by annotations in memory.",
+                (double)drawing->resident_memory);
+    write_gauge(file, "annotation_budget_bytes",
+                "Annotation memory above which unchanged ones are paged out.",
+                (double)drawing->memory_budget);
+
+    struct infinidesk_watchdog *watchdog = &server->watchdog;
+    write_counter(file, "dispatches_total", "Main loop dispatches.",
+                  watchdog->dispatches);
+    write_header(file, "stalls_total", "counter",
+                 "Main loop dispatches and frames over the stall threshold.");
+    fprintf(file, "infinidesk_stalls_total{kind=\"loop\"} %llu\n",
+            (unsigned long long)watchdog->stalls);
+    fprintf(file, "infinidesk_stalls_total{kind=\"frame\"} %llu\n",
+            (unsigned long long)watchdog->frame_stalls);
+    write_header(file, "stall_seconds_total", "counter",
+                 "Time spent in main loop stalls.");
+    fprintf(file, "infinidesk_stall_seconds_total %.6f\n",
+            watchdog->stall_ns_total / 1e9);
+    write_gauge(file, "stall_max_seconds", "Longest main loop stall.",
+                watchdog->max_stall_ns / 1e9);
+    write_gauge(file, "stall_threshold_seconds",
+                "Stall threshold, 0 if stalls aren't being counted.",
+                watchdog->threshold_ns / 1e9);
+    write_gauge(file, "max_commit_rate",
+                "Commit rate above which a client is throttled, 0 for none.",
+                server->max_commit_rate);
+
+    write_counter(file, "metrics_scrapes_total", "Scrapes of these metrics.",
+                  metrics->scrapes);
+}
+
+/*
+ * A scraper still being sent its metrics. The socket is non-blocking, so a
+ * slow reader can't stall the loop; what it hasn't taken yet is kept here
+ * and sent as it becomes writable.
+ */
+struct metrics_connection {
+    struct wl_list link; /* infinidesk_metrics.connections */
+    int fd;
+    struct wl_event_source *source;
+    struct send_buffer text;
+};
+
+static void connection_destroy(struct metrics_connection *connection) {
+    if (connection->source) {
+        wl_event_source_remove(connection->source);
+    }
+    wl_list_remove(&connection->link);
+    close(connection->fd);
+    send_buffer_finish(&connection->text);
+    free(connection);
+}
+
+/* Send as much as the scraper will take. Returns true once finished. */
+static bool connection_send(struct metrics_connection *connection) {
+    enum send_result result =
+        send_buffer_flush(&connection->text, connection->fd);
+    if (result == SEND_FAILED) {
+        wlr_log(WLR_DEBUG, "Metrics scraper only took %zu of %zu bytes",
+                connection->text.sent, connection->text.size);
+    }
+    return result != SEND_PENDING;
+}
+
+static int handle_writable(int fd, uint32_t mask, void *data) {
+    (void)fd;
+    struct metrics_connection *connection = data;
+    if ((mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) ||
+        connection_send(connection)) {
+        connection_destroy(connection);
+    }
+    return 0;
+}
+
+/* Format the metrics for a newly connected scraper, and start sending */
+static void serve(struct infinidesk_metrics *metrics, int fd) {
+    struct metrics_connection *connection = calloc(1, sizeof(*connection));
+    if (!connection) {
+        wlr_log(WLR_ERROR, "Failed to allocate metrics connection");
+        close(fd);
+        return;
+    }
+    connection->fd = fd;
+    wl_list_insert(&metrics->connections, &connection->link);
+
+    FILE *file =
+        open_memstream(&connection->text.data, &connection->text.size);
+    if (!file) {
+        wlr_log_errno(WLR_ERROR, "Failed to format metrics");
+        connection_destroy(connection);
+        return;
+    }
+    metrics->scrapes++;
+    write_metrics(file, metrics);
+    if (fclose(file) != 0) {
+        wlr_log_errno(WLR_ERROR, "Failed to format metrics");
+        connection_destroy(connection);
+        return;
+    }
+
+    if (connection_send(connection)) {
+        connection_destroy(connection);
+        return;
+    }
+    connection->source =
+        wl_event_loop_add_fd(metrics->server->event_loop, fd,
+                             WL_EVENT_WRITABLE, handle_writable, connection);
+    if (!connection->source) {
+        connection_destroy(connection);
+    }
+}
+
+static int handle_connection(int fd, uint32_t mask, void *data) {
+    (void)mask;
+    struct infinidesk_metrics *metrics = data;
+
+    int client_fd = accept(fd, NULL, NULL);
+    if (client_fd < 0) {
+        return 0;
+    }
+    if (wl_list_length(&metrics->connections) >= METRICS_MAX_CONNECTIONS) {
+        /* Scrapers that aren't reading don't get to pile up more text */
+        close(client_fd);
+        return 0;
+    }
+    fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+    fcntl(client_fd, F_SETFL, O_NONBLOCK);
+
+    watchdog_enter(&metrics->server->watchdog, "metrics_scrape");
+    serve(metrics, client_fd);
+    watchdog_leave(&metrics->server->watchdog);
+    return 0;
+}
+
+bool metrics_start(struct infinidesk_metrics *metrics,
+                   struct infinidesk_server *server, const char *display) {
+    metrics->server = server;
+    metrics->fd = -1;
+    wl_list_init(&metrics->connections);
+
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (!runtime_dir) {
+        wlr_log(WLR_ERROR, "XDG_RUNTIME_DIR is not set, so no metrics");
+        return false;
+    }
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    int len = snprintf(addr.sun_path, sizeof(addr.sun_path),
+                       "%s/infinidesk-%s.metrics", runtime_dir, display);
+    if (len < 0 || (size_t)len >= sizeof(addr.sun_path)) {
+        wlr_log(WLR_ERROR, "Metrics socket path is too long");
+        return false;
+    }
+    metrics->path = strdup(addr.sun_path);
+    if (!metrics->path) {
+        return false;
+    }
+
+    metrics->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (metrics->fd < 0) {
+        wlr_log_errno(WLR_ERROR, "Failed to create metrics socket");
+        goto error;
+    }
+    fcntl(metrics->fd, F_SETFD, FD_CLOEXEC);
+    fcntl(metrics->fd, F_SETFL, O_NONBLOCK);
+
+    /* Named after our Wayland socket, so anything there is a leftover */
+    unlink(metrics->path);
+    if (bind(metrics->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(metrics->fd, 4) != 0) {
+        wlr_log_errno(WLR_ERROR, "Failed to listen on %s", metrics->path);
+        goto error;
+    }
+
+    metrics->source =
+        wl_event_loop_add_fd(server->event_loop, metrics->fd,
+                             WL_EVENT_READABLE, handle_connection, metrics);
+    if (!metrics->source) {
+        goto error;
+    }
+
+    setenv("INFINIDESK_METRICS_SOCKET", metrics->path, true);
+    wlr_log(WLR_INFO, "Serving metrics on %s", metrics->path);
+    return true;
+
+error:
+    metrics_finish(metrics);
+    return false;
+}
+
+void metrics_finish(struct infinidesk_metrics *metrics) {
+    if (!metrics->path) {
+        return; /* Never started */
+    }
+    struct metrics_connection *connection, *tmp;
+    wl_list_for_each_safe(connection, tmp, &metrics->connections, link) {
+        connection_destroy(connection);
+    }
+    if (metrics->source) {
+        wl_event_source_remove(metrics->source);
+        metrics->source = NULL;
+    }
+    if (metrics->fd >= 0) {
+        close(metrics->fd);
+        metrics->fd = -1;
+        unlink(metrics->path);
+    }
+    free(metrics->path);
+    metrics->path = NULL;
+}
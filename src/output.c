@@ -19,14 +19,22 @@
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/log.h>
 
+#include "infinidesk/bench.h"
 #include "infinidesk/canvas.h"
 #include "infinidesk/drawing.h"
 #include "infinidesk/drawing_ui.h"
+#include "infinidesk/latency.h"
 #include "infinidesk/layer_shell.h"
+#include "infinidesk/metrics.h"
 #include "infinidesk/output.h"
+#include "infinidesk/perf.h"
+#include "infinidesk/replay.h"
 #include "infinidesk/server.h"
+#include "infinidesk/snapshot.h"
 #include "infinidesk/switcher.h"
+#include "infinidesk/trace.h"
 #include "infinidesk/view.h"
+#include "infinidesk/watchdog.h"
 
 /* Background colour */
 static const float bg_colour[4] = {0.18f, 0.18f, 0.18f, 1.0f};
@@ -63,6 +71,12 @@ void handle_new_output(struct wl_listener *listener, void *data) {
 
     output->server = server;
     output->wlr_output = wlr_output;
+    render_governor_init(&output->governor, server->renderer,
+                         server->render_budget, server->quality_settle_ms);
+    perf_output_init(&output->perf, wlr_output->name, server->perf_enabled,
+                     server->watchdog.threshold_ns > 0 || server->bench ||
+                         server->snapshot || server->metrics_enabled);
+    output->trace_track = trace_register_track(wlr_output->name);
 
     /* Initialise layer surface lists */
     for (int i = 0; i < LAYER_SHELL_LAYER_COUNT; i++) {
@@ -73,6 +87,9 @@ void handle_new_output(struct wl_listener *listener, void *data) {
     output->frame.notify = output_handle_frame;
     wl_signal_add(&wlr_output->events.frame, &output->frame);
 
+    output->present.notify = output_handle_present;
+    wl_signal_add(&wlr_output->events.present, &output->present);
+
     output->request_state.notify = output_handle_request_state;
     wl_signal_add(&wlr_output->events.request_state, &output->request_state);
 
@@ -163,8 +180,15 @@ void output_handle_frame(struct wl_listener *listener, void *data) {
         wlr_log(WLR_DEBUG, "Drawing UI panel initialized");
     }
 
+    /* A replay's clock and input move on with the primary output's frames */
+    if (server->replay && output == output_get_primary(server)) {
+        replay_frame(server->replay, output->wlr_output->refresh);
+    }
+
     /* Use custom rendering pipeline */
+    watchdog_enter(&server->watchdog, "output_frame");
     output_render_custom(output);
+    watchdog_leave(&server->watchdog);
 }
 
 /*
@@ -174,11 +198,13 @@ void output_handle_frame(struct wl_listener *listener, void *data) {
 static void output_render_custom(struct infinidesk_output *output) {
     struct infinidesk_server *server = output->server;
     struct wlr_output *wlr_output = output->wlr_output;
+    struct perf_output *perf = &output->perf;
+
+    perf_frame_begin(perf);
+    uint64_t trace_start_ns = trace_now();
 
     /* Get current time for animations */
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    uint32_t time_ms = (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+    uint32_t time_ms = server_time_ms(server);
 
     /* Update focus animations */
     view_update_focus_animations(server, time_ms);
@@ -186,35 +212,50 @@ static void output_render_custom(struct infinidesk_output *output) {
     /* Update viewport snap animation */
     canvas_update_snap_animation(&server->canvas, time_ms);
 
+    /* Keep canvas coordinates near the viewport small */
+    canvas_rebase(&server->canvas);
+
+    /* Start timing the frame, and find out what quality to render at */
+    struct render_governor *governor = &output->governor;
+    struct wlr_render_timer *timer =
+        render_governor_begin(governor, &server->canvas, wlr_output->refresh);
+    const struct render_quality *quality = &governor->quality;
+
     /* Initialise output state */
     struct wlr_output_state state;
     wlr_output_state_init(&state);
 
     /* Begin a render pass */
-    struct wlr_render_pass *pass =
-        wlr_output_begin_render_pass(wlr_output, &state, NULL, NULL);
+    struct wlr_render_pass *pass = wlr_output_begin_render_pass(
+        wlr_output, &state, NULL,
+        &(struct wlr_buffer_pass_options){.timer = timer});
     if (!pass) {
         wlr_log(WLR_ERROR, "Failed to begin render pass");
         wlr_output_state_finish(&state);
+        metrics_frame_skipped(&output->metrics);
+        trace_complete(output->trace_track, "frame", trace_start_ns,
+                       "no render pass");
         return;
     }
+    hud_frame_begin(&server->hud, &output->hud);
 
     /* Get output dimensions in physical pixels for rendering */
     int width, height;
     wlr_output_transformed_resolution(wlr_output, &width, &height);
 
     /* Clear with background colour */
-    wlr_render_pass_add_rect(pass,
-                             &(struct wlr_render_rect_options){
-                                 .box = {.width = width, .height = height},
-                                 .color =
-                                     {
-                                         .r = bg_colour[0],
-                                         .g = bg_colour[1],
-                                         .b = bg_colour[2],
-                                         .a = bg_colour[3],
-                                     },
-                             });
+    perf_add_rect(pass,
+                  &(struct wlr_render_rect_options){
+                      .box = {.width = width, .height = height},
+                      .color =
+                          {
+                              .r = bg_colour[0],
+                              .g = bg_colour[1],
+                              .b = bg_colour[2],
+                              .a = bg_colour[3],
+                          },
+                  });
+    perf_mark(perf, PERF_STAGE_BEGIN);
 
     /*
      * Render in z-order:
@@ -231,60 +272,96 @@ static void output_render_custom(struct infinidesk_output *output) {
 
     /* 2. Bottom layer */
     render_layer_surfaces(output, pass, ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM);
+    perf_mark(perf, PERF_STAGE_LAYERS);
 
     /* 3. Render views back-to-front (reverse iteration since list is
      * front-to-back) */
     float output_scale = wlr_output->scale;
-    struct infinidesk_view *view;
-    wl_list_for_each_reverse(view, &server->views, link) {
-        if (!view->xdg_toplevel->base->surface->mapped) {
-            continue;
-        }
-        view_render(view, pass, output_scale);
+
+    /* Catch up on commits held back from throttled clients */
+    views_flush_commits(server, time_ms);
+
+    /* Only views whose bounds reach the visible part of the canvas */
+    struct view_cache *cache = &server->view_cache;
+    view_cache_update(cache, &server->views);
+    double min_x, min_y, max_x, max_y;
+    screen_to_canvas(&server->canvas, 0, 0, &min_x, &min_y);
+    screen_to_canvas(&server->canvas, width / output_scale,
+                     height / output_scale, &max_x, &max_y);
+    uint32_t visible = view_cache_cull(cache, min_x, min_y, max_x, max_y);
+    for (uint32_t i = visible; i-- > 0;) {
+        struct infinidesk_view *shown = cache->views[cache->visible[i]];
+        shown->shown_ms = time_ms;
+        view_render(shown, pass, output_scale, quality);
     }
+    perf_mark(perf, PERF_STAGE_VIEWS);
+
+    struct infinidesk_view *view;
 
     /* 3b. Render popups on top of all views (so context menus are visible) */
     wl_list_for_each_reverse(view, &server->views, link) {
         if (!view->xdg_toplevel->base->surface->mapped) {
             continue;
         }
-        view_render_popups(view, pass, output_scale);
+        view_render_popups(view, pass, output_scale, quality);
     }
+    perf_mark(perf, PERF_STAGE_POPUPS);
 
     /* 4. Top layer */
     render_layer_surfaces(output, pass, ZWLR_LAYER_SHELL_V1_LAYER_TOP);
 
     /* 5. Overlay layer */
     render_layer_surfaces(output, pass, ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY);
+    perf_mark(perf, PERF_STAGE_OVERLAYS);
 
     /* 6. Render drawing layer on top of everything */
-    drawing_render(&server->drawing, pass, width, height, output_scale);
+    drawing_render(&server->drawing, pass, width, height, output_scale,
+                   quality);
+    perf_mark(perf, PERF_STAGE_DRAWING);
 
     /* Render UI panel if drawing mode is active */
     if (server->drawing.drawing_mode) {
         drawing_ui_render(&server->drawing.ui_panel, &server->drawing, pass,
                           width, height, output_scale);
     }
+    perf_mark(perf, PERF_STAGE_UI);
 
     /* Render alt-tab switcher overlay */
     switcher_render(&server->switcher, pass, width, height, output_scale);
+    perf_mark(perf, PERF_STAGE_SWITCHER);
+
+    /* Render performance HUD */
+    hud_render(&server->hud, &output->hud, pass, visible, output_scale);
+    perf_mark(perf, PERF_STAGE_HUD);
 
     /* Submit the render pass */
     wlr_render_pass_submit(pass);
+    render_governor_end(governor);
+    hud_frame_end(&server->hud, &output->hud, governor->last_cpu_ns);
+    perf_mark(perf, PERF_STAGE_SUBMIT);
 
     /* Commit the output - check for failure */
-    if (!wlr_output_commit_state(wlr_output, &state)) {
+    bool committed = wlr_output_commit_state(wlr_output, &state);
+    if (!committed) {
         wlr_log(WLR_ERROR, "Failed to commit output state");
+    } else {
+        latency_frame_commit(&server->latency, &output->latency);
+        if (server->snapshot) {
+            snapshot_capture(server->snapshot, output, state.buffer);
+        }
     }
     wlr_output_state_finish(&state);
+    perf_mark(perf, PERF_STAGE_COMMIT);
 
     /* Send frame done to all mapped surfaces (including subsurfaces) */
+    uint64_t trace_done_ns = trace_now();
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
 
     /* Send frame done to views and their popups */
     wl_list_for_each(view, &server->views, link) {
-        if (view->xdg_toplevel->base->surface->mapped) {
+        if (view->xdg_toplevel->base->surface->mapped &&
+            view_frame_due(view, time_ms)) {
             wlr_xdg_surface_for_each_surface(view->xdg_toplevel->base,
                                              send_frame_done_iterator, &now);
             wlr_xdg_surface_for_each_popup_surface(
@@ -294,6 +371,24 @@ static void output_render_custom(struct infinidesk_output *output) {
 
     /* Send frame done to layer surfaces */
     send_layer_frame_done(output, &now);
+    trace_complete(output->trace_track, "frame_done", trace_done_ns, "%s",
+                   wlr_output->name);
+    trace_complete(output->trace_track, "frame", trace_start_ns,
+                   "quality %d", (int)quality->level);
+    perf_mark(perf, PERF_STAGE_FRAME_DONE);
+    perf_frame_end(perf);
+    watchdog_frame(&server->watchdog, wlr_output->name, &perf->current);
+    if (!committed) {
+        metrics_frame_skipped(&output->metrics);
+    } else if (server->metrics_enabled) {
+        metrics_frame_rendered(&output->metrics, perf->current.ns[PERF_TOTAL]);
+    }
+    if (server->bench) {
+        bench_frame(server->bench, output);
+    }
+    if (server->snapshot) {
+        snapshot_frame(server->snapshot, output);
+    }
 }
 
 /* Iterator to send frame_done to each surface */
@@ -305,6 +400,15 @@ static void send_frame_done_iterator(struct wlr_surface *surface, int sx,
     wlr_surface_send_frame_done(surface, now);
 }
 
+void output_handle_present(struct wl_listener *listener, void *data) {
+    struct infinidesk_output *output =
+        wl_container_of(listener, output, present);
+    const struct wlr_output_event_present *event = data;
+
+    latency_frame_present(&output->server->latency, &output->latency,
+                          event->presented, event->when);
+}
+
 void output_handle_request_state(struct wl_listener *listener, void *data) {
     struct infinidesk_output *output =
         wl_container_of(listener, output, request_state);
@@ -326,9 +430,13 @@ void output_handle_destroy(struct wl_listener *listener, void *data) {
 
     wl_list_remove(&output->link);
     wl_list_remove(&output->frame.link);
+    wl_list_remove(&output->present.link);
     wl_list_remove(&output->request_state.link);
     wl_list_remove(&output->destroy.link);
 
+    render_governor_finish(&output->governor);
+    perf_output_finish(&output->perf);
+    hud_output_finish(&output->hud);
     free(output);
 }
 
@@ -393,7 +501,7 @@ static void render_layer_surface_iterator(struct wlr_surface *surface, int sx,
     struct wlr_fbox src_box;
     wlr_surface_get_buffer_source_box(surface, &src_box);
 
-    wlr_render_pass_add_texture(
+    perf_add_texture(
         rdata->pass, &(struct wlr_render_texture_options){
                          .texture = texture,
                          .src_box = src_box,
@@ -0,0 +1,202 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * perf.c - Per-stage frame timing
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <wlr/render/pass.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/perf.h"
+
+/* How often percentiles are logged, in ns */
+#define PERF_REPORT_INTERVAL_NS 5000000000ull
+
+static const char *stage_names[] = {
+    [PERF_STAGE_BEGIN] = "begin",
+    [PERF_STAGE_LAYERS] = "layers",
+    [PERF_STAGE_VIEWS] = "views",
+    [PERF_STAGE_POPUPS] = "popups",
+    [PERF_STAGE_OVERLAYS] = "overlays",
+    [PERF_STAGE_DRAWING] = "drawing",
+    [PERF_STAGE_UI] = "ui",
+    [PERF_STAGE_SWITCHER] = "switcher",
+    [PERF_STAGE_HUD] = "hud",
+    [PERF_STAGE_SUBMIT] = "submit",
+    [PERF_STAGE_COMMIT] = "commit",
+    [PERF_STAGE_FRAME_DONE] = "frame_done",
+    [PERF_TOTAL] = "total",
+};
+
+/*
+ * Draws are counted as they are added with perf_add_rect() and
+ * perf_add_texture(). Only one pass is rendered at a time, so one set of
+ * counters will do.
+ */
+static uint64_t draw_rects;
+static uint64_t draw_textures;
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void perf_output_init(struct perf_output *perf, const char *name,
+                      bool enabled, bool timing) {
+    *perf = (struct perf_output){
+        .name = name,
+        .timing = timing,
+    };
+    if (!enabled) {
+        return;
+    }
+
+    perf->samples = calloc(PERF_WINDOW, sizeof(*perf->samples));
+    if (!perf->samples) {
+        wlr_log(WLR_ERROR, "Failed to allocate frame timings for %s", name);
+        return;
+    }
+    perf->enabled = true;
+    perf->timing = true;
+    perf->last_report_ns = get_time_ns();
+}
+
+void perf_output_finish(struct perf_output *perf) {
+    free(perf->samples);
+    perf->samples = NULL;
+    perf->enabled = false;
+    perf->timing = false;
+}
+
+void perf_frame_begin(struct perf_output *perf) {
+    if (!perf->timing) {
+        return;
+    }
+
+    perf->current = (struct perf_sample){0};
+    perf->frame_start_ns = get_time_ns();
+    perf->mark_ns = perf->frame_start_ns;
+    perf->rects_mark = draw_rects;
+    perf->textures_mark = draw_textures;
+}
+
+void perf_add_rect(struct wlr_render_pass *pass,
+                   const struct wlr_render_rect_options *options) {
+    draw_rects++;
+    wlr_render_pass_add_rect(pass, options);
+}
+
+void perf_add_texture(struct wlr_render_pass *pass,
+                      const struct wlr_render_texture_options *options) {
+    draw_textures++;
+    wlr_render_pass_add_texture(pass, options);
+}
+
+void perf_draw_counts(uint64_t *rects, uint64_t *textures) {
+    *rects = draw_rects;
+    *textures = draw_textures;
+}
+
+void perf_mark(struct perf_output *perf, enum perf_stage stage) {
+    if (!perf->timing) {
+        return;
+    }
+
+    uint64_t now = get_time_ns();
+    struct perf_sample *sample = &perf->current;
+    sample->ns[stage] += (uint32_t)(now - perf->mark_ns);
+    sample->rects[stage] += (uint32_t)(draw_rects - perf->rects_mark);
+    sample->textures[stage] += (uint32_t)(draw_textures - perf->textures_mark);
+
+    perf->mark_ns = now;
+    perf->rects_mark = draw_rects;
+    perf->textures_mark = draw_textures;
+}
+
+static void perf_report(struct perf_output *perf) {
+    for (unsigned int stage = 0; stage <= PERF_TOTAL; stage++) {
+        uint64_t p[3];
+        if (!perf_percentiles(perf, stage, p)) {
+            return;
+        }
+
+        uint64_t rects = 0, textures = 0;
+        if (stage < PERF_STAGE_COUNT) {
+            for (uint32_t i = 0; i < perf->count; i++) {
+                rects += perf->samples[i].rects[stage];
+                textures += perf->samples[i].textures[stage];
+            }
+        }
+
+        wlr_log(WLR_INFO,
+                "perf %s: %-10s p50 %7.3f  p95 %7.3f  p99 %7.3f ms  "
+                "%7.1f rects  %5.1f textures",
+                perf->name, perf_stage_name(stage), p[0] / 1e6, p[1] / 1e6,
+                p[2] / 1e6, (double)rects / perf->count,
+                (double)textures / perf->count);
+    }
+}
+
+void perf_frame_end(struct perf_output *perf) {
+    if (!perf->timing) {
+        return;
+    }
+
+    uint64_t now = get_time_ns();
+    perf->current.ns[PERF_TOTAL] = (uint32_t)(now - perf->frame_start_ns);
+    if (!perf->enabled) {
+        return;
+    }
+
+    perf->samples[perf->head] = perf->current;
+    perf->head = (perf->head + 1) % PERF_WINDOW;
+    if (perf->count < PERF_WINDOW) {
+        perf->count++;
+    }
+    perf->frames++;
+
+    if (now - perf->last_report_ns >= PERF_REPORT_INTERVAL_NS) {
+        perf->last_report_ns = now;
+        perf_report(perf);
+    }
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+bool perf_percentiles(const struct perf_output *perf, unsigned int stage,
+                      uint64_t out[3]) {
+    if (!perf->enabled || perf->count == 0 || stage > PERF_TOTAL) {
+        return false;
+    }
+
+    uint32_t values[PERF_WINDOW];
+    for (uint32_t i = 0; i < perf->count; i++) {
+        values[i] = perf->samples[i].ns[stage];
+    }
+    qsort(values, perf->count, sizeof(values[0]), compare_u32);
+
+    static const unsigned int percent[3] = {50, 95, 99};
+    for (int i = 0; i < 3; i++) {
+        out[i] = values[(perf->count - 1) * percent[i] / 100];
+    }
+    return true;
+}
+
+const char *perf_stage_name(unsigned int stage) {
+    if (stage > PERF_TOTAL) {
+        return "unknown";
+    }
+    return stage_names[stage];
+}
@@ -0,0 +1,204 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * point_codec.c - Compact fixed-point delta encoding of stroke points
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <string.h>
+
+#include <wayland-server-core.h>
+
+#include "infinidesk/point_codec.h"
+#include "infinidesk/stroke.h"
+
+/* Largest quantised coordinate, leaving headroom in the int32 seek table */
+#define POINT_CODEC_MAX_UNITS ((double)(1 << 30))
+
+/* Longest varint for a delta between two 31-bit positions */
+#define POINT_CODEC_MAX_VARINT 5
+
+static uint64_t zigzag_encode(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static bool get_varint(const uint8_t **pos, const uint8_t *end,
+                       uint64_t *v) {
+    const uint8_t *p = *pos;
+    uint64_t result = 0;
+    for (int shift = 0; shift < 7 * POINT_CODEC_MAX_VARINT; shift += 7) {
+        if (p == end) {
+            return false;
+        }
+        uint8_t byte = *p++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *pos = p;
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int32_t quantise(float v, float quantum) {
+    return (int32_t)lrint(v / quantum);
+}
+
+size_t point_codec_seek_size(uint32_t count) {
+    uint32_t entries = count == 0 ? 0
+                                  : (count - 1) / POINT_CODEC_SEEK_INTERVAL + 1;
+    return entries * sizeof(struct point_seek);
+}
+
+bool point_codec_pack(const struct drawing_point *points, uint32_t count,
+                      float *quantum, struct wl_array *out) {
+    /* Keep every quantised position representable */
+    float max_abs = 0.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        max_abs = fmaxf(max_abs, fmaxf(fabsf(points[i].x),
+                                       fabsf(points[i].y)));
+    }
+    float finest = (float)(max_abs / POINT_CODEC_MAX_UNITS);
+    if (!(*quantum >= finest && *quantum > 0.0f)) {
+        *quantum = finest > 0.0f ? finest : 1.0f;
+    }
+
+    /* Reserve the worst case, then give back what wasn't used */
+    size_t start = out->size;
+    size_t seek_size = point_codec_seek_size(count);
+    size_t max_size =
+        seek_size + (size_t)count * 2 * POINT_CODEC_MAX_VARINT;
+    if (!wl_array_add(out, max_size)) {
+        return false;
+    }
+
+    struct point_seek *seek = (struct point_seek *)((uint8_t *)out->data +
+                                                    start);
+    uint8_t *data = (uint8_t *)seek + seek_size;
+    uint8_t *p = data;
+    int32_t x = 0, y = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % POINT_CODEC_SEEK_INTERVAL == 0) {
+            seek[i / POINT_CODEC_SEEK_INTERVAL] = (struct point_seek){
+                .offset = (uint32_t)(p - data),
+                .x = x,
+                .y = y,
+            };
+        }
+
+        int32_t qx = quantise(points[i].x, *quantum);
+        int32_t qy = quantise(points[i].y, *quantum);
+        p = put_varint(p, zigzag_encode((int64_t)qx - x));
+        p = put_varint(p, zigzag_encode((int64_t)qy - y));
+        x = qx;
+        y = qy;
+    }
+
+    out->size = start + seek_size + (p - data);
+    return true;
+}
+
+bool point_codec_view(const void *block, size_t size, uint32_t count,
+                      float quantum, struct packed_points *packed) {
+    size_t seek_size = point_codec_seek_size(count);
+    if (size < seek_size || size - seek_size > UINT32_MAX ||
+        !(quantum > 0.0f)) {
+        return false;
+    }
+
+    packed->seek = block;
+    packed->data = (const uint8_t *)block + seek_size;
+    packed->size = (uint32_t)(size - seek_size);
+    packed->count = count;
+    packed->quantum = quantum;
+
+    /* Offsets are trusted when seeking, so check them once here */
+    uint32_t entries = seek_size / sizeof(struct point_seek);
+    for (uint32_t i = 0; i < entries; i++) {
+        if (packed->seek[i].offset > packed->size ||
+            (i > 0 && packed->seek[i].offset < packed->seek[i - 1].offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void point_cursor_init_packed(struct point_cursor *cursor,
+                              const struct packed_points *packed,
+                              uint32_t first, uint32_t count) {
+    *cursor = (struct point_cursor){
+        .end = packed->data + packed->size,
+        .quantum = packed->quantum,
+    };
+    if (first >= packed->count || count == 0) {
+        cursor->pos = cursor->end;
+        return;
+    }
+
+    /* Jump to the nearest seek point, then skip forward to first */
+    const struct point_seek *seek =
+        &packed->seek[first / POINT_CODEC_SEEK_INTERVAL];
+    cursor->pos = packed->data + seek->offset;
+    cursor->x = seek->x;
+    cursor->y = seek->y;
+    cursor->remaining = first % POINT_CODEC_SEEK_INTERVAL;
+
+    struct drawing_point skipped;
+    while (cursor->remaining > 0 && point_cursor_next(cursor, &skipped)) {
+    }
+    cursor->remaining = count;
+}
+
+void point_cursor_init_plain(struct point_cursor *cursor,
+                             const struct drawing_point *points,
+                             uint32_t count) {
+    *cursor = (struct point_cursor){
+        .plain = points,
+        .remaining = count,
+    };
+}
+
+bool point_cursor_next(struct point_cursor *cursor,
+                       struct drawing_point *point) {
+    if (cursor->remaining == 0) {
+        return false;
+    }
+
+    if (cursor->plain) {
+        *point = *cursor->plain++;
+        cursor->remaining--;
+        return true;
+    }
+
+    uint64_t dx, dy;
+    if (!get_varint(&cursor->pos, cursor->end, &dx) ||
+        !get_varint(&cursor->pos, cursor->end, &dy)) {
+        cursor->remaining = 0;
+        return false;
+    }
+    cursor->x += zigzag_decode(dx);
+    cursor->y += zigzag_decode(dy);
+    cursor->remaining--;
+
+    point->x = (float)cursor->x * cursor->quantum;
+    point->y = (float)cursor->y * cursor->quantum;
+    return true;
+}
@@ -0,0 +1,172 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * render_governor.c - Adaptive render quality under a frame time budget
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/canvas.h"
+#include "infinidesk/render_governor.h"
+
+/* Consecutive frames over budget before quality is stepped down */
+#define RENDER_GOVERNOR_OVER_FRAMES 2
+/* Refresh rate assumed for outputs that don't report one, in mHz */
+#define RENDER_GOVERNOR_DEFAULT_REFRESH 60000
+
+static const struct render_quality quality_levels[] = {
+    [RENDER_QUALITY_FULL] =
+        {
+            .level = RENDER_QUALITY_FULL,
+            .stroke_error = 1.0,
+        },
+    [RENDER_QUALITY_REDUCED] =
+        {
+            .level = RENDER_QUALITY_REDUCED,
+            .nearest_filter = true,
+            .skip_corner_masks = true,
+            .stroke_error = 2.0,
+        },
+    [RENDER_QUALITY_MINIMAL] =
+        {
+            .level = RENDER_QUALITY_MINIMAL,
+            .nearest_filter = true,
+            .skip_corner_masks = true,
+            .stale_scaled = true,
+            .stroke_error = 8.0,
+        },
+};
+
+static const char *level_names[] = {
+    [RENDER_QUALITY_FULL] = "full",
+    [RENDER_QUALITY_REDUCED] = "reduced",
+    [RENDER_QUALITY_MINIMAL] = "minimal",
+};
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void render_governor_init(struct render_governor *governor,
+                          struct wlr_renderer *renderer, float budget,
+                          uint32_t settle_ms) {
+    *governor = (struct render_governor){
+        .budget = budget,
+        .settle_ms = settle_ms,
+        .quality = quality_levels[RENDER_QUALITY_FULL],
+        .last_gpu_ns = -1,
+    };
+
+    /* Not every renderer can time its work on the GPU */
+    governor->timer = wlr_render_timer_create(renderer);
+}
+
+void render_governor_finish(struct render_governor *governor) {
+    if (governor->timer) {
+        wlr_render_timer_destroy(governor->timer);
+        governor->timer = NULL;
+    }
+}
+
+static void set_level(struct render_governor *governor,
+                      enum render_quality_level level, const char *reason) {
+    wlr_log(WLR_DEBUG,
+            "Render quality %s -> %s (%s; cpu %.2f ms, gpu %.2f ms, "
+            "budget %.2f ms)",
+            level_names[governor->quality.level], level_names[level], reason,
+            governor->last_cpu_ns / 1e6,
+            governor->last_gpu_ns >= 0 ? governor->last_gpu_ns / 1e6 : 0.0,
+            governor->budget_ns / 1e6);
+    governor->quality = quality_levels[level];
+}
+
+struct wlr_render_timer *
+render_governor_begin(struct render_governor *governor,
+                      struct infinidesk_canvas *canvas, int refresh_mhz) {
+    uint64_t now = get_time_ns();
+
+    if (refresh_mhz <= 0) {
+        refresh_mhz = RENDER_GOVERNOR_DEFAULT_REFRESH;
+    }
+    governor->budget_ns =
+        (uint64_t)(1e12 / refresh_mhz * (double)governor->budget);
+
+    /*
+     * The previous frame's GPU time is only known once the GPU has caught
+     * up, so frames are judged when the next one starts.
+     */
+    bool judged = governor->frame_ended;
+    governor->frame_ended = false;
+    if (governor->timer_pending) {
+        governor->last_gpu_ns =
+            wlr_render_timer_get_duration_ns(governor->timer);
+        governor->timer_pending = false;
+    }
+
+    /* Motion since the previous frame, in absolute canvas terms */
+    double x = (double)canvas->origin_x + canvas->viewport_x;
+    double y = (double)canvas->origin_y + canvas->viewport_y;
+    bool moving = x != governor->last_x || y != governor->last_y ||
+                  canvas->scale != governor->last_scale ||
+                  canvas->snap_anim_active;
+    governor->last_x = x;
+    governor->last_y = y;
+    governor->last_scale = canvas->scale;
+
+    if (judged) {
+        uint64_t frame_ns = governor->last_cpu_ns;
+        if (governor->last_gpu_ns > (int64_t)frame_ns) {
+            frame_ns = (uint64_t)governor->last_gpu_ns;
+        }
+        bool over = frame_ns > governor->budget_ns;
+        governor->frames++;
+        if (over) {
+            governor->frames_over_budget++;
+            governor->over_budget_run++;
+        } else {
+            governor->over_budget_run = 0;
+        }
+
+        /* Only trade quality for speed while things are moving */
+        enum render_quality_level level = governor->quality.level;
+        if (moving && level + 1 < RENDER_QUALITY_LEVEL_COUNT &&
+            governor->over_budget_run >= RENDER_GOVERNOR_OVER_FRAMES) {
+            set_level(governor, level + 1, "over budget");
+            governor->over_budget_run = 0;
+            governor->downgrades++;
+        }
+    }
+
+    if (moving) {
+        governor->last_motion_ns = now;
+    } else if (governor->quality.level != RENDER_QUALITY_FULL &&
+               now - governor->last_motion_ns >=
+                   (uint64_t)governor->settle_ms * 1000000) {
+        set_level(governor, RENDER_QUALITY_FULL, "settled");
+    }
+
+    governor->cpu_start_ns = now;
+    return governor->timer;
+}
+
+void render_governor_end(struct render_governor *governor) {
+    governor->last_cpu_ns = get_time_ns() - governor->cpu_start_ns;
+    governor->timer_pending = governor->timer != NULL;
+    governor->frame_ended = true;
+}
+
+const char *render_quality_name(enum render_quality_level level) {
+    if (level >= RENDER_QUALITY_LEVEL_COUNT) {
+        return "unknown";
+    }
+    return level_names[level];
+}
@@ -0,0 +1,363 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * replay.c - Input recording and deterministic replay
+ *
+ * A recording is a header followed by events, each a type byte, a time and
+ * the fields for that type, all in native byte order:
+ *
+ *   "IDREPLAY" u32 version, u32 width, u32 height
+ *   u8 type, u32 time_msec, fields...
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/interfaces/wlr_pointer.h>
+#include <wlr/types/wlr_cursor.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/input.h"
+#include "infinidesk/replay.h"
+#include "infinidesk/server.h"
+
+#define REPLAY_MAGIC "IDREPLAY"
+#define REPLAY_VERSION 1
+
+/* Assumed refresh rate for outputs that don't have one, in mHz */
+#define REPLAY_DEFAULT_REFRESH 60000
+
+static const struct wlr_pointer_impl pointer_impl = {
+    .name = "replay-pointer",
+};
+
+static const struct wlr_keyboard_impl keyboard_impl = {
+    .name = "replay-keyboard",
+};
+
+/* The recording in progress, if any */
+static struct {
+    FILE *file;
+    bool started;
+    uint32_t base_ms;
+    uint64_t events;
+} recording;
+
+static uint32_t get_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static bool write_header(FILE *file, uint32_t width, uint32_t height) {
+    uint32_t version = REPLAY_VERSION;
+    return fwrite(REPLAY_MAGIC, 8, 1, file) == 1 &&
+           fwrite(&version, sizeof(version), 1, file) == 1 &&
+           fwrite(&width, sizeof(width), 1, file) == 1 &&
+           fwrite(&height, sizeof(height), 1, file) == 1;
+}
+
+bool replay_record_start(const char *path) {
+    recording.file = fopen(path, "wb");
+    if (!recording.file) {
+        wlr_log_errno(WLR_ERROR, "Failed to open %s", path);
+        return false;
+    }
+
+    /* The output size is filled in when recording stops */
+    if (!write_header(recording.file, 0, 0)) {
+        wlr_log_errno(WLR_ERROR, "Failed to write %s", path);
+        fclose(recording.file);
+        recording.file = NULL;
+        return false;
+    }
+
+    recording.started = false;
+    recording.events = 0;
+    wlr_log(WLR_INFO, "Recording input to %s", path);
+    return true;
+}
+
+#define WRITE(field) fwrite(&(field), sizeof(field), 1, file)
+
+void replay_record(const struct replay_event *event) {
+    FILE *file = recording.file;
+    if (!file) {
+        return;
+    }
+
+    if (!recording.started) {
+        recording.base_ms = event->time_msec;
+        recording.started = true;
+    }
+
+    uint8_t type = event->type;
+    uint32_t time_msec = event->time_msec - recording.base_ms;
+    WRITE(type);
+    WRITE(time_msec);
+
+    switch (event->type) {
+    case REPLAY_MOTION:
+        WRITE(event->motion.dx);
+        WRITE(event->motion.dy);
+        WRITE(event->motion.unaccel_dx);
+        WRITE(event->motion.unaccel_dy);
+        break;
+    case REPLAY_MOTION_ABSOLUTE:
+        WRITE(event->absolute.x);
+        WRITE(event->absolute.y);
+        break;
+    case REPLAY_BUTTON:
+        WRITE(event->button.button);
+        WRITE(event->button.state);
+        break;
+    case REPLAY_AXIS:
+        WRITE(event->axis.source);
+        WRITE(event->axis.orientation);
+        WRITE(event->axis.relative_direction);
+        WRITE(event->axis.delta_discrete);
+        WRITE(event->axis.delta);
+        break;
+    case REPLAY_FRAME:
+        break;
+    case REPLAY_KEY:
+        WRITE(event->key.keycode);
+        WRITE(event->key.state);
+        break;
+    }
+    recording.events++;
+}
+
+#undef WRITE
+
+void replay_record_stop(uint32_t width, uint32_t height) {
+    if (!recording.file) {
+        return;
+    }
+
+    if (fseek(recording.file, 0, SEEK_SET) < 0 ||
+        !write_header(recording.file, width, height)) {
+        wlr_log_errno(WLR_ERROR, "Failed to finish input recording");
+    }
+    if (fclose(recording.file) != 0) {
+        wlr_log_errno(WLR_ERROR, "Failed to write input recording");
+    }
+    recording.file = NULL;
+
+    wlr_log(WLR_INFO, "Recorded %lu input events on a %ux%u output",
+            (unsigned long)recording.events, width, height);
+}
+
+#define READ(field) (fread(&(field), sizeof(field), 1, file) == 1)
+
+static bool read_event(FILE *file, struct replay_event *event) {
+    uint8_t type;
+    if (!READ(type) || !READ(event->time_msec)) {
+        return false;
+    }
+    event->type = type;
+
+    switch (event->type) {
+    case REPLAY_MOTION:
+        return READ(event->motion.dx) && READ(event->motion.dy) &&
+               READ(event->motion.unaccel_dx) &&
+               READ(event->motion.unaccel_dy);
+    case REPLAY_MOTION_ABSOLUTE:
+        return READ(event->absolute.x) && READ(event->absolute.y);
+    case REPLAY_BUTTON:
+        return READ(event->button.button) && READ(event->button.state);
+    case REPLAY_AXIS:
+        return READ(event->axis.source) && READ(event->axis.orientation) &&
+               READ(event->axis.relative_direction) &&
+               READ(event->axis.delta_discrete) && READ(event->axis.delta);
+    case REPLAY_FRAME:
+        return true;
+    case REPLAY_KEY:
+        return READ(event->key.keycode) && READ(event->key.state);
+    }
+
+    wlr_log(WLR_ERROR, "Unknown event type %u in recording", type);
+    return false;
+}
+
+bool replay_load(struct infinidesk_replay *replay, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        wlr_log_errno(WLR_ERROR, "Failed to open %s", path);
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version;
+    if (fread(magic, sizeof(magic), 1, file) != 1 ||
+        memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0 || !READ(version) ||
+        version != REPLAY_VERSION || !READ(replay->width) ||
+        !READ(replay->height)) {
+        wlr_log(WLR_ERROR, "%s is not an input recording", path);
+        fclose(file);
+        return false;
+    }
+
+    size_t capacity = 0;
+    struct replay_event event;
+    while (read_event(file, &event)) {
+        if (replay->event_count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            struct replay_event *events =
+                realloc(replay->events, capacity * sizeof(*events));
+            if (!events) {
+                wlr_log(WLR_ERROR, "Failed to allocate recording");
+                fclose(file);
+                return false;
+            }
+            replay->events = events;
+        }
+        replay->events[replay->event_count++] = event;
+    }
+    fclose(file);
+
+    wlr_log(WLR_INFO, "Loaded %zu input events recorded on a %ux%u output",
+            replay->event_count, replay->width, replay->height);
+    return true;
+}
+
+#undef READ
+
+void replay_start(struct infinidesk_replay *replay,
+                  struct infinidesk_server *server) {
+    replay->server = server;
+    replay->base_ms = get_time_ms();
+    replay->clock_us = 0;
+
+    /* Added as if the backend had found them */
+    wlr_pointer_init(&replay->pointer, &pointer_impl, pointer_impl.name);
+    wlr_keyboard_init(&replay->keyboard, &keyboard_impl, keyboard_impl.name);
+    handle_new_input(&server->new_input, &replay->pointer.base);
+    handle_new_input(&server->new_input, &replay->keyboard.base);
+
+    server->replay = replay;
+}
+
+void replay_finish(struct infinidesk_replay *replay) {
+    if (replay->server) {
+        /* Their destroy signals detach them from the cursor and seat */
+        wlr_keyboard_finish(&replay->keyboard);
+        wlr_pointer_finish(&replay->pointer);
+        replay->server->replay = NULL;
+        replay->server = NULL;
+    }
+    free(replay->events);
+    replay->events = NULL;
+    replay->event_count = 0;
+}
+
+void replay_play(struct infinidesk_replay *replay) {
+    replay->playing = true;
+    replay->play_start_us = replay->clock_us;
+    replay->next_event = 0;
+    replay->settle_frames = 0;
+}
+
+static void inject(struct infinidesk_replay *replay,
+                   const struct replay_event *event) {
+    struct wlr_pointer *pointer = &replay->pointer;
+    uint32_t time_msec = replay_time_ms(replay);
+
+    switch (event->type) {
+    case REPLAY_MOTION: {
+        struct wlr_pointer_motion_event motion = {
+            .pointer = pointer,
+            .time_msec = time_msec,
+            .delta_x = event->motion.dx,
+            .delta_y = event->motion.dy,
+            .unaccel_dx = event->motion.unaccel_dx,
+            .unaccel_dy = event->motion.unaccel_dy,
+        };
+        wl_signal_emit_mutable(&pointer->events.motion, &motion);
+        break;
+    }
+    case REPLAY_MOTION_ABSOLUTE: {
+        struct wlr_pointer_motion_absolute_event motion = {
+            .pointer = pointer,
+            .time_msec = time_msec,
+            .x = event->absolute.x,
+            .y = event->absolute.y,
+        };
+        wl_signal_emit_mutable(&pointer->events.motion_absolute, &motion);
+        break;
+    }
+    case REPLAY_BUTTON: {
+        struct wlr_pointer_button_event button = {
+            .pointer = pointer,
+            .time_msec = time_msec,
+            .button = event->button.button,
+            .state = event->button.state,
+        };
+        wl_signal_emit_mutable(&pointer->events.button, &button);
+        break;
+    }
+    case REPLAY_AXIS: {
+        struct wlr_pointer_axis_event axis = {
+            .pointer = pointer,
+            .time_msec = time_msec,
+            .source = event->axis.source,
+            .orientation = event->axis.orientation,
+            .relative_direction = event->axis.relative_direction,
+            .delta = event->axis.delta,
+            .delta_discrete = event->axis.delta_discrete,
+        };
+        wl_signal_emit_mutable(&pointer->events.axis, &axis);
+        break;
+    }
+    case REPLAY_FRAME:
+        wl_signal_emit_mutable(&pointer->events.frame, pointer);
+        break;
+    case REPLAY_KEY: {
+        struct wlr_keyboard_key_event key = {
+            .time_msec = time_msec,
+            .keycode = event->key.keycode,
+            .update_state = true,
+            .state = event->key.state,
+        };
+        wlr_keyboard_notify_key(&replay->keyboard, &key);
+        break;
+    }
+    }
+}
+
+void replay_frame(struct infinidesk_replay *replay, int32_t refresh_mhz) {
+    if (refresh_mhz <= 0) {
+        refresh_mhz = REPLAY_DEFAULT_REFRESH;
+    }
+    replay->clock_us += 1000000000ull / refresh_mhz;
+
+    if (!replay->playing || replay->done) {
+        return;
+    }
+
+    uint64_t elapsed_us = replay->clock_us - replay->play_start_us;
+    while (replay->next_event < replay->event_count) {
+        const struct replay_event *event = &replay->events[replay->next_event];
+        if ((uint64_t)event->time_msec * 1000 > elapsed_us) {
+            return;
+        }
+        replay->next_event++;
+        inject(replay, event);
+    }
+
+    /* All injected: let whatever they started finish */
+    if (++replay->settle_frames >= REPLAY_SETTLE_FRAMES) {
+        replay->done = true;
+    }
+}
+
+uint32_t replay_time_ms(const struct infinidesk_replay *replay) {
+    return replay->base_ms + (uint32_t)(replay->clock_us / 1000);
+}
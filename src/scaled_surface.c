@@ -0,0 +1,276 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * scaled_surface.c - Pre-scaled surface textures for software rendering
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <drm_fourcc.h>
+#include <math.h>
+#include <pixman.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <wlr/render/pixman.h>
+#include <wlr/util/addon.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/scaled_surface.h"
+
+/*
+ * Copies kept per surface, one for each size it is drawn at, so outputs at
+ * different scales don't take turns redoing a single copy
+ */
+#define SCALED_SURFACE_COPIES 4
+/* Copies not drawn for this long are freed, such as those from a zoom (ms) */
+#define SCALED_SURFACE_KEEP_MS 1000
+
+/* A copy of a surface's texture scaled to one size */
+struct scaled_copy {
+    /* What the scaled texture was made from */
+    struct wlr_texture *source;
+    struct wlr_fbox src_box;
+    bool dirty; /* The surface has new content */
+
+    struct wlr_texture *texture; /* NULL if the slot is free */
+    uint64_t last_used;          /* ms */
+};
+
+/* A surface's scaled textures, attached to the surface */
+struct scaled_surface {
+    struct wlr_addon addon;
+    struct wlr_surface *surface;
+    struct wl_listener commit;
+
+    struct scaled_copy copies[SCALED_SURFACE_COPIES];
+};
+
+/* Bytes of scaled textures in existence */
+static size_t scaled_memory;
+
+static size_t texture_bytes(struct wlr_texture *texture) {
+    return (size_t)texture->width * texture->height * 4;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void destroy_texture(struct scaled_copy *copy) {
+    scaled_memory -= texture_bytes(copy->texture);
+    wlr_texture_destroy(copy->texture);
+    copy->texture = NULL;
+}
+
+static void scaled_surface_destroy(struct scaled_surface *scaled) {
+    wl_list_remove(&scaled->commit.link);
+    wlr_addon_finish(&scaled->addon);
+    for (int i = 0; i < SCALED_SURFACE_COPIES; i++) {
+        if (scaled->copies[i].texture) {
+            destroy_texture(&scaled->copies[i]);
+        }
+    }
+    free(scaled);
+}
+
+static void handle_addon_destroy(struct wlr_addon *addon) {
+    struct scaled_surface *scaled = wl_container_of(addon, scaled, addon);
+    scaled_surface_destroy(scaled);
+}
+
+static const struct wlr_addon_interface scaled_surface_addon_impl = {
+    .name = "infinidesk_scaled_surface",
+    .destroy = handle_addon_destroy,
+};
+
+static void handle_commit(struct wl_listener *listener, void *data) {
+    (void)data;
+    struct scaled_surface *scaled = wl_container_of(listener, scaled, commit);
+
+    /* Commits that only ask for a frame callback leave the content alone */
+    if (pixman_region32_not_empty(&scaled->surface->buffer_damage)) {
+        for (int i = 0; i < SCALED_SURFACE_COPIES; i++) {
+            scaled->copies[i].dirty = true;
+        }
+    }
+}
+
+/*
+ * Whether a scale factor is a whole number, or one over a whole number, so
+ * that every destination pixel maps to exactly one source pixel.
+ */
+static bool is_integer_ratio(double ratio) {
+    if (ratio < 1.0) {
+        ratio = 1.0 / ratio;
+    }
+    return fabs(ratio - round(ratio)) < 1e-6;
+}
+
+/*
+ * Scale the part box of src to fill dst.
+ */
+static void scale_image(pixman_image_t *src, const struct wlr_fbox *box,
+                        pixman_image_t *dst, int width, int height) {
+    double ratio_x = box->width / width;
+    double ratio_y = box->height / height;
+
+    /* Maps destination pixels to source pixels */
+    pixman_transform_t transform;
+    pixman_transform_init_scale(&transform, pixman_double_to_fixed(ratio_x),
+                                pixman_double_to_fixed(ratio_y));
+    pixman_transform_translate(&transform, NULL,
+                               pixman_double_to_fixed(box->x),
+                               pixman_double_to_fixed(box->y));
+
+    pixman_filter_t filter =
+        is_integer_ratio(ratio_x) && is_integer_ratio(ratio_y)
+            ? PIXMAN_FILTER_NEAREST
+            : PIXMAN_FILTER_BILINEAR;
+
+    pixman_image_set_transform(src, &transform);
+    pixman_image_set_filter(src, filter, NULL, 0);
+    pixman_image_composite32(PIXMAN_OP_SRC, src, NULL, dst, 0, 0, 0, 0, 0, 0,
+                             width, height);
+
+    /* The source belongs to the client's buffer, so leave it as it was */
+    pixman_image_set_transform(src, NULL);
+}
+
+static bool scaled_copy_update(struct scaled_copy *copy,
+                               struct wlr_renderer *renderer,
+                               struct wlr_texture *texture,
+                               const struct wlr_fbox *src_box, int width,
+                               int height) {
+    pixman_image_t *src = wlr_pixman_texture_get_image(texture);
+    if (!src) {
+        return false;
+    }
+
+    if (copy->texture && ((int)copy->texture->width != width ||
+                            (int)copy->texture->height != height)) {
+        destroy_texture(copy);
+    }
+
+    if (copy->texture) {
+        /*
+         * Same size as before, so scale straight into the texture's own
+         * image rather than allocating a new texture for every commit.
+         */
+        scale_image(src, src_box, wlr_pixman_texture_get_image(copy->texture),
+                    width, height);
+    } else {
+        pixman_image_t *image =
+            pixman_image_create_bits(PIXMAN_a8r8g8b8, width, height, NULL, 0);
+        if (!image) {
+            return false;
+        }
+        scale_image(src, src_box, image, width, height);
+        copy->texture = wlr_texture_from_pixels(
+            renderer, DRM_FORMAT_ARGB8888, pixman_image_get_stride(image),
+            width, height, pixman_image_get_data(image));
+        pixman_image_unref(image);
+        if (!copy->texture) {
+            return false;
+        }
+        scaled_memory += texture_bytes(copy->texture);
+    }
+
+    copy->source = texture;
+    copy->src_box = *src_box;
+    copy->dirty = false;
+    return true;
+}
+
+static bool copy_has_size(struct scaled_copy *copy, int width, int height) {
+    return (int)copy->texture->width == width &&
+           (int)copy->texture->height == height;
+}
+
+/*
+ * Choose the copy to redo at a size: one that is already that size, so its
+ * texture is reused, or a free slot, or else the least recently drawn.
+ */
+static struct scaled_copy *choose_slot(struct scaled_surface *scaled,
+                                       int width, int height) {
+    struct scaled_copy *free_slot = NULL, *oldest = NULL;
+    for (int i = 0; i < SCALED_SURFACE_COPIES; i++) {
+        struct scaled_copy *copy = &scaled->copies[i];
+        if (!copy->texture) {
+            free_slot = free_slot ? free_slot : copy;
+        } else if (copy_has_size(copy, width, height)) {
+            return copy;
+        } else if (!oldest || copy->last_used < oldest->last_used) {
+            oldest = copy;
+        }
+    }
+    return free_slot ? free_slot : oldest;
+}
+
+struct wlr_texture *scaled_surface_get(struct wlr_renderer *renderer,
+                                       struct wlr_surface *surface,
+                                       struct wlr_texture *texture,
+                                       const struct wlr_fbox *src_box,
+                                       int width, int height,
+                                       bool allow_stale) {
+    struct scaled_surface *scaled;
+    struct wlr_addon *addon =
+        wlr_addon_find(&surface->addons, renderer, &scaled_surface_addon_impl);
+    if (addon) {
+        scaled = wl_container_of(addon, scaled, addon);
+    } else {
+        scaled = calloc(1, sizeof(*scaled));
+        if (!scaled) {
+            wlr_log(WLR_ERROR, "Failed to allocate scaled surface");
+            return NULL;
+        }
+        scaled->surface = surface;
+        wlr_addon_init(&scaled->addon, &surface->addons, renderer,
+                       &scaled_surface_addon_impl);
+        scaled->commit.notify = handle_commit;
+        wl_signal_add(&surface->events.commit, &scaled->commit);
+    }
+
+    /*
+     * Use a current copy of this size or, if allowed, the current copy most
+     * recently drawn at any size
+     */
+    uint64_t now = now_ms();
+    struct scaled_copy *exact = NULL, *stale = NULL;
+    for (int i = 0; i < SCALED_SURFACE_COPIES; i++) {
+        struct scaled_copy *copy = &scaled->copies[i];
+        if (copy->texture && now - copy->last_used > SCALED_SURFACE_KEEP_MS) {
+            destroy_texture(copy);
+        }
+        if (!copy->texture || copy->dirty || copy->source != texture ||
+            !wlr_fbox_equal(&copy->src_box, src_box)) {
+            continue;
+        }
+        if (copy_has_size(copy, width, height)) {
+            exact = copy;
+        } else if (!stale || copy->last_used > stale->last_used) {
+            stale = copy;
+        }
+    }
+
+    struct scaled_copy *copy = exact ? exact : allow_stale ? stale : NULL;
+    if (!copy) {
+        copy = choose_slot(scaled, width, height);
+        if (!scaled_copy_update(copy, renderer, texture, src_box, width,
+                                height)) {
+            wlr_log(WLR_ERROR, "Failed to scale surface texture");
+            scaled_surface_destroy(scaled);
+            return NULL;
+        }
+    }
+    copy->last_used = now;
+    return copy->texture;
+}
+
+size_t scaled_surface_memory(void) {
+    return scaled_memory;
+}
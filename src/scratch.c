@@ -0,0 +1,86 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * scratch.c - Throwaway XDG directories for headless runs
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <wlr/util/log.h>
+
+#include "infinidesk/scratch.h"
+
+/* Make a directory in the scratch directory and point a variable at it */
+static bool make_subdir(struct scratch_env *env, const char *name,
+                        const char *variable) {
+    char path[sizeof(env->dir) + 16];
+    snprintf(path, sizeof(path), "%s/%s", env->dir, name);
+    if (mkdir(path, 0700) < 0) {
+        wlr_log_errno(WLR_ERROR, "Failed to create %s", path);
+        return false;
+    }
+    setenv(variable, path, true);
+    return true;
+}
+
+bool scratch_env_create(struct scratch_env *env, const char *name) {
+    snprintf(env->dir, sizeof(env->dir), "/tmp/infinidesk-%s-XXXXXX", name);
+    if (!mkdtemp(env->dir)) {
+        wlr_log_errno(WLR_ERROR, "Failed to create a scratch directory");
+        env->dir[0] = '\0';
+        return false;
+    }
+
+    if (!make_subdir(env, "data", "XDG_DATA_HOME") ||
+        !make_subdir(env, "config", "XDG_CONFIG_HOME")) {
+        scratch_env_remove(env);
+        return false;
+    }
+    wlr_log(WLR_INFO, "Using scratch directory %s", env->dir);
+    return true;
+}
+
+/* Remove a directory and everything in it */
+static void remove_tree(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir))) {
+            if (strcmp(entry->d_name, ".") == 0 ||
+                strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            size_t len = strlen(path) + strlen(entry->d_name) + 2;
+            char *child = malloc(len);
+            if (!child) {
+                continue;
+            }
+            snprintf(child, len, "%s/%s", path, entry->d_name);
+            struct stat st;
+            if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+                remove_tree(child);
+            } else {
+                unlink(child);
+            }
+            free(child);
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+void scratch_env_remove(struct scratch_env *env) {
+    if (env->dir[0] != '\0') {
+        remove_tree(env->dir);
+        env->dir[0] = '\0';
+    }
+}
@@ -0,0 +1,41 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * send_buffer.c - Text sent a piece at a time on a non-blocking socket
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "infinidesk/send_buffer.h"
+
+enum send_result send_buffer_flush(struct send_buffer *buffer, int fd) {
+    while (buffer->sent < buffer->size) {
+        /* A plain write() would raise SIGPIPE, which kills the compositor */
+        ssize_t n = send(fd, buffer->data + buffer->sent,
+                         buffer->size - buffer->sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return SEND_PENDING;
+        }
+        if (n <= 0) {
+            return SEND_FAILED;
+        }
+        buffer->sent += n;
+    }
+    return SEND_DONE;
+}
+
+void send_buffer_finish(struct send_buffer *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->sent = 0;
+}
@@ -8,7 +8,10 @@
 
 #define _POSIX_C_SOURCE 200809L
 
+#include <errno.h>
+#include <poll.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <wlr/backend.h>
 #include <wlr/render/allocator.h>
@@ -30,12 +33,15 @@
 
 #include "infinidesk/background.h"
 #include "infinidesk/canvas.h"
+#include "infinidesk/client_stats.h"
 #include "infinidesk/cursor.h"
 #include "infinidesk/drawing.h"
+#include "infinidesk/hud.h"
 #include "infinidesk/input.h"
 #include "infinidesk/keyboard.h"
 #include "infinidesk/layer_shell.h"
 #include "infinidesk/output.h"
+#include "infinidesk/replay.h"
 #include "infinidesk/server.h"
 #include "infinidesk/switcher.h"
 #include "infinidesk/view.h"
@@ -46,6 +52,10 @@ bool server_init(struct infinidesk_server *server) {
 
     /* Set default output scale (will be overridden by config if loaded) */
     server->output_scale = 1.0f;
+    server->render_budget = RENDER_GOVERNOR_DEFAULT_BUDGET;
+    server->quality_settle_ms = RENDER_GOVERNOR_DEFAULT_SETTLE_MS;
+    server->stall_threshold_ms = WATCHDOG_DEFAULT_THRESHOLD_MS;
+    server->max_commit_rate = CLIENT_DEFAULT_MAX_COMMIT_RATE;
 
     /* Create the Wayland display */
     server->wl_display = wl_display_create();
@@ -163,17 +173,25 @@ bool server_init(struct infinidesk_server *server) {
     /* Initialise lists */
     wl_list_init(&server->outputs);
     wl_list_init(&server->views);
+    wl_list_init(&server->clients);
     wl_list_init(&server->keyboards);
+    view_cache_init(&server->view_cache);
 
     /* Initialise the canvas */
     canvas_init(&server->canvas, server);
 
     /* Initialise drawing layer */
-    drawing_init(&server->drawing, server);
+    if (!drawing_init(&server->drawing, server)) {
+        wlr_log(WLR_ERROR, "Failed to restore annotations");
+        goto error_scene;
+    }
 
     /* Initialise alt-tab switcher */
     switcher_init(&server->switcher, server);
 
+    /* Initialise performance HUD */
+    hud_init(&server->hud, server);
+
     /* Initialise output handling */
     output_init(server);
 
@@ -211,6 +229,10 @@ error_display:
 }
 
 bool server_start(struct infinidesk_server *server) {
+    /* Before the backend starts, as outputs time their frames for it */
+    watchdog_init(&server->watchdog, server->stall_threshold_ms);
+    latency_init(&server->latency, server->perf_enabled);
+
     /* Add a Unix socket to the Wayland display */
     const char *socket = wl_display_add_socket_auto(server->wl_display);
     if (!socket) {
@@ -229,11 +251,59 @@ bool server_start(struct infinidesk_server *server) {
     wlr_log(WLR_INFO, "Running Wayland compositor on WAYLAND_DISPLAY=%s",
             socket);
 
+    /* Not being able to serve metrics isn't worth failing over */
+    if (server->metrics_enabled) {
+        metrics_start(&server->metrics, server, socket);
+    }
+
     return true;
 }
 
 void server_run(struct infinidesk_server *server) {
-    wl_display_run(server->wl_display);
+    /*
+     * This is wl_display_run(), but waiting for events separately from
+     * dispatching them, so the watchdog can time just the dispatching.
+     */
+    struct wl_event_loop *loop = server->event_loop;
+    struct infinidesk_watchdog *watchdog = &server->watchdog;
+    struct pollfd pfd = {
+        .fd = wl_event_loop_get_fd(loop),
+        .events = POLLIN,
+    };
+
+    server->running = true;
+    while (server->running) {
+        /* Idle callbacks queued by the last dispatch, then client events */
+        watchdog_dispatch_begin(watchdog);
+        wl_event_loop_dispatch_idle(loop);
+        wl_display_flush_clients(server->wl_display);
+        watchdog_dispatch_end(watchdog, "idle callbacks");
+
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            wlr_log_errno(WLR_ERROR, "Failed to wait for events");
+            break;
+        }
+
+        watchdog_dispatch_begin(watchdog);
+        wl_event_loop_dispatch(loop, 0);
+        watchdog_dispatch_end(watchdog, "event dispatch");
+    }
+}
+
+void server_terminate(struct infinidesk_server *server) {
+    server->running = false;
+    /* Also wakes the loop up if it is waiting */
+    wl_display_terminate(server->wl_display);
+}
+
+uint32_t server_time_ms(struct infinidesk_server *server) {
+    if (server->replay) {
+        return replay_time_ms(server->replay);
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
 }
 
 void server_finish(struct infinidesk_server *server) {
@@ -245,6 +315,11 @@ void server_finish(struct infinidesk_server *server) {
     /* Clean up switcher */
     switcher_finish(&server->switcher);
 
+    /* Clean up performance HUD */
+    hud_finish(&server->hud);
+
+    metrics_finish(&server->metrics);
+
     /* Free keybindings (ownership transferred from config in main.c) */
     if (server->keybinds) {
         for (int i = 0; i < server->keybind_count; i++) {
@@ -272,9 +347,10 @@ void server_finish(struct infinidesk_server *server) {
      *
      * During wl_display_destroy(), the backend is torn down, which calls
      * wlr_keyboard_finish() on each hardware keyboard. That function emits
-     * key-release events for any held keys, invoking our keyboard_handle_key()
-     * listener — but by that point the seat and other server state may already
-     * be partially destroyed, causing a use-after-free crash.
+     * key-release events for any held keys, invoking our
+     * keyboard_handle_key() listener — but by that point the seat and other
+     * server state may already be partially destroyed, causing a
+     * use-after-free crash.
      *
      * Since clients are already destroyed above and we no longer need keyboard
      * input, it is safe to remove the listeners and free the structs now.
@@ -291,6 +367,8 @@ void server_finish(struct infinidesk_server *server) {
     /* Most remaining resources are cleaned up when the display is destroyed,
      * as they're attached to it. */
     wl_display_destroy(server->wl_display);
+
+    view_cache_finish(&server->view_cache);
 }
 
 struct infinidesk_view *server_view_at(struct infinidesk_server *server,
@@ -303,104 +381,69 @@ struct infinidesk_view *server_view_at(struct infinidesk_server *server,
      * The scene graph doesn't know about our custom scaled rendering,
      * so we must do hit testing ourselves by matching the rendering logic.
      *
-     * Key insight: We render surfaces at scaled positions and sizes, so we
-     * must do hit testing in screen space against the scaled bounds, then
-     * convert back to surface-local coordinates.
+     * The view cache holds each view's rendered window geometry in canvas
+     * coordinates, so we convert the cursor to canvas space, find the
+     * frontmost view containing it, then convert to surface-local
+     * coordinates.
      */
 
     struct infinidesk_canvas *canvas = &server->canvas;
+    struct view_cache *cache = &server->view_cache;
 
-    /* Views are ordered front-to-back in the list (front first) */
-    struct infinidesk_view *view;
-    wl_list_for_each(view, &server->views, link) {
-        if (!view->xdg_toplevel->base->surface->mapped) {
-            continue;
-        }
-
-        /* Get the view geometry */
-        struct wlr_box geo;
-        wlr_xdg_surface_get_geometry(view->xdg_toplevel->base, &geo);
+    view_cache_update(cache, &server->views);
 
-        /*
-         * Calculate where the view is rendered on screen.
-         * This must match the calculation in view_render().
-         *
-         * In view_render:
-         *   base_x = round(screen_x) - round(geo.x * scale)
-         *
-         * Where screen_x = (view->x - viewport_x) * scale
-         */
-        double screen_x, screen_y;
-        canvas_to_screen(canvas, view->x, view->y, &screen_x, &screen_y);
+    double cx, cy;
+    screen_to_canvas(canvas, lx, ly, &cx, &cy);
 
-        /*
-         * The top-left corner of the rendered surface on screen.
-         * This accounts for CSD windows where geo.x/y may be non-zero.
-         */
-        double render_x = screen_x - geo.x * canvas->scale;
-        double render_y = screen_y - geo.y * canvas->scale;
+    int32_t index = view_cache_find(cache, 0, cx, cy, 0.0);
+    if (index < 0) {
+        /* No view found under cursor */
+        *surface = NULL;
+        *sx = 0;
+        *sy = 0;
+        return NULL;
+    }
 
-        /*
-         * The rendered size on screen. We use the geometry dimensions
-         * (the "window" portion) scaled by canvas scale.
-         */
-        double render_width = geo.width * canvas->scale;
-        double render_height = geo.height * canvas->scale;
+    struct infinidesk_view *view = cache->views[index];
 
-        /* Check if cursor (in screen coords) is within rendered geometry bounds
-         */
-        if (lx >= render_x && lx < render_x + render_width && ly >= render_y &&
-            ly < render_y + render_height) {
-
-            /*
-             * Found a view - calculate surface-local coordinates.
-             *
-             * The cursor position relative to where we started rendering
-             * (render_x, render_y), divided by scale, gives us the position
-             * relative to the content origin (geometry origin).
-             */
-            double content_local_x = (lx - render_x) / canvas->scale;
-            double content_local_y = (ly - render_y) / canvas->scale;
-
-            /*
-             * Use wlr_xdg_surface_surface_at to find the actual surface
-             * (handles subsurfaces, popups, etc.). This function expects
-             * coordinates relative to the XDG surface origin (buffer origin),
-             * not the geometry/content origin. For CSD windows, we must add
-             * back the geometry offset.
-             */
-            double surface_local_x = content_local_x + geo.x;
-            double surface_local_y = content_local_y + geo.y;
-
-            double sub_x, sub_y;
-            struct wlr_surface *found_surface = wlr_xdg_surface_surface_at(
-                view->xdg_toplevel->base, surface_local_x, surface_local_y,
-                &sub_x, &sub_y);
-
-            if (found_surface) {
-                *surface = found_surface;
-                *sx = sub_x;
-                *sy = sub_y;
-                return view;
-            }
+    /*
+     * The cursor position relative to the top-left corner of the rendered
+     * window geometry gives the position relative to the content origin.
+     */
+    double content_local_x = cx - cache->x[index];
+    double content_local_y = cy - cache->y[index];
 
-            /*
-             * If no surface found at exact point (e.g., in transparent
-             * regions of CSD), return the main surface anyway.
-             * Use content-local coordinates for the main surface.
-             */
-            *surface = view->xdg_toplevel->base->surface;
-            *sx = content_local_x;
-            *sy = content_local_y;
-            return view;
-        }
+    /*
+     * Use wlr_xdg_surface_surface_at to find the actual surface
+     * (handles subsurfaces, popups, etc.). This function expects
+     * coordinates relative to the XDG surface origin (buffer origin),
+     * not the geometry/content origin. For CSD windows, we must add
+     * back the geometry offset.
+     */
+    double surface_local_x = content_local_x + cache->geo_x[index];
+    double surface_local_y = content_local_y + cache->geo_y[index];
+
+    double sub_x, sub_y;
+    struct wlr_surface *found_surface =
+        wlr_xdg_surface_surface_at(view->xdg_toplevel->base, surface_local_x,
+                                   surface_local_y, &sub_x, &sub_y);
+
+    if (found_surface) {
+        *surface = found_surface;
+        *sx = sub_x;
+        *sy = sub_y;
+        return view;
     }
 
-    /* No view found under cursor */
-    *surface = NULL;
-    *sx = 0;
-    *sy = 0;
-    return NULL;
+    /*
+     * If no surface found at exact point (e.g., in transparent
+     * regions of CSD), return the main surface anyway.
+     * Use content-local coordinates for the main surface.
+     */
+    *surface = view->xdg_toplevel->base->surface;
+    *sx = content_local_x;
+    *sy = content_local_y;
+    return view;
 }
 
 uint32_t server_view_edge_at(struct infinidesk_server *server, double lx,
@@ -416,54 +459,31 @@ uint32_t server_view_edge_at(struct infinidesk_server *server, double lx,
     double grab_zone = base_grab_zone * server->output_scale;
 
     struct infinidesk_canvas *canvas = &server->canvas;
+    struct view_cache *cache = &server->view_cache;
 
     if (view_out) {
         *view_out = NULL;
     }
 
-    /* Views are ordered front-to-back in the list (front first) */
-    struct infinidesk_view *view;
-    wl_list_for_each(view, &server->views, link) {
-        if (!view->xdg_toplevel->base->surface->mapped) {
-            continue;
-        }
-
-        /* Get the view geometry */
-        struct wlr_box geo;
-        wlr_xdg_surface_get_geometry(view->xdg_toplevel->base, &geo);
-
-        /*
-         * Calculate where the view is rendered on screen.
-         * This must match the calculation in view_render() and
-         * server_view_at().
-         */
-        double screen_x, screen_y;
-        canvas_to_screen(canvas, view->x, view->y, &screen_x, &screen_y);
+    view_cache_update(cache, &server->views);
 
-        /* The rendered bounds of the window geometry on screen */
-        double render_x = screen_x - geo.x * canvas->scale;
-        double render_y = screen_y - geo.y * canvas->scale;
-        double render_width = geo.width * canvas->scale;
-        double render_height = geo.height * canvas->scale;
+    /* The grab zone is a fixed size on screen, so convert it to canvas */
+    double cx, cy;
+    screen_to_canvas(canvas, lx, ly, &cx, &cy);
+    double margin = grab_zone / canvas->scale;
 
-        /*
-         * Check if cursor is OUTSIDE the window but within the grab zone.
-         * First, check if within the extended bounds (window + grab zone).
-         */
-        double ext_x = render_x - grab_zone;
-        double ext_y = render_y - grab_zone;
-        double ext_width = render_width + 2 * grab_zone;
-        double ext_height = render_height + 2 * grab_zone;
-
-        if (lx < ext_x || lx >= ext_x + ext_width || ly < ext_y ||
-            ly >= ext_y + ext_height) {
-            /* Cursor is outside the extended bounds */
-            continue;
-        }
+    /* Visit views front to back whose extended bounds contain the cursor */
+    int32_t index;
+    for (uint32_t start = 0;
+         (index = view_cache_find(cache, start, cx, cy, margin)) >= 0;
+         start = (uint32_t)index + 1) {
+        double x = cache->x[index];
+        double y = cache->y[index];
+        double width = cache->w[index];
+        double height = cache->h[index];
 
         /* Check if cursor is INSIDE the window (not on edge) */
-        if (lx >= render_x && lx < render_x + render_width && ly >= render_y &&
-            ly < render_y + render_height) {
+        if (cx >= x && cx < x + width && cy >= y && cy < y + height) {
             /* Cursor is inside the window, not on an edge */
             continue;
         }
@@ -475,22 +495,22 @@ uint32_t server_view_edge_at(struct infinidesk_server *server, double lx,
         uint32_t edges = WLR_EDGE_NONE;
 
         /* Check vertical edges */
-        if (ly < render_y) {
+        if (cy < y) {
             edges |= WLR_EDGE_TOP;
-        } else if (ly >= render_y + render_height) {
+        } else if (cy >= y + height) {
             edges |= WLR_EDGE_BOTTOM;
         }
 
         /* Check horizontal edges */
-        if (lx < render_x) {
+        if (cx < x) {
             edges |= WLR_EDGE_LEFT;
-        } else if (lx >= render_x + render_width) {
+        } else if (cx >= x + width) {
             edges |= WLR_EDGE_RIGHT;
         }
 
         if (edges != WLR_EDGE_NONE) {
             if (view_out) {
-                *view_out = view;
+                *view_out = cache->views[index];
             }
             return edges;
         }
@@ -0,0 +1,693 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * snapshot.c - Offscreen renders of a described scene, checked against
+ *              golden images
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <drm_fourcc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/canvas.h"
+#include "infinidesk/drawing.h"
+#include "infinidesk/output.h"
+#include "infinidesk/perf.h"
+#include "infinidesk/render_governor.h"
+#include "infinidesk/scratch.h"
+#include "infinidesk/server.h"
+#include "infinidesk/snapshot.h"
+#include "infinidesk/view.h"
+
+static const char *state_names[] = {
+    [SNAPSHOT_WINDOWS] = "opening windows",
+    [SNAPSHOT_SETTLE] = "settling",
+    [SNAPSHOT_CAPTURE] = "capturing",
+    [SNAPSHOT_TIMING] = "timing",
+    [SNAPSHOT_DONE] = "done",
+};
+
+static void strokes_release(struct wl_array *strokes) {
+    struct snapshot_stroke *stroke;
+    wl_array_for_each(stroke, strokes) {
+        wl_array_release(&stroke->points);
+    }
+    wl_array_release(strokes);
+}
+
+/* Parse "x,y" pairs to the end of the line */
+static bool parse_points(char *cursor, struct wl_array *points) {
+    for (;;) {
+        char *end;
+        double x = strtod(cursor, &end);
+        if (end == cursor) {
+            break;
+        }
+        cursor = end;
+        if (*cursor != ',') {
+            return false;
+        }
+        cursor++;
+        double y = strtod(cursor, &end);
+        if (end == cursor) {
+            return false;
+        }
+        cursor = end;
+
+        double *point = wl_array_add(points, 2 * sizeof(double));
+        if (!point) {
+            return false;
+        }
+        point[0] = x;
+        point[1] = y;
+    }
+
+    /* Only whitespace may follow the last point */
+    return strspn(cursor, " \t\r\n") == strlen(cursor);
+}
+
+/*
+ * Parse one line of a scene. Returns false if it isn't understood.
+ */
+static bool parse_line(struct infinidesk_snapshot *snapshot, char *line) {
+    char *comment = strchr(line, '#');
+    if (comment) {
+        *comment = '\0';
+    }
+
+    char keyword[16];
+    int consumed = 0;
+    if (sscanf(line, " %15s%n", keyword, &consumed) != 1) {
+        return true; /* Blank */
+    }
+    char *rest = line + consumed;
+
+    if (strcmp(keyword, "output") == 0) {
+        float scale = 1.0f;
+        int n = sscanf(rest, "%d %d %f", &snapshot->width, &snapshot->height,
+                       &scale);
+        snapshot->scale = scale;
+        return n >= 2 && snapshot->width > 0 && snapshot->height > 0 &&
+               scale > 0.0f;
+    }
+
+    if (strcmp(keyword, "viewport") == 0) {
+        double zoom = 1.0;
+        int n = sscanf(rest, "%lf %lf %lf", &snapshot->viewport_x,
+                       &snapshot->viewport_y, &zoom);
+        snapshot->zoom = zoom;
+        return n >= 2 && zoom > 0.0;
+    }
+
+    if (strcmp(keyword, "window") == 0) {
+        struct snapshot_window window = {0};
+        if (sscanf(rest, "%lf %lf %u %u", &window.x, &window.y,
+                   &window.width, &window.height) != 4 ||
+            window.width == 0 || window.height == 0) {
+            return false;
+        }
+        struct snapshot_window *slot =
+            wl_array_add(&snapshot->windows, sizeof(*slot));
+        if (!slot) {
+            return false;
+        }
+        *slot = window;
+        return true;
+    }
+
+    if (strcmp(keyword, "stroke") == 0) {
+        struct snapshot_stroke stroke = {0};
+        int colour_end = 0;
+        if (sscanf(rest, "%f %f %f%n", &stroke.color.r, &stroke.color.g,
+                   &stroke.color.b, &colour_end) != 3) {
+            return false;
+        }
+        wl_array_init(&stroke.points);
+        if (!parse_points(rest + colour_end, &stroke.points) ||
+            stroke.points.size == 0) {
+            wl_array_release(&stroke.points);
+            return false;
+        }
+        struct snapshot_stroke *slot =
+            wl_array_add(&snapshot->strokes, sizeof(*slot));
+        if (!slot) {
+            wl_array_release(&stroke.points);
+            return false;
+        }
+        *slot = stroke;
+        return true;
+    }
+
+    if (strcmp(keyword, "tolerance") == 0) {
+        double fraction = 0.0;
+        int n = sscanf(rest, "%u %lf", &snapshot->channel_tolerance,
+                       &fraction);
+        snapshot->fraction_tolerance = fraction;
+        return n >= 1 && fraction >= 0.0 && fraction <= 1.0;
+    }
+
+    return false;
+}
+
+bool snapshot_load(struct infinidesk_snapshot *snapshot, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        wlr_log_errno(WLR_ERROR, "Failed to open %s", path);
+        return false;
+    }
+
+    snapshot->path = path;
+    snapshot->width = 1280;
+    snapshot->height = 720;
+    snapshot->scale = 1.0f;
+    snapshot->zoom = 1.0;
+    wl_array_init(&snapshot->windows);
+    wl_array_init(&snapshot->strokes);
+
+    /* Stroke lines can be long, so let getline() size the buffer */
+    char *line = NULL;
+    size_t size = 0;
+    int line_number = 0;
+    bool ok = true;
+    while (getline(&line, &size, file) != -1) {
+        line_number++;
+        if (!parse_line(snapshot, line)) {
+            wlr_log(WLR_ERROR, "%s:%d: not understood", path, line_number);
+            ok = false;
+            break;
+        }
+    }
+    free(line);
+    fclose(file);
+    if (!ok) {
+        wl_array_release(&snapshot->windows);
+        strokes_release(&snapshot->strokes);
+        wl_array_init(&snapshot->windows);
+        wl_array_init(&snapshot->strokes);
+        return false;
+    }
+
+    wlr_log(WLR_INFO,
+            "Loaded scene %s: %dx%d at scale %.2f, %zu windows, %zu strokes",
+            path, snapshot->width, snapshot->height, snapshot->scale,
+            snapshot->windows.size / sizeof(struct snapshot_window),
+            snapshot->strokes.size / sizeof(struct snapshot_stroke));
+    return true;
+}
+
+bool snapshot_setup_env(struct infinidesk_snapshot *snapshot) {
+    /* The renderer is forced too, as goldens are only exact for one */
+    setenv("WLR_BACKENDS", "headless", true);
+    setenv("WLR_LIBINPUT_NO_DEVICES", "1", true);
+    setenv("WLR_RENDERER", "pixman", true);
+
+    /* Annotations are saved under XDG_DATA_HOME, so give the run its own */
+    return scratch_env_create(&snapshot->env, "snapshot");
+}
+
+void snapshot_cleanup_env(struct infinidesk_snapshot *snapshot) {
+    scratch_env_remove(&snapshot->env);
+}
+
+static void find_headless(struct wlr_backend *backend, void *data) {
+    struct wlr_backend **headless = data;
+    if (wlr_backend_is_headless(backend)) {
+        *headless = backend;
+    }
+}
+
+static int handle_timeout(void *data) {
+    struct infinidesk_snapshot *snapshot = data;
+
+    wlr_log(WLR_ERROR, "Snapshot of %s timed out while %s (%u windows mapped)",
+            snapshot->path, state_names[snapshot->state],
+            snapshot->windows_mapped);
+    snapshot->failed = true;
+    snapshot->state = SNAPSHOT_DONE;
+    server_terminate(snapshot->server);
+    return 0;
+}
+
+/* Start the client for the next window of the scene */
+static bool spawn_window(struct infinidesk_snapshot *snapshot) {
+    uint32_t index = snapshot->windows_mapped;
+    struct snapshot_window *window =
+        &((struct snapshot_window *)snapshot->windows.data)[index];
+
+    int len = snprintf(NULL, 0, "%s -n 1 -s %ux%u -d none -o %u",
+                       snapshot->client, window->width, window->height,
+                       index);
+    char *command = malloc(len + 1);
+    if (!command) {
+        return false;
+    }
+    snprintf(command, len + 1, "%s -n 1 -s %ux%u -d none -o %u",
+             snapshot->client, window->width, window->height, index);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl("/bin/sh", "/bin/sh", "-c", command, (char *)NULL);
+        _exit(EXIT_FAILURE);
+    }
+    free(command);
+    return pid > 0;
+}
+
+/* Draw the scene's strokes as if with the pen */
+static void draw_strokes(struct infinidesk_snapshot *snapshot) {
+    struct drawing_layer *drawing = &snapshot->server->drawing;
+    struct drawing_color previous = drawing->current_color;
+
+    drawing_toggle_mode(drawing);
+    struct snapshot_stroke *stroke;
+    wl_array_for_each(stroke, &snapshot->strokes) {
+        const double *points = stroke->points.data;
+        size_t count = stroke->points.size / (2 * sizeof(double));
+
+        drawing->current_color = stroke->color;
+        drawing_stroke_begin(drawing, points[0], points[1]);
+        for (size_t i = 1; i < count; i++) {
+            drawing_stroke_add_point(drawing, points[2 * i],
+                                     points[2 * i + 1]);
+        }
+        drawing_stroke_end(drawing);
+    }
+    drawing_toggle_mode(drawing);
+    drawing->current_color = previous;
+}
+
+bool snapshot_start(struct infinidesk_snapshot *snapshot,
+                    struct infinidesk_server *server) {
+    snapshot->server = server;
+
+    size_t window_count =
+        snapshot->windows.size / sizeof(struct snapshot_window);
+    if (window_count > 0 && !snapshot->client) {
+        wlr_log(WLR_ERROR, "Scene %s has windows but no client to open them",
+                snapshot->path);
+        return false;
+    }
+
+    struct wlr_backend *headless = NULL;
+    if (wlr_backend_is_headless(server->backend)) {
+        headless = server->backend;
+    } else if (wlr_backend_is_multi(server->backend)) {
+        wlr_multi_for_each_backend(server->backend, find_headless, &headless);
+    }
+    if (!headless) {
+        wlr_log(WLR_ERROR, "Snapshot needs the headless backend");
+        return false;
+    }
+
+    /* Outputs take the scale as they are added */
+    server->output_scale = snapshot->scale;
+
+    /* Outputs time their frames if they see a snapshot being taken */
+    server->snapshot = snapshot;
+    snapshot->output =
+        wlr_headless_add_output(headless, snapshot->width, snapshot->height);
+    if (!snapshot->output) {
+        wlr_log(WLR_ERROR, "Failed to add snapshot output");
+        server->snapshot = NULL;
+        return false;
+    }
+
+    struct infinidesk_canvas *canvas = &server->canvas;
+    canvas->viewport_x = snapshot->viewport_x;
+    canvas->viewport_y = snapshot->viewport_y;
+    canvas->scale = canvas_clamp_scale(snapshot->zoom);
+    canvas_update_view_positions(canvas);
+    draw_strokes(snapshot);
+
+    snapshot->timeout =
+        wl_event_loop_add_timer(server->event_loop, handle_timeout, snapshot);
+    if (snapshot->timeout) {
+        wl_event_source_timer_update(snapshot->timeout, SNAPSHOT_TIMEOUT_MS);
+    }
+
+    /* One window at a time, so they stack in the order they're listed */
+    snapshot->state = SNAPSHOT_SETTLE;
+    if (window_count > 0) {
+        snapshot->state = SNAPSHOT_WINDOWS;
+        if (!spawn_window(snapshot)) {
+            wlr_log_errno(WLR_ERROR, "Failed to start snapshot client");
+            return false;
+        }
+    }
+
+    wlr_log(WLR_INFO, "Snapshot started: %dx%d, %zu windows", snapshot->width,
+            snapshot->height, window_count);
+    return true;
+}
+
+void snapshot_finish(struct infinidesk_snapshot *snapshot) {
+    if (snapshot->timeout) {
+        wl_event_source_remove(snapshot->timeout);
+        snapshot->timeout = NULL;
+    }
+    if (snapshot->server) {
+        snapshot->server->snapshot = NULL;
+    }
+    wl_array_release(&snapshot->windows);
+    strokes_release(&snapshot->strokes);
+    wl_array_init(&snapshot->windows);
+    wl_array_init(&snapshot->strokes);
+    free(snapshot->pixels);
+    snapshot->pixels = NULL;
+    free(snapshot->frame_ns);
+    snapshot->frame_ns = NULL;
+}
+
+void snapshot_capture(struct infinidesk_snapshot *snapshot,
+                      struct infinidesk_output *output,
+                      struct wlr_buffer *buffer) {
+    if (output->wlr_output != snapshot->output ||
+        snapshot->state != SNAPSHOT_CAPTURE || snapshot->pixels) {
+        return;
+    }
+    if (buffer->width != snapshot->width ||
+        buffer->height != snapshot->height) {
+        wlr_log(WLR_ERROR, "Snapshot frame is %dx%d, expected %dx%d",
+                buffer->width, buffer->height, snapshot->width,
+                snapshot->height);
+        return;
+    }
+
+    struct wlr_texture *texture =
+        wlr_texture_from_buffer(snapshot->server->renderer, buffer);
+    if (!texture) {
+        wlr_log(WLR_ERROR, "Failed to read back snapshot frame");
+        return;
+    }
+
+    size_t count = (size_t)snapshot->width * snapshot->height;
+    uint32_t *xrgb = malloc(count * sizeof(*xrgb));
+    uint8_t *rgb = malloc(count * 3);
+    bool ok = xrgb && rgb &&
+              wlr_texture_read_pixels(
+                  texture, &(struct wlr_texture_read_pixels_options){
+                               .data = xrgb,
+                               .format = DRM_FORMAT_XRGB8888,
+                               .stride = snapshot->width * 4,
+                           });
+    wlr_texture_destroy(texture);
+    if (!ok) {
+        wlr_log(WLR_ERROR, "Failed to read back snapshot frame");
+        free(xrgb);
+        free(rgb);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        rgb[3 * i] = (xrgb[i] >> 16) & 0xff;
+        rgb[3 * i + 1] = (xrgb[i] >> 8) & 0xff;
+        rgb[3 * i + 2] = xrgb[i] & 0xff;
+    }
+    free(xrgb);
+    snapshot->pixels = rgb;
+}
+
+/* Find a mapped view that isn't one of the scene's windows yet */
+static struct infinidesk_view *find_new_view(
+    struct infinidesk_snapshot *snapshot) {
+    struct snapshot_window *windows = snapshot->windows.data;
+    struct infinidesk_view *view;
+    wl_list_for_each(view, &snapshot->server->views, link) {
+        if (!view->xdg_toplevel->base->surface->mapped) {
+            continue;
+        }
+        bool known = false;
+        for (uint32_t i = 0; i < snapshot->windows_mapped; i++) {
+            known = known || windows[i].view == view;
+        }
+        if (!known) {
+            return view;
+        }
+    }
+    return NULL;
+}
+
+/* Nothing left that would change the next frame */
+static bool scene_still(struct infinidesk_snapshot *snapshot,
+                        struct infinidesk_output *output) {
+    struct infinidesk_server *server = snapshot->server;
+    return !view_any_animating(server) && !server->canvas.snap_anim_active &&
+           output->governor.quality.level == RENDER_QUALITY_FULL;
+}
+
+/*
+ * Path of the golden image, or what a mismatch is saved as: the scene's
+ * path with its extension replaced.
+ */
+static char *image_path(const char *scene, const char *extension) {
+    const char *slash = strrchr(scene, '/');
+    const char *dot = strrchr(scene, '.');
+    size_t stem = dot && (!slash || dot > slash) ? (size_t)(dot - scene)
+                                                 : strlen(scene);
+    size_t len = stem + strlen(extension) + 1;
+    char *path = malloc(len);
+    if (path) {
+        snprintf(path, len, "%.*s%s", (int)stem, scene, extension);
+    }
+    return path;
+}
+
+/* Read a binary PPM of the given size. Returns NULL if there is none. */
+static uint8_t *read_ppm(const char *path, int width, int height,
+                         bool *exists) {
+    FILE *file = fopen(path, "rb");
+    *exists = file != NULL;
+    if (!file) {
+        return NULL;
+    }
+
+    int file_width, file_height, max_value;
+    uint8_t *pixels = NULL;
+    if (fscanf(file, "P6 %d %d %d", &file_width, &file_height,
+               &max_value) != 3 ||
+        max_value != 255 || fgetc(file) == EOF) {
+        wlr_log(WLR_ERROR, "%s is not a binary PPM image", path);
+    } else if (file_width != width || file_height != height) {
+        wlr_log(WLR_ERROR, "%s is %dx%d, but the scene is %dx%d", path,
+                file_width, file_height, width, height);
+    } else {
+        size_t size = (size_t)width * height * 3;
+        pixels = malloc(size);
+        if (pixels && fread(pixels, 1, size, file) != size) {
+            wlr_log(WLR_ERROR, "%s is truncated", path);
+            free(pixels);
+            pixels = NULL;
+        }
+    }
+    fclose(file);
+    return pixels;
+}
+
+static bool write_ppm(const char *path, const uint8_t *pixels, int width,
+                      int height) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        wlr_log_errno(WLR_ERROR, "Failed to open %s", path);
+        return false;
+    }
+    size_t size = (size_t)width * height * 3;
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    bool ok = fwrite(pixels, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Compare the capture with the golden image, saving whichever image needs
+ * saving, and write the result as JSON to stdout.
+ */
+static void report(struct infinidesk_snapshot *snapshot) {
+    int width = snapshot->width, height = snapshot->height;
+    size_t count = (size_t)width * height;
+    const char *result = "match";
+    uint64_t differing = 0;
+    uint32_t max_difference = 0;
+
+    char *golden_path = image_path(snapshot->path, ".ppm");
+    char *actual_path = image_path(snapshot->path, ".actual.ppm");
+    if (!golden_path || !actual_path) {
+        wlr_log(WLR_ERROR, "Failed to allocate snapshot paths");
+        snapshot->failed = true;
+        free(golden_path);
+        free(actual_path);
+        return;
+    }
+
+    bool exists = false;
+    uint8_t *golden = NULL;
+    if (!snapshot->update) {
+        golden = read_ppm(golden_path, width, height, &exists);
+    }
+
+    if (!golden && !exists) {
+        /* A new golden needs looking at, so only an update passes */
+        result = "created";
+        if (!write_ppm(golden_path, snapshot->pixels, width, height)) {
+            snapshot->failed = true;
+        } else if (snapshot->update) {
+            wlr_log(WLR_INFO, "Wrote golden image %s", golden_path);
+        } else {
+            wlr_log(WLR_ERROR, "No golden image for %s, wrote %s",
+                    snapshot->path, golden_path);
+            snapshot->failed = true;
+        }
+    } else {
+        for (size_t i = 0; golden && i < count; i++) {
+            uint32_t pixel_difference = 0;
+            for (int c = 0; c < 3; c++) {
+                int difference = abs((int)snapshot->pixels[3 * i + c] -
+                                     (int)golden[3 * i + c]);
+                if ((uint32_t)difference > pixel_difference) {
+                    pixel_difference = difference;
+                }
+            }
+            if (pixel_difference > snapshot->channel_tolerance) {
+                differing++;
+            }
+            if (pixel_difference > max_difference) {
+                max_difference = pixel_difference;
+            }
+        }
+
+        /* An unreadable golden counts as every pixel differing */
+        if (!golden) {
+            differing = count;
+        }
+        if (differing > snapshot->fraction_tolerance * count) {
+            result = "mismatch";
+            snapshot->failed = true;
+            if (write_ppm(actual_path, snapshot->pixels, width, height)) {
+                wlr_log(WLR_ERROR, "Snapshot differs from %s, wrote %s",
+                        golden_path, actual_path);
+            }
+        }
+    }
+    free(golden);
+    free(golden_path);
+    free(actual_path);
+
+    double mean = 0.0;
+    uint32_t *frame_ns = snapshot->frame_ns;
+    uint32_t frames = snapshot->frames;
+    qsort(frame_ns, frames, sizeof(*frame_ns), compare_u32);
+    for (uint32_t i = 0; i < frames; i++) {
+        mean += frame_ns[i];
+    }
+    mean /= frames;
+
+    printf("{\n");
+    printf("  \"scene\": \"%s\",\n", snapshot->path);
+    printf("  \"result\": \"%s\",\n", result);
+    printf("  \"output\": {\"width\": %d, \"height\": %d, "
+           "\"scale\": %.2f},\n",
+           width, height, snapshot->scale);
+    printf("  \"differing_pixels\": %llu,\n", (unsigned long long)differing);
+    printf("  \"max_difference\": %u,\n", max_difference);
+    printf("  \"render_ms\": {\"frames\": %u, \"mean\": %.3f, "
+           "\"p50\": %.3f, \"p95\": %.3f, \"max\": %.3f}\n",
+           frames, mean / 1e6, frame_ns[(frames - 1) * 50 / 100] / 1e6,
+           frame_ns[(frames - 1) * 95 / 100] / 1e6,
+           frame_ns[frames - 1] / 1e6);
+    printf("}\n");
+    fflush(stdout);
+}
+
+static void stop(struct infinidesk_snapshot *snapshot) {
+    snapshot->state = SNAPSHOT_DONE;
+    server_terminate(snapshot->server);
+}
+
+void snapshot_frame(struct infinidesk_snapshot *snapshot,
+                    struct infinidesk_output *output) {
+    if (output->wlr_output != snapshot->output) {
+        return;
+    }
+
+    size_t window_count =
+        snapshot->windows.size / sizeof(struct snapshot_window);
+
+    switch (snapshot->state) {
+    case SNAPSHOT_WINDOWS: {
+        struct infinidesk_view *view = find_new_view(snapshot);
+        if (!view) {
+            break;
+        }
+        struct snapshot_window *window =
+            &((struct snapshot_window *)
+                  snapshot->windows.data)[snapshot->windows_mapped++];
+        window->view = view;
+        view_set_position(view, window->x, window->y);
+
+        if (snapshot->windows_mapped == window_count) {
+            snapshot->state = SNAPSHOT_SETTLE;
+        } else if (!spawn_window(snapshot)) {
+            wlr_log_errno(WLR_ERROR, "Failed to start snapshot client");
+            snapshot->failed = true;
+            stop(snapshot);
+        }
+        break;
+    }
+
+    case SNAPSHOT_SETTLE:
+        snapshot->settled_frames =
+            scene_still(snapshot, output) ? snapshot->settled_frames + 1 : 0;
+        if (snapshot->settled_frames >= SNAPSHOT_SETTLE_FRAMES) {
+            snapshot->state = SNAPSHOT_CAPTURE;
+        }
+        break;
+
+    case SNAPSHOT_CAPTURE:
+        /* The capture has already happened, as the frame was committed */
+        if (!snapshot->pixels) {
+            wlr_log(WLR_ERROR, "Snapshot of %s failed", snapshot->path);
+            snapshot->failed = true;
+            stop(snapshot);
+            break;
+        }
+        snapshot->frame_ns =
+            calloc(SNAPSHOT_TIMED_FRAMES, sizeof(*snapshot->frame_ns));
+        if (!snapshot->frame_ns) {
+            wlr_log(WLR_ERROR, "Failed to allocate snapshot results");
+            snapshot->failed = true;
+            stop(snapshot);
+            break;
+        }
+        snapshot->state = SNAPSHOT_TIMING;
+        break;
+
+    case SNAPSHOT_TIMING:
+        snapshot->frame_ns[snapshot->frames++] =
+            output->perf.current.ns[PERF_TOTAL];
+        if (snapshot->frames == SNAPSHOT_TIMED_FRAMES) {
+            report(snapshot);
+            stop(snapshot);
+        }
+        break;
+
+    case SNAPSHOT_DONE:
+        break;
+    }
+}
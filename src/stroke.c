@@ -0,0 +1,578 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * stroke.c - Contiguous point storage for drawing strokes
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "infinidesk/stroke.h"
+
+/* Initial point capacity of a new stroke (grows by doubling) */
+#define STROKE_INITIAL_CAPACITY 64
+
+static void stroke_free_lods(struct drawing_stroke *stroke);
+
+static struct stroke_buffer *stroke_buffer_create(uint32_t capacity) {
+    struct stroke_buffer *buffer = calloc(1, sizeof(*buffer));
+    if (!buffer) {
+        return NULL;
+    }
+
+    buffer->data = malloc(capacity * sizeof(struct drawing_point));
+    if (!buffer->data) {
+        free(buffer);
+        return NULL;
+    }
+
+    buffer->refs = 1;
+    buffer->capacity = capacity;
+    return buffer;
+}
+
+static void stroke_buffer_unref(struct stroke_buffer *buffer) {
+    if (--buffer->refs > 0) {
+        return;
+    }
+    if (!buffer->external) {
+        free(buffer->data);
+    }
+    free(buffer);
+}
+
+/*
+ * Whether the stroke is the only user of its whole buffer of plain points,
+ * and so may grow or replace it.
+ */
+static bool stroke_owns_buffer(const struct drawing_stroke *stroke) {
+    return stroke->buffer->refs == 1 && !stroke->buffer->external &&
+           stroke->points && stroke->points == stroke->buffer->data;
+}
+
+struct drawing_stroke *stroke_create(double origin_x, double origin_y,
+                                     struct drawing_color color) {
+    struct drawing_stroke *stroke = calloc(1, sizeof(*stroke));
+    if (!stroke) {
+        return NULL;
+    }
+
+    stroke->buffer = stroke_buffer_create(STROKE_INITIAL_CAPACITY);
+    if (!stroke->buffer) {
+        free(stroke);
+        return NULL;
+    }
+
+    stroke->points = stroke->buffer->data;
+    stroke->point_count = 0;
+    stroke->origin_x = origin_x;
+    stroke->origin_y = origin_y;
+    stroke->color = color;
+    wl_list_init(&stroke->link);
+
+    return stroke;
+}
+
+struct drawing_stroke *
+stroke_create_packed(double origin_x, double origin_y,
+                     struct drawing_color color,
+                     const struct packed_points *packed) {
+    struct drawing_stroke *stroke = calloc(1, sizeof(*stroke));
+    if (!stroke) {
+        return NULL;
+    }
+
+    stroke->buffer = calloc(1, sizeof(*stroke->buffer));
+    if (!stroke->buffer) {
+        free(stroke);
+        return NULL;
+    }
+
+    /* The buffer is never written through, so dropping const is safe */
+    stroke->buffer->refs = 1;
+    stroke->buffer->data = (void *)packed->seek;
+    stroke->buffer->external = true;
+
+    stroke->packed = *packed;
+    stroke->point_count = packed->count;
+    stroke->origin_x = origin_x;
+    stroke->origin_y = origin_y;
+    stroke->color = color;
+    wl_list_init(&stroke->link);
+
+    return stroke;
+}
+
+struct drawing_stroke *stroke_create_fragment(struct drawing_stroke *parent,
+                                              uint32_t first_point,
+                                              uint32_t point_count) {
+    struct drawing_stroke *stroke = calloc(1, sizeof(*stroke));
+    if (!stroke) {
+        return NULL;
+    }
+
+    /* Share the parent's points rather than copying them */
+    stroke->buffer = parent->buffer;
+    stroke->buffer->refs++;
+    if (parent->points) {
+        stroke->points = parent->points + first_point;
+    } else {
+        stroke->packed = parent->packed;
+        stroke->first_point = parent->first_point + first_point;
+    }
+    stroke->point_count = point_count;
+
+    stroke->origin_x = parent->origin_x;
+    stroke->origin_y = parent->origin_y;
+    stroke->color = parent->color;
+    stroke->z = parent->z;
+    stroke->chunk = parent->chunk;
+    stroke->smooth = parent->smooth;
+    stroke->tolerance = parent->tolerance;
+    wl_list_init(&stroke->link);
+
+    stroke_compute_bounds(stroke);
+
+    return stroke;
+}
+
+void stroke_destroy(struct drawing_stroke *stroke) {
+    if (!stroke) {
+        return;
+    }
+
+    /* One block of points, no matter how long the stroke is */
+    stroke_free_lods(stroke);
+    stroke_buffer_unref(stroke->buffer);
+    free(stroke);
+}
+
+bool stroke_append_point(struct drawing_stroke *stroke, double canvas_x,
+                         double canvas_y) {
+    if (!stroke_owns_buffer(stroke)) {
+        return false;
+    }
+
+    /* Grow the array geometrically so appends are amortised O(1) */
+    struct stroke_buffer *buffer = stroke->buffer;
+    if (stroke->point_count >= buffer->capacity) {
+        uint32_t new_capacity = buffer->capacity * 2;
+        struct drawing_point *new_points = realloc(
+            buffer->data, new_capacity * sizeof(struct drawing_point));
+        if (!new_points) {
+            return false;
+        }
+        buffer->data = new_points;
+        buffer->capacity = new_capacity;
+        stroke->points = new_points;
+    }
+
+    struct drawing_point *point = &stroke->points[stroke->point_count++];
+    point->x = (float)(canvas_x - stroke->origin_x);
+    point->y = (float)(canvas_y - stroke->origin_y);
+
+    if (stroke->point_count == 1) {
+        stroke->min_x = stroke->max_x = point->x;
+        stroke->min_y = stroke->max_y = point->y;
+    } else {
+        stroke->min_x = fminf(stroke->min_x, point->x);
+        stroke->max_x = fmaxf(stroke->max_x, point->x);
+        stroke->min_y = fminf(stroke->min_y, point->y);
+        stroke->max_y = fmaxf(stroke->max_y, point->y);
+    }
+
+    return true;
+}
+
+bool stroke_pack(struct drawing_stroke *stroke, float quantum) {
+    if (!stroke_owns_buffer(stroke)) {
+        return false;
+    }
+
+    struct wl_array block;
+    wl_array_init(&block);
+    struct stroke_buffer *buffer = calloc(1, sizeof(*buffer));
+    if (!buffer || !point_codec_pack(stroke->points, stroke->point_count,
+                                     &quantum, &block)) {
+        free(buffer);
+        wl_array_release(&block);
+        return false;
+    }
+
+    /* The block is reserved for the worst case, so drop the slack */
+    void *data = realloc(block.data, block.size ? block.size : 1);
+    if (data) {
+        block.data = data;
+    }
+    point_codec_view(block.data, block.size, stroke->point_count, quantum,
+                     &stroke->packed);
+
+    buffer->refs = 1;
+    buffer->data = block.data;
+    stroke_buffer_unref(stroke->buffer);
+    stroke->buffer = buffer;
+    stroke->points = NULL;
+    stroke->first_point = 0;
+    return true;
+}
+
+bool stroke_export_points(const struct drawing_stroke *stroke,
+                          struct wl_array *out, float *quantum) {
+    /* A whole packed stroke is already in the right form */
+    if (!stroke->points && stroke->first_point == 0 &&
+        stroke->point_count == stroke->packed.count) {
+        size_t size = point_codec_seek_size(stroke->point_count) +
+                      stroke->packed.size;
+        void *dest = wl_array_add(out, size);
+        if (!dest) {
+            return false;
+        }
+        memcpy(dest, stroke->packed.seek, size);
+        *quantum = stroke->packed.quantum;
+        return true;
+    }
+
+    if (stroke->points) {
+        return point_codec_pack(stroke->points, stroke->point_count, quantum,
+                                out);
+    }
+
+    /* A fragment repacks its own range, on the same grid as its parent */
+    struct drawing_point *points =
+        malloc(stroke->point_count * sizeof(*points));
+    if (!points) {
+        return false;
+    }
+    struct point_cursor cursor;
+    stroke_cursor(stroke, 0, stroke->point_count, &cursor);
+    uint32_t count = 0;
+    while (point_cursor_next(&cursor, &points[count])) {
+        count++;
+    }
+
+    *quantum = stroke->packed.quantum;
+    bool ok = point_codec_pack(points, count, quantum, out);
+    free(points);
+    return ok;
+}
+
+size_t stroke_point_bytes(const struct drawing_stroke *stroke) {
+    if (stroke->points) {
+        return stroke->point_count * sizeof(struct drawing_point);
+    }
+    return point_codec_seek_size(stroke->packed.count) +
+           (uint64_t)stroke->packed.size * stroke->point_count /
+               (stroke->packed.count ? stroke->packed.count : 1);
+}
+
+void stroke_cursor(const struct drawing_stroke *stroke, uint32_t first,
+                   uint32_t count, struct point_cursor *cursor) {
+    if (stroke->points) {
+        point_cursor_init_plain(cursor, stroke->points + first, count);
+    } else {
+        point_cursor_init_packed(cursor, &stroke->packed,
+                                 stroke->first_point + first, count);
+    }
+}
+
+/*
+ * Squared distance from point p to the segment a-b.
+ */
+static double segment_distance_sq(double px, double py, double ax, double ay,
+                                  double bx, double by) {
+    double dx = bx - ax;
+    double dy = by - ay;
+    px -= ax;
+    py -= ay;
+    double len_sq = dx * dx + dy * dy;
+
+    if (len_sq > 0.0) {
+        double t = (px * dx + py * dy) / len_sq;
+        if (t > 1.0) {
+            t = 1.0;
+        } else if (t < 0.0) {
+            t = 0.0;
+        }
+        px -= t * dx;
+        py -= t * dy;
+    }
+
+    return px * px + py * py;
+}
+
+/*
+ * Ramer-Douglas-Peucker over points[0..count), writing the kept points to
+ * out (which may alias points) and their number to out_count.
+ */
+static bool simplify_points(const struct drawing_point *points,
+                            uint32_t count, double tolerance,
+                            struct drawing_point *out, uint32_t *out_count) {
+    if (count < 3) {
+        if (out != points) {
+            memcpy(out, points, count * sizeof(*out));
+        }
+        *out_count = count;
+        return true;
+    }
+
+    /*
+     * Iterative RDP: an explicit stack of [first, last] ranges avoids deep
+     * recursion on long strokes. Each range pushes at most two sub-ranges,
+     * so the stack never holds more than count entries.
+     */
+    bool *keep = calloc(count, sizeof(*keep));
+    uint32_t(*stack)[2] = malloc(count * sizeof(*stack));
+    if (!keep || !stack) {
+        free(keep);
+        free(stack);
+        return false;
+    }
+
+    double tolerance_sq = tolerance * tolerance;
+    uint32_t depth = 0;
+
+    keep[0] = true;
+    keep[count - 1] = true;
+    stack[depth][0] = 0;
+    stack[depth][1] = count - 1;
+    depth++;
+
+    while (depth > 0) {
+        depth--;
+        uint32_t first = stack[depth][0];
+        uint32_t last = stack[depth][1];
+
+        double max_dist_sq = 0.0;
+        uint32_t max_index = first;
+        for (uint32_t i = first + 1; i < last; i++) {
+            double dist_sq = segment_distance_sq(
+                points[i].x, points[i].y, points[first].x, points[first].y,
+                points[last].x, points[last].y);
+            if (dist_sq > max_dist_sq) {
+                max_dist_sq = dist_sq;
+                max_index = i;
+            }
+        }
+
+        if (max_dist_sq > tolerance_sq) {
+            keep[max_index] = true;
+            if (max_index - first > 1) {
+                stack[depth][0] = first;
+                stack[depth][1] = max_index;
+                depth++;
+            }
+            if (last - max_index > 1) {
+                stack[depth][0] = max_index;
+                stack[depth][1] = last;
+                depth++;
+            }
+        }
+    }
+
+    /* Compact the kept points (safe in place, as kept <= i) */
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (keep[i]) {
+            out[kept++] = points[i];
+        }
+    }
+    *out_count = kept;
+
+    free(keep);
+    free(stack);
+    return true;
+}
+
+/* Signed area of the triangle a-b-c, doubled */
+static double cross(double ax, double ay, double bx, double by, double cx,
+                    double cy) {
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+bool stroke_segment_near(const struct drawing_stroke *stroke,
+                         const struct drawing_point *p,
+                         const struct drawing_point *q, double ax, double ay,
+                         double bx, double by, double radius) {
+    /* Work in stroke-local coordinates to keep float precision */
+    ax -= stroke->origin_x;
+    ay -= stroke->origin_y;
+    bx -= stroke->origin_x;
+    by -= stroke->origin_y;
+    double px = p->x, py = p->y;
+    double qx = q->x, qy = q->y;
+
+    /* Segments that cross are at distance zero */
+    double d1 = cross(ax, ay, bx, by, px, py);
+    double d2 = cross(ax, ay, bx, by, qx, qy);
+    double d3 = cross(px, py, qx, qy, ax, ay);
+    double d4 = cross(px, py, qx, qy, bx, by);
+    if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) &&
+        ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) {
+        return true;
+    }
+
+    /* Otherwise the closest approach involves an end point */
+    double radius_sq = radius * radius;
+    return segment_distance_sq(px, py, ax, ay, bx, by) <= radius_sq ||
+           segment_distance_sq(qx, qy, ax, ay, bx, by) <= radius_sq ||
+           segment_distance_sq(ax, ay, px, py, qx, qy) <= radius_sq ||
+           segment_distance_sq(bx, by, px, py, qx, qy) <= radius_sq;
+}
+
+bool stroke_simplify(struct drawing_stroke *stroke, double tolerance) {
+    if (!stroke->points) {
+        return false;
+    }
+    return simplify_points(stroke->points, stroke->point_count, tolerance,
+                           stroke->points, &stroke->point_count);
+}
+
+void stroke_compute_bounds(struct drawing_stroke *stroke) {
+    struct point_cursor cursor;
+    struct drawing_point point;
+    stroke_cursor(stroke, 0, stroke->point_count, &cursor);
+    if (!point_cursor_next(&cursor, &point)) {
+        stroke->min_x = stroke->min_y = 0.0f;
+        stroke->max_x = stroke->max_y = 0.0f;
+        return;
+    }
+
+    float min_x = point.x, max_x = point.x;
+    float min_y = point.y, max_y = point.y;
+    while (point_cursor_next(&cursor, &point)) {
+        min_x = fminf(min_x, point.x);
+        max_x = fmaxf(max_x, point.x);
+        min_y = fminf(min_y, point.y);
+        max_y = fmaxf(max_y, point.y);
+    }
+
+    stroke->min_x = min_x;
+    stroke->min_y = min_y;
+    stroke->max_x = max_x;
+    stroke->max_y = max_y;
+}
+
+static void stroke_free_lods(struct drawing_stroke *stroke) {
+    for (uint32_t i = 0; i < stroke->lod_count; i++) {
+        free(stroke->lods[i].data);
+    }
+    stroke->lod_count = 0;
+}
+
+bool stroke_build_lods(struct drawing_stroke *stroke, double base_tolerance) {
+    stroke_free_lods(stroke);
+
+    /* Always decimate from the full-detail points for accuracy */
+    uint32_t full_count = stroke->point_count;
+    struct drawing_point *full = malloc(full_count * sizeof(*full));
+    struct drawing_point *points = malloc(full_count * sizeof(*points));
+    if (!full || !points) {
+        free(full);
+        free(points);
+        return false;
+    }
+    struct point_cursor cursor;
+    stroke_cursor(stroke, 0, full_count, &cursor);
+    full_count = 0;
+    while (point_cursor_next(&cursor, &full[full_count])) {
+        full_count++;
+    }
+
+    /* Nothing coarser than the bounding box makes sense */
+    double extent = fmax(stroke->max_x - stroke->min_x,
+                         stroke->max_y - stroke->min_y);
+    uint32_t prev_count = full_count;
+    double tolerance = base_tolerance;
+    bool ok = true;
+
+    while (stroke->lod_count < STROKE_MAX_LODS && prev_count > 2 &&
+           tolerance < extent) {
+        tolerance *= 2.0;
+
+        /*
+         * Rounding to a fraction of the tolerance is invisible at this
+         * level, but moves each point by up to half the quantum's diagonal,
+         * so simplifying only gets what that leaves of the tolerance.
+         */
+        float quantum = (float)(tolerance / 4.0);
+        double rounding = quantum * sqrt(2.0) / 2.0;
+
+        uint32_t count;
+        if (!simplify_points(full, full_count, tolerance - rounding, points,
+                             &count)) {
+            ok = false;
+            break;
+        }
+
+        /* A level that drops nothing is not worth its memory */
+        if (count >= prev_count) {
+            continue;
+        }
+
+        struct wl_array block;
+        wl_array_init(&block);
+        if (!point_codec_pack(points, count, &quantum, &block)) {
+            wl_array_release(&block);
+            ok = false;
+            break;
+        }
+        void *data = realloc(block.data, block.size ? block.size : 1);
+        if (data) {
+            block.data = data;
+        }
+
+        struct stroke_lod *lod = &stroke->lods[stroke->lod_count++];
+        lod->data = block.data;
+        point_codec_view(block.data, block.size, count, quantum,
+                         &lod->packed);
+        /* The codec may have coarsened the quantum, so count what it used */
+        lod->tolerance =
+            (float)(tolerance - rounding + quantum * sqrt(2.0) / 2.0);
+        prev_count = count;
+    }
+
+    free(full);
+    free(points);
+    if (!ok) {
+        stroke_free_lods(stroke);
+    }
+    return ok;
+}
+
+uint32_t stroke_select_lod(const struct drawing_stroke *stroke,
+                           double max_error, struct point_cursor *cursor) {
+    /* Levels are ordered fine to coarse, so pick the last acceptable one */
+    for (uint32_t i = stroke->lod_count; i > 0; i--) {
+        const struct stroke_lod *lod = &stroke->lods[i - 1];
+        if (lod->tolerance <= max_error) {
+            point_cursor_init_packed(cursor, &lod->packed, 0,
+                                     lod->packed.count);
+            return lod->packed.count;
+        }
+    }
+
+    stroke_cursor(stroke, 0, stroke->point_count, cursor);
+    return stroke->point_count;
+}
+
+void stroke_eval_catmull_rom(const struct drawing_point ctrl[4], float t,
+                             float *x, float *y) {
+    const struct drawing_point *p0 = &ctrl[0];
+    const struct drawing_point *p1 = &ctrl[1];
+    const struct drawing_point *p2 = &ctrl[2];
+    const struct drawing_point *p3 = &ctrl[3];
+    float t2 = t * t;
+    float t3 = t2 * t;
+
+    *x = 0.5f * ((2.0f * p1->x) + (-p0->x + p2->x) * t +
+                 (2.0f * p0->x - 5.0f * p1->x + 4.0f * p2->x - p3->x) * t2 +
+                 (-p0->x + 3.0f * p1->x - 3.0f * p2->x + p3->x) * t3);
+    *y = 0.5f * ((2.0f * p1->y) + (-p0->y + p2->y) * t +
+                 (2.0f * p0->y - 5.0f * p1->y + 4.0f * p2->y - p3->y) * t2 +
+                 (-p0->y + 3.0f * p1->y - 3.0f * p2->y + p3->y) * t3);
+}
@@ -0,0 +1,454 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * stroke_index.c - Uniform grid spatial index of stroke segments
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "infinidesk/stroke.h"
+#include "infinidesk/stroke_index.h"
+
+/* Initial number of hash table slots (must be a power of two) */
+#define STROKE_INDEX_INITIAL_CAPACITY 256
+/* Initial number of entries in a cell */
+#define STROKE_INDEX_INITIAL_ENTRIES 4
+
+/* Inclusive range of cells covered by a rect */
+struct cell_range {
+    int32_t x1, y1, x2, y2;
+};
+
+static int32_t cell_coord(struct stroke_index *index, double v) {
+    double c = floor(v / index->cell_size);
+    if (c < INT32_MIN) {
+        return INT32_MIN;
+    }
+    if (c > INT32_MAX) {
+        return INT32_MAX;
+    }
+    return (int32_t)c;
+}
+
+static struct cell_range cell_range_for_rect(struct stroke_index *index,
+                                             double min_x, double min_y,
+                                             double max_x, double max_y) {
+    return (struct cell_range){
+        .x1 = cell_coord(index, min_x),
+        .y1 = cell_coord(index, min_y),
+        .x2 = cell_coord(index, max_x),
+        .y2 = cell_coord(index, max_y),
+    };
+}
+
+static uint64_t cell_range_count(const struct cell_range *range) {
+    return (uint64_t)((int64_t)range->x2 - range->x1 + 1) *
+           (uint64_t)((int64_t)range->y2 - range->y1 + 1);
+}
+
+static bool cell_in_range(const struct stroke_index_cell *cell,
+                          const struct cell_range *range) {
+    return cell->x >= range->x1 && cell->x <= range->x2 &&
+           cell->y >= range->y1 && cell->y <= range->y2;
+}
+
+static uint32_t cell_hash(int32_t x, int32_t y) {
+    uint32_t h = (uint32_t)x * 0x9e3779b1u ^ (uint32_t)y * 0x85ebca77u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+/*
+ * Find the slot for cell (x, y): either the cell itself or the empty slot
+ * where it would be inserted.
+ */
+static struct stroke_index_cell *find_slot(struct stroke_index_cell *cells,
+                                           uint32_t capacity, int32_t x,
+                                           int32_t y) {
+    uint32_t mask = capacity - 1;
+    uint32_t i = cell_hash(x, y) & mask;
+    while (cells[i].used && (cells[i].x != x || cells[i].y != y)) {
+        i = (i + 1) & mask;
+    }
+    return &cells[i];
+}
+
+static bool grow_table(struct stroke_index *index) {
+    uint32_t new_capacity = index->capacity ? index->capacity * 2
+                                            : STROKE_INDEX_INITIAL_CAPACITY;
+    struct stroke_index_cell *new_cells =
+        calloc(new_capacity, sizeof(*new_cells));
+    if (!new_cells) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < index->capacity; i++) {
+        struct stroke_index_cell *cell = &index->cells[i];
+        if (cell->used) {
+            *find_slot(new_cells, new_capacity, cell->x, cell->y) = *cell;
+        }
+    }
+
+    free(index->cells);
+    index->cells = new_cells;
+    index->capacity = new_capacity;
+    return true;
+}
+
+static struct stroke_index_cell *lookup_cell(struct stroke_index *index,
+                                             int32_t x, int32_t y) {
+    if (index->used == 0) {
+        return NULL;
+    }
+    struct stroke_index_cell *cell =
+        find_slot(index->cells, index->capacity, x, y);
+    return cell->used ? cell : NULL;
+}
+
+static struct stroke_index_cell *get_cell(struct stroke_index *index,
+                                          int32_t x, int32_t y) {
+    /* Keep the load factor under 70% so probe sequences stay short */
+    if ((uint64_t)(index->used + 1) * 10 > (uint64_t)index->capacity * 7) {
+        if (!grow_table(index)) {
+            return NULL;
+        }
+    }
+
+    struct stroke_index_cell *cell =
+        find_slot(index->cells, index->capacity, x, y);
+    if (!cell->used) {
+        cell->used = true;
+        cell->x = x;
+        cell->y = y;
+        index->used++;
+    }
+    return cell;
+}
+
+/*
+ * Record segment seg of stroke in a cell, extending the stroke's last run
+ * in that cell if the segment continues it.
+ */
+static bool cell_add_segment(struct stroke_index_cell *cell,
+                             struct drawing_stroke *stroke, uint32_t seg) {
+    if (cell->entry_count > 0) {
+        struct stroke_index_entry *last =
+            &cell->entries[cell->entry_count - 1];
+        if (last->stroke == stroke && last->last_seg + 1 >= seg) {
+            last->last_seg = seg;
+            return true;
+        }
+    }
+
+    if (cell->entry_count >= cell->entry_capacity) {
+        uint32_t new_capacity = cell->entry_capacity
+                                    ? cell->entry_capacity * 2
+                                    : STROKE_INDEX_INITIAL_ENTRIES;
+        struct stroke_index_entry *new_entries =
+            realloc(cell->entries, new_capacity * sizeof(*new_entries));
+        if (!new_entries) {
+            return false;
+        }
+        cell->entries = new_entries;
+        cell->entry_capacity = new_capacity;
+    }
+
+    cell->entries[cell->entry_count++] = (struct stroke_index_entry){
+        .stroke = stroke,
+        .first_seg = seg,
+        .last_seg = seg,
+    };
+    return true;
+}
+
+/*
+ * Free an emptied cell, shifting later cells of its probe sequence back so
+ * lookups still find them without tombstones.
+ */
+static void delete_cell(struct stroke_index *index,
+                        struct stroke_index_cell *cell) {
+    uint32_t mask = index->capacity - 1;
+    uint32_t hole = (uint32_t)(cell - index->cells);
+    free(cell->entries);
+
+    for (uint32_t i = (hole + 1) & mask; index->cells[i].used;
+         i = (i + 1) & mask) {
+        struct stroke_index_cell *next = &index->cells[i];
+        uint32_t home = cell_hash(next->x, next->y) & mask;
+        /* It may only move back if the hole is between home and here */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            index->cells[hole] = *next;
+            hole = i;
+        }
+    }
+
+    index->cells[hole] = (struct stroke_index_cell){0};
+    index->used--;
+}
+
+static void cell_remove_stroke(struct stroke_index_cell *cell,
+                               struct drawing_stroke *stroke) {
+    /* Order within a cell doesn't matter, so swap-remove */
+    uint32_t i = 0;
+    while (i < cell->entry_count) {
+        if (cell->entries[i].stroke == stroke) {
+            cell->entries[i] = cell->entries[--cell->entry_count];
+        } else {
+            i++;
+        }
+    }
+}
+
+void stroke_index_init(struct stroke_index *index, double cell_size) {
+    index->cell_size = cell_size;
+    index->cells = NULL;
+    index->capacity = 0;
+    index->used = 0;
+    index->stamp = 0;
+}
+
+void stroke_index_finish(struct stroke_index *index) {
+    stroke_index_clear(index);
+    free(index->cells);
+    index->cells = NULL;
+    index->capacity = 0;
+}
+
+void stroke_index_clear(struct stroke_index *index) {
+    for (uint32_t i = 0; i < index->capacity; i++) {
+        struct stroke_index_cell *cell = &index->cells[i];
+        if (cell->used) {
+            free(cell->entries);
+            *cell = (struct stroke_index_cell){0};
+        }
+    }
+    index->used = 0;
+}
+
+bool stroke_index_translate(struct stroke_index *index, double dx,
+                            double dy) {
+    if (index->used == 0) {
+        return true;
+    }
+
+    struct stroke_index_cell *new_cells =
+        calloc(index->capacity, sizeof(*new_cells));
+    if (!new_cells) {
+        return false;
+    }
+
+    /* Cells keep their entries; only their keys, and so slots, change */
+    double cells_x = round(dx / index->cell_size);
+    double cells_y = round(dy / index->cell_size);
+    for (uint32_t i = 0; i < index->capacity; i++) {
+        struct stroke_index_cell *cell = &index->cells[i];
+        if (cell->used) {
+            cell->x = cell_coord(index, (cell->x + cells_x) * index->cell_size);
+            cell->y = cell_coord(index, (cell->y + cells_y) * index->cell_size);
+            *find_slot(new_cells, index->capacity, cell->x, cell->y) = *cell;
+        }
+    }
+
+    free(index->cells);
+    index->cells = new_cells;
+    return true;
+}
+
+static bool add_to_cell(struct stroke_index *index, int32_t cx, int32_t cy,
+                        struct drawing_stroke *stroke, uint32_t seg) {
+    struct stroke_index_cell *cell = get_cell(index, cx, cy);
+    return cell && cell_add_segment(cell, stroke, seg);
+}
+
+/*
+ * Add a segment to each cell it passes through, stepping from cell to cell
+ * along it rather than filling its bounding box, which for a long diagonal
+ * would be mostly cells it never touches. A segment through a cell corner
+ * also gets one of the two cells it only grazes.
+ */
+static bool add_segment(struct stroke_index *index,
+                        struct drawing_stroke *stroke, uint32_t seg,
+                        double x0, double y0, double x1, double y1) {
+    int32_t cx = cell_coord(index, x0);
+    int32_t cy = cell_coord(index, y0);
+    int32_t end_x = cell_coord(index, x1);
+    int32_t end_y = cell_coord(index, y1);
+    if (!add_to_cell(index, cx, cy, stroke, seg)) {
+        return false;
+    }
+
+    /* Distance along the segment, 0 to 1, to the next cell edge in x, y */
+    double dx = x1 - x0, dy = y1 - y0;
+    int32_t step_x = dx > 0 ? 1 : -1;
+    int32_t step_y = dy > 0 ? 1 : -1;
+    double next_x = INFINITY, delta_x = INFINITY;
+    double next_y = INFINITY, delta_y = INFINITY;
+    if (dx != 0) {
+        double edge = ((double)cx + (step_x > 0)) * index->cell_size;
+        next_x = (edge - x0) / dx;
+        delta_x = index->cell_size / fabs(dx);
+    }
+    if (dy != 0) {
+        double edge = ((double)cy + (step_y > 0)) * index->cell_size;
+        next_y = (edge - y0) / dy;
+        delta_y = index->cell_size / fabs(dy);
+    }
+
+    /* Stop at the end cell even if rounding says otherwise */
+    while (cx != end_x || cy != end_y) {
+        if (cy == end_y || (cx != end_x && next_x <= next_y)) {
+            cx += step_x;
+            next_x += delta_x;
+        } else {
+            cy += step_y;
+            next_y += delta_y;
+        }
+        if (!add_to_cell(index, cx, cy, stroke, seg)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool stroke_index_insert(struct stroke_index *index,
+                         struct drawing_stroke *stroke) {
+    struct point_cursor cursor;
+    struct drawing_point a, b;
+    stroke_cursor(stroke, 0, stroke->point_count, &cursor);
+    if (!point_cursor_next(&cursor, &a)) {
+        return true;
+    }
+
+    for (uint32_t seg = 0; point_cursor_next(&cursor, &b); seg++, a = b) {
+        if (!add_segment(index, stroke, seg, stroke->origin_x + a.x,
+                         stroke->origin_y + a.y, stroke->origin_x + b.x,
+                         stroke->origin_y + b.y)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void stroke_index_remove(struct stroke_index *index,
+                         struct drawing_stroke *stroke) {
+    struct cell_range range = cell_range_for_rect(
+        index, stroke->origin_x + stroke->min_x,
+        stroke->origin_y + stroke->min_y, stroke->origin_x + stroke->max_x,
+        stroke->origin_y + stroke->max_y);
+
+    /* For huge strokes, scanning the occupied cells is cheaper */
+    if (cell_range_count(&range) > index->used) {
+        uint32_t i = 0;
+        while (i < index->capacity) {
+            struct stroke_index_cell *cell = &index->cells[i];
+            if (cell->used && cell_in_range(cell, &range)) {
+                cell_remove_stroke(cell, stroke);
+                if (cell->entry_count == 0) {
+                    /* A later cell may have moved into this slot */
+                    delete_cell(index, cell);
+                    continue;
+                }
+            }
+            i++;
+        }
+        return;
+    }
+
+    for (int32_t cy = range.y1; cy <= range.y2; cy++) {
+        for (int32_t cx = range.x1; cx <= range.x2; cx++) {
+            struct stroke_index_cell *cell = lookup_cell(index, cx, cy);
+            if (cell) {
+                cell_remove_stroke(cell, stroke);
+                if (cell->entry_count == 0) {
+                    delete_cell(index, cell);
+                }
+            }
+        }
+    }
+}
+
+static void visit_cell(struct stroke_index_cell *cell,
+                       stroke_index_segment_func_t iterator, void *data) {
+    for (uint32_t i = 0; i < cell->entry_count; i++) {
+        struct stroke_index_entry *entry = &cell->entries[i];
+        iterator(entry->stroke, entry->first_seg, entry->last_seg, data);
+    }
+}
+
+void stroke_index_query_segments(struct stroke_index *index, double min_x,
+                                 double min_y, double max_x, double max_y,
+                                 stroke_index_segment_func_t iterator,
+                                 void *data) {
+    struct cell_range range =
+        cell_range_for_rect(index, min_x, min_y, max_x, max_y);
+
+    /*
+     * When zoomed far out the rect can cover more cells than exist, in
+     * which case it is cheaper to scan the table.
+     */
+    if (cell_range_count(&range) > index->used) {
+        for (uint32_t i = 0; i < index->capacity; i++) {
+            struct stroke_index_cell *cell = &index->cells[i];
+            if (cell->used && cell_in_range(cell, &range)) {
+                visit_cell(cell, iterator, data);
+            }
+        }
+        return;
+    }
+
+    for (int32_t cy = range.y1; cy <= range.y2; cy++) {
+        for (int32_t cx = range.x1; cx <= range.x2; cx++) {
+            struct stroke_index_cell *cell = lookup_cell(index, cx, cy);
+            if (cell) {
+                visit_cell(cell, iterator, data);
+            }
+        }
+    }
+}
+
+struct stroke_query_data {
+    uint32_t stamp;
+    stroke_index_stroke_func_t iterator;
+    void *data;
+};
+
+static void stroke_query_iterator(struct drawing_stroke *stroke,
+                                  uint32_t first_seg, uint32_t last_seg,
+                                  void *data) {
+    (void)first_seg;
+    (void)last_seg;
+    struct stroke_query_data *query = data;
+
+    if (stroke->index_stamp == query->stamp) {
+        return;
+    }
+    stroke->index_stamp = query->stamp;
+    query->iterator(stroke, query->data);
+}
+
+void stroke_index_query_strokes(struct stroke_index *index, double min_x,
+                                double min_y, double max_x, double max_y,
+                                stroke_index_stroke_func_t iterator,
+                                void *data) {
+    /* Stamp 0 is never used, so new strokes are never mistaken as seen */
+    if (++index->stamp == 0) {
+        index->stamp = 1;
+    }
+
+    struct stroke_query_data query = {
+        .stamp = index->stamp,
+        .iterator = iterator,
+        .data = data,
+    };
+    stroke_index_query_segments(index, min_x, min_y, max_x, max_y,
+                                stroke_query_iterator, &query);
+}
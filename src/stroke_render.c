@@ -0,0 +1,220 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * stroke_render.c - Turning strokes into render commands
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "infinidesk/point_codec.h"
+#include "infinidesk/point_transform.h"
+#include "infinidesk/stroke.h"
+#include "infinidesk/stroke_render.h"
+
+/* Screen px per curve subdivision when rendering smoothed strokes */
+#define STROKE_SMOOTH_STEP 8.0
+#define STROKE_SMOOTH_MAX_STEPS 16
+/* Points decoded and transformed together when rendering a stroke */
+#define STROKE_RENDER_BATCH 128
+/* Max deviation allowed when picking a stroke level of detail, in px */
+#define STROKE_LOD_MAX_ERROR 0.5
+
+/*
+ * Draw a small square of the stroke width centred on a point (physical px).
+ */
+static void render_dot(const struct stroke_pass *pass, double x, double y,
+                       double scaled_width,
+                       const struct drawing_color *color) {
+    struct stroke_rect rect = {
+        .x = (int)(x - scaled_width / 2),
+        .y = (int)(y - scaled_width / 2),
+        .width = (int)scaled_width + 1,
+        .height = (int)scaled_width + 1,
+    };
+    pass->add_rect(pass->data, &rect, color);
+}
+
+/*
+ * Render a straight line segment (in physical pixels) of a given length as
+ * a chain of small rectangles, since wlroots doesn't have a direct line
+ * primitive.
+ */
+static void render_segment(const struct stroke_pass *pass, double x1,
+                           double y1, double x2, double y2, double length,
+                           double scaled_width,
+                           const struct drawing_color *color) {
+    double dx = x2 - x1;
+    double dy = y2 - y1;
+
+    if (length <= 0.1) {
+        return;
+    }
+
+    /* Draw multiple small rects along the line for smoothness */
+    int segments = (int)(length / 2.0) + 1;
+    for (int i = 0; i <= segments; i++) {
+        double t = segments > 0 ? (double)i / segments : 0;
+        double x = x1 + dx * t;
+        double y = y1 + dy * t;
+
+        render_dot(pass, x, y, scaled_width, color);
+    }
+}
+
+/*
+ * Render the segment ctrl[1] -> ctrl[2] of a stroke, already transformed to
+ * (x1, y1) -> (x2, y2) in physical pixels, as a Catmull-Rom curve if the
+ * stroke is smooth or a straight line otherwise.
+ */
+static void render_stroke_segment(const struct stroke_pass *pass,
+                                  const struct point_transform *transform,
+                                  const struct drawing_point ctrl[4],
+                                  bool smooth, double x1, double y1,
+                                  double x2, double y2, double length,
+                                  double scaled_width,
+                                  const struct drawing_color *color) {
+    /*
+     * Subdivide the curve in proportion to the segment's on-screen
+     * length, so short segments stay a single straight piece.
+     */
+    int steps = 1;
+    if (smooth) {
+        steps = (int)(length / STROKE_SMOOTH_STEP) + 1;
+        if (steps > STROKE_SMOOTH_MAX_STEPS) {
+            steps = STROKE_SMOOTH_MAX_STEPS;
+        }
+    }
+
+    if (steps == 1) {
+        render_segment(pass, x1, y1, x2, y2, length, scaled_width, color);
+        return;
+    }
+
+    double prev_x = x1;
+    double prev_y = y1;
+    for (int i = 1; i <= steps; i++) {
+        float local_x, local_y;
+        stroke_eval_catmull_rom(ctrl, (float)i / steps, &local_x, &local_y);
+        double x = transform->base_x + local_x * transform->scale;
+        double y = transform->base_y + local_y * transform->scale;
+        double dx = x - prev_x;
+        double dy = y - prev_y;
+        render_segment(pass, prev_x, prev_y, x, y, sqrt(dx * dx + dy * dy),
+                       scaled_width, color);
+        prev_x = x;
+        prev_y = y;
+    }
+}
+
+void stroke_render(const struct stroke_pass *pass,
+                   struct drawing_stroke *stroke,
+                   const struct point_transform *transform,
+                   double error_scale) {
+    /* The transform's scale combines the canvas zoom with the output's */
+    double combined_scale = transform->scale;
+    double scaled_width = STROKE_LINE_WIDTH * combined_scale;
+    const struct drawing_color *color = &stroke->color;
+
+    /*
+     * A stroke that projects to under a pixel is drawn as a single dot
+     * at its centre, regardless of how many points it has.
+     */
+    double extent_x = (stroke->max_x - stroke->min_x) * combined_scale;
+    double extent_y = (stroke->max_y - stroke->min_y) * combined_scale;
+    if (extent_x < 1.0 && extent_y < 1.0) {
+        double x = transform->base_x +
+                   (stroke->min_x + stroke->max_x) / 2.0 * combined_scale;
+        double y = transform->base_y +
+                   (stroke->min_y + stroke->max_y) / 2.0 * combined_scale;
+        render_dot(pass, x, y, scaled_width, color);
+        return;
+    }
+
+    /*
+     * Use the coarsest level that is still accurate to half a pixel, or
+     * more when the render governor is trading detail for speed.
+     * Levels are built when a stroke is finished, or between frames for
+     * strokes loaded from disk, never here; until then the stroke simply
+     * renders at full detail.
+     */
+    double max_error = STROKE_LOD_MAX_ERROR * error_scale / combined_scale;
+    struct point_cursor cursor;
+    stroke_select_lod(stroke, max_error, &cursor);
+
+    /*
+     * Decode the points a batch at a time and transform each batch to
+     * physical pixels in one go. Every segment points[i] -> points[i + 1]
+     * also needs its neighbours for the curve, which are the segment's own
+     * ends at the ends of the stroke. The last two points of a batch are
+     * carried over to start the next one, with the point before them in
+     * prev.
+     */
+    struct drawing_point points[STROKE_RENDER_BATCH];
+    double xs[STROKE_RENDER_BATCH];
+    double ys[STROKE_RENDER_BATCH];
+    double lengths[STROKE_RENDER_BATCH];
+
+    struct drawing_point prev;
+    uint32_t n = 0;
+    for (bool first = true;; first = false) {
+        uint32_t want = STROKE_RENDER_BATCH - n;
+        uint32_t got = 0;
+        while (got < want && point_cursor_next(&cursor, &points[n + got])) {
+            got++;
+        }
+        n += got;
+        bool last = got < want;
+
+        if (first) {
+            if (n < 2) {
+                return;
+            }
+            prev = points[0];
+        }
+
+        point_transform_batch(transform, points, n, xs, ys, lengths);
+
+        /* Segments whose following point has been decoded */
+        uint32_t segments = last ? n - 1 : n - 2;
+        for (uint32_t i = 0; i < segments; i++) {
+            struct drawing_point ctrl[4] = {
+                i > 0 ? points[i - 1] : prev,
+                points[i],
+                points[i + 1],
+                i + 2 < n ? points[i + 2] : points[i + 1],
+            };
+            render_stroke_segment(pass, transform, ctrl, stroke->smooth,
+                                  xs[i], ys[i], xs[i + 1], ys[i + 1],
+                                  lengths[i], scaled_width, color);
+        }
+
+        if (last) {
+            return;
+        }
+        prev = points[n - 3];
+        points[0] = points[n - 2];
+        points[1] = points[n - 1];
+        n = 2;
+    }
+}
+
+static int compare_stroke_z(const void *a, const void *b) {
+    const struct drawing_stroke *stroke_a =
+        *(const struct drawing_stroke *const *)a;
+    const struct drawing_stroke *stroke_b =
+        *(const struct drawing_stroke *const *)b;
+    if (stroke_a->z != stroke_b->z) {
+        return stroke_a->z < stroke_b->z ? -1 : 1;
+    }
+    return (stroke_a->id > stroke_b->id) - (stroke_a->id < stroke_b->id);
+}
+
+void stroke_sort_z(struct drawing_stroke **strokes, uint32_t count) {
+    qsort(strokes, count, sizeof(*strokes), compare_stroke_z);
+}
@@ -23,6 +23,7 @@
 
 #include "infinidesk/canvas.h"
 #include "infinidesk/output.h"
+#include "infinidesk/perf.h"
 #include "infinidesk/server.h"
 #include "infinidesk/switcher.h"
 #include "infinidesk/view.h"
@@ -344,5 +345,5 @@ void switcher_render(struct infinidesk_switcher *switcher,
             },
     };
 
-    wlr_render_pass_add_texture(pass, &opts);
+    perf_add_texture(pass, &opts);
 }
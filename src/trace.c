@@ -0,0 +1,327 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * trace.c - Event tracing in the Chrome trace format
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <wlr/util/log.h>
+
+#include "infinidesk/trace.h"
+
+/* Most tracks, including the fixed ones */
+#define TRACE_MAX_TRACKS 32
+#define TRACE_TRACK_NAME_LEN 32
+
+struct trace_event {
+    uint64_t ts_ns;
+    uint64_t dur_ns;
+    const char *name;
+    uint32_t track;
+    char phase; /* 'i' for instant, 'X' for complete */
+    char arg[TRACE_ARG_LEN];
+};
+
+static struct {
+    bool active;
+    char *path;
+
+    struct trace_event *events; /* Ring of TRACE_CAPACITY */
+    uint32_t head;
+    uint32_t count;
+    uint64_t dropped;
+
+    char track_names[TRACE_MAX_TRACKS][TRACE_TRACK_NAME_LEN];
+    uint32_t track_count;
+} trace = {
+    .track_names =
+        {
+            [TRACE_TRACK_INPUT] = "input",
+            [TRACE_TRACK_CLIENTS] = "clients",
+            [TRACE_TRACK_ANIMATION] = "animation",
+        },
+    .track_count = TRACE_TRACK_FIXED_COUNT,
+};
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static char *default_path(void) {
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    if (!dir || !*dir) {
+        dir = "/tmp";
+    }
+    size_t len = strlen(dir) + sizeof("/infinidesk-trace.json");
+    char *path = malloc(len);
+    if (path) {
+        snprintf(path, len, "%s/infinidesk-trace.json", dir);
+    }
+    return path;
+}
+
+/* Length of the UTF-8 sequence a byte starts, or 0 if it can't start one */
+static int utf8_length(unsigned char c) {
+    if (c < 0x80) {
+        return 1;
+    } else if (c >= 0xc2 && c < 0xe0) {
+        return 2;
+    } else if (c >= 0xe0 && c < 0xf0) {
+        return 3;
+    } else if (c >= 0xf0 && c < 0xf5) {
+        return 4;
+    }
+    return 0;
+}
+
+/*
+ * If a string was cut off at size - 1 bytes, drop any character the cut
+ * split, so a window title doesn't end in half a character.
+ */
+static void trim_utf8(char *s, size_t size) {
+    size_t len = strnlen(s, size);
+    if (len < size - 1) {
+        return;
+    }
+    size_t start = len;
+    while (start > 0 && len - start < 4 &&
+           ((unsigned char)s[start - 1] & 0xc0) == 0x80) {
+        start--;
+    }
+    if (start > 0 && start - 1 + utf8_length(s[start - 1]) > len) {
+        s[start - 1] = '\0';
+    }
+}
+
+bool trace_start(const char *path) {
+    if (trace.active) {
+        return true;
+    }
+
+    char *new_path = path ? strdup(path) : NULL;
+    if (new_path || !trace.path) {
+        if (!new_path) {
+            new_path = default_path();
+        }
+        if (!new_path) {
+            wlr_log(WLR_ERROR, "Failed to allocate trace path");
+            return false;
+        }
+        free(trace.path);
+        trace.path = new_path;
+    }
+
+    trace.events = malloc(TRACE_CAPACITY * sizeof(*trace.events));
+    if (!trace.events) {
+        wlr_log(WLR_ERROR, "Failed to allocate trace buffer");
+        return false;
+    }
+    trace.head = 0;
+    trace.count = 0;
+    trace.dropped = 0;
+    trace.active = true;
+
+    wlr_log(WLR_INFO, "Tracing to %s", trace.path);
+    return true;
+}
+
+bool trace_active(void) {
+    return trace.active;
+}
+
+uint32_t trace_register_track(const char *name) {
+    for (uint32_t i = 0; i < trace.track_count; i++) {
+        if (strncmp(trace.track_names[i], name, TRACE_TRACK_NAME_LEN - 1) ==
+            0) {
+            return i;
+        }
+    }
+    if (trace.track_count == TRACE_MAX_TRACKS) {
+        /* Out of tracks: share the last one */
+        return TRACE_MAX_TRACKS - 1;
+    }
+
+    uint32_t track = trace.track_count++;
+    snprintf(trace.track_names[track], TRACE_TRACK_NAME_LEN, "%s", name);
+    trim_utf8(trace.track_names[track], TRACE_TRACK_NAME_LEN);
+    return track;
+}
+
+uint64_t trace_now(void) {
+    return trace.active ? get_time_ns() : 0;
+}
+
+static void format_arg(char arg[TRACE_ARG_LEN], const char *fmt,
+                       va_list args) {
+    vsnprintf(arg, TRACE_ARG_LEN, fmt, args);
+    trim_utf8(arg, TRACE_ARG_LEN);
+}
+
+static struct trace_event *next_event(void) {
+    struct trace_event *event = &trace.events[trace.head];
+    trace.head = (trace.head + 1) % TRACE_CAPACITY;
+    if (trace.count < TRACE_CAPACITY) {
+        trace.count++;
+    } else {
+        trace.dropped++;
+    }
+    return event;
+}
+
+void trace_instant(uint32_t track, const char *name, const char *fmt, ...) {
+    if (!trace.active) {
+        return;
+    }
+
+    struct trace_event *event = next_event();
+    event->ts_ns = get_time_ns();
+    event->dur_ns = 0;
+    event->name = name;
+    event->track = track;
+    event->phase = 'i';
+
+    va_list args;
+    va_start(args, fmt);
+    format_arg(event->arg, fmt, args);
+    va_end(args);
+}
+
+void trace_complete(uint32_t track, const char *name, uint64_t start_ns,
+                    const char *fmt, ...) {
+    /* start_ns is 0 if tracing started part way through the event */
+    if (!trace.active || start_ns == 0) {
+        return;
+    }
+
+    struct trace_event *event = next_event();
+    event->ts_ns = start_ns;
+    event->dur_ns = get_time_ns() - start_ns;
+    event->name = name;
+    event->track = track;
+    event->phase = 'X';
+
+    va_list args;
+    va_start(args, fmt);
+    format_arg(event->arg, fmt, args);
+    va_end(args);
+}
+
+/*
+ * Write a string as a JSON string literal. Control characters are escaped,
+ * and bytes that aren't valid UTF-8, which clients can put in titles, are
+ * written as U+FFFD so the trace still loads.
+ */
+static void write_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    while (*s) {
+        unsigned char c = (unsigned char)*s;
+        int len = utf8_length(c);
+        for (int i = 1; i < len; i++) {
+            if (((unsigned char)s[i] & 0xc0) != 0x80) {
+                len = 0;
+                break;
+            }
+        }
+
+        if (len == 0) {
+            fputs("\\ufffd", f);
+            len = 1;
+        } else if (len > 1) {
+            fwrite(s, 1, len, f);
+        } else if (c == '"' || c == '\\') {
+            fputc('\\', f);
+            fputc(c, f);
+        } else if (c < 0x20 || c == 0x7f) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+        s += len;
+    }
+    fputc('"', f);
+}
+
+static bool write_trace(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        wlr_log_errno(WLR_ERROR, "Failed to open trace file %s", path);
+        return false;
+    }
+
+    int pid = (int)getpid();
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    fprintf(f,
+            "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":0,"
+            "\"args\":{\"name\":\"infinidesk\"}}",
+            pid);
+    for (uint32_t i = 0; i < trace.track_count; i++) {
+        fprintf(f,
+                ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,"
+                "\"tid\":%u,\"args\":{\"name\":",
+                pid, i);
+        write_json_string(f, trace.track_names[i]);
+        fputs("}}", f);
+    }
+
+    /* Oldest first */
+    uint32_t start =
+        (trace.head + TRACE_CAPACITY - trace.count) % TRACE_CAPACITY;
+    for (uint32_t i = 0; i < trace.count; i++) {
+        const struct trace_event *event =
+            &trace.events[(start + i) % TRACE_CAPACITY];
+        fprintf(f, ",\n{\"ph\":\"%c\",\"name\":", event->phase);
+        write_json_string(f, event->name);
+        fprintf(f, ",\"pid\":%d,\"tid\":%u,\"ts\":%.3f", pid, event->track,
+                event->ts_ns / 1e3);
+        if (event->phase == 'X') {
+            fprintf(f, ",\"dur\":%.3f", event->dur_ns / 1e3);
+        } else {
+            fputs(",\"s\":\"t\"", f);
+        }
+        if (event->arg[0]) {
+            fputs(",\"args\":{\"detail\":", f);
+            write_json_string(f, event->arg);
+            fputc('}', f);
+        }
+        fputc('}', f);
+    }
+    fputs("\n]}\n", f);
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        wlr_log(WLR_ERROR, "Failed to write trace file %s", path);
+    }
+    return ok;
+}
+
+bool trace_stop(void) {
+    if (!trace.active) {
+        return true;
+    }
+    trace.active = false;
+
+    bool ok = write_trace(trace.path);
+    if (ok) {
+        wlr_log(WLR_INFO, "Wrote %u trace events to %s (%lu dropped)",
+                trace.count, trace.path, (unsigned long)trace.dropped);
+    }
+
+    free(trace.events);
+    trace.events = NULL;
+    return ok;
+}
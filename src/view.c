@@ -10,24 +10,33 @@
 
 #include <math.h>
 #include <stdlib.h>
-#include <time.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
 #include <wlr/render/pass.h>
+#include <wlr/render/pixman.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_seat.h>
+#include <wlr/types/wlr_subcompositor.h>
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/util/edges.h>
 #include <wlr/util/log.h>
 
 #include "infinidesk/canvas.h"
+#include "infinidesk/client_stats.h"
+#include "infinidesk/gather.h"
+#include "infinidesk/latency.h"
 #include "infinidesk/output.h"
+#include "infinidesk/perf.h"
+#include "infinidesk/render_governor.h"
+#include "infinidesk/scaled_surface.h"
 #include "infinidesk/server.h"
+#include "infinidesk/trace.h"
 #include "infinidesk/view.h"
+#include "infinidesk/watchdog.h"
 
 /* Window decoration constants */
 #define BORDER_WIDTH 3
@@ -53,11 +62,28 @@
 /* Map/unmap animation scale (windows animate from/to this scale) */
 #define MAP_ANIM_SCALE_START 0.9
 
+/*
+ * A subsurface of a view, at any depth. The view cache keeps the extents of
+ * each view's whole surface tree, so a subsurface committing a new size, or
+ * coming and going, makes it stale just as the view's own commits do.
+ */
+struct view_subsurface {
+    struct wl_list link; /* infinidesk_view.subsurfaces */
+    struct infinidesk_view *view;
+
+    struct wl_listener commit;
+    struct wl_listener new_subsurface;
+    struct wl_listener destroy;
+};
+
 /* Forward declarations for event handlers */
 static void handle_map(struct wl_listener *listener, void *data);
 static void handle_unmap(struct wl_listener *listener, void *data);
 static void handle_destroy(struct wl_listener *listener, void *data);
 static void handle_commit(struct wl_listener *listener, void *data);
+static void handle_new_subsurface(struct wl_listener *listener, void *data);
+static void handle_configure(struct wl_listener *listener, void *data);
+static void handle_ack_configure(struct wl_listener *listener, void *data);
 static void handle_request_move(struct wl_listener *listener, void *data);
 static void handle_request_resize(struct wl_listener *listener, void *data);
 static void handle_request_maximise(struct wl_listener *listener, void *data);
@@ -65,6 +91,82 @@ static void handle_request_fullscreen(struct wl_listener *listener, void *data);
 static void handle_set_title(struct wl_listener *listener, void *data);
 static void handle_set_app_id(struct wl_listener *listener, void *data);
 
+static void untrack_subsurface(struct view_subsurface *subsurface) {
+    wl_list_remove(&subsurface->link);
+    wl_list_remove(&subsurface->commit.link);
+    wl_list_remove(&subsurface->new_subsurface.link);
+    wl_list_remove(&subsurface->destroy.link);
+    free(subsurface);
+}
+
+static void handle_subsurface_commit(struct wl_listener *listener,
+                                     void *data) {
+    (void)data;
+    struct view_subsurface *subsurface =
+        wl_container_of(listener, subsurface, commit);
+    view_cache_invalidate(&subsurface->view->server->view_cache);
+}
+
+static void handle_subsurface_destroy(struct wl_listener *listener,
+                                      void *data) {
+    (void)data;
+    struct view_subsurface *subsurface =
+        wl_container_of(listener, subsurface, destroy);
+    view_cache_invalidate(&subsurface->view->server->view_cache);
+    untrack_subsurface(subsurface);
+}
+
+static void track_subsurface(struct infinidesk_view *view,
+                             struct wlr_subsurface *wlr_subsurface);
+
+/*
+ * Track the subsurfaces a surface already has. Pending state lists every
+ * one, including those not yet committed into current.
+ */
+static void track_subsurfaces(struct infinidesk_view *view,
+                              struct wlr_surface *surface) {
+    struct wlr_subsurface *wlr_subsurface;
+    wl_list_for_each(wlr_subsurface, &surface->pending.subsurfaces_below,
+                     pending.link) {
+        track_subsurface(view, wlr_subsurface);
+    }
+    wl_list_for_each(wlr_subsurface, &surface->pending.subsurfaces_above,
+                     pending.link) {
+        track_subsurface(view, wlr_subsurface);
+    }
+}
+
+static void handle_subsurface_new_subsurface(struct wl_listener *listener,
+                                             void *data) {
+    struct view_subsurface *subsurface =
+        wl_container_of(listener, subsurface, new_subsurface);
+    track_subsurface(subsurface->view, data);
+}
+
+/* Track a subsurface, and any it already has of its own */
+static void track_subsurface(struct infinidesk_view *view,
+                             struct wlr_subsurface *wlr_subsurface) {
+    struct view_subsurface *subsurface = calloc(1, sizeof(*subsurface));
+    if (!subsurface) {
+        wlr_log(WLR_ERROR, "Failed to allocate subsurface tracking");
+        return;
+    }
+    subsurface->view = view;
+    wl_list_insert(&view->subsurfaces, &subsurface->link);
+
+    subsurface->commit.notify = handle_subsurface_commit;
+    wl_signal_add(&wlr_subsurface->surface->events.commit,
+                  &subsurface->commit);
+    subsurface->new_subsurface.notify = handle_subsurface_new_subsurface;
+    wl_signal_add(&wlr_subsurface->surface->events.new_subsurface,
+                  &subsurface->new_subsurface);
+    subsurface->destroy.notify = handle_subsurface_destroy;
+    wl_signal_add(&wlr_subsurface->events.destroy, &subsurface->destroy);
+
+    track_subsurfaces(view, wlr_subsurface->surface);
+    view_cache_invalidate(&view->server->view_cache);
+}
+
 struct infinidesk_view *view_create(struct infinidesk_server *server,
                                     struct wlr_xdg_toplevel *xdg_toplevel) {
     struct infinidesk_view *view = calloc(1, sizeof(*view));
@@ -105,6 +207,19 @@ struct infinidesk_view *view_create(struct infinidesk_server *server,
     view->commit.notify = handle_commit;
     wl_signal_add(&xdg_toplevel->base->surface->events.commit, &view->commit);
 
+    wl_list_init(&view->subsurfaces);
+    view->new_subsurface.notify = handle_new_subsurface;
+    wl_signal_add(&xdg_toplevel->base->surface->events.new_subsurface,
+                  &view->new_subsurface);
+    track_subsurfaces(view, xdg_toplevel->base->surface);
+
+    view->configure.notify = handle_configure;
+    wl_signal_add(&xdg_toplevel->base->events.configure, &view->configure);
+
+    view->ack_configure.notify = handle_ack_configure;
+    wl_signal_add(&xdg_toplevel->base->events.ack_configure,
+                  &view->ack_configure);
+
     /* Set up toplevel event listeners */
     view->request_move.notify = handle_request_move;
     wl_signal_add(&xdg_toplevel->events.request_move, &view->request_move);
@@ -139,6 +254,7 @@ struct infinidesk_view *view_create(struct infinidesk_server *server,
 
     /* Add to the server's view list */
     wl_list_insert(&server->views, &view->link);
+    view_cache_invalidate(&server->view_cache);
 
     wlr_log(WLR_DEBUG, "Created view %p", (void *)view);
     return view;
@@ -148,11 +264,19 @@ void view_destroy(struct infinidesk_view *view) {
     wlr_log(WLR_DEBUG, "Destroying view %p", (void *)view);
 
     wl_list_remove(&view->link);
+    view_cache_invalidate(&view->server->view_cache);
 
     wl_list_remove(&view->map.link);
     wl_list_remove(&view->unmap.link);
     wl_list_remove(&view->destroy.link);
     wl_list_remove(&view->commit.link);
+    wl_list_remove(&view->new_subsurface.link);
+    struct view_subsurface *subsurface, *tmp;
+    wl_list_for_each_safe(subsurface, tmp, &view->subsurfaces, link) {
+        untrack_subsurface(subsurface);
+    }
+    wl_list_remove(&view->configure.link);
+    wl_list_remove(&view->ack_configure.link);
     wl_list_remove(&view->request_move.link);
     wl_list_remove(&view->request_resize.link);
     wl_list_remove(&view->request_maximise.link);
@@ -163,11 +287,9 @@ void view_destroy(struct infinidesk_view *view) {
     free(view);
 }
 
-/* Helper to get current time in milliseconds */
-static uint32_t get_time_ms(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+/* Helper to get the app ID for logs and traces */
+static const char *view_app_id(struct infinidesk_view *view) {
+    return view->xdg_toplevel->app_id ?: "(null)";
 }
 
 void view_focus(struct infinidesk_view *view) {
@@ -200,8 +322,10 @@ void view_focus(struct infinidesk_view *view) {
         if (prev_toplevel && prev_toplevel->base->data) {
             struct infinidesk_view *prev_view = prev_toplevel->base->data;
             prev_view->focused = false;
-            prev_view->focus_anim_start_ms = get_time_ms();
+            prev_view->focus_anim_start_ms = server_time_ms(view->server);
             prev_view->focus_anim_active = true;
+            trace_instant(TRACE_TRACK_ANIMATION, "unfocus_begin", "%s",
+                          view_app_id(prev_view));
             wlr_xdg_toplevel_set_activated(prev_toplevel, false);
         }
     }
@@ -209,8 +333,10 @@ void view_focus(struct infinidesk_view *view) {
     /* Activate the toplevel and start focus animation */
     wlr_xdg_toplevel_set_activated(view->xdg_toplevel, true);
     view->focused = true;
-    view->focus_anim_start_ms = get_time_ms();
+    view->focus_anim_start_ms = server_time_ms(view->server);
     view->focus_anim_active = true;
+    trace_instant(TRACE_TRACK_ANIMATION, "focus_begin", "%s",
+                  view_app_id(view));
 
     /* Send keyboard focus */
     struct wlr_keyboard *keyboard = wlr_seat_get_keyboard(seat);
@@ -233,6 +359,7 @@ void view_raise(struct infinidesk_view *view) {
     /* Move view to the front of the list (top of stack) */
     wl_list_remove(&view->link);
     wl_list_insert(&server->views, &view->link);
+    view_cache_invalidate(&server->view_cache);
 
     /* Raise the scene node to the top */
     wlr_scene_node_raise_to_top(&view->scene_tree->node);
@@ -254,9 +381,24 @@ void view_get_geometry(struct infinidesk_view *view, double *x, double *y,
 void view_set_position(struct infinidesk_view *view, double x, double y) {
     view->x = x;
     view->y = y;
+    view_cache_invalidate(&view->server->view_cache);
     view_update_scene_position(view);
 }
 
+void view_translate(struct infinidesk_view *view, double dx, double dy) {
+    view->x += dx;
+    view->y += dy;
+    view->grab_x += dx;
+    view->grab_y += dy;
+    view->grab_view_x += dx;
+    view->grab_view_y += dy;
+    view->resize_grab_x += dx;
+    view->resize_grab_y += dy;
+    view->resize_start_x += dx;
+    view->resize_start_y += dy;
+    view_cache_invalidate(&view->server->view_cache);
+}
+
 void view_update_scene_position(struct infinidesk_view *view) {
     struct infinidesk_canvas *canvas = &view->server->canvas;
 
@@ -309,6 +451,7 @@ void view_move_update(struct infinidesk_view *view, double cursor_x,
     /* Move view by the delta */
     view->x = view->grab_view_x + delta_x;
     view->y = view->grab_view_y + delta_y;
+    view_cache_invalidate(&view->server->view_cache);
 
     /* Update scene position */
     view_update_scene_position(view);
@@ -427,6 +570,7 @@ void view_resize_update(struct infinidesk_view *view, double cursor_x,
     if (!(view->resize_edges & (WLR_EDGE_LEFT | WLR_EDGE_TOP))) {
         view->x = new_x;
         view->y = new_y;
+        view_cache_invalidate(&view->server->view_cache);
         view_update_scene_position(view);
     }
 
@@ -473,8 +617,10 @@ void view_snap(struct infinidesk_canvas *canvas, struct infinidesk_view *view,
         view_center_y - (output_height / 2.0) / canvas->scale;
 
     /* Start animation */
-    canvas->snap_anim_start_ms = get_time_ms();
+    canvas->snap_anim_start_ms = server_time_ms(view->server);
     canvas->snap_anim_active = true;
+    trace_instant(TRACE_TRACK_ANIMATION, "snap_begin", "%s",
+                  view_app_id(view));
 
     view_focus(view);
     view_raise(view);
@@ -498,116 +644,47 @@ void views_gather(struct infinidesk_server *server, double minimum_gap) {
     canvas_get_viewport_centre(&server->canvas, screen_width, screen_height,
                                &viewport_center_x, &viewport_center_y);
 
-    /* First, calculate initial centroid */
-    int count = 0;
-    double centroid_x = 0.0, centroid_y = 0.0;
-    struct infinidesk_view *view;
-
-    /* Go through the list of views, and add the centre points of each view */
-    wl_list_for_each(view, &server->views, link) {
-        struct wlr_box geo;
-        wlr_xdg_surface_get_geometry(view->xdg_toplevel->base, &geo);
-        centroid_x += view->x + geo.width / 2.0;
-        centroid_y += view->y + geo.height / 2.0;
-        count++;
-    }
-
-    /* Return if there are no views */
+    /* Collect each view's box, in list order */
+    uint32_t count = wl_list_length(&server->views);
     if (count == 0) {
+        /* Nothing to gather, and gather_boxes() would divide by zero */
+        return;
+    }
+    struct gather_box *boxes = calloc(count, sizeof(*boxes));
+    if (!boxes) {
+        wlr_log(WLR_ERROR, "Failed to allocate gather boxes");
         return;
     }
 
-    /* Divide the summed centres by the number of views to get the total centre
-     */
-    centroid_x /= count;
-    centroid_y /= count;
-
-    /* Scale factor to bring views closer to the centroid (0.5 = halfway) */
-    double scale_factor = 0.5;
-
-    /* Move each view closer to the centroid by scaling its vector from the
-     * centroid */
+    uint32_t i = 0;
+    struct infinidesk_view *view;
     wl_list_for_each(view, &server->views, link) {
         struct wlr_box geo;
         wlr_xdg_surface_get_geometry(view->xdg_toplevel->base, &geo);
+        boxes[i++] = (struct gather_box){
+            .x = view->x,
+            .y = view->y,
+            .width = geo.width,
+            .height = geo.height,
+        };
+    }
 
-        /* Calculate current view centre */
-        double view_center_x = view->x + geo.width / 2.0;
-        double view_center_y = view->y + geo.height / 2.0;
-
-        /* Calculate vector from centroid to view centre */
-        double vec_x = view_center_x - centroid_x;
-        double vec_y = view_center_y - centroid_y;
-
-        /* Calculate current distance from centroid */
-        double current_distance = sqrt(vec_x * vec_x + vec_y * vec_y);
-
-        /*
-         * Calculate minimum allowed distance based on view's bounding box.
-         * Use half the diagonal of the bounding box plus the minimum gap.
-         * This ensures the view's edge doesn't get closer than minimum_gap to
-         * the centroid.
-         */
-        double half_width = geo.width / 2.0;
-        double half_height = geo.height / 2.0;
-
-        /*
-         * For a more accurate minimum distance, calculate how far the edge of
-         * the bounding box is from the centre along the direction of the
-         * vector. This accounts for the view's aspect ratio and approach angle.
-         */
-        double min_distance;
-        if (current_distance < 0.001) {
-            /* View is already at centroid, no need to move */
-            min_distance = 0.0;
-        } else {
-            /* Normalise the vector to get direction */
-            double dir_x = vec_x / current_distance;
-            double dir_y = vec_y / current_distance;
-
-            /*
-             * Calculate intersection of the direction ray with the bounding
-             * box. The distance from centre to edge along direction (dir_x,
-             * dir_y) is: min(half_width / |dir_x|, half_height / |dir_y|) but
-             * we need to handle the case where dir_x or dir_y is zero.
-             */
-            double t_x =
-                (fabs(dir_x) > 0.001) ? half_width / fabs(dir_x) : INFINITY;
-            double t_y =
-                (fabs(dir_y) > 0.001) ? half_height / fabs(dir_y) : INFINITY;
-            double edge_distance = fmin(t_x, t_y);
-
-            /* Minimum distance is edge distance plus the gap */
-            min_distance = edge_distance + minimum_gap;
-        }
-
-        /* Calculate the new distance after scaling */
-        double new_distance = current_distance * scale_factor;
-
-        /* Clamp the new distance to not go below minimum */
-        if (new_distance < min_distance) {
-            new_distance = min_distance;
-        }
-
-        /* Calculate scale factor for this view (may differ from global
-         * scale_factor) */
-        double effective_scale =
-            (current_distance > 0.001) ? new_distance / current_distance : 1.0;
-
-        /* Scale the vector to get new position */
-        double new_center_x = centroid_x + vec_x * effective_scale;
-        double new_center_y = centroid_y + vec_y * effective_scale;
-
-        /* Set new view position (converting back from centre to top-left) */
-        view->x = new_center_x - geo.width / 2.0;
-        view->y = new_center_y - geo.height / 2.0;
+    double centroid_x, centroid_y;
+    gather_boxes(boxes, count, minimum_gap, &centroid_x, &centroid_y);
 
-        /* Update scene position */
+    /* Move the views to their new boxes */
+    i = 0;
+    wl_list_for_each(view, &server->views, link) {
+        view->x = boxes[i].x;
+        view->y = boxes[i].y;
+        i++;
         view_update_scene_position(view);
     }
+    view_cache_invalidate(&server->view_cache);
+    free(boxes);
 
     wlr_log(WLR_DEBUG,
-            "Gathered %d views towards centroid (%.1f, %.1f) with min gap %.1f",
+            "Gathered %u views towards centroid (%.1f, %.1f) with min gap %.1f",
             count, centroid_x, centroid_y, minimum_gap);
 }
 
@@ -659,14 +736,17 @@ static void handle_map(struct wl_listener *listener, void *data) {
         view->x = 0;
         view->y = 0;
     }
+    view_cache_invalidate(&server->view_cache);
 
     /* Update scene position */
     view_update_scene_position(view);
 
     /* Start entrance animation */
     view->map_animation = 0.0;
-    view->map_anim_start_ms = get_time_ms();
+    view->map_anim_start_ms = server_time_ms(server);
     view->is_animating_out = false;
+    trace_instant(TRACE_TRACK_ANIMATION, "map_begin", "%s",
+                  view_app_id(view));
 
     /* Focus and raise the new window */
     view_focus(view);
@@ -679,6 +759,8 @@ static void handle_unmap(struct wl_listener *listener, void *data) {
 
     wlr_log(WLR_DEBUG, "View %p unmapped", (void *)view);
 
+    view_cache_invalidate(&view->server->view_cache);
+
     /* If this view was being moved, end the move */
     if (view->is_moving) {
         view_move_end(view);
@@ -709,9 +791,9 @@ static void handle_destroy(struct wl_listener *listener, void *data) {
     view_destroy(view);
 }
 
-static void handle_commit(struct wl_listener *listener, void *data) {
-    (void)data;
-    struct infinidesk_view *view = wl_container_of(listener, view, commit);
+static void process_commit(struct infinidesk_view *view) {
+    view->commit_deferred = false;
+    view->commit_done_ms = server_time_ms(view->server);
 
     if (view->xdg_toplevel->base->initial_commit) {
         /* Schedule configure for initial commit */
@@ -722,6 +804,9 @@ static void handle_commit(struct wl_listener *listener, void *data) {
         return;
     }
 
+    /* The commit may have changed the window's size or geometry offset */
+    view_cache_invalidate(&view->server->view_cache);
+
     /*
      * During a left/top edge resize, synchronise the view position with
      * the client's actual committed size. This prevents jitter caused by
@@ -765,6 +850,60 @@ static void handle_commit(struct wl_listener *listener, void *data) {
     }
 }
 
+static void handle_commit(struct wl_listener *listener, void *data) {
+    (void)data;
+    struct infinidesk_view *view = wl_container_of(listener, view, commit);
+
+    struct infinidesk_server *server = view->server;
+    struct wlr_xdg_surface *xdg_surface = view->xdg_toplevel->base;
+
+    watchdog_enter(&server->watchdog, "view_commit");
+    trace_instant(TRACE_TRACK_CLIENTS, "commit", "%s", view_app_id(view));
+    latency_client_commit(&server->latency, xdg_surface->surface);
+    struct client_stats *client =
+        client_stats_commit(server, xdg_surface->surface, &view->commit_rate);
+
+    /*
+     * wlroots has already applied the new buffer, so all that can be put
+     * off is our own handling of it, which views_flush_commits() catches
+     * up on with the latest state.
+     */
+    if (client && client_stats_is_throttled(client) &&
+        xdg_surface->surface->mapped &&
+        !xdg_surface->initial_commit) {
+        if (view->commit_deferred) {
+            client->coalesced++;
+        }
+        view->commit_deferred = true;
+    } else {
+        process_commit(view);
+    }
+    watchdog_leave(&server->watchdog);
+}
+
+static void handle_new_subsurface(struct wl_listener *listener, void *data) {
+    struct infinidesk_view *view =
+        wl_container_of(listener, view, new_subsurface);
+    track_subsurface(view, data);
+}
+
+static void handle_configure(struct wl_listener *listener, void *data) {
+    struct infinidesk_view *view = wl_container_of(listener, view, configure);
+    struct wlr_xdg_surface_configure *configure = data;
+
+    trace_instant(TRACE_TRACK_CLIENTS, "configure", "%s serial %u",
+                  view_app_id(view), configure->serial);
+}
+
+static void handle_ack_configure(struct wl_listener *listener, void *data) {
+    struct infinidesk_view *view =
+        wl_container_of(listener, view, ack_configure);
+    struct wlr_xdg_surface_configure *configure = data;
+
+    trace_instant(TRACE_TRACK_CLIENTS, "ack_configure", "%s serial %u",
+                  view_app_id(view), configure->serial);
+}
+
 static void handle_request_move(struct wl_listener *listener, void *data) {
     (void)data;
     struct infinidesk_view *view =
@@ -822,7 +961,7 @@ static void handle_set_app_id(struct wl_listener *listener, void *data) {
     struct infinidesk_view *view = wl_container_of(listener, view, set_app_id);
 
     wlr_log(WLR_DEBUG, "View %p app_id: %s", (void *)view,
-            view->xdg_toplevel->app_id ?: "(null)");
+            view_app_id(view));
 }
 
 /*
@@ -837,6 +976,8 @@ struct render_data {
     int geo_x; /* Geometry offset to subtract from sx/sy */
     int geo_y;
     float opacity; /* Overall opacity for map/unmap animation */
+    bool prescale; /* Draw pre-scaled copies (pixman renderer only) */
+    const struct render_quality *quality;
 };
 
 /*
@@ -903,11 +1044,35 @@ static void render_surface_iterator(struct wlr_surface *surface, int sx, int sy,
      * - Otherwise: use bilinear for smooth scaling
      */
     enum wlr_scale_filter_mode filter = WLR_SCALE_FILTER_BILINEAR;
-    if (data->scale == 1.0 && buffer_scale == 1) {
+    if ((data->scale == 1.0 && buffer_scale == 1) ||
+        data->quality->nearest_filter) {
         filter = WLR_SCALE_FILTER_NEAREST;
     }
 
-    wlr_render_pass_add_texture(
+    /*
+     * Software rendering: draw a copy already scaled to the destination
+     * size, which pixman can blit without resampling.
+     */
+    if (data->prescale &&
+        (src_box.width != dst_width || src_box.height != dst_height)) {
+        struct wlr_texture *scaled = scaled_surface_get(
+            data->view->server->renderer, surface, texture, &src_box,
+            dst_width, dst_height, data->quality->stale_scaled);
+        if (scaled) {
+            /* A stale copy may still need stretching to fit */
+            texture = scaled;
+            src_box = (struct wlr_fbox){
+                .width = scaled->width,
+                .height = scaled->height,
+            };
+            if ((int)scaled->width == dst_width &&
+                (int)scaled->height == dst_height) {
+                filter = WLR_SCALE_FILTER_NEAREST;
+            }
+        }
+    }
+
+    perf_add_texture(
         data->pass, &(struct wlr_render_texture_options){
                         .texture = texture,
                         .src_box = src_box,
@@ -968,23 +1133,23 @@ static void render_border(struct wlr_render_pass *pass, int x, int y, int width,
     /* If no corner radius, just draw simple rectangles */
     if (corner_radius == 0) {
         /* Top */
-        wlr_render_pass_add_rect(
+        perf_add_rect(
             pass,
             &(struct wlr_render_rect_options){
                 .box = {.x = x, .y = y, .width = width, .height = border_width},
                 .color = colour,
             });
         /* Bottom */
-        wlr_render_pass_add_rect(pass,
-                                 &(struct wlr_render_rect_options){
-                                     .box = {.x = x,
-                                             .y = y + height - border_width,
-                                             .width = width,
-                                             .height = border_width},
-                                     .color = colour,
-                                 });
+        perf_add_rect(pass,
+                      &(struct wlr_render_rect_options){
+                          .box = {.x = x,
+                                  .y = y + height - border_width,
+                                  .width = width,
+                                  .height = border_width},
+                          .color = colour,
+                      });
         /* Left */
-        wlr_render_pass_add_rect(
+        perf_add_rect(
             pass, &(struct wlr_render_rect_options){
                       .box = {.x = x,
                               .y = y + border_width,
@@ -993,7 +1158,7 @@ static void render_border(struct wlr_render_pass *pass, int x, int y, int width,
                       .color = colour,
                   });
         /* Right */
-        wlr_render_pass_add_rect(
+        perf_add_rect(
             pass, &(struct wlr_render_rect_options){
                       .box = {.x = x + width - border_width,
                               .y = y + border_width,
@@ -1006,37 +1171,37 @@ static void render_border(struct wlr_render_pass *pass, int x, int y, int width,
 
     /* Top edge (between corners) */
     if (width > 2 * corner_radius) {
-        wlr_render_pass_add_rect(pass,
-                                 &(struct wlr_render_rect_options){
-                                     .box =
-                                         {
-                                             .x = x + corner_radius,
-                                             .y = y,
-                                             .width = width - 2 * corner_radius,
-                                             .height = border_width,
-                                         },
-                                     .color = colour,
-                                 });
+        perf_add_rect(pass,
+                      &(struct wlr_render_rect_options){
+                          .box =
+                              {
+                                  .x = x + corner_radius,
+                                  .y = y,
+                                  .width = width - 2 * corner_radius,
+                                  .height = border_width,
+                              },
+                          .color = colour,
+                      });
     }
 
     /* Bottom edge (between corners) */
     if (width > 2 * corner_radius) {
-        wlr_render_pass_add_rect(pass,
-                                 &(struct wlr_render_rect_options){
-                                     .box =
-                                         {
-                                             .x = x + corner_radius,
-                                             .y = y + height - border_width,
-                                             .width = width - 2 * corner_radius,
-                                             .height = border_width,
-                                         },
-                                     .color = colour,
-                                 });
+        perf_add_rect(pass,
+                      &(struct wlr_render_rect_options){
+                          .box =
+                              {
+                                  .x = x + corner_radius,
+                                  .y = y + height - border_width,
+                                  .width = width - 2 * corner_radius,
+                                  .height = border_width,
+                              },
+                          .color = colour,
+                      });
     }
 
     /* Left edge (between corners) */
     if (height > 2 * corner_radius) {
-        wlr_render_pass_add_rect(
+        perf_add_rect(
             pass, &(struct wlr_render_rect_options){
                       .box =
                           {
@@ -1051,7 +1216,7 @@ static void render_border(struct wlr_render_pass *pass, int x, int y, int width,
 
     /* Right edge (between corners) */
     if (height > 2 * corner_radius) {
-        wlr_render_pass_add_rect(
+        perf_add_rect(
             pass, &(struct wlr_render_rect_options){
                       .box =
                           {
@@ -1107,56 +1272,56 @@ static void render_border(struct wlr_render_pass *pass, int x, int y, int width,
             continue;
 
         /* Top-left corner */
-        wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-                                           .box =
-                                               {
-                                                   .x = x + seg_start,
-                                                   .y = y + row,
-                                                   .width = seg_width,
-                                                   .height = 1,
-                                               },
-                                           .color = colour,
-                                       });
+        perf_add_rect(pass, &(struct wlr_render_rect_options){
+                                .box =
+                                    {
+                                        .x = x + seg_start,
+                                        .y = y + row,
+                                        .width = seg_width,
+                                        .height = 1,
+                                    },
+                                .color = colour,
+                            });
 
         /* Top-right corner */
-        wlr_render_pass_add_rect(pass,
-                                 &(struct wlr_render_rect_options){
-                                     .box =
-                                         {
-                                             .x = x + width - corner_radius +
-                                                  (corner_radius - seg_end),
-                                             .y = y + row,
-                                             .width = seg_width,
-                                             .height = 1,
-                                         },
-                                     .color = colour,
-                                 });
+        perf_add_rect(pass,
+                      &(struct wlr_render_rect_options){
+                          .box =
+                              {
+                                  .x = x + width - corner_radius +
+                                       (corner_radius - seg_end),
+                                  .y = y + row,
+                                  .width = seg_width,
+                                  .height = 1,
+                              },
+                          .color = colour,
+                      });
 
         /* Bottom-left corner */
-        wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-                                           .box =
-                                               {
-                                                   .x = x + seg_start,
-                                                   .y = y + height - 1 - row,
-                                                   .width = seg_width,
-                                                   .height = 1,
-                                               },
-                                           .color = colour,
-                                       });
+        perf_add_rect(pass, &(struct wlr_render_rect_options){
+                                .box =
+                                    {
+                                        .x = x + seg_start,
+                                        .y = y + height - 1 - row,
+                                        .width = seg_width,
+                                        .height = 1,
+                                    },
+                                .color = colour,
+                            });
 
         /* Bottom-right corner */
-        wlr_render_pass_add_rect(pass,
-                                 &(struct wlr_render_rect_options){
-                                     .box =
-                                         {
-                                             .x = x + width - corner_radius +
-                                                  (corner_radius - seg_end),
-                                             .y = y + height - 1 - row,
-                                             .width = seg_width,
-                                             .height = 1,
-                                         },
-                                     .color = colour,
-                                 });
+        perf_add_rect(pass,
+                      &(struct wlr_render_rect_options){
+                          .box =
+                              {
+                                  .x = x + width - corner_radius +
+                                       (corner_radius - seg_end),
+                                  .y = y + height - 1 - row,
+                                  .width = seg_width,
+                                  .height = 1,
+                              },
+                          .color = colour,
+                      });
     }
 }
 
@@ -1199,7 +1364,7 @@ static void render_corner_masks(struct wlr_render_pass *pass, int x, int y,
             continue;
 
         /* Top-left corner mask */
-        wlr_render_pass_add_rect(
+        perf_add_rect(
             pass,
             &(struct wlr_render_rect_options){
                 .box = {.x = x, .y = y + row, .width = fill_width, .height = 1},
@@ -1207,36 +1372,36 @@ static void render_corner_masks(struct wlr_render_pass *pass, int x, int y,
             });
 
         /* Top-right corner mask */
-        wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-                                           .box = {.x = x + width - fill_width,
-                                                   .y = y + row,
-                                                   .width = fill_width,
-                                                   .height = 1},
-                                           .color = bg,
-                                       });
+        perf_add_rect(pass, &(struct wlr_render_rect_options){
+                                .box = {.x = x + width - fill_width,
+                                        .y = y + row,
+                                        .width = fill_width,
+                                        .height = 1},
+                                .color = bg,
+                            });
 
         /* Bottom-left corner mask */
-        wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-                                           .box = {.x = x,
-                                                   .y = y + height - 1 - row,
-                                                   .width = fill_width,
-                                                   .height = 1},
-                                           .color = bg,
-                                       });
+        perf_add_rect(pass, &(struct wlr_render_rect_options){
+                                .box = {.x = x,
+                                        .y = y + height - 1 - row,
+                                        .width = fill_width,
+                                        .height = 1},
+                                .color = bg,
+                            });
 
         /* Bottom-right corner mask */
-        wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-                                           .box = {.x = x + width - fill_width,
-                                                   .y = y + height - 1 - row,
-                                                   .width = fill_width,
-                                                   .height = 1},
-                                           .color = bg,
-                                       });
+        perf_add_rect(pass, &(struct wlr_render_rect_options){
+                                .box = {.x = x + width - fill_width,
+                                        .y = y + height - 1 - row,
+                                        .width = fill_width,
+                                        .height = 1},
+                                .color = bg,
+                            });
     }
 }
 
 void view_render(struct infinidesk_view *view, struct wlr_render_pass *pass,
-                 float output_scale) {
+                 float output_scale, const struct render_quality *quality) {
     struct infinidesk_canvas *canvas = &view->server->canvas;
     struct wlr_xdg_surface *xdg_surface = view->xdg_toplevel->base;
 
@@ -1336,6 +1501,10 @@ void view_render(struct infinidesk_view *view, struct wlr_render_pass *pass,
         .geo_x = geo.x,
         .geo_y = geo.y,
         .opacity = anim_opacity,
+        /* Not while animating in, when the size changes every frame */
+        .prescale = wlr_renderer_is_pixman(view->server->renderer) &&
+                    map_anim >= 1.0,
+        .quality = quality,
     };
 
     /*
@@ -1356,9 +1525,11 @@ void view_render(struct infinidesk_view *view, struct wlr_render_pass *pass,
     /* 2. Render corner masks over the content to create rounded corners */
     /* Note: Corner masks use fixed background colour, not affected by opacity
      */
-    render_corner_masks(pass, content_x, content_y, content_width,
-                        content_height, scaled_radius, BG_COLOUR_R, BG_COLOUR_G,
-                        BG_COLOUR_B, BG_COLOUR_A);
+    if (!quality->skip_corner_masks) {
+        render_corner_masks(pass, content_x, content_y, content_width,
+                            content_height, scaled_radius, BG_COLOUR_R,
+                            BG_COLOUR_G, BG_COLOUR_B, BG_COLOUR_A);
+    }
 
     /* 3. Render the border on top of everything */
     render_border(pass, border_x, border_y, border_width, border_height,
@@ -1367,7 +1538,8 @@ void view_render(struct infinidesk_view *view, struct wlr_render_pass *pass,
 }
 
 void view_render_popups(struct infinidesk_view *view,
-                        struct wlr_render_pass *pass, float output_scale) {
+                        struct wlr_render_pass *pass, float output_scale,
+                        const struct render_quality *quality) {
     struct infinidesk_canvas *canvas = &view->server->canvas;
     struct wlr_xdg_surface *xdg_surface = view->xdg_toplevel->base;
 
@@ -1406,6 +1578,8 @@ void view_render_popups(struct infinidesk_view *view,
         .geo_x = geo.x,
         .geo_y = geo.y,
         .opacity = 1.0f, /* Popups always fully opaque */
+        .prescale = wlr_renderer_is_pixman(view->server->renderer),
+        .quality = quality,
     };
 
     /*
@@ -1430,6 +1604,9 @@ void view_update_focus_animations(struct infinidesk_server *server,
                 /* Animation complete */
                 view->focus_animation = view->focused ? 1.0 : 0.0;
                 view->focus_anim_active = false;
+                trace_instant(TRACE_TRACK_ANIMATION,
+                              view->focused ? "focus_end" : "unfocus_end",
+                              "%s", view_app_id(view));
             } else {
                 /* Apply cubic ease-out */
                 double eased = ease_out_cubic(progress);
@@ -1451,6 +1628,8 @@ void view_update_focus_animations(struct infinidesk_server *server,
             if (progress >= 1.0) {
                 /* Animation complete */
                 view->map_animation = 1.0;
+                trace_instant(TRACE_TRACK_ANIMATION, "map_end", "%s",
+                              view_app_id(view));
             } else {
                 /* Apply cubic ease-out for smooth entrance */
                 view->map_animation = ease_out_cubic(progress);
@@ -1472,3 +1651,68 @@ bool view_any_animating(struct infinidesk_server *server) {
     }
     return false;
 }
+
+/* Whether a view has gone a whole off-screen period without being drawn */
+static bool view_offscreen(struct infinidesk_view *view, uint32_t time_ms) {
+    return time_ms - view->shown_ms > 1000 / CLIENT_OFFSCREEN_RATE;
+}
+
+void views_flush_commits(struct infinidesk_server *server, uint32_t time_ms) {
+    struct infinidesk_view *view;
+    wl_list_for_each(view, &server->views, link) {
+        if (!view->commit_deferred) {
+            continue;
+        }
+        if (view_offscreen(view, time_ms) &&
+            time_ms - view->commit_done_ms < 1000 / CLIENT_OFFSCREEN_RATE) {
+            continue;
+        }
+        process_commit(view);
+    }
+}
+
+bool view_frame_due(struct infinidesk_view *view, uint32_t time_ms) {
+    struct wl_client *wl_client =
+        wl_resource_get_client(view->xdg_toplevel->resource);
+    struct client_stats *client = client_stats_find(wl_client);
+    if (!client || !client_stats_is_throttled(client) ||
+        !view_offscreen(view, time_ms)) {
+        return true;
+    }
+
+    /*
+     * Paced: send it in one frame each period. Every output rendering that
+     * frame sends it, rather than just the first to ask.
+     */
+    if (time_ms != view->frame_done_ms &&
+        time_ms - view->frame_done_ms < 1000 / CLIENT_OFFSCREEN_RATE) {
+        return false;
+    }
+    view->frame_done_ms = time_ms;
+    return true;
+}
+
+/* Add up the bytes of client textures */
+static void texture_memory_iterator(struct wlr_surface *surface, int sx,
+                                    int sy, void *data) {
+    (void)sx;
+    (void)sy;
+    size_t *bytes = data;
+    struct wlr_texture *texture = wlr_surface_get_texture(surface);
+    if (texture) {
+        *bytes += (size_t)texture->width * texture->height * 4;
+    }
+}
+
+size_t view_texture_memory(struct infinidesk_view *view) {
+    size_t bytes = 0;
+    struct wlr_xdg_surface *xdg_surface = view->xdg_toplevel->base;
+    if (!xdg_surface->surface->mapped) {
+        return 0;
+    }
+    wlr_xdg_surface_for_each_surface(xdg_surface, texture_memory_iterator,
+                                     &bytes);
+    wlr_xdg_surface_for_each_popup_surface(xdg_surface,
+                                           texture_memory_iterator, &bytes);
+    return bytes;
+}
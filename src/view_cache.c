@@ -0,0 +1,352 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * view_cache.c - Packed view bounds for culling and hit testing
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+
+#include "infinidesk/view.h"
+#include "infinidesk/view_cache.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VIEW_CACHE_X86 1
+#endif
+
+/* Initial number of views the cache has room for (grows by doubling) */
+#define VIEW_CACHE_INITIAL_CAPACITY 16
+/* Room for borders drawn around a view's surfaces, in canvas units */
+#define VIEW_CACHE_DRAW_MARGIN 8.0
+
+/* Arrays of doubles in the cache's block */
+#define VIEW_CACHE_DOUBLE_ARRAYS 8
+
+#ifdef VIEW_CACHE_X86
+static bool have_avx2;
+#endif
+
+void view_cache_init(struct view_cache *cache) {
+    *cache = (struct view_cache){
+        .dirty = true,
+    };
+
+#ifdef VIEW_CACHE_X86
+    __builtin_cpu_init();
+    have_avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+void view_cache_finish(struct view_cache *cache) {
+    /* Every array lives in the block starting at x */
+    free(cache->x);
+    *cache = (struct view_cache){
+        .dirty = true,
+    };
+}
+
+void view_cache_invalidate(struct view_cache *cache) {
+    cache->dirty = true;
+}
+
+bool view_cache_reset(struct view_cache *cache, uint32_t count) {
+    cache->count = 0;
+    if (count <= cache->capacity) {
+        return true;
+    }
+
+    uint32_t capacity = cache->capacity ? cache->capacity
+                                        : VIEW_CACHE_INITIAL_CAPACITY;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    /* One block holds every array, doubles first to keep them aligned */
+    size_t per_view = VIEW_CACHE_DOUBLE_ARRAYS * sizeof(double) +
+                      sizeof(struct infinidesk_view *) +
+                      2 * sizeof(int32_t) + sizeof(uint32_t);
+    double *block = malloc(capacity * per_view);
+    if (!block) {
+        return false;
+    }
+    free(cache->x);
+
+    double *doubles = block;
+    double **arrays[VIEW_CACHE_DOUBLE_ARRAYS] = {
+        &cache->x,      &cache->y,      &cache->w,      &cache->h,
+        &cache->draw_x, &cache->draw_y, &cache->draw_w, &cache->draw_h,
+    };
+    for (int i = 0; i < VIEW_CACHE_DOUBLE_ARRAYS; i++) {
+        *arrays[i] = doubles + (size_t)i * capacity;
+    }
+    double *end = doubles + (size_t)VIEW_CACHE_DOUBLE_ARRAYS * capacity;
+    cache->views = (struct infinidesk_view **)end;
+    cache->geo_x = (int32_t *)(cache->views + capacity);
+    cache->geo_y = cache->geo_x + capacity;
+    cache->visible = (uint32_t *)(cache->geo_y + capacity);
+
+    cache->capacity = capacity;
+    return true;
+}
+
+void view_cache_add(struct view_cache *cache, struct infinidesk_view *view,
+                    double x, double y, const struct wlr_box *geo,
+                    const struct wlr_box *extents) {
+    /*
+     * The surface is rendered with its geometry offset in front of the
+     * view position; see view_render().
+     */
+    uint32_t i = cache->count++;
+    double surface_x = x - geo->x;
+    double surface_y = y - geo->y;
+    cache->views[i] = view;
+    cache->geo_x[i] = geo->x;
+    cache->geo_y[i] = geo->y;
+    cache->x[i] = surface_x;
+    cache->y[i] = surface_y;
+    cache->w[i] = geo->width;
+    cache->h[i] = geo->height;
+
+    /* Subsurfaces and CSD shadows can reach past the geometry */
+    double min_x = fmin(surface_x, surface_x + extents->x);
+    double min_y = fmin(surface_y, surface_y + extents->y);
+    double max_x = fmax(surface_x + geo->width,
+                        surface_x + extents->x + extents->width);
+    double max_y = fmax(surface_y + geo->height,
+                        surface_y + extents->y + extents->height);
+    cache->draw_x[i] = min_x - VIEW_CACHE_DRAW_MARGIN;
+    cache->draw_y[i] = min_y - VIEW_CACHE_DRAW_MARGIN;
+    cache->draw_w[i] = max_x - min_x + 2.0 * VIEW_CACHE_DRAW_MARGIN;
+    cache->draw_h[i] = max_y - min_y + 2.0 * VIEW_CACHE_DRAW_MARGIN;
+}
+
+bool view_cache_update(struct view_cache *cache, struct wl_list *views) {
+    if (!cache->dirty) {
+        return true;
+    }
+
+    uint32_t count = 0;
+    struct infinidesk_view *view;
+    wl_list_for_each(view, views, link) {
+        count++;
+    }
+    if (!view_cache_reset(cache, count)) {
+        wlr_log(WLR_ERROR, "Failed to allocate view cache");
+        return false;
+    }
+
+    /* The list is ordered front to back, and so is the cache */
+    wl_list_for_each(view, views, link) {
+        struct wlr_xdg_surface *xdg_surface = view->xdg_toplevel->base;
+        if (!xdg_surface->surface->mapped) {
+            continue;
+        }
+
+        struct wlr_box geo, extents;
+        wlr_xdg_surface_get_geometry(xdg_surface, &geo);
+        wlr_surface_get_extents(xdg_surface->surface, &extents);
+        view_cache_add(cache, view, view->x, view->y, &geo, &extents);
+    }
+
+    cache->dirty = false;
+    return true;
+}
+
+struct cull_rect {
+    double min_x, min_y, max_x, max_y;
+};
+
+/*
+ * Vector kernels start at a given index, handle whole groups of views and
+ * report how far they got; narrower kernels and the scalar loops finish the
+ * rest. Comparisons match the scalar loops exactly.
+ */
+
+#ifdef VIEW_CACHE_X86
+
+__attribute__((target("avx2"))) static uint32_t
+cull_avx2(struct view_cache *cache, const struct cull_rect *rect,
+          uint32_t start, uint32_t *found) {
+    __m256d min_x = _mm256_set1_pd(rect->min_x);
+    __m256d min_y = _mm256_set1_pd(rect->min_y);
+    __m256d max_x = _mm256_set1_pd(rect->max_x);
+    __m256d max_y = _mm256_set1_pd(rect->max_y);
+
+    uint32_t i = start;
+    for (; i + 4 <= cache->count; i += 4) {
+        __m256d x0 = _mm256_loadu_pd(&cache->draw_x[i]);
+        __m256d y0 = _mm256_loadu_pd(&cache->draw_y[i]);
+        __m256d x1 = _mm256_add_pd(x0, _mm256_loadu_pd(&cache->draw_w[i]));
+        __m256d y1 = _mm256_add_pd(y0, _mm256_loadu_pd(&cache->draw_h[i]));
+
+        __m256d in_x = _mm256_and_pd(_mm256_cmp_pd(x0, max_x, _CMP_LE_OQ),
+                                     _mm256_cmp_pd(x1, min_x, _CMP_GE_OQ));
+        __m256d in_y = _mm256_and_pd(_mm256_cmp_pd(y0, max_y, _CMP_LE_OQ),
+                                     _mm256_cmp_pd(y1, min_y, _CMP_GE_OQ));
+        unsigned mask = _mm256_movemask_pd(_mm256_and_pd(in_x, in_y));
+        while (mask) {
+            cache->visible[(*found)++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) static int32_t
+find_avx2(const struct view_cache *cache, uint32_t *start, double x,
+          double y, double margin) {
+    __m256d px = _mm256_set1_pd(x);
+    __m256d py = _mm256_set1_pd(y);
+    __m256d m = _mm256_set1_pd(margin);
+
+    uint32_t i = *start;
+    for (; i + 4 <= cache->count; i += 4) {
+        __m256d bx = _mm256_loadu_pd(&cache->x[i]);
+        __m256d by = _mm256_loadu_pd(&cache->y[i]);
+        __m256d left = _mm256_sub_pd(bx, m);
+        __m256d top = _mm256_sub_pd(by, m);
+        __m256d right = _mm256_add_pd(
+            _mm256_add_pd(bx, _mm256_loadu_pd(&cache->w[i])), m);
+        __m256d bottom = _mm256_add_pd(
+            _mm256_add_pd(by, _mm256_loadu_pd(&cache->h[i])), m);
+
+        __m256d in_x = _mm256_and_pd(_mm256_cmp_pd(px, left, _CMP_GE_OQ),
+                                     _mm256_cmp_pd(px, right, _CMP_LT_OQ));
+        __m256d in_y = _mm256_and_pd(_mm256_cmp_pd(py, top, _CMP_GE_OQ),
+                                     _mm256_cmp_pd(py, bottom, _CMP_LT_OQ));
+        unsigned mask = _mm256_movemask_pd(_mm256_and_pd(in_x, in_y));
+        if (mask) {
+            return (int32_t)(i + __builtin_ctz(mask));
+        }
+    }
+    *start = i;
+    return -1;
+}
+#endif
+
+#ifdef __SSE2__
+static uint32_t cull_sse2(struct view_cache *cache,
+                          const struct cull_rect *rect, uint32_t start,
+                          uint32_t *found) {
+    __m128d min_x = _mm_set1_pd(rect->min_x);
+    __m128d min_y = _mm_set1_pd(rect->min_y);
+    __m128d max_x = _mm_set1_pd(rect->max_x);
+    __m128d max_y = _mm_set1_pd(rect->max_y);
+
+    uint32_t i = start;
+    for (; i + 2 <= cache->count; i += 2) {
+        __m128d x0 = _mm_loadu_pd(&cache->draw_x[i]);
+        __m128d y0 = _mm_loadu_pd(&cache->draw_y[i]);
+        __m128d x1 = _mm_add_pd(x0, _mm_loadu_pd(&cache->draw_w[i]));
+        __m128d y1 = _mm_add_pd(y0, _mm_loadu_pd(&cache->draw_h[i]));
+
+        __m128d in_x =
+            _mm_and_pd(_mm_cmple_pd(x0, max_x), _mm_cmpge_pd(x1, min_x));
+        __m128d in_y =
+            _mm_and_pd(_mm_cmple_pd(y0, max_y), _mm_cmpge_pd(y1, min_y));
+        unsigned mask = _mm_movemask_pd(_mm_and_pd(in_x, in_y));
+        while (mask) {
+            cache->visible[(*found)++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return i;
+}
+
+static int32_t find_sse2(const struct view_cache *cache, uint32_t *start,
+                         double x, double y, double margin) {
+    __m128d px = _mm_set1_pd(x);
+    __m128d py = _mm_set1_pd(y);
+    __m128d m = _mm_set1_pd(margin);
+
+    uint32_t i = *start;
+    for (; i + 2 <= cache->count; i += 2) {
+        __m128d bx = _mm_loadu_pd(&cache->x[i]);
+        __m128d by = _mm_loadu_pd(&cache->y[i]);
+        __m128d left = _mm_sub_pd(bx, m);
+        __m128d top = _mm_sub_pd(by, m);
+        __m128d right =
+            _mm_add_pd(_mm_add_pd(bx, _mm_loadu_pd(&cache->w[i])), m);
+        __m128d bottom =
+            _mm_add_pd(_mm_add_pd(by, _mm_loadu_pd(&cache->h[i])), m);
+
+        __m128d in_x =
+            _mm_and_pd(_mm_cmpge_pd(px, left), _mm_cmplt_pd(px, right));
+        __m128d in_y =
+            _mm_and_pd(_mm_cmpge_pd(py, top), _mm_cmplt_pd(py, bottom));
+        unsigned mask = _mm_movemask_pd(_mm_and_pd(in_x, in_y));
+        if (mask) {
+            return (int32_t)(i + __builtin_ctz(mask));
+        }
+    }
+    *start = i;
+    return -1;
+}
+#endif
+
+uint32_t view_cache_cull(struct view_cache *cache, double min_x, double min_y,
+                         double max_x, double max_y) {
+    struct cull_rect rect = {min_x, min_y, max_x, max_y};
+    uint32_t found = 0;
+    uint32_t i = 0;
+
+#ifdef VIEW_CACHE_X86
+    if (have_avx2) {
+        i = cull_avx2(cache, &rect, i, &found);
+    }
+#endif
+#ifdef __SSE2__
+    i = cull_sse2(cache, &rect, i, &found);
+#endif
+
+    for (; i < cache->count; i++) {
+        if (cache->draw_x[i] <= max_x &&
+            cache->draw_x[i] + cache->draw_w[i] >= min_x &&
+            cache->draw_y[i] <= max_y &&
+            cache->draw_y[i] + cache->draw_h[i] >= min_y) {
+            cache->visible[found++] = i;
+        }
+    }
+    return found;
+}
+
+int32_t view_cache_find(const struct view_cache *cache, uint32_t start,
+                        double x, double y, double margin) {
+    uint32_t i = start;
+
+#ifdef VIEW_CACHE_X86
+    if (have_avx2) {
+        int32_t index = find_avx2(cache, &i, x, y, margin);
+        if (index >= 0) {
+            return index;
+        }
+    }
+#endif
+#ifdef __SSE2__
+    int32_t index = find_sse2(cache, &i, x, y, margin);
+    if (index >= 0) {
+        return index;
+    }
+#endif
+
+    for (; i < cache->count; i++) {
+        double left = cache->x[i] - margin;
+        double top = cache->y[i] - margin;
+        double right = cache->x[i] + cache->w[i] + margin;
+        double bottom = cache->y[i] + cache->h[i] + margin;
+        if (x >= left && x < right && y >= top && y < bottom) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
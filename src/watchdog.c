@@ -0,0 +1,139 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * watchdog.c - Main loop stall detection
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+
+#include <wlr/util/log.h>
+
+#include "infinidesk/perf.h"
+#include "infinidesk/trace.h"
+#include "infinidesk/watchdog.h"
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void watchdog_init(struct infinidesk_watchdog *watchdog,
+                   uint32_t threshold_ms) {
+    *watchdog = (struct infinidesk_watchdog){
+        .threshold_ns = (uint64_t)threshold_ms * 1000000,
+    };
+}
+
+void watchdog_dispatch_begin(struct infinidesk_watchdog *watchdog) {
+    if (watchdog->threshold_ns == 0) {
+        return;
+    }
+
+    watchdog->dispatch_start_ns = get_time_ns();
+    watchdog->section_count = 0;
+    watchdog->sections_dropped = 0;
+    watchdog->depth = 0;
+}
+
+void watchdog_dispatch_end(struct infinidesk_watchdog *watchdog,
+                           const char *name) {
+    if (watchdog->threshold_ns == 0) {
+        return;
+    }
+
+    uint64_t ns = get_time_ns() - watchdog->dispatch_start_ns;
+    watchdog->dispatches++;
+    if (ns < watchdog->threshold_ns) {
+        return;
+    }
+
+    watchdog->stalls++;
+    watchdog->stall_ns_total += ns;
+    watchdog->last_stall_ns = ns;
+    if (ns > watchdog->max_stall_ns) {
+        watchdog->max_stall_ns = ns;
+    }
+
+    wlr_log(WLR_INFO, "Main loop stalled for %.1f ms in %s", ns / 1e6, name);
+    for (uint32_t i = 0; i < watchdog->section_count; i++) {
+        const struct watchdog_section *section = &watchdog->sections[i];
+        wlr_log(WLR_INFO, "  %*s%-20s %7.2f ms", (int)section->depth * 2, "",
+                section->name, section->ns / 1e6);
+    }
+    if (watchdog->section_count == 0) {
+        wlr_log(WLR_INFO, "  (no marked handler ran)");
+    }
+    if (watchdog->sections_dropped > 0) {
+        wlr_log(WLR_INFO, "  (%u more handlers)", watchdog->sections_dropped);
+    }
+
+    trace_complete(TRACE_TRACK_CLIENTS, "stall",
+                   trace_active() ? watchdog->dispatch_start_ns : 0, "%s",
+                   name);
+}
+
+void watchdog_enter(struct infinidesk_watchdog *watchdog, const char *name) {
+    if (watchdog->threshold_ns == 0) {
+        return;
+    }
+
+    /* Too deep: the section is counted in its parent */
+    if (watchdog->depth < WATCHDOG_MAX_DEPTH) {
+        watchdog->stack[watchdog->depth].name = name;
+        watchdog->stack[watchdog->depth].start_ns = get_time_ns();
+        watchdog->stack[watchdog->depth].first = watchdog->section_count;
+    }
+    watchdog->depth++;
+}
+
+void watchdog_leave(struct infinidesk_watchdog *watchdog) {
+    if (watchdog->threshold_ns == 0 || watchdog->depth == 0) {
+        return;
+    }
+
+    uint32_t depth = --watchdog->depth;
+    if (depth >= WATCHDOG_MAX_DEPTH) {
+        return;
+    }
+    if (watchdog->section_count == WATCHDOG_MAX_SECTIONS) {
+        watchdog->sections_dropped++;
+        return;
+    }
+
+    /*
+     * Sections are recorded as they end, so inner ones come before the
+     * section containing them; shift those along to keep the log in the
+     * order the handlers started.
+     */
+    uint32_t first = watchdog->stack[depth].first;
+    for (uint32_t i = watchdog->section_count; i > first; i--) {
+        watchdog->sections[i] = watchdog->sections[i - 1];
+    }
+    watchdog->sections[first] = (struct watchdog_section){
+        .name = watchdog->stack[depth].name,
+        .depth = depth,
+        .ns = get_time_ns() - watchdog->stack[depth].start_ns,
+    };
+    watchdog->section_count++;
+}
+
+void watchdog_frame(struct infinidesk_watchdog *watchdog,
+                    const char *output_name, const struct perf_sample *sample) {
+    if (watchdog->threshold_ns == 0 ||
+        sample->ns[PERF_TOTAL] < watchdog->threshold_ns) {
+        return;
+    }
+
+    watchdog->frame_stalls++;
+    wlr_log(WLR_INFO, "Frame on %s took %.1f ms:", output_name,
+            sample->ns[PERF_TOTAL] / 1e6);
+    for (unsigned int stage = 0; stage < PERF_STAGE_COUNT; stage++) {
+        wlr_log(WLR_INFO, "  %-10s %7.2f ms", perf_stage_name(stage),
+                sample->ns[stage] / 1e6);
+    }
+}
@@ -0,0 +1,142 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * tests/chunk_store.c - Chunk file writing and garbage collection
+ *
+ * Writes chunk files into a scratch directory and collects them more than
+ * once, as a long session's checkpoints do, checking each collect deletes
+ * exactly the files no longer kept.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <wayland-server-core.h>
+
+#include "infinidesk/chunk_store.h"
+
+static int failures;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #cond);                                                  \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+/* Keeps only the chunk files of one generation */
+static bool keep_generation(int32_t x, int32_t y, uint64_t generation,
+                            void *data) {
+    (void)x;
+    (void)y;
+    return generation == *(uint64_t *)data;
+}
+
+static void ignore_load(int32_t x, int32_t y, uint64_t generation,
+                        void *records, size_t size, void *data) {
+    (void)x;
+    (void)y;
+    (void)generation;
+    (void)size;
+    (void)data;
+    free(records);
+}
+
+static int count_files(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return -1;
+    }
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] != '.') {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static void write_generation(struct chunk_store *store, uint64_t generation,
+                             int count) {
+    static const char records[] = "records";
+    for (int i = 0; i < count; i++) {
+        CHECK(chunk_store_write(store, i, -i, generation, records,
+                                sizeof(records)));
+    }
+}
+
+static void remove_dir(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir))) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            char file[4096];
+            snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+            unlink(file);
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+int main(void) {
+    char dir[] = "/tmp/infinidesk-test-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    char path[sizeof(dir) + sizeof("/chunks")];
+    snprintf(path, sizeof(path), "%s/chunks", dir);
+
+    struct wl_event_loop *loop = wl_event_loop_create();
+    struct chunk_store *store =
+        loop ? chunk_store_create(path, loop, ignore_load, NULL) : NULL;
+    if (!store) {
+        fprintf(stderr, "Failed to create the chunk store\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Each collect must see every file, not just the first */
+    for (uint64_t generation = 1; generation <= 3; generation++) {
+        write_generation(store, generation, 5);
+        CHECK(count_files(path) == (generation == 1 ? 5 : 10));
+        chunk_store_collect(store, keep_generation, &generation);
+        CHECK(count_files(path) == 5);
+
+        size_t size;
+        void *records = chunk_store_read(store, 4, -4, generation, &size);
+        CHECK(records && size == sizeof("records"));
+        free(records);
+    }
+
+    /* Keeping nothing leaves nothing */
+    uint64_t none = 0;
+    chunk_store_collect(store, keep_generation, &none);
+    CHECK(count_files(path) == 0);
+
+    chunk_store_destroy(store);
+    wl_event_loop_destroy(loop);
+    remove_dir(path);
+    rmdir(dir);
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("chunk store: ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * tests/commit_rate.c - Commit rate measurement and throttling decisions
+ *
+ * Drives a client's commit rate through simulated time, deciding after
+ * each commit whether it is throttled as client_stats_commit() does, and
+ * checks clients near the limit aren't throttled and let off over and over.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "infinidesk/commit_rate.h"
+
+#define LIMIT 300
+
+static int failures;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #cond);                                                  \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+/* A simulated client, throttled as the compositor would */
+struct client {
+    struct commit_rate rate;
+    uint32_t now_ms;
+    bool throttled;
+    uint32_t changed_ms;
+    uint32_t episodes;
+    uint32_t releases;
+};
+
+static void commit(struct client *client) {
+    commit_rate_add(&client->rate, client->now_ms, 0);
+    bool over = commit_rate_over_limit(&client->rate, LIMIT, client->throttled,
+                                       client->now_ms - client->changed_ms);
+    if (over != client->throttled) {
+        client->throttled = over;
+        client->changed_ms = client->now_ms;
+        if (over) {
+            client->episodes++;
+        } else {
+            client->releases++;
+        }
+    }
+}
+
+/* Commit evenly at hz for ms, then move the clock to the end */
+static void run(struct client *client, uint32_t hz, uint32_t ms) {
+    uint32_t start_ms = client->now_ms;
+    for (uint64_t i = 0; i < (uint64_t)hz * ms / 1000; i++) {
+        client->now_ms = start_ms + (uint32_t)(i * 1000 / hz);
+        commit(client);
+    }
+    client->now_ms = start_ms + ms;
+}
+
+int main(void) {
+    /* Steadily over the limit: throttled once, and kept throttled */
+    struct client steady = {0};
+    run(&steady, 330, 60000);
+    CHECK(steady.throttled);
+    CHECK(steady.episodes == 1);
+    CHECK(steady.releases == 0);
+
+    /* Steadily just under it: never throttled */
+    struct client under = {0};
+    run(&under, 290, 60000);
+    CHECK(!under.throttled);
+    CHECK(under.episodes == 0);
+
+    /* Wavering either side of the limit: throttled once, not flapping */
+    struct client wavering = {0};
+    for (int i = 0; i < 30; i++) {
+        run(&wavering, i % 2 ? 280 : 320, CLIENT_RATE_WINDOW_MS);
+    }
+    CHECK(wavering.episodes == 1);
+    CHECK(wavering.releases == 0);
+
+    /* Slowing down well under the limit lets it off, but not straight away */
+    struct client slowing = {0};
+    run(&slowing, 400, 3000);
+    CHECK(slowing.throttled);
+    uint32_t throttled_ms = slowing.changed_ms;
+    run(&slowing, 60, 2000);
+    CHECK(slowing.throttled);
+    run(&slowing, 60, 10000);
+    CHECK(!slowing.throttled);
+    CHECK(slowing.changed_ms - throttled_ms >= CLIENT_THROTTLE_HOLD_MS);
+
+    /* Going quiet counts as slowing down once it commits again */
+    struct client quiet = {0};
+    run(&quiet, 400, 10000);
+    CHECK(quiet.throttled);
+    quiet.now_ms += 5000;
+    commit(&quiet);
+    commit(&quiet);
+    quiet.now_ms += CLIENT_RATE_WINDOW_MS;
+    commit(&quiet);
+    CHECK(!quiet.throttled);
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("commit rate: ok\n");
+    return EXIT_SUCCESS;
+}
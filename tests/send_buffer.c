@@ -0,0 +1,132 @@
+/*
+ * Infinidesk - Infinite Canvas Wayland Compositor
+ * Copyright (c) 2025
+ * SPDX-License-Identifier: MIT
+ *
+ * tests/send_buffer.c - Sending to slow readers and ones that go away
+ *
+ * Sends more than a socket holds to a reader that takes it a piece at a
+ * time, then to readers that close their end early. SIGPIPE is left at its
+ * default, so a send that raised it would kill the test rather than pass.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "infinidesk/send_buffer.h"
+
+#define TEXT_SIZE (4 * 1024 * 1024)
+
+static int failures;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #cond);                                                  \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+/* A connected pair, with the sending end non-blocking as a scraper's is */
+static void make_pair(int fds[2]) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("socketpair");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+}
+
+/* Text to send, with a pattern that shows where it was cut */
+static void make_text(struct send_buffer *buffer, size_t size) {
+    buffer->data = malloc(size);
+    if (!buffer->data) {
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < size; i++) {
+        buffer->data[i] = (char)(i % 251);
+    }
+    buffer->size = size;
+    buffer->sent = 0;
+}
+
+/* Read up to max bytes, checking they are the next ones of the text */
+static size_t drain(int fd, const struct send_buffer *buffer, size_t *offset,
+                    size_t max) {
+    char chunk[65536];
+    size_t total = 0;
+    while (total < max) {
+        size_t want = max - total < sizeof(chunk) ? max - total : sizeof(chunk);
+        ssize_t n = read(fd, chunk, want);
+        if (n <= 0) {
+            break;
+        }
+        CHECK(memcmp(chunk, buffer->data + *offset, n) == 0);
+        *offset += n;
+        total += n;
+    }
+    return total;
+}
+
+int main(void) {
+    int fds[2];
+
+    /* A slow reader is sent everything, a socketful at a time */
+    make_pair(fds);
+    struct send_buffer slow;
+    make_text(&slow, TEXT_SIZE);
+    size_t offset = 0;
+    int rounds = 0;
+    enum send_result result;
+    while ((result = send_buffer_flush(&slow, fds[0])) == SEND_PENDING) {
+        CHECK(slow.sent < slow.size);
+        CHECK(slow.sent - offset > 0);
+        drain(fds[1], &slow, &offset, slow.sent - offset);
+        rounds++;
+    }
+    CHECK(result == SEND_DONE);
+    CHECK(rounds > 0);
+    CHECK(slow.sent == slow.size);
+    drain(fds[1], &slow, &offset, slow.size - offset);
+    CHECK(offset == slow.size);
+    send_buffer_finish(&slow);
+    close(fds[0]);
+    close(fds[1]);
+
+    /* A reader that closes its end partway through fails the send */
+    make_pair(fds);
+    struct send_buffer early;
+    make_text(&early, TEXT_SIZE);
+    CHECK(send_buffer_flush(&early, fds[0]) == SEND_PENDING);
+    offset = 0;
+    drain(fds[1], &early, &offset, 4096);
+    close(fds[1]);
+    size_t sent = early.sent;
+    CHECK(send_buffer_flush(&early, fds[0]) == SEND_FAILED);
+    CHECK(early.sent >= sent && early.sent < early.size);
+    send_buffer_finish(&early);
+    close(fds[0]);
+
+    /* As does one that closes it before anything was sent */
+    make_pair(fds);
+    struct send_buffer gone;
+    make_text(&gone, 1024);
+    close(fds[1]);
+    CHECK(send_buffer_flush(&gone, fds[0]) == SEND_FAILED);
+    CHECK(gone.sent == 0);
+    send_buffer_finish(&gone);
+    close(fds[0]);
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("send buffer: ok\n");
+    return EXIT_SUCCESS;
+}